@@ -1,29 +1,46 @@
-
 /* Public domain FFT implementation from Don Cross. */
 
 #include "Cross.h"
 
 #include <math.h>
 #include <stdio.h>
-
-void
-fftCross(unsigned int n, int inverse,
-	 const double *ri, const double *ii,
-	 double *ro, double *io)
+#include <stdlib.h>
+
+struct FFTCrossPlan {
+    unsigned int n;
+    unsigned int *table;
+
+    /* Twiddles for each stage in turn: the stage with butterflies
+       blockEnd apart uses the blockEnd entries starting at index
+       blockEnd - 1. These are the forward twiddles; the inverse uses
+       their conjugates. */
+    double *twr;
+    double *twi;
+};
+
+FFTCrossPlan *
+fftCrossPlan(unsigned int n)
 {
-    if (!ri || !ro || !io) return;
-
+    FFTCrossPlan *plan;
     unsigned int bits;
     unsigned int i, j, k, m;
-    unsigned int blockSize, blockEnd;
+    unsigned int blockEnd;
 
-    double tr, ti;
+    if (n < 2) return 0;
+    if (n & (n-1)) return 0;
 
-    if (n < 2) return;
-    if (n & (n-1)) return;
+    plan = (FFTCrossPlan *)malloc(sizeof(FFTCrossPlan));
+    if (!plan) return 0;
 
-    double angle = 2.0 * M_PI;
-    if (inverse) angle = -angle;
+    plan->n = n;
+    plan->table = (unsigned int *)malloc(n * sizeof(unsigned int));
+    plan->twr = (double *)malloc(n * sizeof(double));
+    plan->twi = (double *)malloc(n * sizeof(double));
+
+    if (!plan->table || !plan->twr || !plan->twi) {
+	fftCrossDestroy(plan);
+	return 0;
+    }
 
     for (i = 0; ; ++i) {
 	if (n & (1 << i)) {
@@ -32,66 +49,102 @@ fftCross(unsigned int n, int inverse,
 	}
     }
 
-#ifdef _MSC_VER
-    int *table = (int *)_malloca(n * sizeof(int));
-#else
-    int table[n];
-#endif
-
     for (i = 0; i < n; ++i) {
         m = i;
         for (j = k = 0; j < bits; ++j) {
             k = (k << 1) | (m & 1);
             m >>= 1;
         }
-        table[i] = k;
+        plan->table[i] = k;
     }
 
-    if (ii) {
+    /* Computed directly rather than by recurrence, which loses
+       accuracy as the size grows */
+
+    for (blockEnd = 1; blockEnd < n; blockEnd <<= 1) {
+	double delta = M_PI / (double)blockEnd;
+	for (m = 0; m < blockEnd; ++m) {
+	    plan->twr[blockEnd - 1 + m] = cos(delta * m);
+	    plan->twi[blockEnd - 1 + m] = -sin(delta * m);
+	}
+    }
+
+    return plan;
+}
+
+void
+fftCrossDestroy(FFTCrossPlan *plan)
+{
+    if (!plan) return;
+    free(plan->table);
+    free(plan->twr);
+    free(plan->twi);
+    free(plan);
+}
+
+static void
+permute(const FFTCrossPlan *plan, const double *in, double *out)
+{
+    const unsigned int n = plan->n;
+    const unsigned int *table = plan->table;
+    unsigned int i;
+
+    if (in == out) {
+	for (i = 0; i < n; ++i) {
+	    unsigned int k = table[i];
+	    if (k > i) {
+		double t = out[i];
+		out[i] = out[k];
+		out[k] = t;
+	    }
+	}
+    } else if (in) {
 	for (i = 0; i < n; ++i) {
-	    ro[table[i]] = ri[i];
-	    io[table[i]] = ii[i];
+	    out[table[i]] = in[i];
 	}
     } else {
 	for (i = 0; i < n; ++i) {
-	    ro[table[i]] = ri[i];
-	    io[table[i]] = 0.0;
+	    out[i] = 0.0;
 	}
     }
+}
+
+void
+fftCrossExecute(const FFTCrossPlan *plan, int inverse,
+		const double *ri, const double *ii,
+		double *ro, double *io)
+{
+    unsigned int n;
+    unsigned int i, j, k, m;
+    unsigned int blockSize, blockEnd;
+
+    double tr, ti;
+    double sign = (inverse ? -1.0 : 1.0);
+
+    if (!plan || !ri || !ro || !io) return;
+
+    n = plan->n;
+
+    permute(plan, ri, ro);
+    permute(plan, ii, io);
 
     blockEnd = 1;
 
     for (blockSize = 2; blockSize <= n; blockSize <<= 1) {
 
-	double delta = angle / (double)blockSize;
-	double sm2 = -sin(-2 * delta);
-	double sm1 = -sin(-delta);
-	double cm2 = cos(-2 * delta);
-	double cm1 = cos(-delta);
-	double w = 2 * cm1;
-	double ar[3], ai[3];
+	const double *twr = plan->twr + blockEnd - 1;
+	const double *twi = plan->twi + blockEnd - 1;
 
 	for (i = 0; i < n; i += blockSize) {
 
-	    ar[2] = cm2;
-	    ar[1] = cm1;
-
-	    ai[2] = sm2;
-	    ai[1] = sm1;
-
 	    for (j = i, m = 0; m < blockEnd; j++, m++) {
 
-		ar[0] = w * ar[1] - ar[2];
-		ar[2] = ar[1];
-		ar[1] = ar[0];
-
-		ai[0] = w * ai[1] - ai[2];
-		ai[2] = ai[1];
-		ai[1] = ai[0];
+		double wr = twr[m];
+		double wi = sign * twi[m];
 
 		k = j + blockEnd;
-		tr = ar[0] * ro[k] - ai[0] * io[k];
-		ti = ar[0] * io[k] + ai[0] * ro[k];
+		tr = wr * ro[k] - wi * io[k];
+		ti = wr * io[k] + wi * ro[k];
 
 		ro[k] = ro[j] - tr;
 		io[k] = io[j] - ti;
@@ -113,9 +166,21 @@ fftCross(unsigned int n, int inverse,
 	    io[i] /= denom;
 	}
     }
+}
+
+void
+fftCross(unsigned int n, int inverse,
+	 const double *ri, const double *ii,
+	 double *ro, double *io)
+{
+    FFTCrossPlan *plan;
+
+    if (!ri || !ro || !io) return;
+
+    plan = fftCrossPlan(n);
+    if (!plan) return;
 
-#ifdef _MSC_VER
-    _freea(table);
-#endif
+    fftCrossExecute(plan, inverse, ri, ii, ro, io);
+    fftCrossDestroy(plan);
 }
 
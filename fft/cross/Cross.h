@@ -1,4 +1,3 @@
-
 #ifndef CROSS_H
 #define CROSS_H
 
@@ -6,12 +5,35 @@
 extern "C" {
 #endif
 
+    /* One-off transform of size n, which must be a power of two. The
+       inverse is scaled by 1/n. ii may be NULL for real input. */
+
     extern void fftCross(unsigned int n, int inverse,
 			 const double *ri, const double *ii,
 			 double *ro, double *io);
 
+    /* A plan holds the bit-reversal permutation and the twiddle
+       factors for one size, so that repeated transforms of that size
+       need not recalculate them. fftCrossPlan returns NULL if n is
+       not a power of two of at least 2, or if allocation fails.
+
+       fftCrossExecute behaves like fftCross, and also works in place
+       (with ro == ri and io == ii). A plan is not modified by
+       execution, so it may be shared between threads. */
+
+    typedef struct FFTCrossPlan FFTCrossPlan;
+
+    extern FFTCrossPlan *fftCrossPlan(unsigned int n);
+
+    extern void fftCrossExecute(const FFTCrossPlan *plan, int inverse,
+				const double *ri, const double *ii,
+				double *ro, double *io);
+
+    extern void fftCrossDestroy(FFTCrossPlan *plan);
+
 #ifdef __cplusplus
 }
 #endif
 
 #endif
+
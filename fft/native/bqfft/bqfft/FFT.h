@@ -49,14 +49,21 @@ class FFTImpl;
  * Provide basic FFT computations using one of a set of candidate FFT
  * implementations (depending on compile flags).
  *
- * Implements real->complex FFTs of power-of-two sizes only.  Note
+ * Implements real->complex FFTs of any size from 2 upwards.  Note
  * that only the first half of the output signal is returned (the
  * complex conjugates half is omitted), so the "complex" arrays need
- * room for size/2+1 elements.
+ * room for size/2+1 elements (rounding down, so an odd size has no
+ * Nyquist bin).
  *
  * The "interleaved" functions use the format sometimes called CCS --
- * size/2+1 real+imaginary pairs.  So, the array elements at indices 1
- * and size+1 will always be zero (since the signal is real).
+ * size/2+1 real+imaginary pairs.  So, the array element at index 1
+ * will always be zero (since the signal is real), as will the one at
+ * index size+1 if the size is even.
+ *
+ * Not every implementation supports every size natively; see
+ * getSupportedSizes. Those that only handle powers of two are used
+ * for other sizes by way of Bluestein's algorithm, which works but is
+ * several times slower than a native transform of similar size.
  *
  * All pointer arguments must point to valid data. A NullArgument
  * exception is thrown if any argument is NULL.
@@ -70,7 +77,8 @@ class FFT
 {
 public:
     enum Exception {
-        NullArgument, InvalidSize, InvalidImplementation, InternalError
+        NullArgument, InvalidSize, InvalidImplementation, InternalError,
+        RealtimeViolation
     };
 
     FFT(int size, int debugLevel = 0); // may throw InvalidSize
@@ -96,6 +104,154 @@ public:
     void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut);
     void inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut);
 
+    /**
+     * Spectra of windowed input, and power and decibel spectra. The
+     * Windowed forms multiply realIn by window, which has size
+     * elements, before transforming. Implementations apply the window
+     * while copying the input into their own buffers, so this costs
+     * less than a separate multiply. Power is re^2 + im^2 for each
+     * bin, without the square root that a magnitude needs. Decibels
+     * are 10 log10 of the power, with power below 1e-20 taken as
+     * 1e-20 (-200 dB). All of these write size/2+1 bins.
+     */
+    void forwardWindowed(const double *BQ_R__ realIn, const double *BQ_R__ window,
+                         double *BQ_R__ realOut, double *BQ_R__ imagOut);
+    void forwardWindowedMagnitude(const double *BQ_R__ realIn, const double *BQ_R__ window,
+                                  double *BQ_R__ magOut);
+    void forwardPower(const double *BQ_R__ realIn, double *BQ_R__ powerOut);
+    void forwardWindowedPower(const double *BQ_R__ realIn, const double *BQ_R__ window,
+                              double *BQ_R__ powerOut);
+    void forwardDecibels(const double *BQ_R__ realIn, double *BQ_R__ dbOut);
+    void forwardWindowedDecibels(const double *BQ_R__ realIn, const double *BQ_R__ window,
+                                 double *BQ_R__ dbOut);
+
+    void forwardWindowed(const float *BQ_R__ realIn, const float *BQ_R__ window,
+                         float *BQ_R__ realOut, float *BQ_R__ imagOut);
+    void forwardWindowedMagnitude(const float *BQ_R__ realIn, const float *BQ_R__ window,
+                                  float *BQ_R__ magOut);
+    void forwardPower(const float *BQ_R__ realIn, float *BQ_R__ powerOut);
+    void forwardWindowedPower(const float *BQ_R__ realIn, const float *BQ_R__ window,
+                              float *BQ_R__ powerOut);
+    void forwardDecibels(const float *BQ_R__ realIn, float *BQ_R__ dbOut);
+    void forwardWindowedDecibels(const float *BQ_R__ realIn, const float *BQ_R__ window,
+                                 float *BQ_R__ dbOut);
+
+    /**
+     * Forward transforms returning only the binCount bins starting at
+     * firstBin, written to the start of the output arrays, which need
+     * room for binCount elements. The range must lie within the
+     * size/2+1 bins of a full transform, or InvalidSize is thrown.
+     *
+     * Only the requested bins are unpacked and converted. Where very
+     * few are wanted, they are computed directly with Goertzel's
+     * algorithm if that is quicker than a full transform with the
+     * implementation in use (KissFFT and the built-in ones, for up to
+     * a handful of bins). Otherwise the transform itself is done in
+     * full, so savings are mostly in the conversions: magnitude and
+     * phase cost more per bin than the transform does.
+     */
+    void forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut,
+                 int firstBin, int binCount);
+    void forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut,
+                      int firstBin, int binCount);
+    void forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut,
+                          int firstBin, int binCount);
+
+    void forward(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut,
+                 int firstBin, int binCount);
+    void forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut,
+                      int firstBin, int binCount);
+    void forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut,
+                          int firstBin, int binCount);
+
+    /**
+     * Forward transform of inCount samples followed by size - inCount
+     * zeros, as when a short frame or filter is zero-padded for
+     * interpolated spectra or fast convolution. Only the inCount
+     * samples are read, so realIn need be no longer than that. The
+     * results are as for forward() on the padded buffer; inCount must
+     * be between 0 and size.
+     *
+     * The built-in implementation skips the work on the zeros in the
+     * early stages of its transform, saving most where inCount is a
+     * quarter of size or less. The others save only the caller's
+     * copy.
+     */
+    void forwardPadded(const double *BQ_R__ realIn, int inCount,
+                       double *BQ_R__ realOut, double *BQ_R__ imagOut);
+    void forwardPadded(const float *BQ_R__ realIn, int inCount,
+                       float *BQ_R__ realOut, float *BQ_R__ imagOut);
+
+    /**
+     * Batch forms of forward() and inverse(), transforming count
+     * frames in a single call. Frame n of the input is read starting
+     * at index n * inStride, and frame n of the output written
+     * starting at index n * outStride. The time-domain stride must be
+     * at least size and the frequency-domain stride at least
+     * size/2+1. Results are identical to calling forward() or
+     * inverse() once per frame, but implementations that support it
+     * will transform all frames together.
+     */
+    void forwardMany(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut,
+                     int inStride, int outStride, int count);
+    void forwardMany(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut,
+                     int inStride, int outStride, int count);
+
+    void inverseMany(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut,
+                     int inStride, int outStride, int count);
+    void inverseMany(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut,
+                     int inStride, int outStride, int count);
+
+    /**
+     * Complex-to-complex transforms. These take size complex values
+     * and return size complex values, with no conjugate symmetry
+     * assumed or implied, either as separate real and imaginary
+     * arrays or as size interleaved real+imaginary pairs (2*size
+     * elements). Like the real transforms they are unscaled, so a
+     * forward transform followed by an inverse one multiplies the
+     * input by size.
+     *
+     * Implementations that have a complex transform of their own
+     * (FFTW, KissFFT and the built-in ones) use it; the rest make one
+     * from two real transforms.
+     */
+    void forwardComplex(const double *BQ_R__ realIn, const double *BQ_R__ imagIn,
+                        double *BQ_R__ realOut, double *BQ_R__ imagOut);
+    void forwardComplexInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ complexOut);
+    void inverseComplex(const double *BQ_R__ realIn, const double *BQ_R__ imagIn,
+                        double *BQ_R__ realOut, double *BQ_R__ imagOut);
+    void inverseComplexInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ complexOut);
+
+    void forwardComplex(const float *BQ_R__ realIn, const float *BQ_R__ imagIn,
+                        float *BQ_R__ realOut, float *BQ_R__ imagOut);
+    void forwardComplexInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ complexOut);
+    void inverseComplex(const float *BQ_R__ realIn, const float *BQ_R__ imagIn,
+                        float *BQ_R__ realOut, float *BQ_R__ imagOut);
+    void inverseComplexInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ complexOut);
+
+    enum PolarAccuracy {
+        ExactPolar,
+        PrecisePolar,
+        FastPolar
+    };
+
+    /**
+     * Set the accuracy of the conversions to and from magnitude and
+     * phase in forwardPolar() and inversePolar(). ExactPolar, the
+     * default, uses the standard library (or the implementation's own
+     * routines). PrecisePolar uses vectorised approximations accurate
+     * to within a few units in the last place of a float; FastPolar
+     * uses shorter ones, with phase errors up to about 1e-3 radians
+     * and magnitudes within about 2e-4 relative.
+     *
+     * The approximations are only available when bqvec is built with
+     * HAVE_BQ_SIMD, and are not used by the IPP and vDSP
+     * implementations, which have fast conversions of their own. In
+     * all other cases the accuracy setting has no effect.
+     */
+    void setPolarAccuracy(PolarAccuracy accuracy);
+    PolarAccuracy getPolarAccuracy() const;
+
     // Calling one or both of these is optional -- if neither is
     // called, the first call to a forward or inverse method will call
     // init().  You only need call these if you don't want to risk
@@ -103,6 +259,36 @@ public:
     void initFloat();
     void initDouble();
 
+    // The same for the complex transforms, which some implementations
+    // set up separately. These also do what initFloat or initDouble
+    // would.
+    void initFloatComplex();
+    void initDoubleComplex();
+
+    /**
+     * Set or clear realtime mode. In realtime mode, any call that
+     * would allocate or plan something, or take a lock, prints an
+     * error and throws RealtimeViolation (or aborts, if exceptions
+     * are disabled) instead. Set it after calling the init functions
+     * for everything the realtime code will use. The batch functions
+     * (forwardMany, inverseMany) may set up again when called with
+     * more frames than before, so call each once at the largest
+     * count to be used before setting realtime mode.
+     */
+    void setRealtime(bool realtime);
+    bool getRealtime() const;
+
+    /**
+     * Return the number of setup steps (allocations of working
+     * buffers, plan creation) and lock acquisitions made since
+     * construction or the last call to resetCounts(). A step may
+     * involve several allocations; these count the occasions, not
+     * individual calls to malloc.
+     */
+    int getAllocationCount() const;
+    int getLockCount() const;
+    void resetCounts();
+
     enum Precision {
         SinglePrecision = 0x1,
         DoublePrecision = 0x2
@@ -121,18 +307,66 @@ public:
      */
     Precisions getSupportedPrecisions() const;
 
+    enum SizeClass {
+        PowerOfTwoSizes = 0x1,
+        OtherSizes = 0x2
+    };
+    typedef int SizeClasses;
+
+    /**
+     * Return the OR of the classes of size that the named
+     * implementation transforms natively. All sizes are accepted
+     * regardless, but sizes not supported natively are computed using
+     * a larger power-of-two transform.
+     */
+    static SizeClasses getSupportedSizes(std::string implementation);
+
+    /**
+     * Return the smallest size of at least n that can be transformed
+     * efficiently: the next power of two if the default
+     * implementation (or, if none is set, every compiled-in
+     * implementation) supports only those, or otherwise the next even
+     * size having no prime factors greater than 5.
+     */
+    static int nextFastSize(int n);
+
     static std::set<std::string> getImplementations();
+
+    /**
+     * Return the implementation that new FFT objects will use, as set
+     * with setDefaultImplementation, or the empty string if none has
+     * been set. In that case each FFT object picks the fastest
+     * implementation for its size and precision, as found by tune().
+     */
     static std::string getDefaultImplementation();
     static void setDefaultImplementation(std::string);
 
-#ifdef FFT_MEASUREMENT
-    static std::string tune();
-#endif
+    /**
+     * Time every compiled-in implementation at the given size and
+     * precision, and return the name of the fastest. The result is
+     * recorded in a tuning profile kept in $HOME/.bqfft.tuning, so
+     * that later processes can use it without timing anything.
+     *
+     * An FFT object with no default implementation set calls this
+     * the first time it is used at a precision for which no result
+     * has been recorded. As that may take a while, an application
+     * that cares can call tune() up front, or call initFloat() or
+     * initDouble() in advance of using the object. Tuning is
+     * serialised by an internal lock, so objects may be first used
+     * from several threads at once; but the first use at a size and
+     * precision not yet tuned may block while another thread times
+     * it.
+     */
+    static std::string tune(int size, Precision precision);
 
 protected:
     FFTImpl *d;
+    FFTImpl *df;
+    int m_size;
+    int m_debugLevel;
+    PolarAccuracy m_polarAccuracy;
+    bool m_realtime;
     static std::string m_implementation;
-    static void pickDefaultImplementation();
 
 private:
     FFT(const FFT &); // not provided
@@ -0,0 +1,217 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    bqfft
+
+    A small library wrapping various FFT implementations for some
+    common audio processing use cases.
+
+    Copyright 2007-2015 Particular Programs Ltd.
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of Chris Cannam and
+    Particular Programs Ltd shall not be used in advertising or
+    otherwise to promote the sale, use or other dealings in this
+    Software without prior written authorization.
+*/
+
+#ifndef BQFFT_STFT_H
+#define BQFFT_STFT_H
+
+#include "FFT.h"
+
+#include <bqvec/RingBuffer.h>
+
+namespace breakfastquay {
+
+/**
+ * Streaming short-time Fourier transform of a single channel of float
+ * samples, with overlap-add resynthesis.
+ *
+ * Analysis takes frames of fftSize samples, each starting hop samples
+ * after the last (the first starting at the first input sample),
+ * multiplies them by the window, and transforms them. Input comes
+ * either from a RingBuffer supplied by the caller or from one owned
+ * by the STFT, which the caller fills using write().
+ *
+ * Synthesis inverse-transforms frames, multiplies them by the same
+ * window again, and overlap-adds them at the same hop, emitting hop
+ * samples per frame to a RingBuffer (again either the caller's or one
+ * owned by the STFT, which the caller empties using read()). The
+ * output is scaled so that analysis followed directly by synthesis
+ * reproduces the input, provided the window is nowhere zero over a
+ * whole set of overlapping positions (true of all the windows here
+ * when hop is at most fftSize/2). The first fftSize - hop output
+ * samples lack some of their overlapping frames, and so are
+ * attenuated.
+ *
+ * Spectral frames are fftSize/2+1 bins long, as for FFT, and a call
+ * handling several frames expects them consecutively in each array,
+ * with frame n starting at index n * (fftSize/2+1). Cartesian frames
+ * are unscaled, as from FFT::forward().
+ *
+ * All buffers are allocated, and the FFT initialised, on
+ * construction. After that no method allocates memory or takes a
+ * lock, so analysis and synthesis may be used on a realtime thread.
+ * Up to batchSize frames are transformed at once, using the batch
+ * functions of FFT (FFT::forwardMany and FFT::inverseMany).
+ *
+ * As for RingBuffer, the internal input buffer may be written from
+ * one thread while another analyses, and the internal output buffer
+ * read from one thread while another synthesises. Otherwise this
+ * class is not thread safe.
+ */
+class STFT
+{
+public:
+    enum WindowType {
+        RectangularWindow,
+        HannWindow,
+        HammingWindow,
+        BlackmanWindow
+    };
+
+    /**
+     * Construct an STFT with the given frame size and hop. The
+     * internal input and output buffers each have room for
+     * bufferSize samples; if bufferSize is zero, they hold
+     * fftSize + batchSize * hop samples.
+     *
+     * Throws FFT::InvalidSize unless fftSize is at least 2, hop is
+     * between 1 and fftSize, and batchSize is at least 1.
+     */
+    STFT(int fftSize, int hop,
+         WindowType window = HannWindow,
+         int batchSize = 8,
+         int bufferSize = 0);
+    ~STFT();
+
+    int getFFTSize() const { return m_fftSize; }
+    int getHop() const { return m_hop; }
+
+    /**
+     * Return the number of bins in each spectral frame, fftSize/2+1.
+     */
+    int getBinCount() const { return m_bins; }
+
+    /**
+     * Return the window, of fftSize samples.
+     */
+    const float *getWindow() const { return m_window; }
+
+    /**
+     * Write n samples to the internal input buffer. Returns the
+     * number actually written, which is less than n if there was not
+     * room for them all.
+     */
+    int write(const float *BQ_R__ input, int n);
+
+    /**
+     * Return the number of samples that may be written to the
+     * internal input buffer.
+     */
+    int getWriteSpace() const;
+
+    /**
+     * Return the number of complete frames waiting to be analysed in
+     * the internal input buffer.
+     */
+    int getAvailableFrames() const;
+
+    /**
+     * Analyse up to maxFrames frames from the internal input buffer,
+     * or from the given ring buffer, writing cartesian output.
+     * Returns the number of frames analysed, which is limited by the
+     * input available. Input is consumed hop samples per frame.
+     */
+    int analyse(float *BQ_R__ realOut, float *BQ_R__ imagOut, int maxFrames);
+    int analyse(RingBuffer<float> &input,
+                float *BQ_R__ realOut, float *BQ_R__ imagOut, int maxFrames);
+
+    /**
+     * As analyse(), but write magnitude and phase, as from
+     * FFT::forwardPolar().
+     */
+    int analysePolar(float *BQ_R__ magOut, float *BQ_R__ phaseOut, int maxFrames);
+    int analysePolar(RingBuffer<float> &input,
+                     float *BQ_R__ magOut, float *BQ_R__ phaseOut, int maxFrames);
+
+    /**
+     * Resynthesise up to count cartesian frames, overlap-adding into
+     * the internal output buffer or the given ring buffer. Returns
+     * the number of frames used, which is limited by the space in
+     * the output buffer: each frame needs room for hop samples.
+     */
+    int synthesise(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, int count);
+    int synthesise(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, int count,
+                   RingBuffer<float> &output);
+
+    /**
+     * As synthesise(), but from magnitude and phase.
+     */
+    int synthesisePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, int count);
+    int synthesisePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, int count,
+                        RingBuffer<float> &output);
+
+    /**
+     * Return the number of samples waiting in the internal output
+     * buffer.
+     */
+    int getOutputAvailable() const;
+
+    /**
+     * Read up to n samples from the internal output buffer. Returns
+     * the number actually read; the remainder of output is zeroed.
+     */
+    int read(float *BQ_R__ output, int n);
+
+    /**
+     * Empty the internal input and output buffers and discard any
+     * partly overlap-added output.
+     */
+    void reset();
+
+private:
+    const int m_fftSize;
+    const int m_hop;
+    const int m_bins;
+    const int m_batchSize;
+    FFT m_fft;
+    float *m_window;
+    float *m_scale;
+    float *m_frames;
+    float *m_re;
+    float *m_im;
+    float *m_accumulator;
+    RingBuffer<float> *m_input;
+    RingBuffer<float> *m_output;
+
+    int gather(RingBuffer<float> &input, int maxFrames);
+    int overlapAdd(const float *BQ_R__ realIn, const float *BQ_R__ imagIn,
+                   int count, RingBuffer<float> &output);
+
+    STFT(const STFT &); // not provided
+    STFT &operator=(const STFT &); // not provided
+};
+
+}
+
+#endif
@@ -40,12 +40,7 @@
 #include <bqvec/Allocators.h>
 #include <bqvec/VectorOps.h>
 #include <bqvec/VectorOpsComplex.h>
-
-//#define FFT_MEASUREMENT 1
-
-#ifdef FFT_MEASUREMENT
-#include <sstream>
-#endif
+#include <bqvec/VectorOpsFixed.h>
 
 #ifdef HAVE_IPP
 #include <ipps.h>
@@ -53,6 +48,14 @@
 
 #ifdef HAVE_FFTW3
 #include <fftw3.h>
+#include <bqvec/Barrier.h>
+#ifndef NO_THREADING
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
 #endif
 
 #ifdef HAVE_VDSP
@@ -77,6 +80,27 @@ extern "C" {
 #include "kissfft/kiss_fftr.h"
 #endif
 
+#ifdef USE_BUILTIN_FFT
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BQ_BUILTIN_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#define BQ_BUILTIN_AVX 1
+#define BQ_BUILTIN_AVX_TARGET
+#include <immintrin.h>
+#elif defined(BQ_BUILTIN_SSE2) && defined(__GNUC__)
+#define BQ_BUILTIN_AVX 1
+#define BQ_BUILTIN_AVX_RUNTIME 1
+#define BQ_BUILTIN_AVX_TARGET __attribute__((target("avx")))
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define BQ_BUILTIN_NEON 1
+#include <arm_neon.h>
+#endif
+#endif
+
 #ifndef HAVE_IPP
 #ifndef HAVE_FFTW3
 #ifndef HAVE_KISSFFT
@@ -102,17 +126,73 @@ extern "C" {
 #include <cstdlib>
 #include <vector>
 
-#ifdef FFT_MEASUREMENT
-#ifndef _WIN32
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <sys/time.h>
 #include <unistd.h>
+#ifndef NO_THREADING
+#include <pthread.h>
 #endif
 #endif
 
 namespace breakfastquay {
 
+static void
+realtimeViolation(const char *what)
+{
+    std::cerr << "FFT: ERROR: " << what << " attempted in realtime mode"
+              << std::endl;
+#ifndef NO_EXCEPTIONS
+    throw FFT::RealtimeViolation;
+#else
+    abort();
+#endif
+}
+
+// Scratch space for FFTImpl's default complex and windowed transforms
+// below: the real and imaginary parts of an interleaved input (or a
+// windowed real one), and the two half spectra they are transformed
+// into
+
+template <typename T>
+struct Scratch
+{
+    Scratch() : size(0), re(0), im(0), pr(0), pi(0), qr(0), qi(0) { }
+    ~Scratch() {
+        deallocate(re);
+        deallocate(im);
+        deallocate(pr);
+        deallocate(pi);
+        deallocate(qr);
+        deallocate(qi);
+    }
+    void init(int n) {
+        if (size) return;
+        re = allocate<T>(n);
+        im = allocate<T>(n);
+        pr = allocate<T>(n/2 + 1);
+        pi = allocate<T>(n/2 + 1);
+        qr = allocate<T>(n/2 + 1);
+        qi = allocate<T>(n/2 + 1);
+        size = n;
+    }
+    int size;
+    T *re, *im, *pr, *pi, *qr, *qi;
+private:
+    Scratch(const Scratch &);
+    Scratch &operator=(const Scratch &);
+};
+
 class FFTImpl
 {
 public:
+    FFTImpl() :
+        m_polarAccuracy(PolarExact),
+        m_realtime(false),
+        m_allocations(0),
+        m_locks(0) { }
     virtual ~FFTImpl() { }
 
     virtual FFT::Precisions getSupportedPrecisions() const = 0;
@@ -139,10 +219,462 @@ public:
     virtual void inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut) = 0;
     virtual void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut) = 0;
     virtual void inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut) = 0;
+
+    // The batch functions default to a simple loop over frames;
+    // implementations that can plan a single transform across many
+    // frames override them
+
+    virtual void forwardMany(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut, int inStride, int outStride, int count) {
+        for (int i = 0; i < count; ++i) {
+            forward(realIn + i * inStride, realOut + i * outStride, imagOut + i * outStride);
+        }
+    }
+
+    virtual void forwardMany(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut, int inStride, int outStride, int count) {
+        for (int i = 0; i < count; ++i) {
+            forward(realIn + i * inStride, realOut + i * outStride, imagOut + i * outStride);
+        }
+    }
+
+    virtual void inverseMany(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut, int inStride, int outStride, int count) {
+        for (int i = 0; i < count; ++i) {
+            inverse(realIn + i * inStride, imagIn + i * inStride, realOut + i * outStride);
+        }
+    }
+
+    virtual void inverseMany(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut, int inStride, int outStride, int count) {
+        for (int i = 0; i < count; ++i) {
+            inverse(realIn + i * inStride, imagIn + i * inStride, realOut + i * outStride);
+        }
+    }
+
+    // Complex transforms of size complex values. FFT calls
+    // initFloatComplex or initDoubleComplex, with the size, after
+    // initFloat or initDouble and before each complex transform at
+    // that precision, so they must return quickly if there is nothing
+    // left to do. The defaults make a complex transform from two real
+    // forward transforms, using the conjugate symmetry of each, and
+    // get the inverse by swapping the real and imaginary parts on the
+    // way in and out of a forward transform. Implementations with a
+    // complex transform of their own override all of these
+
+    virtual void initFloatComplex(int size) {
+        initScratch(m_fscratch, size);
+    }
+
+    virtual void initDoubleComplex(int size) {
+        initScratch(m_dscratch, size);
+    }
+
+    virtual void forwardComplex(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        complexFromReal(m_dscratch, realIn, imagIn, realOut, imagOut, 1);
+    }
+
+    virtual void forwardComplexInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ complexOut) {
+        Scratch<double> &s = m_dscratch;
+        splitComplex(s.re, s.im, complexIn, s.size);
+        complexFromReal(s, s.re, s.im, complexOut, complexOut + 1, 2);
+    }
+
+    virtual void inverseComplex(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        complexFromReal(m_dscratch, imagIn, realIn, imagOut, realOut, 1);
+    }
+
+    virtual void inverseComplexInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ complexOut) {
+        Scratch<double> &s = m_dscratch;
+        splitComplex(s.im, s.re, complexIn, s.size);
+        complexFromReal(s, s.re, s.im, complexOut + 1, complexOut, 2);
+    }
+
+    virtual void forwardComplex(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        complexFromReal(m_fscratch, realIn, imagIn, realOut, imagOut, 1);
+    }
+
+    virtual void forwardComplexInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ complexOut) {
+        Scratch<float> &s = m_fscratch;
+        splitComplex(s.re, s.im, complexIn, s.size);
+        complexFromReal(s, s.re, s.im, complexOut, complexOut + 1, 2);
+    }
+
+    virtual void inverseComplex(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        complexFromReal(m_fscratch, imagIn, realIn, imagOut, realOut, 1);
+    }
+
+    virtual void inverseComplexInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ complexOut) {
+        Scratch<float> &s = m_fscratch;
+        splitComplex(s.im, s.re, complexIn, s.size);
+        complexFromReal(s, s.re, s.im, complexOut + 1, complexOut, 2);
+    }
+
+    // Windowed transforms and power spectra. Implementations that
+    // copy their input anyway apply the window as they do so, and
+    // compute power straight from their own output rather than going
+    // through forward(). The window passed to forwardPower may be
+    // null, for none. FFT calls initFloatSpectra or initDoubleSpectra
+    // straight after initFloat or initDouble; the defaults use the
+    // same scratch space as the default complex transforms
+
+    virtual void initFloatSpectra(int size) {
+        initScratch(m_fscratch, size);
+    }
+
+    virtual void initDoubleSpectra(int size) {
+        initScratch(m_dscratch, size);
+    }
+
+    virtual void forwardWindowed(const double *BQ_R__ realIn, const double *BQ_R__ window, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        Scratch<double> &s = m_dscratch;
+        v_multiply(s.re, realIn, window, s.size);
+        forward(s.re, realOut, imagOut);
+    }
+
+    virtual void forwardPower(const double *BQ_R__ realIn, const double *BQ_R__ window, double *BQ_R__ powerOut) {
+        Scratch<double> &s = m_dscratch;
+        if (window) {
+            v_multiply(s.re, realIn, window, s.size);
+            forward(s.re, s.pr, s.pi);
+        } else {
+            forward(realIn, s.pr, s.pi);
+        }
+        cartesianToPower(powerOut, s.pr, s.pi, s.size/2 + 1);
+    }
+
+    virtual void forwardWindowed(const float *BQ_R__ realIn, const float *BQ_R__ window, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        Scratch<float> &s = m_fscratch;
+        v_multiply(s.re, realIn, window, s.size);
+        forward(s.re, realOut, imagOut);
+    }
+
+    virtual void forwardPower(const float *BQ_R__ realIn, const float *BQ_R__ window, float *BQ_R__ powerOut) {
+        Scratch<float> &s = m_fscratch;
+        if (window) {
+            v_multiply(s.re, realIn, window, s.size);
+            forward(s.re, s.pr, s.pi);
+        } else {
+            forward(realIn, s.pr, s.pi);
+        }
+        cartesianToPower(powerOut, s.pr, s.pi, s.size/2 + 1);
+    }
+
+    // Transforms returning only the count bins starting at first, to
+    // the start of the output arrays. FFT checks the range, and uses
+    // goertzel() instead for no more than getGoertzelLimit() bins,
+    // the point up to which that is quicker than a full transform
+    // with this implementation. The defaults transform in full to the
+    // scratch space and convert only the bins requested
+
+    virtual int getGoertzelLimit() const {
+        return 0;
+    }
+
+    virtual void forwardBins(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut, int first, int count) {
+        Scratch<double> &s = m_dscratch;
+        forward(realIn, s.pr, s.pi);
+        v_copy(realOut, s.pr + first, count);
+        v_copy(imagOut, s.pi + first, count);
+    }
+
+    virtual void forwardBinsPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut, int first, int count) {
+        Scratch<double> &s = m_dscratch;
+        forward(realIn, s.pr, s.pi);
+        cartesianToPolar(magOut, phaseOut, s.pr + first, s.pi + first, count);
+    }
+
+    virtual void forwardBinsMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut, int first, int count) {
+        Scratch<double> &s = m_dscratch;
+        forward(realIn, s.pr, s.pi);
+        cartesianToMagnitude(magOut, s.pr + first, s.pi + first, count);
+    }
+
+    virtual void forwardBins(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut, int first, int count) {
+        Scratch<float> &s = m_fscratch;
+        forward(realIn, s.pr, s.pi);
+        v_copy(realOut, s.pr + first, count);
+        v_copy(imagOut, s.pi + first, count);
+    }
+
+    virtual void forwardBinsPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut, int first, int count) {
+        Scratch<float> &s = m_fscratch;
+        forward(realIn, s.pr, s.pi);
+        cartesianToPolar(magOut, phaseOut, s.pr + first, s.pi + first, count);
+    }
+
+    virtual void forwardBinsMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut, int first, int count) {
+        Scratch<float> &s = m_fscratch;
+        forward(realIn, s.pr, s.pi);
+        cartesianToMagnitude(magOut, s.pr + first, s.pi + first, count);
+    }
+
+    // Transforms of inCount samples followed by zeros to the full
+    // size. FFT checks inCount. The defaults pad into the scratch
+    // space; implementations with an input buffer of their own pad
+    // into that instead, and any that can skip the work on the zeros
+    // do so
+
+    virtual void forwardPadded(const double *BQ_R__ realIn, int inCount, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        Scratch<double> &s = m_dscratch;
+        v_copy(s.re, realIn, inCount);
+        v_zero(s.re + inCount, s.size - inCount);
+        forward(s.re, realOut, imagOut);
+    }
+
+    virtual void forwardPadded(const float *BQ_R__ realIn, int inCount, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        Scratch<float> &s = m_fscratch;
+        v_copy(s.re, realIn, inCount);
+        v_zero(s.re + inCount, s.size - inCount);
+        forward(s.re, realOut, imagOut);
+    }
+
+    void setPolarAccuracy(PolarAccuracy accuracy) {
+        m_polarAccuracy = accuracy;
+    }
+
+    // Setup accounting. Implementations call allocating() before
+    // each piece of setup work (allocating buffers, creating plans)
+    // and locking() before taking a lock; in realtime mode either is
+    // an error. FFT only switches an implementation to realtime mode
+    // once it has been initialised. Implementations that wrap
+    // another include it in these
+
+    virtual void setRealtime(bool realtime) {
+        m_realtime = realtime;
+    }
+
+    virtual int getAllocationCount() const { return m_allocations; }
+    virtual int getLockCount() const { return m_locks; }
+
+    virtual void resetCounts() {
+        m_allocations = 0;
+        m_locks = 0;
+    }
+
+protected:
+    PolarAccuracy m_polarAccuracy;
+    bool m_realtime;
+    int m_allocations;
+    int m_locks;
+    Scratch<float> m_fscratch;
+    Scratch<double> m_dscratch;
+
+    void allocating() {
+        ++m_allocations;
+        if (m_realtime) realtimeViolation("setup");
+    }
+
+    void locking() {
+        ++m_locks;
+        if (m_realtime) realtimeViolation("lock");
+    }
+
+    template <typename T>
+    void initScratch(Scratch<T> &s, int size) {
+        if (s.size) return;
+        allocating();
+        s.init(size);
+    }
+
+    template <typename T, typename S>
+    static void splitComplex(T *BQ_R__ re, T *BQ_R__ im,
+                             const S *BQ_R__ complexIn, int n) {
+        for (int i = 0; i < n; ++i) {
+            re[i] = T(complexIn[i*2]);
+            im[i] = T(complexIn[i*2+1]);
+        }
+    }
+
+    template <typename T, typename S>
+    static void joinComplex(T *BQ_R__ complexOut,
+                            const S *BQ_R__ re, const S *BQ_R__ im, int n) {
+        for (int i = 0; i < n; ++i) {
+            complexOut[i*2] = T(re[i]);
+            complexOut[i*2+1] = T(im[i]);
+        }
+    }
+
+    // Windowing with conversion, for implementations whose internal
+    // precision differs from the caller's
+
+    template <typename T, typename S>
+    static void windowInto(T *BQ_R__ dst, const S *BQ_R__ src,
+                           const S *BQ_R__ window, int n) {
+        for (int i = 0; i < n; ++i) {
+            dst[i] = T(src[i] * window[i]);
+        }
+    }
+
+    template <typename T>
+    static void windowInto(T *BQ_R__ dst, const T *BQ_R__ src,
+                           const T *BQ_R__ window, int n) {
+        v_multiply(dst, src, window, n);
+    }
+
+    template <typename T, typename S>
+    static void cartesianToPower(T *BQ_R__ power, const S *BQ_R__ re,
+                                 const S *BQ_R__ im, int n) {
+        for (int i = 0; i < n; ++i) {
+            power[i] = T(re[i] * re[i] + im[i] * im[i]);
+        }
+    }
+
+    template <typename T, typename S>
+    static void interleavedToPower(T *BQ_R__ power, const S *BQ_R__ packed,
+                                   int n) {
+        for (int i = 0; i < n; ++i) {
+            power[i] = T(packed[i*2] * packed[i*2] +
+                         packed[i*2+1] * packed[i*2+1]);
+        }
+    }
+
+    template <typename T, typename S>
+    static void cartesianToMagnitude(T *BQ_R__ mag, const S *BQ_R__ re,
+                                     const S *BQ_R__ im, int n) {
+        for (int i = 0; i < n; ++i) {
+            mag[i] = T(sqrt(re[i] * re[i] + im[i] * im[i]));
+        }
+    }
+
+    template <typename T, typename S>
+    static void interleavedToMagnitude(T *BQ_R__ mag, const S *BQ_R__ packed,
+                                       int n) {
+        for (int i = 0; i < n; ++i) {
+            mag[i] = T(sqrt(packed[i*2] * packed[i*2] +
+                            packed[i*2+1] * packed[i*2+1]));
+        }
+    }
+
+    // Polar conversions at m_polarAccuracy where the types match, and
+    // exact otherwise
+
+    template <typename T, typename S>
+    void cartesianToPolar(T *BQ_R__ mag, T *BQ_R__ phase,
+                          const S *BQ_R__ re, const S *BQ_R__ im, int n) {
+        for (int i = 0; i < n; ++i) {
+            mag[i] = T(sqrt(re[i] * re[i] + im[i] * im[i]));
+            phase[i] = T(atan2(im[i], re[i]));
+        }
+    }
+
+    template <typename T>
+    void cartesianToPolar(T *BQ_R__ mag, T *BQ_R__ phase,
+                          const T *BQ_R__ re, const T *BQ_R__ im, int n) {
+        v_cartesian_to_polar(mag, phase, re, im, n, m_polarAccuracy);
+    }
+
+    template <typename T, typename S>
+    void interleavedToPolar(T *BQ_R__ mag, T *BQ_R__ phase,
+                            const S *BQ_R__ packed, int n) {
+        for (int i = 0; i < n; ++i) {
+            mag[i] = T(sqrt(packed[i*2] * packed[i*2] +
+                            packed[i*2+1] * packed[i*2+1]));
+            phase[i] = T(atan2(packed[i*2+1], packed[i*2]));
+        }
+    }
+
+    template <typename T>
+    void interleavedToPolar(T *BQ_R__ mag, T *BQ_R__ phase,
+                            const T *BQ_R__ packed, int n) {
+        v_cartesian_interleaved_to_polar(mag, phase, packed, n, m_polarAccuracy);
+    }
+
+    // With P and Q the transforms of the real and imaginary parts,
+    // the transform of the whole is P + iQ; the upper half of each
+    // follows from the lower by conjugate symmetry. The output is
+    // written at the given stride
+
+    template <typename T>
+    void complexFromReal(Scratch<T> &s,
+                         const T *BQ_R__ ri, const T *BQ_R__ ii,
+                         T *BQ_R__ ro, T *BQ_R__ io, int stride) {
+        const int n = s.size;
+        const int hn = n/2;
+        forward(ri, s.pr, s.pi);
+        forward(ii, s.qr, s.qi);
+        for (int k = 0; k <= hn; ++k) {
+            ro[k * stride] = s.pr[k] - s.qi[k];
+            io[k * stride] = s.pi[k] + s.qr[k];
+        }
+        for (int k = hn + 1; k < n; ++k) {
+            ro[k * stride] = s.pr[n - k] + s.qi[n - k];
+            io[k * stride] = s.qr[n - k] - s.pi[n - k];
+        }
+    }
+
+    // True if the polar functions should go through the bqvec polar
+    // conversions at m_polarAccuracy rather than their own exact
+    // code. Without HAVE_BQ_SIMD those conversions are exact anyway,
+    // and no faster than the implementations' own loops
+    bool approximatePolar() const {
+#ifdef HAVE_BQ_SIMD
+        return m_polarAccuracy != PolarExact;
+#else
+        return false;
+#endif
+    }
 };    
 
 namespace FFTs {
 
+// Move the size/2 + 1 bins of a real transform between separate real
+// and imaginary arrays and interleaved complex pairs, converting
+// between precisions if need be. Where no conversion is involved, the
+// common FFT sizes use the fixed-length functions from
+// VectorOpsFixed.h, whose loops the compiler can lay out for the
+// exact count
+
+template<typename T, typename S>
+static void interleaveBins(T *const BQ_R__ packed,
+                        const S *const BQ_R__ re, const S *const BQ_R__ im,
+                        const int size)
+{
+    const int hs = size/2;
+    for (int i = 0; i <= hs; ++i) packed[i*2] = T(re[i]);
+    if (im) {
+        for (int i = 0; i <= hs; ++i) packed[i*2+1] = T(im[i]);
+    } else {
+        for (int i = 0; i <= hs; ++i) packed[i*2+1] = T(0);
+    }
+}
+
+template<typename T>
+static void interleaveBins(T *const BQ_R__ packed,
+                        const T *const BQ_R__ re, const T *const BQ_R__ im,
+                        const int size)
+{
+    switch (size) {
+    case 256: v_interleave_complex<129>(packed, re, im); break;
+    case 512: v_interleave_complex<257>(packed, re, im); break;
+    case 1024: v_interleave_complex<513>(packed, re, im); break;
+    case 2048: v_interleave_complex<1025>(packed, re, im); break;
+    default: interleaveBins<T, T>(packed, re, im, size); break;
+    }
+}
+
+template<typename T, typename S>
+static void deinterleaveBins(T *const BQ_R__ re, T *const BQ_R__ im,
+                          const S *const BQ_R__ packed,
+                          const int size)
+{
+    const int hs = size/2;
+    for (int i = 0; i <= hs; ++i) re[i] = T(packed[i*2]);
+    if (im) {
+        for (int i = 0; i <= hs; ++i) im[i] = T(packed[i*2+1]);
+    }
+}
+
+template<typename T>
+static void deinterleaveBins(T *const BQ_R__ re, T *const BQ_R__ im,
+                          const T *const BQ_R__ packed,
+                          const int size)
+{
+    switch (size) {
+    case 256: v_deinterleave_complex<129>(re, im, packed); break;
+    case 512: v_deinterleave_complex<257>(re, im, packed); break;
+    case 1024: v_deinterleave_complex<513>(re, im, packed); break;
+    case 2048: v_deinterleave_complex<1025>(re, im, packed); break;
+    default: deinterleaveBins<T, T>(re, im, packed, size); break;
+    }
+}
+
 #ifdef HAVE_IPP
 
 class D_IPP : public FFTImpl
@@ -183,6 +715,7 @@ public:
 
     void initFloat() {
         if (m_fspec) return;
+        allocating();
         int specSize, specBufferSize, bufferSize;
         ippsFFTGetSize_R_32f(m_order, IPP_FFT_NODIV_BY_ANY, ippAlgHintFast,
                              &specSize, &specBufferSize, &bufferSize);
@@ -195,6 +728,7 @@ public:
 
     void initDouble() {
         if (m_dspec) return;
+        allocating();
         int specSize, specBufferSize, bufferSize;
         ippsFFTGetSize_R_64f(m_order, IPP_FFT_NODIV_BY_ANY, ippAlgHintFast,
                              &specSize, &specBufferSize, &bufferSize);
@@ -206,45 +740,11 @@ public:
     }
 
     void packFloat(const float *BQ_R__ re, const float *BQ_R__ im) {
-        int index = 0;
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            m_fpacked[index++] = re[i];
-            index++;
-        }
-        index = 0;
-        if (im) {
-            for (int i = 0; i <= hs; ++i) {
-                index++;
-                m_fpacked[index++] = im[i];
-            }
-        } else {
-            for (int i = 0; i <= hs; ++i) {
-                index++;
-                m_fpacked[index++] = 0.f;
-            }
-        }
+        interleaveBins(m_fpacked, re, im, m_size);
     }
 
     void packDouble(const double *BQ_R__ re, const double *BQ_R__ im) {
-        int index = 0;
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            m_dpacked[index++] = re[i];
-            index++;
-        }
-        index = 0;
-        if (im) {
-            for (int i = 0; i <= hs; ++i) {
-                index++;
-                m_dpacked[index++] = im[i];
-            }
-        } else {
-            for (int i = 0; i <= hs; ++i) {
-                index++;
-                m_dpacked[index++] = 0.0;
-            }
-        }
+        interleaveBins(m_dpacked, re, im, m_size);
     }
 
     void unpackFloat(float *re, float *BQ_R__ im) { // re may be equal to m_fpacked
@@ -452,6 +952,7 @@ public:
 
     void initFloat() {
         if (m_fspec) return;
+        allocating();
         m_fspec = vDSP_create_fftsetup(m_order, FFT_RADIX2);
         m_fbuf = new DSPSplitComplex;
         //!!! "If possible, tempBuffer->realp and tempBuffer->imagp should be 32-byte aligned for best performance."
@@ -466,6 +967,7 @@ public:
 
     void initDouble() {
         if (m_dspec) return;
+        allocating();
         m_dspec = vDSP_create_fftsetupD(m_order, FFT_RADIX2);
         m_dbuf = new DSPDoubleSplitComplex;
         //!!! "If possible, tempBuffer->realp and tempBuffer->imagp should be 32-byte aligned for best performance."
@@ -786,10 +1288,14 @@ public:
     //!!! rv check
 
     void initFloat() {
+        if (m_fpacked) return;
+        allocating();
         m_fpacked = allocate<float>(m_size*2);
     }
 
     void initDouble() {
+        if (m_dpacked) return;
+        allocating();
         m_dpacked = allocate<double>(m_size*2);
     }
 
@@ -810,46 +1316,12 @@ public:
     }
 
     void packFloat(const float *BQ_R__ re, const float *BQ_R__ im) {
-        int index = 0;
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            m_fpacked[index++] = re[i];
-            index++;
-        }
-        index = 0;
-        if (im) {
-            for (int i = 0; i <= hs; ++i) {
-                index++;
-                m_fpacked[index++] = im[i];
-            }
-        } else {
-            for (int i = 0; i <= hs; ++i) {
-                index++;
-                m_fpacked[index++] = 0.f;
-            }
-        }
+        interleaveBins(m_fpacked, re, im, m_size);
         packFloatConjugates();
     }
 
     void packDouble(const double *BQ_R__ re, const double *BQ_R__ im) {
-        int index = 0;
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            m_dpacked[index++] = re[i];
-            index++;
-        }
-        index = 0;
-        if (im) {
-            for (int i = 0; i <= hs; ++i) {
-                index++;
-                m_dpacked[index++] = im[i];
-            }
-        } else {
-            for (int i = 0; i <= hs; ++i) {
-                index++;
-                m_dpacked[index++] = 0.0;
-            }
-        }
+        interleaveBins(m_dpacked, re, im, m_size);
         packDoubleConjugates();
     }
 
@@ -902,6 +1374,11 @@ public:
         if (!m_dpacked) initDouble();
         mlib_SignalFFT_1_D64C_D64(m_dpacked, realIn, m_order);
         const int hs = m_size/2;
+        if (approximatePolar()) {
+            v_cartesian_interleaved_to_polar(magOut, phaseOut, m_dpacked,
+                                             hs + 1, m_polarAccuracy);
+            return;
+        }
         int index = 0;
         for (int i = 0; i <= hs; ++i) {
             int reali = index;
@@ -944,6 +1421,11 @@ public:
         if (!m_fpacked) initFloat();
         mlib_SignalFFT_1_F32C_F32(m_fpacked, realIn, m_order);
         const int hs = m_size/2;
+        if (approximatePolar()) {
+            v_cartesian_interleaved_to_polar(magOut, phaseOut, m_fpacked,
+                                             hs + 1, m_polarAccuracy);
+            return;
+        }
         int index = 0;
         for (int i = 0; i <= hs; ++i) {
             int reali = index;
@@ -985,11 +1467,16 @@ public:
     void inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut) {
         if (!m_dpacked) initDouble();
         const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            double real = magIn[i] * cos(phaseIn[i]);
-            double imag = magIn[i] * sin(phaseIn[i]);
-            m_dpacked[i*2] = real;
-            m_dpacked[i*2 + 1] = imag;
+        if (approximatePolar()) {
+            v_polar_to_cartesian_interleaved(m_dpacked, magIn, phaseIn,
+                                             hs + 1, m_polarAccuracy);
+        } else {
+            for (int i = 0; i <= hs; ++i) {
+                double real = magIn[i] * cos(phaseIn[i]);
+                double imag = magIn[i] * sin(phaseIn[i]);
+                m_dpacked[i*2] = real;
+                m_dpacked[i*2 + 1] = imag;
+            }
         }
         packDoubleConjugates();
         mlib_SignalIFFT_2_D64_D64C(realOut, m_dpacked, m_order);
@@ -1022,12 +1509,17 @@ public:
     void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut) {
         if (!m_fpacked) initFloat();
         const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            double real = magIn[i] * cos(phaseIn[i]);
-            double imag = magIn[i] * sin(phaseIn[i]);
-            m_fpacked[i*2] = real;
-            m_fpacked[i*2 + 1] = imag;
-        }
+        if (approximatePolar()) {
+            v_polar_to_cartesian_interleaved(m_fpacked, magIn, phaseIn,
+                                             hs + 1, m_polarAccuracy);
+        } else {
+            for (int i = 0; i <= hs; ++i) {
+                double real = magIn[i] * cos(phaseIn[i]);
+                double imag = magIn[i] * sin(phaseIn[i]);
+                m_fpacked[i*2] = real;
+                m_fpacked[i*2 + 1] = imag;
+            }
+        }
         packFloatConjugates();
         mlib_SignalIFFT_2_F32_F32C(realOut, m_fpacked, m_order);
     }
@@ -1098,6 +1590,7 @@ public:
             deallocate(m_packed);
             deallocate(m_buf);
             deallocate(m_fbuf);
+            deallocate(m_dbuf);
             deallocate(m_spec);
         }
     }
@@ -1119,9 +1612,11 @@ public:
 
     void initDouble() {
         if (!m_packed) {
+            allocating();
             m_buf = allocate<OMX_S32>(m_size);
             m_packed = allocate<OMX_S32>(m_size*2 + 2);
             m_fbuf = allocate<float>(m_size*2 + 2);
+            m_dbuf = allocate<double>(m_size*2 + 2);
             OMX_INT sz = 0;
             omxSP_FFTGetBufSize_R_S32(m_order, &sz);
             m_spec = (OMXFFTSpec_R_S32 *)allocate<char>(sz);
@@ -1289,14 +1784,9 @@ public:
         if (!m_packed) initDouble();
         packDouble(realIn);
         omxSP_FFTFwd_RToCCS_S32_Sfs(m_buf, m_packed, m_spec, m_order);
-        unpackDouble(magOut, phaseOut); // temporarily
-        // at this point we actually have real/imag in the mag/phase arrays
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            double real = magOut[i];
-            double imag = phaseOut[i];
-            c_magphase(magOut + i, phaseOut + i, real, imag);
-        }
+        unpackDoubleInterleaved(m_dbuf);
+        v_cartesian_interleaved_to_polar(magOut, phaseOut, m_dbuf,
+                                         m_size/2 + 1, m_polarAccuracy);
     }
 
     void forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut) {
@@ -1332,14 +1822,9 @@ public:
 
         packFloat(realIn);
         omxSP_FFTFwd_RToCCS_S32_Sfs(m_buf, m_packed, m_spec, m_order);
-        unpackFloat(magOut, phaseOut); // temporarily
-        // at this point we actually have real/imag in the mag/phase arrays
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            float real = magOut[i];
-            float imag = phaseOut[i];
-            c_magphase(magOut + i, phaseOut + i, real, imag);
-        }
+        unpackFloatInterleaved(m_fbuf);
+        v_cartesian_interleaved_to_polar(magOut, phaseOut, m_fbuf,
+                                         m_size/2 + 1, m_polarAccuracy);
     }
 
     void forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut) {
@@ -1372,15 +1857,9 @@ public:
 
     void inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut) {
         if (!m_packed) initDouble();
-        int index = 0;
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            double real, imag;
-            c_phasor(&real, &imag, phaseIn[i]);
-            m_fbuf[index++] = float(real);
-            m_fbuf[index++] = float(imag);
-        }
-        convertFloat(m_fbuf);
+        v_polar_to_cartesian_interleaved(m_dbuf, magIn, phaseIn,
+                                         m_size/2 + 1, m_polarAccuracy);
+        convertDouble(m_dbuf);
         omxSP_FFTInv_CCSToR_S32_Sfs(m_packed, m_buf, m_spec, 0);
         unpackDouble(realOut);
     }
@@ -1407,8 +1886,8 @@ public:
 
     void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut) {
         if (!m_packed) initFloat();
-        const int hs = m_size/2;
-        v_polar_to_cartesian_interleaved(m_fbuf, magIn, phaseIn, hs+1);
+        v_polar_to_cartesian_interleaved(m_fbuf, magIn, phaseIn,
+                                         m_size/2 + 1, m_polarAccuracy);
         convertFloat(m_fbuf);
         omxSP_FFTInv_CCSToR_S32_Sfs(m_packed, m_buf, m_spec, 0);
         unpackFloat(realOut);
@@ -1426,6 +1905,7 @@ private:
     OMX_S32 *m_packed;
     OMX_S32 *m_buf;
     float *m_fbuf;
+    double *m_dbuf;
     OMXFFTSpec_R_S32 *m_spec;
 
 };
@@ -1465,12 +1945,18 @@ private:
 #define fft_float_type double
 #define fftwf_complex fftw_complex
 #define fftwf_plan fftw_plan
-#define fftwf_plan_dft_r2c_1d fftw_plan_dft_r2c_1d
-#define fftwf_plan_dft_c2r_1d fftw_plan_dft_c2r_1d
+#define fftwf_plan_guru_dft_r2c fftw_plan_guru_dft_r2c
+#define fftwf_plan_guru_dft_c2r fftw_plan_guru_dft_c2r
+#define fftwf_plan_guru_split_dft_r2c fftw_plan_guru_split_dft_r2c
+#define fftwf_iodim fftw_iodim
 #define fftwf_destroy_plan fftw_destroy_plan
 #define fftwf_malloc fftw_malloc
 #define fftwf_free fftw_free
-#define fftwf_execute fftw_execute
+#define fftwf_execute_dft_r2c fftw_execute_dft_r2c
+#define fftwf_execute_dft_c2r fftw_execute_dft_c2r
+#define fftwf_execute_split_dft_r2c fftw_execute_split_dft_r2c
+#define fftwf_plan_dft_1d fftw_plan_dft_1d
+#define fftwf_execute_dft fftw_execute_dft
 #define atan2f atan2
 #define sqrtf sqrt
 #define cosf cos
@@ -1483,12 +1969,18 @@ private:
 #define fft_double_type float
 #define fftw_complex fftwf_complex
 #define fftw_plan fftwf_plan
-#define fftw_plan_dft_r2c_1d fftwf_plan_dft_r2c_1d
-#define fftw_plan_dft_c2r_1d fftwf_plan_dft_c2r_1d
+#define fftw_plan_guru_dft_r2c fftwf_plan_guru_dft_r2c
+#define fftw_plan_guru_dft_c2r fftwf_plan_guru_dft_c2r
+#define fftw_plan_guru_split_dft_r2c fftwf_plan_guru_split_dft_r2c
+#define fftw_iodim fftwf_iodim
 #define fftw_destroy_plan fftwf_destroy_plan
 #define fftw_malloc fftwf_malloc
 #define fftw_free fftwf_free
-#define fftw_execute fftwf_execute
+#define fftw_execute_dft_r2c fftwf_execute_dft_r2c
+#define fftw_execute_dft_c2r fftwf_execute_dft_c2r
+#define fftw_execute_split_dft_r2c fftwf_execute_split_dft_r2c
+#define fftw_plan_dft_1d fftwf_plan_dft_1d
+#define fftw_execute_dft fftwf_execute_dft
 #define atan2 atan2f
 #define sqrt sqrtf
 #define cos cosf
@@ -1501,39 +1993,65 @@ class D_FFTW : public FFTImpl
 {
 public:
     D_FFTW(int size) :
-        m_fplanf(0), m_dplanf(0), m_size(size)
+        m_fplanf(0), m_fplanmf(0), m_fmany(0), m_fcplanf(0),
+        m_dplanf(0), m_dplanmf(0), m_dmany(0), m_dcplanf(0),
+        m_size(size)
     {
-        initMutex();
     }
 
     ~D_FFTW() {
+        if (m_fcplanf) {
+            releasePlan(m_fcplanf);
+            releasePlan(m_fcplani);
+            fftwf_free(m_fcin);
+            fftwf_free(m_fcout);
+        }
+        if (m_dcplanf) {
+            releasePlan(m_dcplanf);
+            releasePlan(m_dcplani);
+            fftw_free(m_dcin);
+            fftw_free(m_dcout);
+        }
+        if (m_fplanmf) {
+            releasePlan(m_fplanmf);
+            releasePlan(m_fplanmi);
+            fftwf_free(m_fmbuf);
+            fftwf_free(m_fmre);
+            fftwf_free(m_fmpacked);
+        }
+        if (m_dplanmf) {
+            releasePlan(m_dplanmf);
+            releasePlan(m_dplanmi);
+            fftw_free(m_dmbuf);
+            fftw_free(m_dmre);
+            fftw_free(m_dmpacked);
+        }
         if (m_fplanf) {
-            lock();
-            bool save = false;
-            if (m_extantf > 0 && --m_extantf == 0) save = true;
-#ifndef FFTW_DOUBLE_ONLY
-            if (save) saveWisdom('f');
-#endif
-            fftwf_destroy_plan(m_fplanf);
-            fftwf_destroy_plan(m_fplani);
+            releasePlan(m_fplanf);
+            releasePlan(m_fplani);
             fftwf_free(m_fbuf);
             fftwf_free(m_fpacked);
-            unlock();
+            if (atomicAdd(&m_extantf, -1) == 0) {
+                lock();
+#ifndef FFTW_DOUBLE_ONLY
+                saveWisdom('f');
+#endif
+                unlock();
+            }
         }
         if (m_dplanf) {
-            lock();
-            bool save = false;
-            if (m_extantd > 0 && --m_extantd == 0) save = true;
-#ifndef FFTW_SINGLE_ONLY
-            if (save) saveWisdom('d');
-#endif
-            fftw_destroy_plan(m_dplanf);
-            fftw_destroy_plan(m_dplani);
+            releasePlan(m_dplanf);
+            releasePlan(m_dplani);
             fftw_free(m_dbuf);
             fftw_free(m_dpacked);
-            unlock();
+            if (atomicAdd(&m_extantd, -1) == 0) {
+                lock();
+#ifndef FFTW_SINGLE_ONLY
+                saveWisdom('d');
+#endif
+                unlock();
+            }
         }
-        destroyMutex();
     }
 
     FFT::Precisions
@@ -1549,50 +2067,143 @@ public:
 #endif
     }
 
+    /*
+     All plans are executed through the new-array execute functions,
+     so that whenever the caller's buffers have the same alignment as
+     the buffers we planned with (which come from fftw_malloc), we can
+     work on them directly instead of copying through our own. The
+     r2c transforms preserve their input, so passing a caller's const
+     input buffer to them is safe; c2r transforms do not, so inverse
+     transforms always go through m_fpacked or m_dpacked.
+
+     Because plans are never executed on the arrays they were made
+     with, they are shared between instances: see acquirePlan below.
+     Each instance has only its own scratch buffers.
+    */
+
     void initFloat() {
         if (m_fplanf) return;
-        bool load = false;
-        lock();
-        if (m_extantf++ == 0) load = true;
-#ifdef FFTW_DOUBLE_ONLY
-        if (load) loadWisdom('d');
-#else
-        if (load) loadWisdom('f');
-#endif
+        allocating();
+        atomicAdd(&m_extantf, 1);
+        const int hs = m_size/2;
         m_fbuf = (fft_float_type *)fftw_malloc(m_size * sizeof(fft_float_type));
         m_fpacked = (fftwf_complex *)fftw_malloc
-            ((m_size/2 + 1) * sizeof(fftwf_complex));
-        m_fplanf = fftwf_plan_dft_r2c_1d
-            (m_size, m_fbuf, m_fpacked, FFTW_MEASURE);
-        m_fplani = fftwf_plan_dft_c2r_1d
-            (m_size, m_fpacked, m_fbuf, FFTW_MEASURE);
-        unlock();
+            ((hs + 1) * sizeof(fftwf_complex));
+        m_fplani = (fftwf_plan)acquire('f', true, InterleavedLayout, m_size, 1);
+        m_fplanf = (fftwf_plan)acquire('f', false, InterleavedLayout, m_size, 1);
     }
 
     void initDouble() {
         if (m_dplanf) return;
-        bool load = false;
-        lock();
-        if (m_extantd++ == 0) load = true;
-#ifdef FFTW_SINGLE_ONLY
-        if (load) loadWisdom('f');
-#else
-        if (load) loadWisdom('d');
-#endif
+        allocating();
+        atomicAdd(&m_extantd, 1);
+        const int hs = m_size/2;
         m_dbuf = (fft_double_type *)fftw_malloc(m_size * sizeof(fft_double_type));
         m_dpacked = (fftw_complex *)fftw_malloc
-            ((m_size/2 + 1) * sizeof(fftw_complex));
-        m_dplanf = fftw_plan_dft_r2c_1d
-            (m_size, m_dbuf, m_dpacked, FFTW_MEASURE);
-        m_dplani = fftw_plan_dft_c2r_1d
-            (m_size, m_dpacked, m_dbuf, FFTW_MEASURE);
-        unlock();
+            ((hs + 1) * sizeof(fftw_complex));
+        m_dplani = (fftw_plan)acquire('d', true, InterleavedLayout, m_size, 1);
+        m_dplanf = (fftw_plan)acquire('d', false, InterleavedLayout, m_size, 1);
+    }
+
+    // Batch plans transform up to m_maxMany frames at once; longer
+    // batches are processed in chunks of that many. They are acquired
+    // on the first batch call, and replaced if a later call asks for
+    // more frames than the existing plan holds. The forward batch
+    // plan writes split-complex output, to m_fmre and m_fmim or
+    // m_dmre and m_dmim. These share a single allocation, because
+    // FFTW requires the distance between the real and imaginary
+    // arrays to be the same on execution as it was when planning:
+    // see splitOffset.
+
+    void initFloatMany(int count) {
+        if (count > m_maxMany) count = m_maxMany;
+        if (count < 2 || count <= m_fmany) return;
+        allocating();
+        initFloat();
+        if (m_fplanmf) {
+            releasePlan(m_fplanmf);
+            releasePlan(m_fplanmi);
+            fftwf_free(m_fmbuf);
+            fftwf_free(m_fmre);
+            fftwf_free(m_fmpacked);
+        }
+        const int sz = m_size;
+        const int hs = m_size/2;
+        m_fmbuf = (fft_float_type *)fftw_malloc
+            (count * sz * sizeof(fft_float_type));
+        const int off = splitOffset(sz, count);
+        m_fmre = (fft_float_type *)fftw_malloc
+            (2 * off * sizeof(fft_float_type));
+        m_fmim = m_fmre + off;
+        m_fmpacked = (fftwf_complex *)fftw_malloc
+            (count * (hs + 1) * sizeof(fftwf_complex));
+        m_fplanmf = (fftwf_plan)acquire('f', false, SplitLayout, sz, count);
+        m_fplanmi = (fftwf_plan)acquire('f', true, InterleavedLayout, sz, count);
+        m_fmany = count;
+    }
+
+    void initDoubleMany(int count) {
+        if (count > m_maxMany) count = m_maxMany;
+        if (count < 2 || count <= m_dmany) return;
+        allocating();
+        initDouble();
+        if (m_dplanmf) {
+            releasePlan(m_dplanmf);
+            releasePlan(m_dplanmi);
+            fftw_free(m_dmbuf);
+            fftw_free(m_dmre);
+            fftw_free(m_dmpacked);
+        }
+        const int sz = m_size;
+        const int hs = m_size/2;
+        m_dmbuf = (fft_double_type *)fftw_malloc
+            (count * sz * sizeof(fft_double_type));
+        const int off = splitOffset(sz, count);
+        m_dmre = (fft_double_type *)fftw_malloc
+            (2 * off * sizeof(fft_double_type));
+        m_dmim = m_dmre + off;
+        m_dmpacked = (fftw_complex *)fftw_malloc
+            (count * (hs + 1) * sizeof(fftw_complex));
+        m_dplanmf = (fftw_plan)acquire('d', false, SplitLayout, sz, count);
+        m_dplanmi = (fftw_plan)acquire('d', true, InterleavedLayout, sz, count);
+        m_dmany = count;
+    }
+
+    // Complex plans are single-frame, interleaved, and acquired on
+    // the first complex transform at each precision. Their input and
+    // output buffers are used when the caller's are not aligned as
+    // the plans expect, and for split-complex data
+
+    void initFloatComplex(int) {
+        if (m_fcplanf) return;
+        allocating();
+        initFloat();
+        m_fcin = (fftwf_complex *)fftw_malloc(m_size * sizeof(fftwf_complex));
+        m_fcout = (fftwf_complex *)fftw_malloc(m_size * sizeof(fftwf_complex));
+        m_fcplani = (fftwf_plan)acquire('f', true, ComplexLayout, m_size, 1);
+        m_fcplanf = (fftwf_plan)acquire('f', false, ComplexLayout, m_size, 1);
+    }
+
+    void initDoubleComplex(int) {
+        if (m_dcplanf) return;
+        allocating();
+        initDouble();
+        m_dcin = (fftw_complex *)fftw_malloc(m_size * sizeof(fftw_complex));
+        m_dcout = (fftw_complex *)fftw_malloc(m_size * sizeof(fftw_complex));
+        m_dcplani = (fftw_plan)acquire('d', true, ComplexLayout, m_size, 1);
+        m_dcplanf = (fftw_plan)acquire('d', false, ComplexLayout, m_size, 1);
+    }
+
+    static int splitOffset(int size, int count) {
+        // Rounded up so the imaginary array is as aligned as the real
+        const int n = count * (size/2 + 1);
+        return (n + 7) & ~7;
     }
 
-    void loadWisdom(char type) { wisdom(false, type); }
-    void saveWisdom(char type) { wisdom(true, type); }
+    static void loadWisdom(char type) { wisdom(false, type); }
+    static void saveWisdom(char type) { wisdom(true, type); }
 
-    void wisdom(bool save, char type) {
+    static void wisdom(bool save, char type) {
 
 #ifdef FFTW_DOUBLE_ONLY
         if (type == 'f') return;
@@ -1643,118 +2254,174 @@ public:
         fclose(f);
     }
 
-    void packFloat(const float *BQ_R__ re, const float *BQ_R__ im) {
-        const int hs = m_size/2;
-        fftwf_complex *const BQ_R__ fpacked = m_fpacked; 
-        for (int i = 0; i <= hs; ++i) {
-            fpacked[i][0] = re[i];
-        }
-        if (im) {
-            for (int i = 0; i <= hs; ++i) {
-                fpacked[i][1] = im[i];
-            }
-        } else {
-            for (int i = 0; i <= hs; ++i) {
-                fpacked[i][1] = 0.f;
-            }
-        }                
+    // Return a pointer suitable for passing as the input of a forward
+    // plan: either the caller's own buffer, if it is aligned the way
+    // the plans expect, or our internal buffer with the input copied
+    // into it
+
+    fft_float_type *floatInput(const float *BQ_R__ realIn) {
+#ifndef FFTW_DOUBLE_ONLY
+        float *in = const_cast<float *>(realIn);
+        if (fftwf_alignment_of(in) == 0) return in;
+#endif
+        v_convert(m_fbuf, realIn, m_size);
+        return m_fbuf;
     }
 
-    void packDouble(const double *BQ_R__ re, const double *BQ_R__ im) {
-        const int hs = m_size/2;
-        fftw_complex *const BQ_R__ dpacked = m_dpacked; 
-        for (int i = 0; i <= hs; ++i) {
-            dpacked[i][0] = re[i];
+    fft_double_type *doubleInput(const double *BQ_R__ realIn) {
+#ifndef FFTW_SINGLE_ONLY
+        double *in = const_cast<double *>(realIn);
+        if (fftw_alignment_of(in) == 0) return in;
+#endif
+        v_convert(m_dbuf, realIn, m_size);
+        return m_dbuf;
+    }
+
+    // The same, for windowed input: the window is applied as the
+    // input is copied into our internal buffer, which is then used
+    // whatever the caller's alignment
+
+    fft_float_type *floatWindowed(const float *BQ_R__ realIn,
+                                  const float *BQ_R__ window) {
+        windowInto(m_fbuf, realIn, window, m_size);
+        return m_fbuf;
+    }
+
+    fft_double_type *doubleWindowed(const double *BQ_R__ realIn,
+                                    const double *BQ_R__ window) {
+        windowInto(m_dbuf, realIn, window, m_size);
+        return m_dbuf;
+    }
+
+    // And for input of inCount samples, padded with zeros in our
+    // internal buffer. FFTW has no way to plan for input known to be
+    // mostly zero, so this saves the caller the copy but no more
+
+    fft_float_type *floatPadded(const float *BQ_R__ realIn, int inCount) {
+        v_convert(m_fbuf, realIn, inCount);
+        v_zero(m_fbuf + inCount, m_size - inCount);
+        return m_fbuf;
+    }
+
+    fft_double_type *doublePadded(const double *BQ_R__ realIn, int inCount) {
+        v_convert(m_dbuf, realIn, inCount);
+        v_zero(m_dbuf + inCount, m_size - inCount);
+        return m_dbuf;
+    }
+
+    // Run the inverse plan from m_fpacked or m_dpacked, writing
+    // directly to the caller's buffer if it is suitably aligned
+
+    void executeFloatInverse(float *BQ_R__ realOut) {
+#ifndef FFTW_DOUBLE_ONLY
+        if (fftwf_alignment_of(realOut) == 0) {
+            fftwf_execute_dft_c2r(m_fplani, m_fpacked, realOut);
+            return;
         }
-        if (im) {
-            for (int i = 0; i <= hs; ++i) {
-                dpacked[i][1] = im[i];
-            }
-        } else {
-            for (int i = 0; i <= hs; ++i) {
-                dpacked[i][1] = 0.0;
-            }
+#endif
+        fftwf_execute_dft_c2r(m_fplani, m_fpacked, m_fbuf);
+        v_convert(realOut, m_fbuf, m_size);
+    }
+
+    void executeDoubleInverse(double *BQ_R__ realOut) {
+#ifndef FFTW_SINGLE_ONLY
+        if (fftw_alignment_of(realOut) == 0) {
+            fftw_execute_dft_c2r(m_dplani, m_dpacked, realOut);
+            return;
         }
+#endif
+        fftw_execute_dft_c2r(m_dplani, m_dpacked, m_dbuf);
+        v_convert(realOut, m_dbuf, m_size);
     }
 
-    void unpackFloat(float *BQ_R__ re, float *BQ_R__ im) {
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            re[i] = m_fpacked[i][0];
+    // Run a complex plan from the caller's interleaved input to their
+    // output, using either directly if it is suitably aligned and
+    // going through m_fcin or m_fcout (m_dcin, m_dcout) otherwise.
+    // The complex transforms preserve their input, so the caller's
+    // const input buffer is safe to pass
+
+    void executeFloatComplex(fftwf_plan plan, const float *BQ_R__ complexIn,
+                             float *BQ_R__ complexOut) {
+        fftwf_complex *in = m_fcin;
+        fftwf_complex *out = m_fcout;
+#ifndef FFTW_DOUBLE_ONLY
+        float *cin = const_cast<float *>(complexIn);
+        if (fftwf_alignment_of(cin) == 0) in = (fftwf_complex *)cin;
+        if (fftwf_alignment_of(complexOut) == 0) out = (fftwf_complex *)complexOut;
+#endif
+        if (in == m_fcin) {
+            v_convert((fft_float_type *)m_fcin, complexIn, m_size * 2);
         }
-        if (im) {
-            for (int i = 0; i <= hs; ++i) {
-                im[i] = m_fpacked[i][1];
-            }
+        fftwf_execute_dft(plan, in, out);
+        if (out == m_fcout) {
+            v_convert(complexOut, (const fft_float_type *)m_fcout, m_size * 2);
         }
-    }        
+    }
 
-    void unpackDouble(double *BQ_R__ re, double *BQ_R__ im) {
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            re[i] = m_dpacked[i][0];
+    void executeDoubleComplex(fftw_plan plan, const double *BQ_R__ complexIn,
+                              double *BQ_R__ complexOut) {
+        fftw_complex *in = m_dcin;
+        fftw_complex *out = m_dcout;
+#ifndef FFTW_SINGLE_ONLY
+        double *cin = const_cast<double *>(complexIn);
+        if (fftw_alignment_of(cin) == 0) in = (fftw_complex *)cin;
+        if (fftw_alignment_of(complexOut) == 0) out = (fftw_complex *)complexOut;
+#endif
+        if (in == m_dcin) {
+            v_convert((fft_double_type *)m_dcin, complexIn, m_size * 2);
         }
-        if (im) {
-            for (int i = 0; i <= hs; ++i) {
-                im[i] = m_dpacked[i][1];
-            }
+        fftw_execute_dft(plan, in, out);
+        if (out == m_dcout) {
+            v_convert(complexOut, (const fft_double_type *)m_dcout, m_size * 2);
         }
-    }        
+    }
+
+    void packFloat(const float *BQ_R__ re, const float *BQ_R__ im) {
+        interleaveBins((fft_float_type *)m_fpacked, re, im, m_size);
+    }
+
+    void packDouble(const double *BQ_R__ re, const double *BQ_R__ im) {
+        interleaveBins((fft_double_type *)m_dpacked, re, im, m_size);
+    }
+
+    void unpackFloat(float *BQ_R__ re, float *BQ_R__ im) {
+        deinterleaveBins(re, im, (const fft_float_type *)m_fpacked, m_size);
+    }
+
+    void unpackDouble(double *BQ_R__ re, double *BQ_R__ im) {
+        deinterleaveBins(re, im, (const fft_double_type *)m_dpacked, m_size);
+    }
 
     void forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
         if (!m_dplanf) initDouble();
-        const int sz = m_size;
-        fft_double_type *const BQ_R__ dbuf = m_dbuf;
-#ifndef FFTW_SINGLE_ONLY
-        if (realIn != dbuf) 
-#endif
-            for (int i = 0; i < sz; ++i) {
-                dbuf[i] = realIn[i];
-            }
-        fftw_execute(m_dplanf);
+        fftw_execute_dft_r2c(m_dplanf, doubleInput(realIn), m_dpacked);
         unpackDouble(realOut, imagOut);
     }
 
     void forwardInterleaved(const double *BQ_R__ realIn, double *BQ_R__ complexOut) {
         if (!m_dplanf) initDouble();
-        const int sz = m_size;
-        fft_double_type *const BQ_R__ dbuf = m_dbuf;
+        fft_double_type *in = doubleInput(realIn);
 #ifndef FFTW_SINGLE_ONLY
-        if (realIn != dbuf) 
+        if (fftw_alignment_of(complexOut) == 0) {
+            fftw_execute_dft_r2c(m_dplanf, in, (fftw_complex *)complexOut);
+            return;
+        }
 #endif
-            for (int i = 0; i < sz; ++i) {
-                dbuf[i] = realIn[i];
-            }
-        fftw_execute(m_dplanf);
-        v_convert(complexOut, (fft_double_type *)m_dpacked, sz + 2);
+        fftw_execute_dft_r2c(m_dplanf, in, m_dpacked);
+        v_convert(complexOut, (fft_double_type *)m_dpacked, (m_size/2 + 1) * 2);
     }
 
     void forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut) {
         if (!m_dplanf) initDouble();
-        fft_double_type *const BQ_R__ dbuf = m_dbuf;
-        const int sz = m_size;
-#ifndef FFTW_SINGLE_ONLY
-        if (realIn != dbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                dbuf[i] = realIn[i];
-            }
-        fftw_execute(m_dplanf);
+        fftw_execute_dft_r2c(m_dplanf, doubleInput(realIn), m_dpacked);
         v_cartesian_interleaved_to_polar(magOut, phaseOut,
-                                         (double *)m_dpacked, m_size/2+1);
+                                         (fft_double_type *)m_dpacked, m_size/2+1,
+                                         m_polarAccuracy);
     }
 
     void forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut) {
         if (!m_dplanf) initDouble();
-        fft_double_type *const BQ_R__ dbuf = m_dbuf;
-        const int sz = m_size;
-#ifndef FFTW_SINGLE_ONLY
-        if (realIn != m_dbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                dbuf[i] = realIn[i];
-            }
-        fftw_execute(m_dplanf);
+        fftw_execute_dft_r2c(m_dplanf, doubleInput(realIn), m_dpacked);
         const int hs = m_size/2;
         for (int i = 0; i <= hs; ++i) {
             magOut[i] = sqrt(m_dpacked[i][0] * m_dpacked[i][0] +
@@ -1764,58 +2431,34 @@ public:
 
     void forward(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
         if (!m_fplanf) initFloat();
-        fft_float_type *const BQ_R__ fbuf = m_fbuf;
-        const int sz = m_size;
-#ifndef FFTW_DOUBLE_ONLY
-        if (realIn != fbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                fbuf[i] = realIn[i];
-            }
-        fftwf_execute(m_fplanf);
+        fftwf_execute_dft_r2c(m_fplanf, floatInput(realIn), m_fpacked);
         unpackFloat(realOut, imagOut);
     }
 
     void forwardInterleaved(const float *BQ_R__ realIn, float *BQ_R__ complexOut) {
         if (!m_fplanf) initFloat();
-        fft_float_type *const BQ_R__ fbuf = m_fbuf;
-        const int sz = m_size;
+        fft_float_type *in = floatInput(realIn);
 #ifndef FFTW_DOUBLE_ONLY
-        if (realIn != fbuf)
+        if (fftwf_alignment_of(complexOut) == 0) {
+            fftwf_execute_dft_r2c(m_fplanf, in, (fftwf_complex *)complexOut);
+            return;
+        }
 #endif
-            for (int i = 0; i < sz; ++i) {
-                fbuf[i] = realIn[i];
-            }
-        fftwf_execute(m_fplanf);
-        v_convert(complexOut, (fft_float_type *)m_fpacked, sz + 2);
+        fftwf_execute_dft_r2c(m_fplanf, in, m_fpacked);
+        v_convert(complexOut, (fft_float_type *)m_fpacked, (m_size/2 + 1) * 2);
     }
 
     void forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut) {
         if (!m_fplanf) initFloat();
-        fft_float_type *const BQ_R__ fbuf = m_fbuf;
-        const int sz = m_size;
-#ifndef FFTW_DOUBLE_ONLY
-        if (realIn != fbuf) 
-#endif
-            for (int i = 0; i < sz; ++i) {
-                fbuf[i] = realIn[i];
-            }
-        fftwf_execute(m_fplanf);
+        fftwf_execute_dft_r2c(m_fplanf, floatInput(realIn), m_fpacked);
         v_cartesian_interleaved_to_polar(magOut, phaseOut,
-                                         (float *)m_fpacked, m_size/2+1);
+                                         (fft_float_type *)m_fpacked, m_size/2+1,
+                                         m_polarAccuracy);
     }
 
     void forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut) {
         if (!m_fplanf) initFloat();
-        fft_float_type *const BQ_R__ fbuf = m_fbuf;
-        const int sz = m_size;
-#ifndef FFTW_DOUBLE_ONLY
-        if (realIn != fbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                fbuf[i] = realIn[i];
-            }
-        fftwf_execute(m_fplanf);
+        fftwf_execute_dft_r2c(m_fplanf, floatInput(realIn), m_fpacked);
         const int hs = m_size/2;
         for (int i = 0; i <= hs; ++i) {
             magOut[i] = sqrtf(m_fpacked[i][0] * m_fpacked[i][0] +
@@ -1823,37 +2466,79 @@ public:
         }
     }
 
+    // A full transform is always the quickest way to get any number
+    // of bins here: only the unpacking is limited to the range
+
+    void forwardBins(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut, int first, int count) {
+        if (!m_dplanf) initDouble();
+        fftw_execute_dft_r2c(m_dplanf, doubleInput(realIn), m_dpacked);
+        splitComplex(realOut, imagOut, (const fft_double_type *)(m_dpacked + first), count);
+    }
+
+    void forwardBinsPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut, int first, int count) {
+        if (!m_dplanf) initDouble();
+        fftw_execute_dft_r2c(m_dplanf, doubleInput(realIn), m_dpacked);
+        interleavedToPolar(magOut, phaseOut, (const fft_double_type *)(m_dpacked + first), count);
+    }
+
+    void forwardBinsMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut, int first, int count) {
+        if (!m_dplanf) initDouble();
+        fftw_execute_dft_r2c(m_dplanf, doubleInput(realIn), m_dpacked);
+        interleavedToMagnitude(magOut, (const fft_double_type *)(m_dpacked + first), count);
+    }
+
+    void forwardBins(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut, int first, int count) {
+        if (!m_fplanf) initFloat();
+        fftwf_execute_dft_r2c(m_fplanf, floatInput(realIn), m_fpacked);
+        splitComplex(realOut, imagOut, (const fft_float_type *)(m_fpacked + first), count);
+    }
+
+    void forwardBinsPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut, int first, int count) {
+        if (!m_fplanf) initFloat();
+        fftwf_execute_dft_r2c(m_fplanf, floatInput(realIn), m_fpacked);
+        interleavedToPolar(magOut, phaseOut, (const fft_float_type *)(m_fpacked + first), count);
+    }
+
+    void forwardBinsMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut, int first, int count) {
+        if (!m_fplanf) initFloat();
+        fftwf_execute_dft_r2c(m_fplanf, floatInput(realIn), m_fpacked);
+        interleavedToMagnitude(magOut, (const fft_float_type *)(m_fpacked + first), count);
+    }
+
+    void forwardPadded(const double *BQ_R__ realIn, int inCount, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_dplanf) initDouble();
+        fftw_execute_dft_r2c(m_dplanf, doublePadded(realIn, inCount), m_dpacked);
+        unpackDouble(realOut, imagOut);
+    }
+
+    void forwardPadded(const float *BQ_R__ realIn, int inCount, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_fplanf) initFloat();
+        fftwf_execute_dft_r2c(m_fplanf, floatPadded(realIn, inCount), m_fpacked);
+        unpackFloat(realOut, imagOut);
+    }
+
     void inverse(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut) {
         if (!m_dplanf) initDouble();
         packDouble(realIn, imagIn);
-        fftw_execute(m_dplani);
-        const int sz = m_size;
-        fft_double_type *const BQ_R__ dbuf = m_dbuf;
-#ifndef FFTW_SINGLE_ONLY
-        if (realOut != dbuf) 
-#endif
-            for (int i = 0; i < sz; ++i) {
-                realOut[i] = dbuf[i];
-            }
+        executeDoubleInverse(realOut);
     }
 
     void inverseInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ realOut) {
         if (!m_dplanf) initDouble();
-        v_convert((double *)m_dpacked, complexIn, m_size + 2);
-        fftw_execute(m_dplani);
-        const int sz = m_size;
-        fft_double_type *const BQ_R__ dbuf = m_dbuf;
-#ifndef FFTW_SINGLE_ONLY
-        if (realOut != dbuf) 
-#endif
-            for (int i = 0; i < sz; ++i) {
-                realOut[i] = dbuf[i];
-            }
+        v_convert((fft_double_type *)m_dpacked, complexIn, (m_size/2 + 1) * 2);
+        executeDoubleInverse(realOut);
     }
 
     void inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut) {
         if (!m_dplanf) initDouble();
         const int hs = m_size/2;
+        if (approximatePolar()) {
+            v_polar_to_cartesian_interleaved((fft_double_type *)m_dpacked,
+                                             magIn, phaseIn, hs + 1,
+                                             m_polarAccuracy);
+            executeDoubleInverse(realOut);
+            return;
+        }
         fftw_complex *const BQ_R__ dpacked = m_dpacked;
         for (int i = 0; i <= hs; ++i) {
             dpacked[i][0] = magIn[i] * cos(phaseIn[i]);
@@ -1861,20 +2546,11 @@ public:
         for (int i = 0; i <= hs; ++i) {
             dpacked[i][1] = magIn[i] * sin(phaseIn[i]);
         }
-        fftw_execute(m_dplani);
-        const int sz = m_size;
-        fft_double_type *const BQ_R__ dbuf = m_dbuf;
-#ifndef FFTW_SINGLE_ONLY
-        if (realOut != dbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                realOut[i] = dbuf[i];
-            }
+        executeDoubleInverse(realOut);
     }
 
     void inverseCepstral(const double *BQ_R__ magIn, double *BQ_R__ cepOut) {
         if (!m_dplanf) initDouble();
-        fft_double_type *const BQ_R__ dbuf = m_dbuf;
         fftw_complex *const BQ_R__ dpacked = m_dpacked;
         const int hs = m_size/2;
         for (int i = 0; i <= hs; ++i) {
@@ -1883,47 +2559,31 @@ public:
         for (int i = 0; i <= hs; ++i) {
             dpacked[i][1] = 0.0;
         }
-        fftw_execute(m_dplani);
-        const int sz = m_size;
-#ifndef FFTW_SINGLE_ONLY
-        if (cepOut != dbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                cepOut[i] = dbuf[i];
-            }
+        executeDoubleInverse(cepOut);
     }
 
     void inverse(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut) {
         if (!m_fplanf) initFloat();
         packFloat(realIn, imagIn);
-        fftwf_execute(m_fplani);
-        const int sz = m_size;
-        fft_float_type *const BQ_R__ fbuf = m_fbuf;
-#ifndef FFTW_DOUBLE_ONLY
-        if (realOut != fbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                realOut[i] = fbuf[i];
-            }
+        executeFloatInverse(realOut);
     }
 
     void inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut) {
         if (!m_fplanf) initFloat();
-        v_copy((float *)m_fpacked, complexIn, m_size + 2);
-        fftwf_execute(m_fplani);
-        const int sz = m_size;
-        fft_float_type *const BQ_R__ fbuf = m_fbuf;
-#ifndef FFTW_DOUBLE_ONLY
-        if (realOut != fbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                realOut[i] = fbuf[i];
-            }
+        v_convert((fft_float_type *)m_fpacked, complexIn, (m_size/2 + 1) * 2);
+        executeFloatInverse(realOut);
     }
 
     void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut) {
         if (!m_fplanf) initFloat();
         const int hs = m_size/2;
+        if (approximatePolar()) {
+            v_polar_to_cartesian_interleaved((fft_float_type *)m_fpacked,
+                                             magIn, phaseIn, hs + 1,
+                                             m_polarAccuracy);
+            executeFloatInverse(realOut);
+            return;
+        }
         fftwf_complex *const BQ_R__ fpacked = m_fpacked;
         for (int i = 0; i <= hs; ++i) {
             fpacked[i][0] = magIn[i] * cosf(phaseIn[i]);
@@ -1931,15 +2591,7 @@ public:
         for (int i = 0; i <= hs; ++i) {
             fpacked[i][1] = magIn[i] * sinf(phaseIn[i]);
         }
-        fftwf_execute(m_fplani);
-        const int sz = m_size;
-        fft_float_type *const BQ_R__ fbuf = m_fbuf;
-#ifndef FFTW_DOUBLE_ONLY
-        if (realOut != fbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                realOut[i] = fbuf[i];
-            }
+        executeFloatInverse(realOut);
     }
 
     void inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut) {
@@ -1952,70 +2604,606 @@ public:
         for (int i = 0; i <= hs; ++i) {
             fpacked[i][1] = 0.f;
         }
-        fftwf_execute(m_fplani);
+        executeFloatInverse(cepOut);
+    }
+
+    // The batch functions read time-domain frames directly from the
+    // caller's input buffer (forward), or write them directly to its
+    // output buffer (inverse), when the stride matches the batch
+    // plan's layout and the buffer is aligned. Forward output always
+    // goes through m_fmre/m_fmim or m_dmre/m_dmim, see initFloatMany
+
+    void forwardMany(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut, int inStride, int outStride, int count) {
+        if (count > m_dmany) initDoubleMany(count);
         const int sz = m_size;
-        fft_float_type *const BQ_R__ fbuf = m_fbuf;
-#ifndef FFTW_DOUBLE_ONLY
-        if (cepOut != fbuf)
+        const int hs = m_size/2;
+        int done = 0;
+        if (m_dmany > 1) {
+            const int n = m_dmany;
+            for ( ; done + n <= count; done += n) {
+                fft_double_type *in = m_dmbuf;
+#ifndef FFTW_SINGLE_ONLY
+                double *callerIn = const_cast<double *>(realIn + done * inStride);
+                if (inStride == sz && fftw_alignment_of(callerIn) == 0) {
+                    in = callerIn;
+                } else
 #endif
-            for (int i = 0; i < sz; ++i) {
-                cepOut[i] = fbuf[i];
+                for (int j = 0; j < n; ++j) {
+                    v_convert(m_dmbuf + j * sz, realIn + (done + j) * inStride, sz);
+                }
+                fftw_execute_split_dft_r2c(m_dplanmf, in, m_dmre, m_dmim);
+                for (int j = 0; j < n; ++j) {
+                    v_convert(realOut + (done + j) * outStride, m_dmre + j * (hs + 1), hs + 1);
+                    v_convert(imagOut + (done + j) * outStride, m_dmim + j * (hs + 1), hs + 1);
+                }
             }
+        }
+        for ( ; done < count; ++done) {
+            forward(realIn + done * inStride,
+                    realOut + done * outStride, imagOut + done * outStride);
+        }
     }
 
-private:
-    fftwf_plan m_fplanf;
-    fftwf_plan m_fplani;
-#ifdef FFTW_DOUBLE_ONLY
-    double *m_fbuf;
-#else
-    float *m_fbuf;
+    void forwardMany(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut, int inStride, int outStride, int count) {
+        if (count > m_fmany) initFloatMany(count);
+        const int sz = m_size;
+        const int hs = m_size/2;
+        int done = 0;
+        if (m_fmany > 1) {
+            const int n = m_fmany;
+            for ( ; done + n <= count; done += n) {
+                fft_float_type *in = m_fmbuf;
+#ifndef FFTW_DOUBLE_ONLY
+                float *callerIn = const_cast<float *>(realIn + done * inStride);
+                if (inStride == sz && fftwf_alignment_of(callerIn) == 0) {
+                    in = callerIn;
+                } else
 #endif
-    fftwf_complex *m_fpacked;
-    fftw_plan m_dplanf;
-    fftw_plan m_dplani;
-#ifdef FFTW_SINGLE_ONLY
-    float *m_dbuf;
-#else
-    double *m_dbuf;
+                for (int j = 0; j < n; ++j) {
+                    v_convert(m_fmbuf + j * sz, realIn + (done + j) * inStride, sz);
+                }
+                fftwf_execute_split_dft_r2c(m_fplanmf, in, m_fmre, m_fmim);
+                for (int j = 0; j < n; ++j) {
+                    v_convert(realOut + (done + j) * outStride, m_fmre + j * (hs + 1), hs + 1);
+                    v_convert(imagOut + (done + j) * outStride, m_fmim + j * (hs + 1), hs + 1);
+                }
+            }
+        }
+        for ( ; done < count; ++done) {
+            forward(realIn + done * inStride,
+                    realOut + done * outStride, imagOut + done * outStride);
+        }
+    }
+
+    void inverseMany(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut, int inStride, int outStride, int count) {
+        if (count > m_dmany) initDoubleMany(count);
+        const int sz = m_size;
+        const int hs = m_size/2;
+        int done = 0;
+        if (m_dmany > 1) {
+            const int n = m_dmany;
+            for ( ; done + n <= count; done += n) {
+                for (int j = 0; j < n; ++j) {
+                    const double *const BQ_R__ re = realIn + (done + j) * inStride;
+                    const double *const BQ_R__ im = imagIn + (done + j) * inStride;
+                    fftw_complex *const BQ_R__ dpacked = m_dmpacked + j * (hs + 1);
+                    for (int i = 0; i <= hs; ++i) {
+                        dpacked[i][0] = re[i];
+                    }
+                    for (int i = 0; i <= hs; ++i) {
+                        dpacked[i][1] = im[i];
+                    }
+                }
+#ifndef FFTW_SINGLE_ONLY
+                double *out = realOut + done * outStride;
+                if (outStride == sz && fftw_alignment_of(out) == 0) {
+                    fftw_execute_dft_c2r(m_dplanmi, m_dmpacked, out);
+                    continue;
+                }
 #endif
-    fftw_complex *m_dpacked;
-    const int m_size;
-    static int m_extantf;
-    static int m_extantd;
-#ifdef NO_THREADING
-    void initMutex() {}
-    void destroyMutex() {}
-    void lock() {}
-    void unlock() {}
+                fftw_execute_dft_c2r(m_dplanmi, m_dmpacked, m_dmbuf);
+                for (int j = 0; j < n; ++j) {
+                    v_convert(realOut + (done + j) * outStride, m_dmbuf + j * sz, sz);
+                }
+            }
+        }
+        for ( ; done < count; ++done) {
+            inverse(realIn + done * inStride, imagIn + done * inStride,
+                    realOut + done * outStride);
+        }
+    }
+
+    void inverseMany(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut, int inStride, int outStride, int count) {
+        if (count > m_fmany) initFloatMany(count);
+        const int sz = m_size;
+        const int hs = m_size/2;
+        int done = 0;
+        if (m_fmany > 1) {
+            const int n = m_fmany;
+            for ( ; done + n <= count; done += n) {
+                for (int j = 0; j < n; ++j) {
+                    const float *const BQ_R__ re = realIn + (done + j) * inStride;
+                    const float *const BQ_R__ im = imagIn + (done + j) * inStride;
+                    fftwf_complex *const BQ_R__ fpacked = m_fmpacked + j * (hs + 1);
+                    for (int i = 0; i <= hs; ++i) {
+                        fpacked[i][0] = re[i];
+                    }
+                    for (int i = 0; i <= hs; ++i) {
+                        fpacked[i][1] = im[i];
+                    }
+                }
+#ifndef FFTW_DOUBLE_ONLY
+                float *out = realOut + done * outStride;
+                if (outStride == sz && fftwf_alignment_of(out) == 0) {
+                    fftwf_execute_dft_c2r(m_fplanmi, m_fmpacked, out);
+                    continue;
+                }
+#endif
+                fftwf_execute_dft_c2r(m_fplanmi, m_fmpacked, m_fmbuf);
+                for (int j = 0; j < n; ++j) {
+                    v_convert(realOut + (done + j) * outStride, m_fmbuf + j * sz, sz);
+                }
+            }
+        }
+        for ( ; done < count; ++done) {
+            inverse(realIn + done * inStride, imagIn + done * inStride,
+                    realOut + done * outStride);
+        }
+    }
+
+    void forwardComplex(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_dcplanf) initDoubleComplex(m_size);
+        joinComplex((fft_double_type *)m_dcin, realIn, imagIn, m_size);
+        fftw_execute_dft(m_dcplanf, m_dcin, m_dcout);
+        splitComplex(realOut, imagOut, (const fft_double_type *)m_dcout, m_size);
+    }
+
+    void forwardComplexInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ complexOut) {
+        if (!m_dcplanf) initDoubleComplex(m_size);
+        executeDoubleComplex(m_dcplanf, complexIn, complexOut);
+    }
+
+    void inverseComplex(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_dcplanf) initDoubleComplex(m_size);
+        joinComplex((fft_double_type *)m_dcin, realIn, imagIn, m_size);
+        fftw_execute_dft(m_dcplani, m_dcin, m_dcout);
+        splitComplex(realOut, imagOut, (const fft_double_type *)m_dcout, m_size);
+    }
+
+    void inverseComplexInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ complexOut) {
+        if (!m_dcplanf) initDoubleComplex(m_size);
+        executeDoubleComplex(m_dcplani, complexIn, complexOut);
+    }
+
+    void forwardComplex(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_fcplanf) initFloatComplex(m_size);
+        joinComplex((fft_float_type *)m_fcin, realIn, imagIn, m_size);
+        fftwf_execute_dft(m_fcplanf, m_fcin, m_fcout);
+        splitComplex(realOut, imagOut, (const fft_float_type *)m_fcout, m_size);
+    }
+
+    void forwardComplexInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ complexOut) {
+        if (!m_fcplanf) initFloatComplex(m_size);
+        executeFloatComplex(m_fcplanf, complexIn, complexOut);
+    }
+
+    void inverseComplex(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_fcplanf) initFloatComplex(m_size);
+        joinComplex((fft_float_type *)m_fcin, realIn, imagIn, m_size);
+        fftwf_execute_dft(m_fcplani, m_fcin, m_fcout);
+        splitComplex(realOut, imagOut, (const fft_float_type *)m_fcout, m_size);
+    }
+
+    void inverseComplexInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ complexOut) {
+        if (!m_fcplanf) initFloatComplex(m_size);
+        executeFloatComplex(m_fcplani, complexIn, complexOut);
+    }
+
+    void initFloatSpectra(int) { }
+    void initDoubleSpectra(int) { }
+
+    void forwardWindowed(const double *BQ_R__ realIn, const double *BQ_R__ window, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_dplanf) initDouble();
+        fftw_execute_dft_r2c(m_dplanf, doubleWindowed(realIn, window), m_dpacked);
+        unpackDouble(realOut, imagOut);
+    }
+
+    void forwardPower(const double *BQ_R__ realIn, const double *BQ_R__ window, double *BQ_R__ powerOut) {
+        if (!m_dplanf) initDouble();
+        fftw_execute_dft_r2c(m_dplanf,
+                             window ? doubleWindowed(realIn, window) : doubleInput(realIn),
+                             m_dpacked);
+        interleavedToPower(powerOut, (const fft_double_type *)m_dpacked, m_size/2 + 1);
+    }
+
+    void forwardWindowed(const float *BQ_R__ realIn, const float *BQ_R__ window, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_fplanf) initFloat();
+        fftwf_execute_dft_r2c(m_fplanf, floatWindowed(realIn, window), m_fpacked);
+        unpackFloat(realOut, imagOut);
+    }
+
+    void forwardPower(const float *BQ_R__ realIn, const float *BQ_R__ window, float *BQ_R__ powerOut) {
+        if (!m_fplanf) initFloat();
+        fftwf_execute_dft_r2c(m_fplanf,
+                              window ? floatWindowed(realIn, window) : floatInput(realIn),
+                              m_fpacked);
+        interleavedToPower(powerOut, (const fft_float_type *)m_fpacked, m_size/2 + 1);
+    }
+
+private:
+    fftwf_plan m_fplanf;
+    fftwf_plan m_fplani;
+    fft_float_type *m_fbuf;
+    fftwf_complex *m_fpacked;
+    fftwf_plan m_fplanmf;
+    fftwf_plan m_fplanmi;
+    fft_float_type *m_fmbuf;
+    fft_float_type *m_fmre;
+    fft_float_type *m_fmim;
+    fftwf_complex *m_fmpacked;
+    int m_fmany;
+    fftwf_plan m_fcplanf;
+    fftwf_plan m_fcplani;
+    fftwf_complex *m_fcin;
+    fftwf_complex *m_fcout;
+    fftw_plan m_dplanf;
+    fftw_plan m_dplani;
+    fft_double_type *m_dbuf;
+    fftw_complex *m_dpacked;
+    fftw_plan m_dplanmf;
+    fftw_plan m_dplanmi;
+    fft_double_type *m_dmbuf;
+    fft_double_type *m_dmre;
+    fft_double_type *m_dmim;
+    fftw_complex *m_dmpacked;
+    int m_dmany;
+    fftw_plan m_dcplanf;
+    fftw_plan m_dcplani;
+    fftw_complex *m_dcin;
+    fftw_complex *m_dcout;
+    const int m_size;
+    static const int m_maxMany = 16;
+    static volatile int m_extantf;
+    static volatile int m_extantd;
+
+    /*
+     The plan cache. Plans are keyed by precision ('f' or 'd'),
+     direction, layout, size and number of frames, and are reference
+     counted. Entries are only ever added at the head of the list,
+     and are never removed from it (an entry whose plan has been
+     destroyed is reused if the same key comes up again), so the list
+     can be walked without locking.
+
+     An entry's refcount is positive while the plan is in use, zero
+     after its last user has released it but before it has been
+     destroyed, and -1 once destroyed. A lookup that finds a positive
+     refcount just increments it; anything else, including a miss,
+     goes through the planner lock. Plans are only created and
+     destroyed with the lock held, as FFTW requires.
+    */
+
+    enum PlanLayout { InterleavedLayout, SplitLayout, ComplexLayout };
+
+    struct CachedPlan {
+        char type;
+        bool inverse;
+        PlanLayout layout;
+        int size;
+        int count;
+        void *plan;
+        volatile int refcount;
+        CachedPlan *next;
+    };
+
+    static CachedPlan *volatile m_plans;
+    static bool m_wisdomLoadedf;
+    static bool m_wisdomLoadedd;
+
+    static void *acquirePlan(char type, bool inverse, PlanLayout layout,
+                             int size, int count, bool &locked);
+    static void releasePlan(void *plan);
+
+    // Acquire a plan for this instance, counting any lock taken
+    void *acquire(char type, bool inverse, PlanLayout layout,
+                  int size, int count) {
+        bool locked = false;
+        void *plan = acquirePlan(type, inverse, layout, size, count, locked);
+        if (locked) locking();
+        return plan;
+    }
+    static void *createPlan(char type, bool inverse, PlanLayout layout,
+                            int size, int count);
+
+#ifdef NO_THREADING
+    static void lock() {}
+    static void unlock() {}
+    static bool atomicCAS(volatile int *p, int oldv, int newv) {
+        if (*p != oldv) return false;
+        *p = newv;
+        return true;
+    }
+    static int atomicAdd(volatile int *p, int v) {
+        return (*p += v);
+    }
 #else
 #ifdef _WIN32
     static HANDLE m_commonMutex;
-    void initMutex() { m_commonMutex = CreateMutex(NULL, FALSE, NULL); }
-    void destroyMutex() { CloseHandle(m_commonMutex); }
-    void lock() { WaitForSingleObject(m_commonMutex, INFINITE); }
-    void unlock() { ReleaseMutex(m_commonMutex); }
+    static void lock() {
+        if (!m_commonMutex) {
+            HANDLE h = CreateMutex(NULL, FALSE, NULL);
+            if (InterlockedCompareExchangePointer
+                ((PVOID volatile *)&m_commonMutex, h, NULL) != NULL) {
+                CloseHandle(h);
+            }
+        }
+        WaitForSingleObject(m_commonMutex, INFINITE);
+    }
+    static void unlock() { ReleaseMutex(m_commonMutex); }
+    static bool atomicCAS(volatile int *p, int oldv, int newv) {
+        return InterlockedCompareExchange((volatile LONG *)p, newv, oldv) == oldv;
+    }
+    static int atomicAdd(volatile int *p, int v) {
+        return InterlockedExchangeAdd((volatile LONG *)p, v) + v;
+    }
 #else
     static pthread_mutex_t m_commonMutex;
-    void initMutex() { pthread_mutex_init(&m_commonMutex, 0); }
-    void destroyMutex() { pthread_mutex_destroy(&m_commonMutex); }
-    void lock() { pthread_mutex_lock(&m_commonMutex); }
-    void unlock() { pthread_mutex_unlock(&m_commonMutex); }
+    static void lock() { pthread_mutex_lock(&m_commonMutex); }
+    static void unlock() { pthread_mutex_unlock(&m_commonMutex); }
+#if defined(__GNUC__)
+    static bool atomicCAS(volatile int *p, int oldv, int newv) {
+        return __sync_bool_compare_and_swap(p, oldv, newv);
+    }
+    static int atomicAdd(volatile int *p, int v) {
+        return __sync_add_and_fetch(p, v);
+    }
+#else
+    // No compiler atomics known: serialise through a second mutex
+    static pthread_mutex_t m_atomicMutex;
+    static bool atomicCAS(volatile int *p, int oldv, int newv) {
+        pthread_mutex_lock(&m_atomicMutex);
+        bool ok = (*p == oldv);
+        if (ok) *p = newv;
+        pthread_mutex_unlock(&m_atomicMutex);
+        return ok;
+    }
+    static int atomicAdd(volatile int *p, int v) {
+        pthread_mutex_lock(&m_atomicMutex);
+        int result = (*p += v);
+        pthread_mutex_unlock(&m_atomicMutex);
+        return result;
+    }
+#endif
 #endif
 #endif
 };
 
-int
+void *
+D_FFTW::acquirePlan(char type, bool inverse, PlanLayout layout,
+                    int size, int count, bool &locked)
+{
+    CachedPlan *p;
+
+    locked = false;
+
+    for (p = m_plans; p; p = p->next) {
+        if (p->type == type && p->inverse == inverse &&
+            p->layout == layout && p->size == size && p->count == count) {
+            int rc;
+            while ((rc = p->refcount) > 0) {
+                if (atomicCAS(&p->refcount, rc, rc + 1)) {
+                    return p->plan;
+                }
+            }
+            break;
+        }
+    }
+
+    locked = true;
+    lock();
+
+    for (p = m_plans; p; p = p->next) {
+        if (p->type == type && p->inverse == inverse &&
+            p->layout == layout && p->size == size && p->count == count) {
+            break;
+        }
+    }
+
+    if (!p) {
+        p = new CachedPlan;
+        p->type = type;
+        p->inverse = inverse;
+        p->layout = layout;
+        p->size = size;
+        p->count = count;
+        p->plan = createPlan(type, inverse, layout, size, count);
+        p->refcount = 1;
+        p->next = m_plans;
+        BQ_MBARRIER();
+        m_plans = p;
+    } else {
+        while (true) {
+            int rc = p->refcount;
+            if (rc >= 0) {
+                // Either in use, or released but not yet destroyed
+                // (the destroyer is waiting for the lock we hold)
+                if (atomicCAS(&p->refcount, rc, rc + 1)) break;
+            } else {
+                p->plan = createPlan(type, inverse, layout, size, count);
+                BQ_MBARRIER();
+                p->refcount = 1;
+                break;
+            }
+        }
+    }
+
+    void *plan = p->plan;
+    unlock();
+    return plan;
+}
+
+void
+D_FFTW::releasePlan(void *plan)
+{
+    CachedPlan *p;
+
+    for (p = m_plans; p; p = p->next) {
+        if (p->plan == plan && p->refcount > 0) break;
+    }
+    if (!p) return;
+
+    if (atomicAdd(&p->refcount, -1) > 0) return;
+
+    lock();
+    if (atomicCAS(&p->refcount, 0, -1)) {
+        if (p->type == 'f') {
+            fftwf_destroy_plan((fftwf_plan)p->plan);
+        } else {
+            fftw_destroy_plan((fftw_plan)p->plan);
+        }
+        p->plan = 0;
+    }
+    unlock();
+}
+
+void *
+D_FFTW::createPlan(char type, bool inverse, PlanLayout layout,
+                   int size, int count)
+{
+    // Called with the lock held. The arrays are needed only for
+    // planning, as all execution uses the new-array functions; but
+    // their layout still matters, as the split real and imaginary
+    // arrays must be the same distance apart as the ones the plan
+    // will be executed on
+
+    const int hs = size/2;
+    const int off = splitOffset(size, count);
+
+    fftw_iodim dim, howmany;
+    dim.n = size;
+    dim.is = 1;
+    dim.os = 1;
+    howmany.n = count;
+    howmany.is = (inverse ? hs + 1 : size);
+    howmany.os = (inverse ? size : hs + 1);
+    const int hrank = (count > 1 ? 1 : 0);
+
+    void *plan = 0;
+
+    if (type == 'f') {
+
+        if (!m_wisdomLoadedf) {
+#ifdef FFTW_DOUBLE_ONLY
+            loadWisdom('d');
+#else
+            loadWisdom('f');
+#endif
+            m_wisdomLoadedf = true;
+        }
+
+        fft_float_type *buf = (fft_float_type *)fftw_malloc
+            (count * size * sizeof(fft_float_type));
+        fftwf_complex *packed = (fftwf_complex *)fftw_malloc
+            (count * (hs + 1) * sizeof(fftwf_complex));
+        fft_float_type *re = (fft_float_type *)fftw_malloc
+            (2 * off * sizeof(fft_float_type));
+        fft_float_type *im = re + off;
+
+        if (layout == ComplexLayout) {
+            fftwf_complex *cbuf = (fftwf_complex *)fftw_malloc
+                (size * sizeof(fftwf_complex));
+            fftwf_complex *cpacked = (fftwf_complex *)fftw_malloc
+                (size * sizeof(fftwf_complex));
+            plan = fftwf_plan_dft_1d
+                (size, cbuf, cpacked, inverse ? FFTW_BACKWARD : FFTW_FORWARD,
+                 FFTW_MEASURE);
+            fftwf_free(cbuf);
+            fftwf_free(cpacked);
+        } else if (inverse) {
+            plan = fftwf_plan_guru_dft_c2r
+                (1, &dim, hrank, &howmany, packed, buf, FFTW_MEASURE);
+        } else if (layout == SplitLayout) {
+            plan = fftwf_plan_guru_split_dft_r2c
+                (1, &dim, hrank, &howmany, buf, re, im, FFTW_MEASURE);
+        } else {
+            plan = fftwf_plan_guru_dft_r2c
+                (1, &dim, hrank, &howmany, buf, packed, FFTW_MEASURE);
+        }
+
+        fftwf_free(buf);
+        fftwf_free(packed);
+        fftwf_free(re);
+
+    } else {
+
+        if (!m_wisdomLoadedd) {
+#ifdef FFTW_SINGLE_ONLY
+            loadWisdom('f');
+#else
+            loadWisdom('d');
+#endif
+            m_wisdomLoadedd = true;
+        }
+
+        fft_double_type *buf = (fft_double_type *)fftw_malloc
+            (count * size * sizeof(fft_double_type));
+        fftw_complex *packed = (fftw_complex *)fftw_malloc
+            (count * (hs + 1) * sizeof(fftw_complex));
+        fft_double_type *re = (fft_double_type *)fftw_malloc
+            (2 * off * sizeof(fft_double_type));
+        fft_double_type *im = re + off;
+
+        if (layout == ComplexLayout) {
+            fftw_complex *cbuf = (fftw_complex *)fftw_malloc
+                (size * sizeof(fftw_complex));
+            fftw_complex *cpacked = (fftw_complex *)fftw_malloc
+                (size * sizeof(fftw_complex));
+            plan = fftw_plan_dft_1d
+                (size, cbuf, cpacked, inverse ? FFTW_BACKWARD : FFTW_FORWARD,
+                 FFTW_MEASURE);
+            fftw_free(cbuf);
+            fftw_free(cpacked);
+        } else if (inverse) {
+            plan = fftw_plan_guru_dft_c2r
+                (1, &dim, hrank, &howmany, packed, buf, FFTW_MEASURE);
+        } else if (layout == SplitLayout) {
+            plan = fftw_plan_guru_split_dft_r2c
+                (1, &dim, hrank, &howmany, buf, re, im, FFTW_MEASURE);
+        } else {
+            plan = fftw_plan_guru_dft_r2c
+                (1, &dim, hrank, &howmany, buf, packed, FFTW_MEASURE);
+        }
+
+        fftw_free(buf);
+        fftw_free(packed);
+        fftw_free(re);
+    }
+
+    return plan;
+}
+
+volatile int
 D_FFTW::m_extantf = 0;
 
-int
+volatile int
 D_FFTW::m_extantd = 0;
 
+D_FFTW::CachedPlan *volatile
+D_FFTW::m_plans = 0;
+
+bool
+D_FFTW::m_wisdomLoadedf = false;
+
+bool
+D_FFTW::m_wisdomLoadedd = false;
+
 #ifndef NO_THREADING
 #ifdef _WIN32
-HANDLE D_FFTW::m_commonMutex;
+HANDLE D_FFTW::m_commonMutex = 0;
 #else
-pthread_mutex_t D_FFTW::m_commonMutex;
+pthread_mutex_t D_FFTW::m_commonMutex = PTHREAD_MUTEX_INITIALIZER;
+#if !defined(__GNUC__)
+pthread_mutex_t D_FFTW::m_atomicMutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
 #endif
 #endif
 
@@ -2108,6 +3296,7 @@ public:
 
     void initFloat() {
         if (m_fplanf) return;
+        allocating();
         m_fbuf = allocate<fft_float_type>(2 * m_size);
         m_fresult = allocate<fft_float_type>(2 * m_size);
         m_fplanf = sfft_init(m_size, SFFT_FORWARD | FLAG_SFFT_FLOAT);
@@ -2128,6 +3317,7 @@ public:
 
     void initDouble() {
         if (m_dplanf) return;
+        allocating();
         m_dbuf = allocate<fft_double_type>(2 * m_size);
         m_dresult = allocate<fft_double_type>(2 * m_size);
         m_dplanf = sfft_init(m_size, SFFT_FORWARD | FLAG_SFFT_DOUBLE);
@@ -2206,7 +3396,8 @@ public:
         packDouble(realIn, 0, m_dbuf, m_size);
         sfft_execute(m_dplanf, m_dbuf, m_dresult);
         v_cartesian_interleaved_to_polar(magOut, phaseOut,
-                                         m_dresult, m_size/2+1);
+                                         m_dresult, m_size/2+1,
+                                         m_polarAccuracy);
     }
 
     void forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut) {
@@ -2239,7 +3430,8 @@ public:
         packFloat(realIn, 0, m_fbuf, m_size);
         sfft_execute(m_fplanf, m_fbuf, m_fresult);
         v_cartesian_interleaved_to_polar(magOut, phaseOut,
-                                         m_fresult, m_size/2+1);
+                                         m_fresult, m_size/2+1,
+                                         m_polarAccuracy);
     }
 
     void forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut) {
@@ -2276,9 +3468,14 @@ public:
     void inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut) {
         if (!m_dplanf) initDouble();
         const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            m_dbuf[i*2] = magIn[i] * cos(phaseIn[i]);
-            m_dbuf[i*2+1] = magIn[i] * sin(phaseIn[i]);
+        if (approximatePolar()) {
+            v_polar_to_cartesian_interleaved(m_dbuf, magIn, phaseIn, hs + 1,
+                                             m_polarAccuracy);
+        } else {
+            for (int i = 0; i <= hs; ++i) {
+                m_dbuf[i*2] = magIn[i] * cos(phaseIn[i]);
+                m_dbuf[i*2+1] = magIn[i] * sin(phaseIn[i]);
+            }
         }
         mirror(m_dbuf, m_size);
         sfft_execute(m_dplani, m_dbuf, m_dresult);
@@ -2324,9 +3521,14 @@ public:
     void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut) {
         if (!m_fplanf) initFloat();
         const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            m_fbuf[i*2] = magIn[i] * cosf(phaseIn[i]);
-            m_fbuf[i*2+1] = magIn[i] * sinf(phaseIn[i]);
+        if (approximatePolar()) {
+            v_polar_to_cartesian_interleaved(m_fbuf, magIn, phaseIn, hs + 1,
+                                             m_polarAccuracy);
+        } else {
+            for (int i = 0; i <= hs; ++i) {
+                m_fbuf[i*2] = magIn[i] * cosf(phaseIn[i]);
+                m_fbuf[i*2+1] = magIn[i] * sinf(phaseIn[i]);
+            }
         }
         mirror(m_fbuf, m_size);
         sfft_execute(m_fplani, m_fbuf, m_fresult);
@@ -2372,7 +3574,11 @@ public:
     D_KISSFFT(int size) :
         m_size(size),
         m_fplanf(0),  
-        m_fplani(0)
+        m_fplani(0),
+        m_cplanf(0),
+        m_cplani(0),
+        m_cin(0),
+        m_cout(0)
     {
 #ifdef FIXED_POINT
 #error KISSFFT is not configured for float values
@@ -2384,17 +3590,28 @@ public:
 
         m_fbuf = new kiss_fft_scalar[m_size + 2];
         m_fpacked = new kiss_fft_cpx[m_size + 2];
-        m_fplanf = kiss_fftr_alloc(m_size, 0, NULL, NULL);
-        m_fplani = kiss_fftr_alloc(m_size, 1, NULL, NULL);
+        if (m_size % 2 == 0) {
+            m_fplanf = kiss_fftr_alloc(m_size, 0, NULL, NULL);
+            m_fplani = kiss_fftr_alloc(m_size, 1, NULL, NULL);
+        } else {
+            m_cplanf = kiss_fft_alloc(m_size, 0, NULL, NULL);
+            m_cplani = kiss_fft_alloc(m_size, 1, NULL, NULL);
+            m_cin = new kiss_fft_cpx[m_size];
+            m_cout = new kiss_fft_cpx[m_size];
+        }
     }
 
     ~D_KISSFFT() {
         kiss_fftr_free(m_fplanf);
         kiss_fftr_free(m_fplani);
+        kiss_fft_free(m_cplanf);
+        kiss_fft_free(m_cplani);
         kiss_fft_cleanup();
 
         delete[] m_fbuf;
         delete[] m_fpacked;
+        delete[] m_cin;
+        delete[] m_cout;
     }
 
     FFT::Precisions
@@ -2405,74 +3622,89 @@ public:
     void initFloat() { }
     void initDouble() { }
 
-    void packFloat(const float *BQ_R__ re, const float *BQ_R__ im) {
+    // The complex transforms share the plans and buffers that odd
+    // sizes already use for their real transforms
+
+    void initFloatComplex(int) {
+        if (m_cplanf) return;
+        allocating();
+        m_cplanf = kiss_fft_alloc(m_size, 0, NULL, NULL);
+        m_cplani = kiss_fft_alloc(m_size, 1, NULL, NULL);
+        m_cin = new kiss_fft_cpx[m_size];
+        m_cout = new kiss_fft_cpx[m_size];
+    }
+
+    void initDoubleComplex(int size) {
+        initFloatComplex(size);
+    }
+
+    // The real-input transforms only handle even sizes, so odd sizes
+    // use a complex transform of the full length instead
+
+    void kissForward(const kiss_fft_scalar *BQ_R__ in, kiss_fft_cpx *BQ_R__ out) {
+        if (m_fplanf) {
+            kiss_fftr(m_fplanf, in, out);
+            return;
+        }
+        for (int i = 0; i < m_size; ++i) {
+            m_cin[i].r = in[i];
+            m_cin[i].i = 0.f;
+        }
+        kiss_fft(m_cplanf, m_cin, m_cout);
         const int hs = m_size/2;
         for (int i = 0; i <= hs; ++i) {
-            m_fpacked[i].r = re[i];
-        }
-        if (im) {
-            for (int i = 0; i <= hs; ++i) {
-                m_fpacked[i].i = im[i];
-            }
-        } else {
-            for (int i = 0; i <= hs; ++i) {
-                m_fpacked[i].i = 0.f;
-            }
+            out[i] = m_cout[i];
         }
     }
 
-    void unpackFloat(float *BQ_R__ re, float *BQ_R__ im) {
+    void kissInverse(const kiss_fft_cpx *BQ_R__ in, kiss_fft_scalar *BQ_R__ out) {
+        if (m_fplani) {
+            kiss_fftri(m_fplani, in, out);
+            return;
+        }
         const int hs = m_size/2;
         for (int i = 0; i <= hs; ++i) {
-            re[i] = m_fpacked[i].r;
+            m_cin[i] = in[i];
         }
-        if (im) {
-            for (int i = 0; i <= hs; ++i) {
-                im[i] = m_fpacked[i].i;
-            }
+        m_cin[0].i = 0.f;
+        for (int i = hs + 1; i < m_size; ++i) {
+            m_cin[i].r = in[m_size - i].r;
+            m_cin[i].i = -in[m_size - i].i;
+        }
+        kiss_fft(m_cplani, m_cin, m_cout);
+        for (int i = 0; i < m_size; ++i) {
+            out[i] = m_cout[i].r;
         }
+    }
+
+    void packFloat(const float *BQ_R__ re, const float *BQ_R__ im) {
+        interleaveBins((kiss_fft_scalar *)m_fpacked, re, im, m_size);
+    }
+
+    void unpackFloat(float *BQ_R__ re, float *BQ_R__ im) {
+        deinterleaveBins(re, im, (const kiss_fft_scalar *)m_fpacked, m_size);
     }        
 
     void packDouble(const double *BQ_R__ re, const double *BQ_R__ im) {
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            m_fpacked[i].r = float(re[i]);
-        }
-        if (im) {
-            for (int i = 0; i <= hs; ++i) {
-                m_fpacked[i].i = float(im[i]);
-            }
-        } else {
-            for (int i = 0; i <= hs; ++i) {
-                m_fpacked[i].i = 0.f;
-            }
-        }
+        interleaveBins((kiss_fft_scalar *)m_fpacked, re, im, m_size);
     }
 
     void unpackDouble(double *BQ_R__ re, double *BQ_R__ im) {
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            re[i] = double(m_fpacked[i].r);
-        }
-        if (im) {
-            for (int i = 0; i <= hs; ++i) {
-                im[i] = double(m_fpacked[i].i);
-            }
-        }
+        deinterleaveBins(re, im, (const kiss_fft_scalar *)m_fpacked, m_size);
     }        
 
     void forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
 
         v_convert(m_fbuf, realIn, m_size);
-        kiss_fftr(m_fplanf, m_fbuf, m_fpacked);
+        kissForward(m_fbuf, m_fpacked);
         unpackDouble(realOut, imagOut);
     }
 
     void forwardInterleaved(const double *BQ_R__ realIn, double *BQ_R__ complexOut) {
 
         v_convert(m_fbuf, realIn, m_size);
-        kiss_fftr(m_fplanf, m_fbuf, m_fpacked);
-        v_convert(complexOut, (float *)m_fpacked, m_size + 2);
+        kissForward(m_fbuf, m_fpacked);
+        v_convert(complexOut, (float *)m_fpacked, (m_size/2 + 1) * 2);
     }
 
     void forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut) {
@@ -2481,7 +3713,7 @@ public:
             m_fbuf[i] = float(realIn[i]);
         }
 
-        kiss_fftr(m_fplanf, m_fbuf, m_fpacked);
+        kissForward(m_fbuf, m_fpacked);
 
         const int hs = m_size/2;
 
@@ -2501,7 +3733,7 @@ public:
             m_fbuf[i] = float(realIn[i]);
         }
 
-        kiss_fftr(m_fplanf, m_fbuf, m_fpacked);
+        kissForward(m_fbuf, m_fpacked);
 
         const int hs = m_size/2;
 
@@ -2513,21 +3745,28 @@ public:
 
     void forward(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
 
-        kiss_fftr(m_fplanf, realIn, m_fpacked);
+        kissForward(realIn, m_fpacked);
         unpackFloat(realOut, imagOut);
     }
 
     void forwardInterleaved(const float *BQ_R__ realIn, float *BQ_R__ complexOut) {
 
-        kiss_fftr(m_fplanf, realIn, (kiss_fft_cpx *)complexOut);
+        kissForward(realIn, (kiss_fft_cpx *)complexOut);
     }
 
     void forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut) {
 
-        kiss_fftr(m_fplanf, realIn, m_fpacked);
+        kissForward(realIn, m_fpacked);
 
         const int hs = m_size/2;
 
+        if (approximatePolar()) {
+            v_cartesian_interleaved_to_polar(magOut, phaseOut,
+                                             (float *)m_fpacked, hs + 1,
+                                             m_polarAccuracy);
+            return;
+        }
+
         for (int i = 0; i <= hs; ++i) {
             magOut[i] = sqrtf(m_fpacked[i].r * m_fpacked[i].r +
                               m_fpacked[i].i * m_fpacked[i].i);
@@ -2540,7 +3779,7 @@ public:
 
     void forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut) {
 
-        kiss_fftr(m_fplanf, realIn, m_fpacked);
+        kissForward(realIn, m_fpacked);
 
         const int hs = m_size/2;
 
@@ -2550,11 +3789,65 @@ public:
         }
     }
 
+    int getGoertzelLimit() const {
+        return 8;
+    }
+
+    void forwardBins(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut, int first, int count) {
+        v_convert(m_fbuf, realIn, m_size);
+        kissForward(m_fbuf, m_fpacked);
+        splitComplex(realOut, imagOut, (const float *)(m_fpacked + first), count);
+    }
+
+    void forwardBinsPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut, int first, int count) {
+        v_convert(m_fbuf, realIn, m_size);
+        kissForward(m_fbuf, m_fpacked);
+        interleavedToPolar(magOut, phaseOut, (const float *)(m_fpacked + first), count);
+    }
+
+    void forwardBinsMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut, int first, int count) {
+        v_convert(m_fbuf, realIn, m_size);
+        kissForward(m_fbuf, m_fpacked);
+        interleavedToMagnitude(magOut, (const float *)(m_fpacked + first), count);
+    }
+
+    void forwardBins(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut, int first, int count) {
+        kissForward(realIn, m_fpacked);
+        splitComplex(realOut, imagOut, (const float *)(m_fpacked + first), count);
+    }
+
+    void forwardBinsPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut, int first, int count) {
+        kissForward(realIn, m_fpacked);
+        interleavedToPolar(magOut, phaseOut, (const float *)(m_fpacked + first), count);
+    }
+
+    void forwardBinsMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut, int first, int count) {
+        kissForward(realIn, m_fpacked);
+        interleavedToMagnitude(magOut, (const float *)(m_fpacked + first), count);
+    }
+
+    // KissFFT has no pruned transform either, but we have an input
+    // buffer to pad into
+
+    void forwardPadded(const double *BQ_R__ realIn, int inCount, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        v_convert(m_fbuf, realIn, inCount);
+        v_zero(m_fbuf + inCount, m_size - inCount);
+        kissForward(m_fbuf, m_fpacked);
+        unpackDouble(realOut, imagOut);
+    }
+
+    void forwardPadded(const float *BQ_R__ realIn, int inCount, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        v_copy(m_fbuf, realIn, inCount);
+        v_zero(m_fbuf + inCount, m_size - inCount);
+        kissForward(m_fbuf, m_fpacked);
+        unpackFloat(realOut, imagOut);
+    }
+
     void inverse(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut) {
 
         packDouble(realIn, imagIn);
 
-        kiss_fftri(m_fplani, m_fpacked, m_fbuf);
+        kissInverse(m_fpacked, m_fbuf);
 
         for (int i = 0; i < m_size; ++i) {
             realOut[i] = m_fbuf[i];
@@ -2563,9 +3856,9 @@ public:
 
     void inverseInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ realOut) {
 
-        v_convert((float *)m_fpacked, complexIn, m_size + 2);
+        v_convert((float *)m_fpacked, complexIn, (m_size/2 + 1) * 2);
 
-        kiss_fftri(m_fplani, m_fpacked, m_fbuf);
+        kissInverse(m_fpacked, m_fbuf);
 
         for (int i = 0; i < m_size; ++i) {
             realOut[i] = m_fbuf[i];
@@ -2581,7 +3874,7 @@ public:
             m_fpacked[i].i = float(magIn[i] * sin(phaseIn[i]));
         }
 
-        kiss_fftri(m_fplani, m_fpacked, m_fbuf);
+        kissInverse(m_fpacked, m_fbuf);
 
         for (int i = 0; i < m_size; ++i) {
             realOut[i] = m_fbuf[i];
@@ -2597,7 +3890,7 @@ public:
             m_fpacked[i].i = 0.0f;
         }
 
-        kiss_fftri(m_fplani, m_fpacked, m_fbuf);
+        kissInverse(m_fpacked, m_fbuf);
 
         for (int i = 0; i < m_size; ++i) {
             cepOut[i] = m_fbuf[i];
@@ -2607,61 +3900,159 @@ public:
     void inverse(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut) {
 
         packFloat(realIn, imagIn);
-        kiss_fftri(m_fplani, m_fpacked, realOut);
+        kissInverse(m_fpacked, realOut);
     }
 
-    void inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut) {
+    void initFloatSpectra(int) { }
+    void initDoubleSpectra(int) { }
 
-        v_copy((float *)m_fpacked, complexIn, m_size + 2);
-        kiss_fftri(m_fplani, m_fpacked, realOut);
+    void forwardWindowed(const double *BQ_R__ realIn, const double *BQ_R__ window, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        windowInto(m_fbuf, realIn, window, m_size);
+        kissForward(m_fbuf, m_fpacked);
+        unpackDouble(realOut, imagOut);
     }
 
-    void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut) {
+    void forwardPower(const double *BQ_R__ realIn, const double *BQ_R__ window, double *BQ_R__ powerOut) {
+        if (window) {
+            windowInto(m_fbuf, realIn, window, m_size);
+        } else {
+            v_convert(m_fbuf, realIn, m_size);
+        }
+        kissForward(m_fbuf, m_fpacked);
+        interleavedToPower(powerOut, (const kiss_fft_scalar *)m_fpacked, m_size/2 + 1);
+    }
 
-        const int hs = m_size/2;
+    void forwardWindowed(const float *BQ_R__ realIn, const float *BQ_R__ window, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        windowInto(m_fbuf, realIn, window, m_size);
+        kissForward(m_fbuf, m_fpacked);
+        unpackFloat(realOut, imagOut);
+    }
 
-        for (int i = 0; i <= hs; ++i) {
-            m_fpacked[i].r = magIn[i] * cosf(phaseIn[i]);
-            m_fpacked[i].i = magIn[i] * sinf(phaseIn[i]);
+    void forwardPower(const float *BQ_R__ realIn, const float *BQ_R__ window, float *BQ_R__ powerOut) {
+        if (window) {
+            windowInto(m_fbuf, realIn, window, m_size);
+            kissForward(m_fbuf, m_fpacked);
+        } else {
+            kissForward(realIn, m_fpacked);
         }
+        interleavedToPower(powerOut, (const kiss_fft_scalar *)m_fpacked, m_size/2 + 1);
+    }
 
-        kiss_fftri(m_fplani, m_fpacked, realOut);
+    void forwardComplex(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_cplanf) initDoubleComplex(m_size);
+        joinComplex((kiss_fft_scalar *)m_cin, realIn, imagIn, m_size);
+        kiss_fft(m_cplanf, m_cin, m_cout);
+        splitComplex(realOut, imagOut, (const kiss_fft_scalar *)m_cout, m_size);
     }
 
-    void inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut) {
+    void forwardComplexInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ complexOut) {
+        if (!m_cplanf) initDoubleComplex(m_size);
+        v_convert((kiss_fft_scalar *)m_cin, complexIn, m_size * 2);
+        kiss_fft(m_cplanf, m_cin, m_cout);
+        v_convert(complexOut, (const kiss_fft_scalar *)m_cout, m_size * 2);
+    }
 
-        const int hs = m_size/2;
+    void inverseComplex(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_cplanf) initDoubleComplex(m_size);
+        joinComplex((kiss_fft_scalar *)m_cin, realIn, imagIn, m_size);
+        kiss_fft(m_cplani, m_cin, m_cout);
+        splitComplex(realOut, imagOut, (const kiss_fft_scalar *)m_cout, m_size);
+    }
 
-        for (int i = 0; i <= hs; ++i) {
-            m_fpacked[i].r = logf(magIn[i] + 0.000001f);
-            m_fpacked[i].i = 0.0f;
-        }
+    void inverseComplexInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ complexOut) {
+        if (!m_cplanf) initDoubleComplex(m_size);
+        v_convert((kiss_fft_scalar *)m_cin, complexIn, m_size * 2);
+        kiss_fft(m_cplani, m_cin, m_cout);
+        v_convert(complexOut, (const kiss_fft_scalar *)m_cout, m_size * 2);
+    }
 
-        kiss_fftri(m_fplani, m_fpacked, cepOut);
+    void forwardComplex(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_cplanf) initFloatComplex(m_size);
+        joinComplex((kiss_fft_scalar *)m_cin, realIn, imagIn, m_size);
+        kiss_fft(m_cplanf, m_cin, m_cout);
+        splitComplex(realOut, imagOut, (const kiss_fft_scalar *)m_cout, m_size);
     }
 
-private:
-    const int m_size;
-    kiss_fftr_cfg m_fplanf;
-    kiss_fftr_cfg m_fplani;
-    kiss_fft_scalar *m_fbuf;
-    kiss_fft_cpx *m_fpacked;
-};
+    void forwardComplexInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ complexOut) {
+        if (!m_cplanf) initFloatComplex(m_size);
+        kiss_fft(m_cplanf, (const kiss_fft_cpx *)complexIn,
+                 (kiss_fft_cpx *)complexOut);
+    }
 
-#endif /* HAVE_KISSFFT */
+    void inverseComplex(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_cplanf) initFloatComplex(m_size);
+        joinComplex((kiss_fft_scalar *)m_cin, realIn, imagIn, m_size);
+        kiss_fft(m_cplani, m_cin, m_cout);
+        splitComplex(realOut, imagOut, (const kiss_fft_scalar *)m_cout, m_size);
+    }
 
-#ifdef USE_BUILTIN_FFT
+    void inverseComplexInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ complexOut) {
+        if (!m_cplanf) initFloatComplex(m_size);
+        kiss_fft(m_cplani, (const kiss_fft_cpx *)complexIn,
+                 (kiss_fft_cpx *)complexOut);
+    }
 
-class D_Cross : public FFTImpl
+    void inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut) {
+
+        v_copy((float *)m_fpacked, complexIn, (m_size/2 + 1) * 2);
+        kissInverse(m_fpacked, realOut);
+    }
+
+    void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut) {
+
+        const int hs = m_size/2;
+
+        if (approximatePolar()) {
+            v_polar_to_cartesian_interleaved((float *)m_fpacked,
+                                             magIn, phaseIn, hs + 1,
+                                             m_polarAccuracy);
+        } else {
+            for (int i = 0; i <= hs; ++i) {
+                m_fpacked[i].r = magIn[i] * cosf(phaseIn[i]);
+                m_fpacked[i].i = magIn[i] * sinf(phaseIn[i]);
+            }
+        }
+
+        kissInverse(m_fpacked, realOut);
+    }
+
+    void inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut) {
+
+        const int hs = m_size/2;
+
+        for (int i = 0; i <= hs; ++i) {
+            m_fpacked[i].r = logf(magIn[i] + 0.000001f);
+            m_fpacked[i].i = 0.0f;
+        }
+
+        kissInverse(m_fpacked, cepOut);
+    }
+
+private:
+    const int m_size;
+    kiss_fftr_cfg m_fplanf;
+    kiss_fftr_cfg m_fplani;
+    kiss_fft_cfg m_cplanf;
+    kiss_fft_cfg m_cplani;
+    kiss_fft_cpx *m_cin;
+    kiss_fft_cpx *m_cout;
+    kiss_fft_scalar *m_fbuf;
+    kiss_fft_cpx *m_fpacked;
+};
+
+#endif /* HAVE_KISSFFT */
+
+#ifdef USE_BUILTIN_FFT
+
+class D_Cross : public FFTImpl
 {
 public:
-    D_Cross(int size) : m_size(size), m_table(0) {
+    D_Cross(int size) :
+        m_size(size), m_table(0), m_twr(0), m_twi(0),
+        m_ftwr(0), m_ftwi(0),
+        m_a(0), m_b(0), m_c(0), m_d(0),
+        m_fa(0), m_fb(0), m_fc(0), m_fd(0) {
         
-        m_a = new double[size];
-        m_b = new double[size];
-        m_c = new double[size];
-        m_d = new double[size];
-
         m_table = new int[m_size];
     
         int bits;
@@ -2685,26 +4076,73 @@ public:
             
             m_table[i] = k;
         }
+
+        // Forward twiddles for each stage in turn: the stage whose
+        // butterflies are blockEnd apart uses the blockEnd entries
+        // starting at blockEnd - 1. Inverse transforms conjugate them.
+        // They are calculated directly, in double precision, as a
+        // recurrence loses accuracy quickly with size
+
+        m_twr = new double[m_size];
+        m_twi = new double[m_size];
+
+        for (int blockEnd = 1; blockEnd < m_size; blockEnd <<= 1) {
+            double delta = M_PI / double(blockEnd);
+            for (m = 0; m < blockEnd; ++m) {
+                m_twr[blockEnd - 1 + m] = cos(delta * m);
+                m_twi[blockEnd - 1 + m] = -sin(delta * m);
+            }
+        }
     }
 
     ~D_Cross() {
         delete[] m_table;
+        delete[] m_twr;
+        delete[] m_twi;
+        delete[] m_ftwr;
+        delete[] m_ftwi;
         delete[] m_a;
         delete[] m_b;
         delete[] m_c;
         delete[] m_d;
+        delete[] m_fa;
+        delete[] m_fb;
+        delete[] m_fc;
+        delete[] m_fd;
     }
 
     FFT::Precisions
     getSupportedPrecisions() const {
-        return FFT::DoublePrecision;
+        return FFT::SinglePrecision | FFT::DoublePrecision;
     }
 
-    void initFloat() { }
-    void initDouble() { }
+    void initFloat() {
+        if (m_fa) return;
+        allocating();
+        m_fa = new float[m_size];
+        m_fb = new float[m_size];
+        m_fc = new float[m_size];
+        m_fd = new float[m_size];
+        m_ftwr = new float[m_size];
+        m_ftwi = new float[m_size];
+        for (int i = 0; i < m_size; ++i) {
+            m_ftwr[i] = float(m_twr[i]);
+            m_ftwi[i] = float(m_twi[i]);
+        }
+    }
+
+    void initDouble() {
+        if (m_a) return;
+        allocating();
+        m_a = new double[m_size];
+        m_b = new double[m_size];
+        m_c = new double[m_size];
+        m_d = new double[m_size];
+    }
 
     void forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
-        basefft(false, realIn, 0, m_c, m_d);
+        if (!m_a) initDouble();
+        basefft<double>(false, realIn, 0, m_c, m_d);
         const int hs = m_size/2;
         for (int i = 0; i <= hs; ++i) realOut[i] = m_c[i];
         if (imagOut) {
@@ -2713,15 +4151,22 @@ public:
     }
 
     void forwardInterleaved(const double *BQ_R__ realIn, double *BQ_R__ complexOut) {
-        basefft(false, realIn, 0, m_c, m_d);
+        if (!m_a) initDouble();
+        basefft<double>(false, realIn, 0, m_c, m_d);
         const int hs = m_size/2;
         for (int i = 0; i <= hs; ++i) complexOut[i*2] = m_c[i];
         for (int i = 0; i <= hs; ++i) complexOut[i*2+1] = m_d[i];
     }
 
     void forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut) {
-        basefft(false, realIn, 0, m_c, m_d);
+        if (!m_a) initDouble();
+        basefft<double>(false, realIn, 0, m_c, m_d);
         const int hs = m_size/2;
+        if (approximatePolar()) {
+            v_cartesian_to_polar(magOut, phaseOut, m_c, m_d, hs + 1,
+                                 m_polarAccuracy);
+            return;
+        }
         for (int i = 0; i <= hs; ++i) {
             magOut[i] = sqrt(m_c[i] * m_c[i] + m_d[i] * m_d[i]);
             phaseOut[i] = atan2(m_d[i], m_c[i]) ;
@@ -2729,7 +4174,8 @@ public:
     }
 
     void forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut) {
-        basefft(false, realIn, 0, m_c, m_d);
+        if (!m_a) initDouble();
+        basefft<double>(false, realIn, 0, m_c, m_d);
         const int hs = m_size/2;
         for (int i = 0; i <= hs; ++i) {
             magOut[i] = sqrt(m_c[i] * m_c[i] + m_d[i] * m_d[i]);
@@ -2737,43 +4183,105 @@ public:
     }
 
     void forward(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
-        for (int i = 0; i < m_size; ++i) m_a[i] = realIn[i];
-        basefft(false, m_a, 0, m_c, m_d);
+        if (!m_fa) initFloat();
+        basefft<float>(false, realIn, 0, m_fc, m_fd);
         const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) realOut[i] = m_c[i];
+        for (int i = 0; i <= hs; ++i) realOut[i] = m_fc[i];
         if (imagOut) {
-            for (int i = 0; i <= hs; ++i) imagOut[i] = m_d[i];
+            for (int i = 0; i <= hs; ++i) imagOut[i] = m_fd[i];
         }
     }
 
     void forwardInterleaved(const float *BQ_R__ realIn, float *BQ_R__ complexOut) {
-        for (int i = 0; i < m_size; ++i) m_a[i] = realIn[i];
-        basefft(false, m_a, 0, m_c, m_d);
+        if (!m_fa) initFloat();
+        basefft<float>(false, realIn, 0, m_fc, m_fd);
         const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) complexOut[i*2] = m_c[i];
-        for (int i = 0; i <= hs; ++i) complexOut[i*2+1] = m_d[i];
+        for (int i = 0; i <= hs; ++i) complexOut[i*2] = m_fc[i];
+        for (int i = 0; i <= hs; ++i) complexOut[i*2+1] = m_fd[i];
     }
 
     void forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut) {
-        for (int i = 0; i < m_size; ++i) m_a[i] = realIn[i];
-        basefft(false, m_a, 0, m_c, m_d);
+        if (!m_fa) initFloat();
+        basefft<float>(false, realIn, 0, m_fc, m_fd);
         const int hs = m_size/2;
+        if (approximatePolar()) {
+            v_cartesian_to_polar(magOut, phaseOut, m_fc, m_fd, hs + 1,
+                                 m_polarAccuracy);
+            return;
+        }
         for (int i = 0; i <= hs; ++i) {
-            magOut[i] = sqrt(m_c[i] * m_c[i] + m_d[i] * m_d[i]);
-            phaseOut[i] = atan2(m_d[i], m_c[i]) ;
+            magOut[i] = sqrtf(m_fc[i] * m_fc[i] + m_fd[i] * m_fd[i]);
+            phaseOut[i] = atan2f(m_fd[i], m_fc[i]) ;
         }
     }
 
     void forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut) {
-        for (int i = 0; i < m_size; ++i) m_a[i] = realIn[i];
-        basefft(false, m_a, 0, m_c, m_d);
+        if (!m_fa) initFloat();
+        basefft<float>(false, realIn, 0, m_fc, m_fd);
         const int hs = m_size/2;
         for (int i = 0; i <= hs; ++i) {
-            magOut[i] = sqrt(m_c[i] * m_c[i] + m_d[i] * m_d[i]);
+            magOut[i] = sqrtf(m_fc[i] * m_fc[i] + m_fd[i] * m_fd[i]);
         }
     }
 
+    int getGoertzelLimit() const {
+        return 16;
+    }
+
+    void forwardBins(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut, int first, int count) {
+        if (!m_a) initDouble();
+        basefft<double>(false, realIn, 0, m_c, m_d);
+        v_copy(realOut, m_c + first, count);
+        v_copy(imagOut, m_d + first, count);
+    }
+
+    void forwardBinsPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut, int first, int count) {
+        if (!m_a) initDouble();
+        basefft<double>(false, realIn, 0, m_c, m_d);
+        cartesianToPolar(magOut, phaseOut, m_c + first, m_d + first, count);
+    }
+
+    void forwardBinsMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut, int first, int count) {
+        if (!m_a) initDouble();
+        basefft<double>(false, realIn, 0, m_c, m_d);
+        cartesianToMagnitude(magOut, m_c + first, m_d + first, count);
+    }
+
+    void forwardBins(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut, int first, int count) {
+        if (!m_fa) initFloat();
+        basefft<float>(false, realIn, 0, m_fc, m_fd);
+        v_copy(realOut, m_fc + first, count);
+        v_copy(imagOut, m_fd + first, count);
+    }
+
+    void forwardBinsPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut, int first, int count) {
+        if (!m_fa) initFloat();
+        basefft<float>(false, realIn, 0, m_fc, m_fd);
+        cartesianToPolar(magOut, phaseOut, m_fc + first, m_fd + first, count);
+    }
+
+    void forwardBinsMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut, int first, int count) {
+        if (!m_fa) initFloat();
+        basefft<float>(false, realIn, 0, m_fc, m_fd);
+        cartesianToMagnitude(magOut, m_fc + first, m_fd + first, count);
+    }
+
+    void forwardPadded(const double *BQ_R__ realIn, int inCount, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_a) initDouble();
+        v_copy(m_a, realIn, inCount);
+        v_zero(m_a + inCount, m_size - inCount);
+        forward(m_a, realOut, imagOut);
+    }
+
+    void forwardPadded(const float *BQ_R__ realIn, int inCount, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_fa) initFloat();
+        v_copy(m_fa, realIn, inCount);
+        v_zero(m_fa + inCount, m_size - inCount);
+        forward(m_fa, realOut, imagOut);
+    }
+
     void inverse(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut) {
+        if (!m_a) initDouble();
         const int hs = m_size/2;
         for (int i = 0; i <= hs; ++i) {
             double real = realIn[i];
@@ -2789,6 +4297,7 @@ public:
     }
 
     void inverseInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ realOut) {
+        if (!m_a) initDouble();
         const int hs = m_size/2;
         for (int i = 0; i <= hs; ++i) {
             double real = complexIn[i*2];
@@ -2804,7 +4313,18 @@ public:
     }
 
     void inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut) {
+        if (!m_a) initDouble();
         const int hs = m_size/2;
+        if (approximatePolar()) {
+            v_polar_to_cartesian(m_a, m_b, magIn, phaseIn, hs + 1,
+                                 m_polarAccuracy);
+            for (int i = 1; i <= hs; ++i) {
+                m_a[m_size-i] = m_a[i];
+                m_b[m_size-i] = -m_b[i];
+            }
+            basefft(true, m_a, m_b, realOut, m_d);
+            return;
+        }
         for (int i = 0; i <= hs; ++i) {
             double real = magIn[i] * cos(phaseIn[i]);
             double imag = magIn[i] * sin(phaseIn[i]);
@@ -2819,6 +4339,7 @@ public:
     }
 
     void inverseCepstral(const double *BQ_R__ magIn, double *BQ_R__ cepOut) {
+        if (!m_a) initDouble();
         const int hs = m_size/2;
         for (int i = 0; i <= hs; ++i) {
             double real = log(magIn[i] + 0.000001);
@@ -2833,104 +4354,241 @@ public:
     }
 
     void inverse(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut) {
+        if (!m_fa) initFloat();
         const int hs = m_size/2;
         for (int i = 0; i <= hs; ++i) {
             float real = realIn[i];
             float imag = imagIn[i];
-            m_a[i] = real;
-            m_b[i] = imag;
+            m_fa[i] = real;
+            m_fb[i] = imag;
             if (i > 0) {
-                m_a[m_size-i] = real;
-                m_b[m_size-i] = -imag;
+                m_fa[m_size-i] = real;
+                m_fb[m_size-i] = -imag;
             }
         }
-        basefft(true, m_a, m_b, m_c, m_d);
-        for (int i = 0; i < m_size; ++i) realOut[i] = m_c[i];
+        basefft(true, m_fa, m_fb, realOut, m_fd);
     }
 
     void inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut) {
+        if (!m_fa) initFloat();
         const int hs = m_size/2;
         for (int i = 0; i <= hs; ++i) {
             float real = complexIn[i*2];
             float imag = complexIn[i*2+1];
-            m_a[i] = real;
-            m_b[i] = imag;
+            m_fa[i] = real;
+            m_fb[i] = imag;
             if (i > 0) {
-                m_a[m_size-i] = real;
-                m_b[m_size-i] = -imag;
+                m_fa[m_size-i] = real;
+                m_fb[m_size-i] = -imag;
             }
         }
-        basefft(true, m_a, m_b, m_c, m_d);
-        for (int i = 0; i < m_size; ++i) realOut[i] = m_c[i];
+        basefft(true, m_fa, m_fb, realOut, m_fd);
     }
 
     void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut) {
+        if (!m_fa) initFloat();
         const int hs = m_size/2;
+        if (approximatePolar()) {
+            v_polar_to_cartesian(m_fa, m_fb, magIn, phaseIn, hs + 1,
+                                 m_polarAccuracy);
+            for (int i = 1; i <= hs; ++i) {
+                m_fa[m_size-i] = m_fa[i];
+                m_fb[m_size-i] = -m_fb[i];
+            }
+            basefft(true, m_fa, m_fb, realOut, m_fd);
+            return;
+        }
         for (int i = 0; i <= hs; ++i) {
             float real = magIn[i] * cosf(phaseIn[i]);
             float imag = magIn[i] * sinf(phaseIn[i]);
-            m_a[i] = real;
-            m_b[i] = imag;
+            m_fa[i] = real;
+            m_fb[i] = imag;
             if (i > 0) {
-                m_a[m_size-i] = real;
-                m_b[m_size-i] = -imag;
+                m_fa[m_size-i] = real;
+                m_fb[m_size-i] = -imag;
             }
         }
-        basefft(true, m_a, m_b, m_c, m_d);
-        for (int i = 0; i < m_size; ++i) realOut[i] = m_c[i];
+        basefft(true, m_fa, m_fb, realOut, m_fd);
     }
 
     void inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut) {
+        if (!m_fa) initFloat();
         const int hs = m_size/2;
         for (int i = 0; i <= hs; ++i) {
             float real = logf(magIn[i] + 0.000001);
-            m_a[i] = real;
-            m_b[i] = 0.0;
+            m_fa[i] = real;
+            m_fb[i] = 0.0;
             if (i > 0) {
-                m_a[m_size-i] = real;
-                m_b[m_size-i] = 0.0;
+                m_fa[m_size-i] = real;
+                m_fb[m_size-i] = 0.0;
             }
         }
+        basefft(true, m_fa, m_fb, cepOut, m_fd);
+    }
+
+    void initFloatSpectra(int) { }
+    void initDoubleSpectra(int) { }
+
+    void forwardWindowed(const double *BQ_R__ realIn, const double *BQ_R__ window, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_a) initDouble();
+        forwardWindowedReal(realIn, window, realOut, imagOut, m_c, m_d);
+    }
+
+    void forwardPower(const double *BQ_R__ realIn, const double *BQ_R__ window, double *BQ_R__ powerOut) {
+        if (!m_a) initDouble();
+        forwardPowerReal(realIn, window, powerOut, m_c, m_d);
+    }
+
+    void forwardWindowed(const float *BQ_R__ realIn, const float *BQ_R__ window, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_fa) initFloat();
+        forwardWindowedReal(realIn, window, realOut, imagOut, m_fc, m_fd);
+    }
+
+    void forwardPower(const float *BQ_R__ realIn, const float *BQ_R__ window, float *BQ_R__ powerOut) {
+        if (!m_fa) initFloat();
+        forwardPowerReal(realIn, window, powerOut, m_fc, m_fd);
+    }
+
+    // basefft is a complex transform already, so the split forms need
+    // no buffers of their own and initFloatComplex and
+    // initDoubleComplex only have to ensure those for the
+    // interleaved forms
+
+    void initFloatComplex(int) {
+        initFloat();
+    }
+
+    void initDoubleComplex(int) {
+        initDouble();
+    }
+
+    void forwardComplex(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        basefft(false, realIn, imagIn, realOut, imagOut);
+    }
+
+    void forwardComplexInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ complexOut) {
+        if (!m_a) initDouble();
+        splitComplex(m_a, m_b, complexIn, m_size);
+        basefft(false, m_a, m_b, m_c, m_d);
+        joinComplex(complexOut, m_c, m_d, m_size);
+    }
+
+    void inverseComplex(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        basefft(true, realIn, imagIn, realOut, imagOut);
+    }
+
+    void inverseComplexInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ complexOut) {
+        if (!m_a) initDouble();
+        splitComplex(m_a, m_b, complexIn, m_size);
         basefft(true, m_a, m_b, m_c, m_d);
-        for (int i = 0; i < m_size; ++i) cepOut[i] = m_c[i];
+        joinComplex(complexOut, m_c, m_d, m_size);
+    }
+
+    void forwardComplex(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_fa) initFloat();
+        basefft(false, realIn, imagIn, realOut, imagOut);
+    }
+
+    void forwardComplexInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ complexOut) {
+        if (!m_fa) initFloat();
+        splitComplex(m_fa, m_fb, complexIn, m_size);
+        basefft(false, m_fa, m_fb, m_fc, m_fd);
+        joinComplex(complexOut, m_fc, m_fd, m_size);
+    }
+
+    void inverseComplex(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_fa) initFloat();
+        basefft(true, realIn, imagIn, realOut, imagOut);
+    }
+
+    void inverseComplexInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ complexOut) {
+        if (!m_fa) initFloat();
+        splitComplex(m_fa, m_fb, complexIn, m_size);
+        basefft(true, m_fa, m_fb, m_fc, m_fd);
+        joinComplex(complexOut, m_fc, m_fd, m_size);
     }
 
 private:
     const int m_size;
     int *m_table;
+    double *m_twr;
+    double *m_twi;
+    float *m_ftwr;
+    float *m_ftwi;
     double *m_a;
     double *m_b;
     double *m_c;
     double *m_d;
-    void basefft(bool inverse, const double *BQ_R__ ri, const double *BQ_R__ ii, double *BQ_R__ ro, double *BQ_R__ io);
+    float *m_fa;
+    float *m_fb;
+    float *m_fc;
+    float *m_fd;
+
+    void twiddles(const double *&wr, const double *&wi) const {
+        wr = m_twr; wi = m_twi;
+    }
+    void twiddles(const float *&wr, const float *&wi) const {
+        wr = m_ftwr; wi = m_ftwi;
+    }
+
+    template <typename T>
+    void basefft(bool inverse, const T *BQ_R__ ri, const T *BQ_R__ ii, T *BQ_R__ ro, T *BQ_R__ io,
+                 const T *BQ_R__ window = 0);
+
+    template <typename T>
+    void forwardWindowedReal(const T *BQ_R__ realIn, const T *BQ_R__ window,
+                             T *BQ_R__ realOut, T *BQ_R__ imagOut,
+                             T *BQ_R__ c, T *BQ_R__ d) {
+        basefft<T>(false, realIn, 0, c, d, window);
+        const int hs = m_size/2;
+        for (int i = 0; i <= hs; ++i) realOut[i] = c[i];
+        for (int i = 0; i <= hs; ++i) imagOut[i] = d[i];
+    }
+
+    template <typename T>
+    void forwardPowerReal(const T *BQ_R__ realIn, const T *BQ_R__ window,
+                          T *BQ_R__ powerOut, T *BQ_R__ c, T *BQ_R__ d) {
+        basefft<T>(false, realIn, 0, c, d, window);
+        cartesianToPower(powerOut, c, d, m_size/2 + 1);
+    }
 };
 
+template <typename T>
 void
-D_Cross::basefft(bool inverse, const double *BQ_R__ ri, const double *BQ_R__ ii, double *BQ_R__ ro, double *BQ_R__ io)
+D_Cross::basefft(bool inverse, const T *BQ_R__ ri, const T *BQ_R__ ii, T *BQ_R__ ro, T *BQ_R__ io,
+                 const T *BQ_R__ window)
 {
     if (!ri || !ro || !io) return;
 
     int i, j, k, m;
     int blockSize, blockEnd;
 
-    double tr, ti;
+    T tr, ti;
 
-    double angle = 2.0 * M_PI;
-    if (inverse) angle = -angle;
+    const T sign = (inverse ? T(-1) : T(1));
+
+    const T *twr, *twi;
+    twiddles(twr, twi);
 
     const int n = m_size;
 
-    if (ii) {
+    // Any window is applied as part of the bit-reversing copy
+
+    if (window) {
+	for (i = 0; i < n; ++i) {
+	    ro[m_table[i]] = ri[i] * window[i];
+        }
+    } else {
 	for (i = 0; i < n; ++i) {
 	    ro[m_table[i]] = ri[i];
         }
+    }
+
+    if (ii) {
 	for (i = 0; i < n; ++i) {
 	    io[m_table[i]] = ii[i];
 	}
     } else {
-	for (i = 0; i < n; ++i) {
-	    ro[m_table[i]] = ri[i];
-        }
 	for (i = 0; i < n; ++i) {
 	    io[m_table[i]] = 0.0;
 	}
@@ -2940,35 +4598,19 @@ D_Cross::basefft(bool inverse, const double *BQ_R__ ri, const double *BQ_R__ ii,
 
     for (blockSize = 2; blockSize <= n; blockSize <<= 1) {
 
-	double delta = angle / (double)blockSize;
-	double sm2 = -sin(-2 * delta);
-	double sm1 = -sin(-delta);
-	double cm2 = cos(-2 * delta);
-	double cm1 = cos(-delta);
-	double w = 2 * cm1;
-	double ar[3], ai[3];
+	const T *BQ_R__ sr = twr + blockEnd - 1;
+	const T *BQ_R__ si = twi + blockEnd - 1;
 
 	for (i = 0; i < n; i += blockSize) {
 
-	    ar[2] = cm2;
-	    ar[1] = cm1;
-
-	    ai[2] = sm2;
-	    ai[1] = sm1;
-
 	    for (j = i, m = 0; m < blockEnd; j++, m++) {
 
-		ar[0] = w * ar[1] - ar[2];
-		ar[2] = ar[1];
-		ar[1] = ar[0];
-
-		ai[0] = w * ai[1] - ai[2];
-		ai[2] = ai[1];
-		ai[1] = ai[0];
+		const T wr = sr[m];
+		const T wi = sign * si[m];
 
 		k = j + blockEnd;
-		tr = ar[0] * ro[k] - ai[0] * io[k];
-		ti = ar[0] * io[k] + ai[0] * ro[k];
+		tr = wr * ro[k] - wi * io[k];
+		ti = wr * io[k] + wi * ro[k];
 
 		ro[k] = ro[j] - tr;
 		io[k] = io[j] - ti;
@@ -2995,591 +4637,2986 @@ D_Cross::basefft(bool inverse, const double *BQ_R__ ri, const double *BQ_R__ ii,
 */
 }
 
-#endif /* USE_BUILTIN_FFT */
 
-} /* end namespace FFTs */
+#if defined(BQ_BUILTIN_AVX_RUNTIME) && defined(__GNUC__) && !defined(__clang__)
+// The AVX kernels are instantiated from templates that are not
+// themselves built for AVX, which GCC warns about although they are
+// only ever inlined into functions that are
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
 
-std::string
-FFT::m_implementation;
+/*
+ The vectorised built-in implementation. A real transform of size N
+ is carried out as a complex transform of size N/2 on the even and
+ odd samples, followed by a pass that separates the two halves of the
+ spectrum again. The complex transform is a radix-4 Stockham
+ autosort, with a final radix-2 stage if N/2 is not a power of four,
+ working on split real and imaginary arrays. Being autosorting it
+ needs no bit-reversal, at the cost of ping-ponging between two pairs
+ of buffers.
+
+ Each stage of length m at stride s (the product of the lengths of
+ the stages before it) runs p over m/4 twiddle factors and, within
+ each, q over s contiguous elements with the same twiddles. The q
+ loop is the one we vectorise, which works once s is at least the
+ vector width; the earlier stages use scalar code.
+
+ The vector types provide load, store, set (broadcast), add, sub and
+ mul. SSE2 (x86) and NEON (ARM) are used when the compiler targets
+ them. With GCC or Clang on x86 the AVX versions are also compiled,
+ and are chosen at runtime if the CPU supports them. Inverse
+ transforms use the same code, as swapping the real and imaginary
+ parts on the way in and out of a forward transform gives an
+ (unscaled) inverse.
+*/
 
-std::set<std::string>
-FFT::getImplementations()
-{
-    std::set<std::string> impls;
-#ifdef HAVE_IPP
-    impls.insert("ipp");
-#endif
-#ifdef HAVE_FFTW3
-    impls.insert("fftw");
-#endif
-#ifdef HAVE_KISSFFT
-    impls.insert("kissfft");
-#endif
-#ifdef HAVE_VDSP
-    impls.insert("vdsp");
-#endif
-#ifdef HAVE_MEDIALIB
-    impls.insert("medialib");
-#endif
-#ifdef HAVE_OPENMAX
-    impls.insert("openmax");
-#endif
-#ifdef HAVE_SFFT
-    impls.insert("sfft");
-#endif
-#ifdef USE_BUILTIN_FFT
-    impls.insert("cross");
+#if defined(_MSC_VER)
+#define BQ_BUILTIN_INLINE __forceinline
+#else
+#define BQ_BUILTIN_INLINE inline __attribute__((always_inline))
 #endif
-    return impls;
-}
 
-void
-FFT::pickDefaultImplementation()
+template <typename T>
+struct BuiltinScalar
 {
-    if (m_implementation != "") return;
+    typedef T V;
+    enum { width = 1 };
+    static inline V load(const T *p) { return *p; }
+    static inline void store(T *p, V v) { *p = v; }
+    static inline V set(T x) { return x; }
+    static inline V add(V a, V b) { return a + b; }
+    static inline V sub(V a, V b) { return a - b; }
+    static inline V mul(V a, V b) { return a * b; }
+};
 
-    std::set<std::string> impls = getImplementations();
+#ifdef BQ_BUILTIN_SSE2
 
-    std::string best = "cross";
-    if (impls.find("kissfft") != impls.end()) best = "kissfft";
-    if (impls.find("medialib") != impls.end()) best = "medialib";
-    if (impls.find("openmax") != impls.end()) best = "openmax";
-    if (impls.find("sfft") != impls.end()) best = "sfft";
-    if (impls.find("fftw") != impls.end()) best = "fftw";
-    if (impls.find("vdsp") != impls.end()) best = "vdsp";
-    if (impls.find("ipp") != impls.end()) best = "ipp";
-    
-    m_implementation = best;
-}
+struct BuiltinSSE2f
+{
+    typedef __m128 V;
+    enum { width = 4 };
+    static inline V load(const float *p) { return _mm_loadu_ps(p); }
+    static inline void store(float *p, V v) { _mm_storeu_ps(p, v); }
+    static inline V set(float x) { return _mm_set1_ps(x); }
+    static inline V add(V a, V b) { return _mm_add_ps(a, b); }
+    static inline V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static inline V mul(V a, V b) { return _mm_mul_ps(a, b); }
+};
 
-std::string
-FFT::getDefaultImplementation()
+struct BuiltinSSE2d
 {
-    return m_implementation;
-}
+    typedef __m128d V;
+    enum { width = 2 };
+    static inline V load(const double *p) { return _mm_loadu_pd(p); }
+    static inline void store(double *p, V v) { _mm_storeu_pd(p, v); }
+    static inline V set(double x) { return _mm_set1_pd(x); }
+    static inline V add(V a, V b) { return _mm_add_pd(a, b); }
+    static inline V sub(V a, V b) { return _mm_sub_pd(a, b); }
+    static inline V mul(V a, V b) { return _mm_mul_pd(a, b); }
+};
 
-void
-FFT::setDefaultImplementation(std::string i)
+#endif
+
+#ifdef BQ_BUILTIN_AVX
+
+struct BuiltinAVXf
 {
-    m_implementation = i;
-}
+    typedef __m256 V;
+    enum { width = 8 };
+    static BQ_BUILTIN_AVX_TARGET inline V load(const float *p) { return _mm256_loadu_ps(p); }
+    static BQ_BUILTIN_AVX_TARGET inline void store(float *p, V v) { _mm256_storeu_ps(p, v); }
+    static BQ_BUILTIN_AVX_TARGET inline V set(float x) { return _mm256_set1_ps(x); }
+    static BQ_BUILTIN_AVX_TARGET inline V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static BQ_BUILTIN_AVX_TARGET inline V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static BQ_BUILTIN_AVX_TARGET inline V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+};
 
-FFT::FFT(int size, int debugLevel) :
-    d(0)
+struct BuiltinAVXd
 {
-    if ((size < 2) ||
-        (size & (size-1))) {
-        std::cerr << "FFT::FFT(" << size << "): power-of-two sizes only supported, minimum size 2" << std::endl;
-#ifndef NO_EXCEPTIONS
-        throw InvalidSize;
-#else
-        abort();
+    typedef __m256d V;
+    enum { width = 4 };
+    static BQ_BUILTIN_AVX_TARGET inline V load(const double *p) { return _mm256_loadu_pd(p); }
+    static BQ_BUILTIN_AVX_TARGET inline void store(double *p, V v) { _mm256_storeu_pd(p, v); }
+    static BQ_BUILTIN_AVX_TARGET inline V set(double x) { return _mm256_set1_pd(x); }
+    static BQ_BUILTIN_AVX_TARGET inline V add(V a, V b) { return _mm256_add_pd(a, b); }
+    static BQ_BUILTIN_AVX_TARGET inline V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+    static BQ_BUILTIN_AVX_TARGET inline V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+};
+
 #endif
-    }
 
-    if (m_implementation == "") pickDefaultImplementation();
-    std::string impl = m_implementation;
+#ifdef BQ_BUILTIN_NEON
 
-    if (debugLevel > 0) {
-        std::cerr << "FFT::FFT(" << size << "): using implementation: "
-                  << impl << std::endl;
-    }
+struct BuiltinNEONf
+{
+    typedef float32x4_t V;
+    enum { width = 4 };
+    static inline V load(const float *p) { return vld1q_f32(p); }
+    static inline void store(float *p, V v) { vst1q_f32(p, v); }
+    static inline V set(float x) { return vdupq_n_f32(x); }
+    static inline V add(V a, V b) { return vaddq_f32(a, b); }
+    static inline V sub(V a, V b) { return vsubq_f32(a, b); }
+    static inline V mul(V a, V b) { return vmulq_f32(a, b); }
+};
 
-    if (impl == "ipp") {
-#ifdef HAVE_IPP
-        d = new FFTs::D_IPP(size);
-#endif
-    } else if (impl == "fftw") {
-#ifdef HAVE_FFTW3
-        d = new FFTs::D_FFTW(size);
+#ifdef __aarch64__
+struct BuiltinNEONd
+{
+    typedef float64x2_t V;
+    enum { width = 2 };
+    static inline V load(const double *p) { return vld1q_f64(p); }
+    static inline void store(double *p, V v) { vst1q_f64(p, v); }
+    static inline V set(double x) { return vdupq_n_f64(x); }
+    static inline V add(V a, V b) { return vaddq_f64(a, b); }
+    static inline V sub(V a, V b) { return vsubq_f64(a, b); }
+    static inline V mul(V a, V b) { return vmulq_f64(a, b); }
+};
 #endif
-    } else if (impl == "kissfft") {        
-#ifdef HAVE_KISSFFT
-        d = new FFTs::D_KISSFFT(size);
+
 #endif
-    } else if (impl == "vdsp") {
-#ifdef HAVE_VDSP
-        d = new FFTs::D_VDSP(size);
+
+template <typename T, typename S>
+BQ_BUILTIN_INLINE void
+builtinRadix4(int m, int s,
+              const T *BQ_R__ xr, const T *BQ_R__ xi,
+              T *BQ_R__ yr, T *BQ_R__ yi,
+              const T *BQ_R__ tw)
+{
+    typedef typename S::V V;
+    const int m1 = m/4;
+
+    for (int p = 0; p < m1; ++p) {
+
+        const V w1r = S::set(tw[p*6]), w1i = S::set(tw[p*6+1]);
+        const V w2r = S::set(tw[p*6+2]), w2i = S::set(tw[p*6+3]);
+        const V w3r = S::set(tw[p*6+4]), w3i = S::set(tw[p*6+5]);
+
+        const int i0 = s*p, i1 = i0 + s*m1, i2 = i1 + s*m1, i3 = i2 + s*m1;
+        const int o0 = s*p*4, o1 = o0 + s, o2 = o1 + s, o3 = o2 + s;
+
+        for (int q = 0; q < s; q += S::width) {
+
+            const V ar = S::load(xr + i0 + q), ai = S::load(xi + i0 + q);
+            const V br = S::load(xr + i1 + q), bi = S::load(xi + i1 + q);
+            const V cr = S::load(xr + i2 + q), ci = S::load(xi + i2 + q);
+            const V dr = S::load(xr + i3 + q), di = S::load(xi + i3 + q);
+
+            const V apcr = S::add(ar, cr), apci = S::add(ai, ci);
+            const V amcr = S::sub(ar, cr), amci = S::sub(ai, ci);
+            const V bpdr = S::add(br, dr), bpdi = S::add(bi, di);
+            const V bmdr = S::sub(br, dr), bmdi = S::sub(bi, di);
+
+            // (a - c) -/+ i(b - d) for outputs 1 and 3
+            const V t1r = S::add(amcr, bmdi), t1i = S::sub(amci, bmdr);
+            const V t2r = S::sub(apcr, bpdr), t2i = S::sub(apci, bpdi);
+            const V t3r = S::sub(amcr, bmdi), t3i = S::add(amci, bmdr);
+
+            S::store(yr + o0 + q, S::add(apcr, bpdr));
+            S::store(yi + o0 + q, S::add(apci, bpdi));
+            S::store(yr + o1 + q, S::sub(S::mul(t1r, w1r), S::mul(t1i, w1i)));
+            S::store(yi + o1 + q, S::add(S::mul(t1r, w1i), S::mul(t1i, w1r)));
+            S::store(yr + o2 + q, S::sub(S::mul(t2r, w2r), S::mul(t2i, w2i)));
+            S::store(yi + o2 + q, S::add(S::mul(t2r, w2i), S::mul(t2i, w2r)));
+            S::store(yr + o3 + q, S::sub(S::mul(t3r, w3r), S::mul(t3i, w3i)));
+            S::store(yi + o3 + q, S::add(S::mul(t3r, w3i), S::mul(t3i, w3r)));
+        }
+    }
+}
+
+// A radix-4 stage whose input is zero beyond its first few quarters
+// (the four inputs of each butterfly being a quarter of the buffer
+// apart), as in the first stages of a transform of zero-padded
+// input. The zero quarters are not read, and with only the first
+// quarter nonzero each butterfly is just three twiddle multiplies
+
+template <typename T, typename S>
+BQ_BUILTIN_INLINE void
+builtinRadix4Pruned(int m, int s, int quarters,
+                    const T *BQ_R__ xr, const T *BQ_R__ xi,
+                    T *BQ_R__ yr, T *BQ_R__ yi,
+                    const T *BQ_R__ tw)
+{
+    typedef typename S::V V;
+    const int m1 = m/4;
+    const V zero = S::set(T(0));
+
+    for (int p = 0; p < m1; ++p) {
+
+        const V w1r = S::set(tw[p*6]), w1i = S::set(tw[p*6+1]);
+        const V w2r = S::set(tw[p*6+2]), w2i = S::set(tw[p*6+3]);
+        const V w3r = S::set(tw[p*6+4]), w3i = S::set(tw[p*6+5]);
+
+        const int i0 = s*p, i1 = i0 + s*m1, i2 = i1 + s*m1;
+        const int o0 = s*p*4, o1 = o0 + s, o2 = o1 + s, o3 = o2 + s;
+
+        if (quarters == 1) {
+            for (int q = 0; q < s; q += S::width) {
+                const V ar = S::load(xr + i0 + q), ai = S::load(xi + i0 + q);
+                S::store(yr + o0 + q, ar);
+                S::store(yi + o0 + q, ai);
+                S::store(yr + o1 + q, S::sub(S::mul(ar, w1r), S::mul(ai, w1i)));
+                S::store(yi + o1 + q, S::add(S::mul(ar, w1i), S::mul(ai, w1r)));
+                S::store(yr + o2 + q, S::sub(S::mul(ar, w2r), S::mul(ai, w2i)));
+                S::store(yi + o2 + q, S::add(S::mul(ar, w2i), S::mul(ai, w2r)));
+                S::store(yr + o3 + q, S::sub(S::mul(ar, w3r), S::mul(ai, w3i)));
+                S::store(yi + o3 + q, S::add(S::mul(ar, w3i), S::mul(ai, w3r)));
+            }
+            continue;
+        }
+
+        for (int q = 0; q < s; q += S::width) {
+
+            // As builtinRadix4 with d = 0, and c = 0 too if only two
+            // quarters are nonzero
+            const V ar = S::load(xr + i0 + q), ai = S::load(xi + i0 + q);
+            const V br = S::load(xr + i1 + q), bi = S::load(xi + i1 + q);
+            V cr = zero, ci = zero;
+            if (quarters > 2) {
+                cr = S::load(xr + i2 + q);
+                ci = S::load(xi + i2 + q);
+            }
+
+            const V apcr = S::add(ar, cr), apci = S::add(ai, ci);
+            const V amcr = S::sub(ar, cr), amci = S::sub(ai, ci);
+
+            const V t1r = S::add(amcr, bi), t1i = S::sub(amci, br);
+            const V t2r = S::sub(apcr, br), t2i = S::sub(apci, bi);
+            const V t3r = S::sub(amcr, bi), t3i = S::add(amci, br);
+
+            S::store(yr + o0 + q, S::add(apcr, br));
+            S::store(yi + o0 + q, S::add(apci, bi));
+            S::store(yr + o1 + q, S::sub(S::mul(t1r, w1r), S::mul(t1i, w1i)));
+            S::store(yi + o1 + q, S::add(S::mul(t1r, w1i), S::mul(t1i, w1r)));
+            S::store(yr + o2 + q, S::sub(S::mul(t2r, w2r), S::mul(t2i, w2i)));
+            S::store(yi + o2 + q, S::add(S::mul(t2r, w2i), S::mul(t2i, w2r)));
+            S::store(yr + o3 + q, S::sub(S::mul(t3r, w3r), S::mul(t3i, w3i)));
+            S::store(yi + o3 + q, S::add(S::mul(t3r, w3i), S::mul(t3i, w3r)));
+        }
+    }
+}
+
+template <typename T, typename S>
+BQ_BUILTIN_INLINE void
+builtinRadix2(int s,
+              const T *BQ_R__ xr, const T *BQ_R__ xi,
+              T *BQ_R__ yr, T *BQ_R__ yi)
+{
+    typedef typename S::V V;
+
+    for (int q = 0; q < s; q += S::width) {
+        const V ar = S::load(xr + q), ai = S::load(xi + q);
+        const V br = S::load(xr + s + q), bi = S::load(xi + s + q);
+        S::store(yr + q, S::add(ar, br));
+        S::store(yi + q, S::add(ai, bi));
+        S::store(yr + s + q, S::sub(ar, br));
+        S::store(yi + s + q, S::sub(ai, bi));
+    }
+}
+
+// Transform the n complex values in ar/ai, using br/bi as the other
+// buffer, and return true if the result ended up in ar/ai or false
+// if in br/bi. Only the first nz inputs may be nonzero; the rest of
+// the quarters of ar/ai they occupy must be zero, and the quarters
+// after those are not read. While the nonzero part fits in fewer
+// than four quarters, the stages that would combine it with zeros
+// are pruned. Each stage widens it fourfold
+
+template <typename T, typename S>
+BQ_BUILTIN_INLINE bool
+builtinTransform(int n, int nz, T *ar, T *ai, T *br, T *bi, const T *tw)
+{
+    typedef BuiltinScalar<T> Scalar;
+
+    int m = n, s = 1;
+    bool inA = true;
+
+    while (m >= 4) {
+        const T *xr = inA ? ar : br, *xi = inA ? ai : bi;
+        T *yr = inA ? br : ar, *yi = inA ? bi : ai;
+        int quarters = (nz * 4 + n - 1) / n;
+        if (quarters < 1) quarters = 1;
+        if (quarters < 4) {
+            if (s < S::width) {
+                builtinRadix4Pruned<T, Scalar>(m, s, quarters, xr, xi, yr, yi, tw);
+            } else {
+                builtinRadix4Pruned<T, S>(m, s, quarters, xr, xi, yr, yi, tw);
+            }
+            nz = (quarters == 1 ? 4 * s * ((nz + s - 1) / s) : n);
+            if (nz > n) nz = n;
+        } else if (s < S::width) {
+            builtinRadix4<T, Scalar>(m, s, xr, xi, yr, yi, tw);
+        } else {
+            builtinRadix4<T, S>(m, s, xr, xi, yr, yi, tw);
+        }
+        tw += (m/4) * 6;
+        s *= 4;
+        m /= 4;
+        inA = !inA;
+    }
+
+    if (m == 2) {
+        const T *xr = inA ? ar : br, *xi = inA ? ai : bi;
+        T *yr = inA ? br : ar, *yi = inA ? bi : ai;
+        if (s < S::width) {
+            builtinRadix2<T, Scalar>(s, xr, xi, yr, yi);
+        } else {
+            builtinRadix2<T, S>(s, xr, xi, yr, yi);
+        }
+        inA = !inA;
+    }
+
+    return inA;
+}
+
+typedef bool (*BuiltinKernelF)(int, int, float *, float *, float *, float *, const float *);
+typedef bool (*BuiltinKernelD)(int, int, double *, double *, double *, double *, const double *);
+
+#if !defined(BQ_BUILTIN_SSE2) && !defined(BQ_BUILTIN_NEON)
+static bool
+builtinTransformScalar(int n, int nz, float *ar, float *ai, float *br, float *bi, const float *tw)
+{
+    return builtinTransform<float, BuiltinScalar<float> >(n, nz, ar, ai, br, bi, tw);
+}
 #endif
-    } else if (impl == "medialib") {
-#ifdef HAVE_MEDIALIB
-        d = new FFTs::D_MEDIALIB(size);
+
+#if !defined(BQ_BUILTIN_SSE2) && !(defined(BQ_BUILTIN_NEON) && defined(__aarch64__))
+static bool
+builtinTransformScalar(int n, int nz, double *ar, double *ai, double *br, double *bi, const double *tw)
+{
+    return builtinTransform<double, BuiltinScalar<double> >(n, nz, ar, ai, br, bi, tw);
+}
 #endif
-    } else if (impl == "openmax") {
-#ifdef HAVE_OPENMAX
-        d = new FFTs::D_OPENMAX(size);
+
+#ifdef BQ_BUILTIN_SSE2
+static bool
+builtinTransformSSE2(int n, int nz, float *ar, float *ai, float *br, float *bi, const float *tw)
+{
+    return builtinTransform<float, BuiltinSSE2f>(n, nz, ar, ai, br, bi, tw);
+}
+
+static bool
+builtinTransformSSE2(int n, int nz, double *ar, double *ai, double *br, double *bi, const double *tw)
+{
+    return builtinTransform<double, BuiltinSSE2d>(n, nz, ar, ai, br, bi, tw);
+}
 #endif
-    } else if (impl == "sfft") {
-#ifdef HAVE_SFFT
-        d = new FFTs::D_SFFT(size);
+
+#ifdef BQ_BUILTIN_AVX
+static BQ_BUILTIN_AVX_TARGET bool
+builtinTransformAVX(int n, int nz, float *ar, float *ai, float *br, float *bi, const float *tw)
+{
+    return builtinTransform<float, BuiltinAVXf>(n, nz, ar, ai, br, bi, tw);
+}
+
+static BQ_BUILTIN_AVX_TARGET bool
+builtinTransformAVX(int n, int nz, double *ar, double *ai, double *br, double *bi, const double *tw)
+{
+    return builtinTransform<double, BuiltinAVXd>(n, nz, ar, ai, br, bi, tw);
+}
+
+static bool
+builtinHaveAVX()
+{
+#ifdef BQ_BUILTIN_AVX_RUNTIME
+    return __builtin_cpu_supports("avx");
+#else
+    return true;
 #endif
-    } else if (impl == "cross") {
-#ifdef USE_BUILTIN_FFT
-        d = new FFTs::D_Cross(size);
+}
+#endif
+
+#ifdef BQ_BUILTIN_NEON
+static bool
+builtinTransformNEON(int n, int nz, float *ar, float *ai, float *br, float *bi, const float *tw)
+{
+    return builtinTransform<float, BuiltinNEONf>(n, nz, ar, ai, br, bi, tw);
+}
+
+#ifdef __aarch64__
+static bool
+builtinTransformNEON(int n, int nz, double *ar, double *ai, double *br, double *bi, const double *tw)
+{
+    return builtinTransform<double, BuiltinNEONd>(n, nz, ar, ai, br, bi, tw);
+}
+#endif
+#endif
+
+static BuiltinKernelF
+builtinKernel(float *)
+{
+#ifdef BQ_BUILTIN_AVX
+    if (builtinHaveAVX()) return builtinTransformAVX;
+#endif
+#if defined(BQ_BUILTIN_SSE2)
+    return builtinTransformSSE2;
+#elif defined(BQ_BUILTIN_NEON)
+    return builtinTransformNEON;
+#else
+    return builtinTransformScalar;
+#endif
+}
+
+static BuiltinKernelD
+builtinKernel(double *)
+{
+#ifdef BQ_BUILTIN_AVX
+    if (builtinHaveAVX()) return builtinTransformAVX;
 #endif
+#if defined(BQ_BUILTIN_SSE2)
+    return builtinTransformSSE2;
+#elif defined(BQ_BUILTIN_NEON) && defined(__aarch64__)
+    return builtinTransformNEON;
+#else
+    return builtinTransformScalar;
+#endif
+}
+
+template <typename T>
+class BuiltinPlan
+{
+public:
+    BuiltinPlan(int size) :
+        m_size(size),
+        m_half(size/2),
+        m_kernel(builtinKernel((T *)0)),
+        m_car(0), m_cai(0), m_cbr(0), m_cbi(0), m_ctwiddles(0) {
+
+        const int n = m_half;
+
+        m_ar = allocate<T>(n);
+        m_ai = allocate<T>(n);
+        m_br = allocate<T>(n);
+        m_bi = allocate<T>(n);
+        m_re = allocate<T>(n + 1);
+        m_im = allocate<T>(n + 1);
+        m_twiddles = makeTwiddles(n);
+
+        // Twiddles for separating the real transform from the complex one
+
+        m_pr = allocate<T>(n);
+        m_pi = allocate<T>(n);
+        for (int k = 0; k < n; ++k) {
+            double arg = 2.0 * M_PI * double(k) / double(m_size);
+            m_pr[k] = T(cos(arg));
+            m_pi[k] = T(sin(arg));
+        }
+    }
+
+    ~BuiltinPlan() {
+        deallocate(m_car);
+        deallocate(m_cai);
+        deallocate(m_cbr);
+        deallocate(m_cbi);
+        deallocate(m_ctwiddles);
+        deallocate(m_ar);
+        deallocate(m_ai);
+        deallocate(m_br);
+        deallocate(m_bi);
+        deallocate(m_re);
+        deallocate(m_im);
+        deallocate(m_twiddles);
+        deallocate(m_pr);
+        deallocate(m_pi);
+    }
+
+    void forward(const T *BQ_R__ realIn, T *BQ_R__ realOut, T *BQ_R__ imagOut,
+                 int stride = 1, const T *BQ_R__ window = 0) {
+        forwardBins(realIn, realOut, imagOut, 0, m_half + 1, stride, window);
+    }
+
+    // Bins first to first+count-1 only. The half-length complex
+    // transform is needed in full, but the separation of the real
+    // transform from it is done only for the bins requested
+
+    void forwardBins(const T *BQ_R__ realIn, T *BQ_R__ realOut, T *BQ_R__ imagOut,
+                     int first, int count,
+                     int stride = 1, const T *BQ_R__ window = 0) {
+
+        const int n = m_half;
+
+        // Any window is applied as the samples are split into even
+        // and odd
+
+        if (window) {
+            for (int k = 0; k < n; ++k) {
+                m_ar[k] = realIn[k*2] * window[k*2];
+                m_ai[k] = realIn[k*2+1] * window[k*2+1];
+            }
+        } else {
+            for (int k = 0; k < n; ++k) {
+                m_ar[k] = realIn[k*2];
+                m_ai[k] = realIn[k*2+1];
+            }
+        }
+
+        transformAndSeparate(n, realOut, imagOut, first, count, stride);
+    }
+
+    // Only the first inCount samples are given, the rest being
+    // zero. Whole quarters of the complex transform's input that are
+    // zero are skipped by the kernel, and the rest of the zeros are
+    // written here, so the cost falls as inCount does
+
+    void forwardPadded(const T *BQ_R__ realIn, int inCount,
+                       T *BQ_R__ realOut, T *BQ_R__ imagOut) {
+
+        const int n = m_half;
+        const int pairs = inCount / 2;
+        const int nz = (inCount + 1) / 2;
+
+        for (int k = 0; k < pairs; ++k) {
+            m_ar[k] = realIn[k*2];
+            m_ai[k] = realIn[k*2+1];
+        }
+        if (nz > pairs) {
+            m_ar[pairs] = realIn[pairs*2];
+            m_ai[pairs] = T(0);
+        }
+
+        int end = n;
+        if (n >= 4) {
+            const int quarter = n / 4;
+            end = ((nz + quarter - 1) / quarter) * quarter;
+            if (end < quarter) end = quarter;
+        }
+        for (int k = nz; k < end; ++k) {
+            m_ar[k] = T(0);
+            m_ai[k] = T(0);
+        }
+
+        transformAndSeparate(nz, realOut, imagOut, 0, n + 1, 1);
+    }
+
+    void forwardInterleaved(const T *BQ_R__ realIn, T *BQ_R__ complexOut) {
+        forward(realIn, complexOut, complexOut + 1, 2);
+    }
+
+    void forwardPolar(const T *BQ_R__ realIn, T *BQ_R__ magOut, T *BQ_R__ phaseOut,
+                      PolarAccuracy accuracy) {
+        forward(realIn, m_re, m_im);
+        v_cartesian_to_polar(magOut, phaseOut, m_re, m_im, m_half + 1, accuracy);
+    }
+
+    void forwardMagnitude(const T *BQ_R__ realIn, T *BQ_R__ magOut) {
+        forward(realIn, m_re, m_im);
+        for (int i = 0; i <= m_half; ++i) {
+            magOut[i] = sqrt(m_re[i] * m_re[i] + m_im[i] * m_im[i]);
+        }
+    }
+
+    void forwardBinsPolar(const T *BQ_R__ realIn, T *BQ_R__ magOut, T *BQ_R__ phaseOut,
+                          int first, int count, PolarAccuracy accuracy) {
+        forwardBins(realIn, m_re, m_im, first, count);
+        v_cartesian_to_polar(magOut, phaseOut, m_re, m_im, count, accuracy);
+    }
+
+    void forwardBinsMagnitude(const T *BQ_R__ realIn, T *BQ_R__ magOut,
+                              int first, int count) {
+        forwardBins(realIn, m_re, m_im, first, count);
+        for (int i = 0; i < count; ++i) {
+            magOut[i] = sqrt(m_re[i] * m_re[i] + m_im[i] * m_im[i]);
+        }
+    }
+
+    void forwardWindowed(const T *BQ_R__ realIn, const T *BQ_R__ window,
+                         T *BQ_R__ realOut, T *BQ_R__ imagOut) {
+        forward(realIn, realOut, imagOut, 1, window);
+    }
+
+    void forwardPower(const T *BQ_R__ realIn, const T *BQ_R__ window,
+                      T *BQ_R__ powerOut) {
+        forward(realIn, m_re, m_im, 1, window);
+        for (int i = 0; i <= m_half; ++i) {
+            powerOut[i] = m_re[i] * m_re[i] + m_im[i] * m_im[i];
+        }
+    }
+
+    void inverse(const T *BQ_R__ realIn, const T *BQ_R__ imagIn, T *BQ_R__ realOut,
+                 int stride = 1) {
+
+        const int n = m_half;
+
+        // The reverse of the separation in forward(), giving 2Z so
+        // that the result is scaled by N like the other
+        // implementations. It is written with real and imaginary
+        // parts swapped, to get an inverse from the forward transform
+
+        for (int k = 0; k < n; ++k) {
+            const T xr = realIn[k * stride], xi = imagIn[k * stride];
+            const T yr = realIn[(n-k) * stride], yi = imagIn[(n-k) * stride];
+            const T ar = xr + yr, ai = xi - yi;
+            const T br = xr - yr, bi = xi + yi;
+            const T c = m_pr[k], s = m_pi[k];
+            m_ai[k] = ar - s * br - c * bi;
+            m_ar[k] = ai + c * br - s * bi;
+        }
+
+        const bool inA = m_kernel(n, n, m_ar, m_ai, m_br, m_bi, m_twiddles);
+        const T *BQ_R__ zr = inA ? m_ar : m_br;
+        const T *BQ_R__ zi = inA ? m_ai : m_bi;
+
+        for (int k = 0; k < n; ++k) {
+            realOut[k*2] = zi[k];
+            realOut[k*2+1] = zr[k];
+        }
+    }
+
+    void inverseInterleaved(const T *BQ_R__ complexIn, T *BQ_R__ realOut) {
+        inverse(complexIn, complexIn + 1, realOut, 2);
+    }
+
+    void inversePolar(const T *BQ_R__ magIn, const T *BQ_R__ phaseIn, T *BQ_R__ realOut,
+                      PolarAccuracy accuracy) {
+        v_polar_to_cartesian(m_re, m_im, magIn, phaseIn, m_half + 1, accuracy);
+        inverse(m_re, m_im, realOut);
+    }
+
+    void inverseCepstral(const T *BQ_R__ magIn, T *BQ_R__ cepOut) {
+        for (int i = 0; i <= m_half; ++i) {
+            m_re[i] = log(magIn[i] + T(0.000001));
+            m_im[i] = T(0);
+        }
+        inverse(m_re, m_im, cepOut);
+    }
+
+    // The complex transforms run the kernel at the full size, so
+    // they have buffers and twiddles of their own, made on the first
+    // call to initComplex. Inverse transforms swap the real and
+    // imaginary parts on the way in and out
+
+    bool hasComplex() const {
+        return m_ctwiddles != 0;
+    }
+
+    void initComplex() {
+        if (m_ctwiddles) return;
+        m_car = allocate<T>(m_size);
+        m_cai = allocate<T>(m_size);
+        m_cbr = allocate<T>(m_size);
+        m_cbi = allocate<T>(m_size);
+        m_ctwiddles = makeTwiddles(m_size);
+    }
+
+    void forwardComplex(const T *BQ_R__ realIn, const T *BQ_R__ imagIn,
+                        T *BQ_R__ realOut, T *BQ_R__ imagOut,
+                        int stride = 1) {
+
+        initComplex();
+
+        const int n = m_size;
+
+        for (int k = 0; k < n; ++k) {
+            m_car[k] = realIn[k * stride];
+            m_cai[k] = imagIn[k * stride];
+        }
+
+        const bool inA = m_kernel(n, n, m_car, m_cai, m_cbr, m_cbi, m_ctwiddles);
+        const T *BQ_R__ zr = inA ? m_car : m_cbr;
+        const T *BQ_R__ zi = inA ? m_cai : m_cbi;
+
+        for (int k = 0; k < n; ++k) {
+            realOut[k * stride] = zr[k];
+            imagOut[k * stride] = zi[k];
+        }
+    }
+
+    void forwardComplexInterleaved(const T *BQ_R__ complexIn, T *BQ_R__ complexOut) {
+        forwardComplex(complexIn, complexIn + 1, complexOut, complexOut + 1, 2);
+    }
+
+    void inverseComplex(const T *BQ_R__ realIn, const T *BQ_R__ imagIn,
+                        T *BQ_R__ realOut, T *BQ_R__ imagOut) {
+        forwardComplex(imagIn, realIn, imagOut, realOut);
+    }
+
+    void inverseComplexInterleaved(const T *BQ_R__ complexIn, T *BQ_R__ complexOut) {
+        forwardComplex(complexIn + 1, complexIn, complexOut + 1, complexOut, 2);
+    }
+
+private:
+    // Transform m_ar/m_ai, of which only the first nz values may be
+    // nonzero, and separate bins first to first+count-1 of the real
+    // transform from the result
+
+    void transformAndSeparate(int nz, T *BQ_R__ realOut, T *BQ_R__ imagOut,
+                              int first, int count, int stride) {
+
+        const int n = m_half;
+
+        const bool inA = m_kernel(n, nz, m_ar, m_ai, m_br, m_bi, m_twiddles);
+        const T *BQ_R__ zr = inA ? m_ar : m_br;
+        const T *BQ_R__ zi = inA ? m_ai : m_bi;
+
+        // With Z the transform of the even samples plus i times the
+        // odd ones, X[k] = E[k] + w^k O[k] where w = exp(-2 pi i / N),
+        // E[k] = (Z[k] + Z*[n-k]) / 2 and O[k] = (Z[k] - Z*[n-k]) / 2i
+
+        // Output index i is bin first + i. DC and Nyquist come
+        // straight from Z[0]
+
+        int from = first, to = first + count;
+        if (from == 0) {
+            realOut[0] = zr[0] + zi[0];
+            imagOut[0] = T(0);
+            ++from;
+        }
+        if (to == n + 1) {
+            realOut[(n - first) * stride] = zr[0] - zi[0];
+            imagOut[(n - first) * stride] = T(0);
+            --to;
+        }
+
+        for (int k = from; k < to; ++k) {
+            const T sr = zr[k] + zr[n-k];
+            const T si = zi[k] - zi[n-k];
+            const T dr = zr[k] - zr[n-k];
+            const T di = zi[k] + zi[n-k];
+            const T c = m_pr[k], s = m_pi[k];
+            realOut[(k - first) * stride] = T(0.5) * (sr + c * di - s * dr);
+            imagOut[(k - first) * stride] = T(0.5) * (si - c * dr - s * di);
+        }
+    }
+
+    typedef bool (*Kernel)(int, int, T *, T *, T *, T *, const T *);
+
+    // Per-stage twiddles w^p, w^2p and w^3p for w = exp(-2 pi i / m),
+    // for a kernel of length n
+
+    static T *makeTwiddles(int n) {
+
+        int count = 0;
+        for (int m = n; m >= 4; m /= 4) count += (m/4) * 6;
+        T *twiddles = allocate<T>(count > 0 ? count : 1);
+
+        T *tw = twiddles;
+        for (int m = n; m >= 4; m /= 4) {
+            for (int p = 0; p < m/4; ++p) {
+                for (int k = 1; k <= 3; ++k) {
+                    double arg = 2.0 * M_PI * double(k * p) / double(m);
+                    *tw++ = T(cos(arg));
+                    *tw++ = T(-sin(arg));
+                }
+            }
+        }
+
+        return twiddles;
+    }
+
+    const int m_size;
+    const int m_half;
+    Kernel m_kernel;
+    T *m_ar;
+    T *m_ai;
+    T *m_br;
+    T *m_bi;
+    T *m_re;
+    T *m_im;
+    T *m_twiddles;
+    T *m_pr;
+    T *m_pi;
+    T *m_car;
+    T *m_cai;
+    T *m_cbr;
+    T *m_cbi;
+    T *m_ctwiddles;
+
+    BuiltinPlan(const BuiltinPlan &);
+    BuiltinPlan &operator=(const BuiltinPlan &);
+};
+
+class D_Builtin : public FFTImpl
+{
+public:
+    D_Builtin(int size) : m_size(size), m_fplan(0), m_dplan(0) { }
+
+    ~D_Builtin() {
+        delete m_fplan;
+        delete m_dplan;
+    }
+
+    FFT::Precisions
+    getSupportedPrecisions() const {
+        return FFT::SinglePrecision | FFT::DoublePrecision;
+    }
+
+    void initFloat() {
+        if (m_fplan) return;
+        allocating();
+        m_fplan = new BuiltinPlan<float>(m_size);
+    }
+
+    void initDouble() {
+        if (m_dplan) return;
+        allocating();
+        m_dplan = new BuiltinPlan<double>(m_size);
+    }
+
+    void forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_dplan) initDouble();
+        m_dplan->forward(realIn, realOut, imagOut);
+    }
+
+    void forwardInterleaved(const double *BQ_R__ realIn, double *BQ_R__ complexOut) {
+        if (!m_dplan) initDouble();
+        m_dplan->forwardInterleaved(realIn, complexOut);
+    }
+
+    void forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut) {
+        if (!m_dplan) initDouble();
+        m_dplan->forwardPolar(realIn, magOut, phaseOut, m_polarAccuracy);
+    }
+
+    void forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut) {
+        if (!m_dplan) initDouble();
+        m_dplan->forwardMagnitude(realIn, magOut);
+    }
+
+    void forward(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_fplan) initFloat();
+        m_fplan->forward(realIn, realOut, imagOut);
+    }
+
+    void forwardInterleaved(const float *BQ_R__ realIn, float *BQ_R__ complexOut) {
+        if (!m_fplan) initFloat();
+        m_fplan->forwardInterleaved(realIn, complexOut);
+    }
+
+    void forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut) {
+        if (!m_fplan) initFloat();
+        m_fplan->forwardPolar(realIn, magOut, phaseOut, m_polarAccuracy);
+    }
+
+    void forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut) {
+        if (!m_fplan) initFloat();
+        m_fplan->forwardMagnitude(realIn, magOut);
+    }
+
+    int getGoertzelLimit() const {
+        return 4;
+    }
+
+    void forwardBins(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut, int first, int count) {
+        if (!m_dplan) initDouble();
+        m_dplan->forwardBins(realIn, realOut, imagOut, first, count);
+    }
+
+    void forwardBinsPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut, int first, int count) {
+        if (!m_dplan) initDouble();
+        m_dplan->forwardBinsPolar(realIn, magOut, phaseOut, first, count, m_polarAccuracy);
+    }
+
+    void forwardBinsMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut, int first, int count) {
+        if (!m_dplan) initDouble();
+        m_dplan->forwardBinsMagnitude(realIn, magOut, first, count);
+    }
+
+    void forwardBins(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut, int first, int count) {
+        if (!m_fplan) initFloat();
+        m_fplan->forwardBins(realIn, realOut, imagOut, first, count);
+    }
+
+    void forwardBinsPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut, int first, int count) {
+        if (!m_fplan) initFloat();
+        m_fplan->forwardBinsPolar(realIn, magOut, phaseOut, first, count, m_polarAccuracy);
+    }
+
+    void forwardBinsMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut, int first, int count) {
+        if (!m_fplan) initFloat();
+        m_fplan->forwardBinsMagnitude(realIn, magOut, first, count);
+    }
+
+    void forwardPadded(const double *BQ_R__ realIn, int inCount, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_dplan) initDouble();
+        m_dplan->forwardPadded(realIn, inCount, realOut, imagOut);
+    }
+
+    void forwardPadded(const float *BQ_R__ realIn, int inCount, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_fplan) initFloat();
+        m_fplan->forwardPadded(realIn, inCount, realOut, imagOut);
     }
 
-    if (!d) {
-        std::cerr << "FFT::FFT(" << size << "): ERROR: implementation "
-                  << impl << " is not compiled in" << std::endl;
-#ifndef NO_EXCEPTIONS
-        throw InvalidImplementation;
-#else
-        abort();
-#endif
-    }
+    void inverse(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut) {
+        if (!m_dplan) initDouble();
+        m_dplan->inverse(realIn, imagIn, realOut);
+    }
+
+    void inverseInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ realOut) {
+        if (!m_dplan) initDouble();
+        m_dplan->inverseInterleaved(complexIn, realOut);
+    }
+
+    void inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut) {
+        if (!m_dplan) initDouble();
+        m_dplan->inversePolar(magIn, phaseIn, realOut, m_polarAccuracy);
+    }
+
+    void inverseCepstral(const double *BQ_R__ magIn, double *BQ_R__ cepOut) {
+        if (!m_dplan) initDouble();
+        m_dplan->inverseCepstral(magIn, cepOut);
+    }
+
+    void inverse(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut) {
+        if (!m_fplan) initFloat();
+        m_fplan->inverse(realIn, imagIn, realOut);
+    }
+
+    void inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut) {
+        if (!m_fplan) initFloat();
+        m_fplan->inverseInterleaved(complexIn, realOut);
+    }
+
+    void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut) {
+        if (!m_fplan) initFloat();
+        m_fplan->inversePolar(magIn, phaseIn, realOut, m_polarAccuracy);
+    }
+
+    void inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut) {
+        if (!m_fplan) initFloat();
+        m_fplan->inverseCepstral(magIn, cepOut);
+    }
+
+    void initFloatSpectra(int) { }
+    void initDoubleSpectra(int) { }
+
+    void forwardWindowed(const double *BQ_R__ realIn, const double *BQ_R__ window, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_dplan) initDouble();
+        m_dplan->forwardWindowed(realIn, window, realOut, imagOut);
+    }
+
+    void forwardPower(const double *BQ_R__ realIn, const double *BQ_R__ window, double *BQ_R__ powerOut) {
+        if (!m_dplan) initDouble();
+        m_dplan->forwardPower(realIn, window, powerOut);
+    }
+
+    void forwardWindowed(const float *BQ_R__ realIn, const float *BQ_R__ window, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_fplan) initFloat();
+        m_fplan->forwardWindowed(realIn, window, realOut, imagOut);
+    }
+
+    void forwardPower(const float *BQ_R__ realIn, const float *BQ_R__ window, float *BQ_R__ powerOut) {
+        if (!m_fplan) initFloat();
+        m_fplan->forwardPower(realIn, window, powerOut);
+    }
+
+    void initFloatComplex(int) {
+        initFloat();
+        if (m_fplan->hasComplex()) return;
+        allocating();
+        m_fplan->initComplex();
+    }
+
+    void initDoubleComplex(int) {
+        initDouble();
+        if (m_dplan->hasComplex()) return;
+        allocating();
+        m_dplan->initComplex();
+    }
+
+    void forwardComplex(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_dplan) initDouble();
+        m_dplan->forwardComplex(realIn, imagIn, realOut, imagOut);
+    }
+
+    void forwardComplexInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ complexOut) {
+        if (!m_dplan) initDouble();
+        m_dplan->forwardComplexInterleaved(complexIn, complexOut);
+    }
+
+    void inverseComplex(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_dplan) initDouble();
+        m_dplan->inverseComplex(realIn, imagIn, realOut, imagOut);
+    }
+
+    void inverseComplexInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ complexOut) {
+        if (!m_dplan) initDouble();
+        m_dplan->inverseComplexInterleaved(complexIn, complexOut);
+    }
+
+    void forwardComplex(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_fplan) initFloat();
+        m_fplan->forwardComplex(realIn, imagIn, realOut, imagOut);
+    }
+
+    void forwardComplexInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ complexOut) {
+        if (!m_fplan) initFloat();
+        m_fplan->forwardComplexInterleaved(complexIn, complexOut);
+    }
+
+    void inverseComplex(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_fplan) initFloat();
+        m_fplan->inverseComplex(realIn, imagIn, realOut, imagOut);
+    }
+
+    void inverseComplexInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ complexOut) {
+        if (!m_fplan) initFloat();
+        m_fplan->inverseComplexInterleaved(complexIn, complexOut);
+    }
+
+private:
+    const int m_size;
+    BuiltinPlan<float> *m_fplan;
+    BuiltinPlan<double> *m_dplan;
+};
+
+#if defined(BQ_BUILTIN_AVX_RUNTIME) && defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif /* USE_BUILTIN_FFT */
+
+/*
+ Bluestein's algorithm, for sizes that the underlying implementation
+ cannot transform natively. A DFT of length n is rewritten as a
+ circular convolution with a chirp, which is carried out using
+ transforms of a power-of-two length m >= 2n-1 from an inner
+ implementation. Each complex transform of length m is made from two
+ real forward transforms, as the inner implementation only does
+ real->complex. All arithmetic is done in double precision.
+*/
+
+class D_Bluestein : public FFTImpl
+{
+public:
+    D_Bluestein(int size, FFTImpl *inner) :
+        m_size(size), m_inner(inner), m_m(innerSize(size)) {
+
+        m_a = new double[m_size];
+        m_b = new double[m_size];
+        m_c = new double[m_size];
+        m_d = new double[m_size];
+
+        m_wr = new double[m_size];
+        m_wi = new double[m_size];
+        m_br = new double[m_m];
+        m_bi = new double[m_m];
+        m_xr = new double[m_m];
+        m_xi = new double[m_m];
+        m_yr = new double[m_m];
+        m_yi = new double[m_m];
+        m_pr = new double[m_m/2 + 1];
+        m_pi = new double[m_m/2 + 1];
+        m_qr = new double[m_m/2 + 1];
+        m_qi = new double[m_m/2 + 1];
+
+        m_inner->initDouble();
+
+        // Chirp w[j] = exp(i pi j^2 / n). j^2 is reduced mod 2n
+        // first, to keep the argument small for large sizes
+
+        for (int j = 0; j < m_size; ++j) {
+            double arg = M_PI * fmod(double(j) * double(j), 2.0 * m_size) / m_size;
+            m_wr[j] = cos(arg);
+            m_wi[j] = sin(arg);
+        }
+
+        // The convolution kernel is the chirp, wrapped around so as
+        // to be symmetrical about zero. Its transform is scaled by
+        // 1/m here, to save scaling the convolution result later
+
+        for (int j = 0; j < m_m; ++j) {
+            m_xr[j] = 0.0;
+            m_xi[j] = 0.0;
+        }
+        for (int j = 0; j < m_size; ++j) {
+            m_xr[j] = m_wr[j];
+            m_xi[j] = m_wi[j];
+            if (j > 0) {
+                m_xr[m_m - j] = m_wr[j];
+                m_xi[m_m - j] = m_wi[j];
+            }
+        }
+        complexForward(m_xr, m_xi, m_br, m_bi);
+        for (int j = 0; j < m_m; ++j) {
+            m_br[j] /= m_m;
+            m_bi[j] /= m_m;
+        }
+    }
+
+    ~D_Bluestein() {
+        delete m_inner;
+        delete[] m_a;
+        delete[] m_b;
+        delete[] m_c;
+        delete[] m_d;
+        delete[] m_wr;
+        delete[] m_wi;
+        delete[] m_br;
+        delete[] m_bi;
+        delete[] m_xr;
+        delete[] m_xi;
+        delete[] m_yr;
+        delete[] m_yi;
+        delete[] m_pr;
+        delete[] m_pi;
+        delete[] m_qr;
+        delete[] m_qi;
+    }
+
+    static int innerSize(int size) {
+        int m = 1;
+        while (m < 2 * size - 1) m <<= 1;
+        return m;
+    }
+
+    FFT::Precisions
+    getSupportedPrecisions() const {
+        return m_inner->getSupportedPrecisions();
+    }
+
+    void setRealtime(bool realtime) {
+        FFTImpl::setRealtime(realtime);
+        m_inner->setRealtime(realtime);
+    }
+
+    int getAllocationCount() const {
+        return FFTImpl::getAllocationCount() + m_inner->getAllocationCount();
+    }
+
+    int getLockCount() const {
+        return FFTImpl::getLockCount() + m_inner->getLockCount();
+    }
+
+    void resetCounts() {
+        FFTImpl::resetCounts();
+        m_inner->resetCounts();
+    }
+
+    void initFloat() { }
+    void initDouble() { }
+
+    void forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        bluestein(false, realIn, 0, m_c, m_d);
+        const int hs = m_size/2;
+        for (int i = 0; i <= hs; ++i) realOut[i] = m_c[i];
+        if (imagOut) {
+            for (int i = 0; i <= hs; ++i) imagOut[i] = m_d[i];
+        }
+    }
+
+    void forwardInterleaved(const double *BQ_R__ realIn, double *BQ_R__ complexOut) {
+        bluestein(false, realIn, 0, m_c, m_d);
+        const int hs = m_size/2;
+        for (int i = 0; i <= hs; ++i) complexOut[i*2] = m_c[i];
+        for (int i = 0; i <= hs; ++i) complexOut[i*2+1] = m_d[i];
+    }
+
+    void forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut) {
+        bluestein(false, realIn, 0, m_c, m_d);
+        const int hs = m_size/2;
+        if (approximatePolar()) {
+            v_cartesian_to_polar(magOut, phaseOut, m_c, m_d, hs + 1,
+                                 m_polarAccuracy);
+            return;
+        }
+        for (int i = 0; i <= hs; ++i) {
+            magOut[i] = sqrt(m_c[i] * m_c[i] + m_d[i] * m_d[i]);
+            phaseOut[i] = atan2(m_d[i], m_c[i]) ;
+        }
+    }
+
+    void forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut) {
+        bluestein(false, realIn, 0, m_c, m_d);
+        const int hs = m_size/2;
+        for (int i = 0; i <= hs; ++i) {
+            magOut[i] = sqrt(m_c[i] * m_c[i] + m_d[i] * m_d[i]);
+        }
+    }
+
+    void forward(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        for (int i = 0; i < m_size; ++i) m_a[i] = realIn[i];
+        bluestein(false, m_a, 0, m_c, m_d);
+        const int hs = m_size/2;
+        for (int i = 0; i <= hs; ++i) realOut[i] = m_c[i];
+        if (imagOut) {
+            for (int i = 0; i <= hs; ++i) imagOut[i] = m_d[i];
+        }
+    }
+
+    void forwardInterleaved(const float *BQ_R__ realIn, float *BQ_R__ complexOut) {
+        for (int i = 0; i < m_size; ++i) m_a[i] = realIn[i];
+        bluestein(false, m_a, 0, m_c, m_d);
+        const int hs = m_size/2;
+        for (int i = 0; i <= hs; ++i) complexOut[i*2] = m_c[i];
+        for (int i = 0; i <= hs; ++i) complexOut[i*2+1] = m_d[i];
+    }
+
+    void forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut) {
+        for (int i = 0; i < m_size; ++i) m_a[i] = realIn[i];
+        bluestein(false, m_a, 0, m_c, m_d);
+        const int hs = m_size/2;
+        if (approximatePolar()) {
+            // Our spectrum is double, so convert in double and
+            // narrow afterwards, using m_a and m_b which are free now
+            v_cartesian_to_polar(m_a, m_b, m_c, m_d, hs + 1,
+                                 m_polarAccuracy);
+            v_convert(magOut, m_a, hs + 1);
+            v_convert(phaseOut, m_b, hs + 1);
+            return;
+        }
+        for (int i = 0; i <= hs; ++i) {
+            magOut[i] = sqrt(m_c[i] * m_c[i] + m_d[i] * m_d[i]);
+            phaseOut[i] = atan2(m_d[i], m_c[i]) ;
+        }
+    }
+
+    void forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut) {
+        for (int i = 0; i < m_size; ++i) m_a[i] = realIn[i];
+        bluestein(false, m_a, 0, m_c, m_d);
+        const int hs = m_size/2;
+        for (int i = 0; i <= hs; ++i) {
+            magOut[i] = sqrt(m_c[i] * m_c[i] + m_d[i] * m_d[i]);
+        }
+    }
+
+    int getGoertzelLimit() const {
+        return 16;
+    }
+
+    void forwardBins(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut, int first, int count) {
+        bluestein(false, realIn, 0, m_c, m_d);
+        v_copy(realOut, m_c + first, count);
+        v_copy(imagOut, m_d + first, count);
+    }
+
+    void forwardBinsPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut, int first, int count) {
+        bluestein(false, realIn, 0, m_c, m_d);
+        cartesianToPolar(magOut, phaseOut, m_c + first, m_d + first, count);
+    }
+
+    void forwardBinsMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut, int first, int count) {
+        bluestein(false, realIn, 0, m_c, m_d);
+        cartesianToMagnitude(magOut, m_c + first, m_d + first, count);
+    }
+
+    void forwardBins(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut, int first, int count) {
+        v_convert(m_a, realIn, m_size);
+        bluestein(false, m_a, 0, m_c, m_d);
+        v_convert(realOut, m_c + first, count);
+        v_convert(imagOut, m_d + first, count);
+    }
+
+    void forwardBinsPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut, int first, int count) {
+        v_convert(m_a, realIn, m_size);
+        bluestein(false, m_a, 0, m_c, m_d);
+        cartesianToPolar(m_a, m_b, m_c + first, m_d + first, count);
+        v_convert(magOut, m_a, count);
+        v_convert(phaseOut, m_b, count);
+    }
+
+    void forwardBinsMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut, int first, int count) {
+        v_convert(m_a, realIn, m_size);
+        bluestein(false, m_a, 0, m_c, m_d);
+        cartesianToMagnitude(magOut, m_c + first, m_d + first, count);
+    }
+
+    void forwardPadded(const double *BQ_R__ realIn, int inCount, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        v_copy(m_a, realIn, inCount);
+        v_zero(m_a + inCount, m_size - inCount);
+        forward(m_a, realOut, imagOut);
+    }
+
+    void forwardPadded(const float *BQ_R__ realIn, int inCount, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        v_convert(m_a, realIn, inCount);
+        v_zero(m_a + inCount, m_size - inCount);
+        bluestein(false, m_a, 0, m_c, m_d);
+        const int hs = m_size/2;
+        v_convert(realOut, m_c, hs + 1);
+        v_convert(imagOut, m_d, hs + 1);
+    }
+
+    void inverse(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut) {
+        const int hs = m_size/2;
+        for (int i = 0; i <= hs; ++i) {
+            double real = realIn[i];
+            double imag = imagIn[i];
+            m_a[i] = real;
+            m_b[i] = imag;
+            if (i > 0) {
+                m_a[m_size-i] = real;
+                m_b[m_size-i] = -imag;
+            }
+        }
+        bluestein(true, m_a, m_b, realOut, m_d);
+    }
+
+    void inverseInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ realOut) {
+        const int hs = m_size/2;
+        for (int i = 0; i <= hs; ++i) {
+            double real = complexIn[i*2];
+            double imag = complexIn[i*2+1];
+            m_a[i] = real;
+            m_b[i] = imag;
+            if (i > 0) {
+                m_a[m_size-i] = real;
+                m_b[m_size-i] = -imag;
+            }
+        }
+        bluestein(true, m_a, m_b, realOut, m_d);
+    }
+
+    void inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut) {
+        const int hs = m_size/2;
+        if (approximatePolar()) {
+            v_polar_to_cartesian(m_a, m_b, magIn, phaseIn, hs + 1,
+                                 m_polarAccuracy);
+            for (int i = 1; i <= hs; ++i) {
+                m_a[m_size-i] = m_a[i];
+                m_b[m_size-i] = -m_b[i];
+            }
+            bluestein(true, m_a, m_b, realOut, m_d);
+            return;
+        }
+        for (int i = 0; i <= hs; ++i) {
+            double real = magIn[i] * cos(phaseIn[i]);
+            double imag = magIn[i] * sin(phaseIn[i]);
+            m_a[i] = real;
+            m_b[i] = imag;
+            if (i > 0) {
+                m_a[m_size-i] = real;
+                m_b[m_size-i] = -imag;
+            }
+        }
+        bluestein(true, m_a, m_b, realOut, m_d);
+    }
+
+    void inverseCepstral(const double *BQ_R__ magIn, double *BQ_R__ cepOut) {
+        const int hs = m_size/2;
+        for (int i = 0; i <= hs; ++i) {
+            double real = log(magIn[i] + 0.000001);
+            m_a[i] = real;
+            m_b[i] = 0.0;
+            if (i > 0) {
+                m_a[m_size-i] = real;
+                m_b[m_size-i] = 0.0;
+            }
+        }
+        bluestein(true, m_a, m_b, cepOut, m_d);
+    }
+
+    void inverse(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut) {
+        const int hs = m_size/2;
+        for (int i = 0; i <= hs; ++i) {
+            float real = realIn[i];
+            float imag = imagIn[i];
+            m_a[i] = real;
+            m_b[i] = imag;
+            if (i > 0) {
+                m_a[m_size-i] = real;
+                m_b[m_size-i] = -imag;
+            }
+        }
+        bluestein(true, m_a, m_b, m_c, m_d);
+        for (int i = 0; i < m_size; ++i) realOut[i] = m_c[i];
+    }
+
+    void inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut) {
+        const int hs = m_size/2;
+        for (int i = 0; i <= hs; ++i) {
+            float real = complexIn[i*2];
+            float imag = complexIn[i*2+1];
+            m_a[i] = real;
+            m_b[i] = imag;
+            if (i > 0) {
+                m_a[m_size-i] = real;
+                m_b[m_size-i] = -imag;
+            }
+        }
+        bluestein(true, m_a, m_b, m_c, m_d);
+        for (int i = 0; i < m_size; ++i) realOut[i] = m_c[i];
+    }
+
+    void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut) {
+        const int hs = m_size/2;
+        if (approximatePolar()) {
+            // Widen the input into m_c and m_d, which are not needed
+            // until the transform writes its output to them
+            v_convert(m_c, magIn, hs + 1);
+            v_convert(m_d, phaseIn, hs + 1);
+            v_polar_to_cartesian(m_a, m_b, m_c, m_d, hs + 1,
+                                 m_polarAccuracy);
+            for (int i = 1; i <= hs; ++i) {
+                m_a[m_size-i] = m_a[i];
+                m_b[m_size-i] = -m_b[i];
+            }
+            bluestein(true, m_a, m_b, m_c, m_d);
+            v_convert(realOut, m_c, m_size);
+            return;
+        }
+        for (int i = 0; i <= hs; ++i) {
+            float real = magIn[i] * cosf(phaseIn[i]);
+            float imag = magIn[i] * sinf(phaseIn[i]);
+            m_a[i] = real;
+            m_b[i] = imag;
+            if (i > 0) {
+                m_a[m_size-i] = real;
+                m_b[m_size-i] = -imag;
+            }
+        }
+        bluestein(true, m_a, m_b, m_c, m_d);
+        for (int i = 0; i < m_size; ++i) realOut[i] = m_c[i];
+    }
+
+    void inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut) {
+        const int hs = m_size/2;
+        for (int i = 0; i <= hs; ++i) {
+            float real = logf(magIn[i] + 0.000001);
+            m_a[i] = real;
+            m_b[i] = 0.0;
+            if (i > 0) {
+                m_a[m_size-i] = real;
+                m_b[m_size-i] = 0.0;
+            }
+        }
+        bluestein(true, m_a, m_b, m_c, m_d);
+        for (int i = 0; i < m_size; ++i) cepOut[i] = m_c[i];
+    }
+
+    void initFloatSpectra(int) { }
+    void initDoubleSpectra(int) { }
+
+    void forwardWindowed(const double *BQ_R__ realIn, const double *BQ_R__ window, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        windowInto(m_a, realIn, window, m_size);
+        forward(m_a, realOut, imagOut);
+    }
+
+    void forwardPower(const double *BQ_R__ realIn, const double *BQ_R__ window, double *BQ_R__ powerOut) {
+        const double *in = realIn;
+        if (window) {
+            windowInto(m_a, realIn, window, m_size);
+            in = m_a;
+        }
+        bluestein(false, in, 0, m_c, m_d);
+        cartesianToPower(powerOut, m_c, m_d, m_size/2 + 1);
+    }
+
+    void forwardWindowed(const float *BQ_R__ realIn, const float *BQ_R__ window, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        windowInto(m_a, realIn, window, m_size);
+        bluestein(false, m_a, 0, m_c, m_d);
+        const int hs = m_size/2;
+        for (int i = 0; i <= hs; ++i) realOut[i] = m_c[i];
+        for (int i = 0; i <= hs; ++i) imagOut[i] = m_d[i];
+    }
+
+    void forwardPower(const float *BQ_R__ realIn, const float *BQ_R__ window, float *BQ_R__ powerOut) {
+        if (window) {
+            windowInto(m_a, realIn, window, m_size);
+        } else {
+            for (int i = 0; i < m_size; ++i) m_a[i] = realIn[i];
+        }
+        bluestein(false, m_a, 0, m_c, m_d);
+        cartesianToPower(powerOut, m_c, m_d, m_size/2 + 1);
+    }
+
+    // bluestein is a complex transform already, and the buffers it
+    // and these use were all allocated on construction
+
+    void initFloatComplex(int) { }
+    void initDoubleComplex(int) { }
+
+    void forwardComplex(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        bluestein(false, realIn, imagIn, realOut, imagOut);
+    }
+
+    void forwardComplexInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ complexOut) {
+        splitComplex(m_a, m_b, complexIn, m_size);
+        bluestein(false, m_a, m_b, m_c, m_d);
+        joinComplex(complexOut, m_c, m_d, m_size);
+    }
+
+    void inverseComplex(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        bluestein(true, realIn, imagIn, realOut, imagOut);
+    }
+
+    void inverseComplexInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ complexOut) {
+        splitComplex(m_a, m_b, complexIn, m_size);
+        bluestein(true, m_a, m_b, m_c, m_d);
+        joinComplex(complexOut, m_c, m_d, m_size);
+    }
+
+    void forwardComplex(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        for (int i = 0; i < m_size; ++i) m_a[i] = realIn[i];
+        for (int i = 0; i < m_size; ++i) m_b[i] = imagIn[i];
+        bluestein(false, m_a, m_b, m_c, m_d);
+        for (int i = 0; i < m_size; ++i) realOut[i] = m_c[i];
+        for (int i = 0; i < m_size; ++i) imagOut[i] = m_d[i];
+    }
+
+    void forwardComplexInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ complexOut) {
+        splitComplex(m_a, m_b, complexIn, m_size);
+        bluestein(false, m_a, m_b, m_c, m_d);
+        joinComplex(complexOut, m_c, m_d, m_size);
+    }
+
+    void inverseComplex(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        for (int i = 0; i < m_size; ++i) m_a[i] = realIn[i];
+        for (int i = 0; i < m_size; ++i) m_b[i] = imagIn[i];
+        bluestein(true, m_a, m_b, m_c, m_d);
+        for (int i = 0; i < m_size; ++i) realOut[i] = m_c[i];
+        for (int i = 0; i < m_size; ++i) imagOut[i] = m_d[i];
+    }
+
+    void inverseComplexInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ complexOut) {
+        splitComplex(m_a, m_b, complexIn, m_size);
+        bluestein(true, m_a, m_b, m_c, m_d);
+        joinComplex(complexOut, m_c, m_d, m_size);
+    }
+
+private:
+    const int m_size;
+    FFTImpl *m_inner;
+    const int m_m;
+    double *m_a;
+    double *m_b;
+    double *m_c;
+    double *m_d;
+    double *m_wr;
+    double *m_wi;
+    double *m_br;
+    double *m_bi;
+    double *m_xr;
+    double *m_xi;
+    double *m_yr;
+    double *m_yi;
+    double *m_pr;
+    double *m_pi;
+    double *m_qr;
+    double *m_qi;
+    void complexForward(const double *BQ_R__ ri, const double *BQ_R__ ii, double *BQ_R__ ro, double *BQ_R__ io);
+    void bluestein(bool inverse, const double *BQ_R__ ri, const double *BQ_R__ ii, double *BQ_R__ ro, double *BQ_R__ io);
+};
+
+void
+D_Bluestein::complexForward(const double *BQ_R__ ri, const double *BQ_R__ ii, double *BQ_R__ ro, double *BQ_R__ io)
+{
+    // With P and Q the transforms of the real and imaginary parts,
+    // the transform of the whole is P + iQ; the upper half of each
+    // follows from the lower by conjugate symmetry
+
+    const int m = m_m;
+    const int hm = m/2;
+
+    m_inner->forward(ri, m_pr, m_pi);
+    m_inner->forward(ii, m_qr, m_qi);
+
+    for (int k = 0; k <= hm; ++k) {
+        ro[k] = m_pr[k] - m_qi[k];
+        io[k] = m_pi[k] + m_qr[k];
+    }
+    for (int k = hm + 1; k < m; ++k) {
+        ro[k] = m_pr[m - k] + m_qi[m - k];
+        io[k] = m_qr[m - k] - m_pi[m - k];
+    }
+}
+
+void
+D_Bluestein::bluestein(bool inverse, const double *BQ_R__ ri, const double *BQ_R__ ii, double *BQ_R__ ro, double *BQ_R__ io)
+{
+    // The inverse transform is the conjugate of the forward
+    // transform of the conjugate, so we conjugate on the way in and
+    // out. As elsewhere, neither direction is scaled
+
+    const int n = m_size;
+    const int m = m_m;
+    const double sign = (inverse ? -1.0 : 1.0);
+
+    for (int j = 0; j < n; ++j) {
+        double xr = ri[j];
+        double xi = (ii ? sign * ii[j] : 0.0);
+        m_xr[j] = xr * m_wr[j] + xi * m_wi[j];
+        m_xi[j] = xi * m_wr[j] - xr * m_wi[j];
+    }
+    for (int j = n; j < m; ++j) {
+        m_xr[j] = 0.0;
+        m_xi[j] = 0.0;
+    }
+
+    complexForward(m_xr, m_xi, m_yr, m_yi);
+
+    // Multiply by the kernel, and conjugate so that a second forward
+    // transform gives us the (conjugated) inverse
+
+    for (int k = 0; k < m; ++k) {
+        double yr = m_yr[k] * m_br[k] - m_yi[k] * m_bi[k];
+        double yi = m_yr[k] * m_bi[k] + m_yi[k] * m_br[k];
+        m_xr[k] = yr;
+        m_xi[k] = -yi;
+    }
+
+    complexForward(m_xr, m_xi, m_yr, m_yi);
+
+    for (int k = 0; k < n; ++k) {
+        double cr = m_yr[k];
+        double ci = -m_yi[k];
+        ro[k] = cr * m_wr[k] + ci * m_wi[k];
+        io[k] = sign * (ci * m_wr[k] - cr * m_wi[k]);
+    }
+}
+
+} /* end namespace FFTs */
+
+std::string
+FFT::m_implementation;
+
+std::set<std::string>
+FFT::getImplementations()
+{
+    std::set<std::string> impls;
+#ifdef HAVE_IPP
+    impls.insert("ipp");
+#endif
+#ifdef HAVE_FFTW3
+    impls.insert("fftw");
+#endif
+#ifdef HAVE_KISSFFT
+    impls.insert("kissfft");
+#endif
+#ifdef HAVE_VDSP
+    impls.insert("vdsp");
+#endif
+#ifdef HAVE_MEDIALIB
+    impls.insert("medialib");
+#endif
+#ifdef HAVE_OPENMAX
+    impls.insert("openmax");
+#endif
+#ifdef HAVE_SFFT
+    impls.insert("sfft");
+#endif
+#ifdef USE_BUILTIN_FFT
+    impls.insert("builtin");
+    impls.insert("cross");
+#endif
+    return impls;
+}
+
+std::string
+FFT::getDefaultImplementation()
+{
+    return m_implementation;
+}
+
+void
+FFT::setDefaultImplementation(std::string i)
+{
+    m_implementation = i;
+}
+
+FFT::SizeClasses
+FFT::getSupportedSizes(std::string impl)
+{
+    if (impl == "fftw" || impl == "kissfft") {
+        return PowerOfTwoSizes | OtherSizes;
+    }
+    return PowerOfTwoSizes;
+}
+
+int
+FFT::nextFastSize(int n)
+{
+    if (n < 2) return 2;
+
+    // Beyond this the next power of two would overflow
+    if (n > (1 << 30)) {
+        std::cerr << "FFT::nextFastSize(" << n << "): maximum size is "
+                  << (1 << 30) << std::endl;
+#ifndef NO_EXCEPTIONS
+        throw InvalidSize;
+#else
+        abort();
+#endif
+    }
+
+    bool other = false;
+    if (m_implementation != "") {
+        other = (getSupportedSizes(m_implementation) & OtherSizes);
+    } else {
+        std::set<std::string> impls = getImplementations();
+        for (std::set<std::string>::const_iterator i = impls.begin();
+             i != impls.end(); ++i) {
+            if (getSupportedSizes(*i) & OtherSizes) other = true;
+        }
+    }
+
+    if (!other) {
+        int m = 2;
+        while (m < n) m <<= 1;
+        return m;
+    }
+
+    // Odd sizes are excluded as well as those with large factors,
+    // because real transforms of odd size are the slower kind in
+    // every implementation we support. KissFFT has this search
+    // already; without it, we do the same
+
+#ifdef HAVE_KISSFFT
+    return kiss_fftr_next_fast_size_real(n);
+#else
+    for (int m = n + (n % 2); ; m += 2) {
+        int r = m;
+        while (r % 2 == 0) r /= 2;
+        while (r % 3 == 0) r /= 3;
+        while (r % 5 == 0) r /= 5;
+        if (r == 1) return m;
+    }
+#endif
+}
+
+static FFTImpl *
+createNativeImplementation(std::string impl, int size)
+{
+    FFTImpl *d = 0;
+
+    if (impl == "ipp") {
+#ifdef HAVE_IPP
+        d = new FFTs::D_IPP(size);
+#endif
+    } else if (impl == "fftw") {
+#ifdef HAVE_FFTW3
+        d = new FFTs::D_FFTW(size);
+#endif
+    } else if (impl == "kissfft") {        
+#ifdef HAVE_KISSFFT
+        d = new FFTs::D_KISSFFT(size);
+#endif
+    } else if (impl == "vdsp") {
+#ifdef HAVE_VDSP
+        d = new FFTs::D_VDSP(size);
+#endif
+    } else if (impl == "medialib") {
+#ifdef HAVE_MEDIALIB
+        d = new FFTs::D_MEDIALIB(size);
+#endif
+    } else if (impl == "openmax") {
+#ifdef HAVE_OPENMAX
+        d = new FFTs::D_OPENMAX(size);
+#endif
+    } else if (impl == "sfft") {
+#ifdef HAVE_SFFT
+        d = new FFTs::D_SFFT(size);
+#endif
+    } else if (impl == "builtin") {
+#ifdef USE_BUILTIN_FFT
+        d = new FFTs::D_Builtin(size);
+#endif
+    } else if (impl == "cross") {
+#ifdef USE_BUILTIN_FFT
+        d = new FFTs::D_Cross(size);
+#endif
+    }
+
+    return d;
+}
+
+static FFTImpl *
+createImplementation(std::string impl, int size)
+{
+    if (!(size & (size-1)) ||
+        (FFT::getSupportedSizes(impl) & FFT::OtherSizes)) {
+        return createNativeImplementation(impl, size);
+    }
+    FFTImpl *inner = createNativeImplementation
+        (impl, FFTs::D_Bluestein::innerSize(size));
+    if (!inner) return 0;
+    return new FFTs::D_Bluestein(size, inner);
+}
+
+static FFT::Precisions
+nativePrecisions(std::string impl)
+{
+    FFTImpl *d = createNativeImplementation(impl, 2);
+    if (!d) return 0;
+    FFT::Precisions p = d->getSupportedPrecisions();
+    delete d;
+    return p;
+}
+
+/*
+ The tuning profile records the fastest implementation found for each
+ size and precision. Entries are keyed by the set of implementations
+ compiled in as well, so that builds with different sets can share a
+ profile file without using one another's results. Each line of the
+ file reads
+
+   <size> <d|f> <comma-separated candidates> <fastest>
+
+ The file is rewritten whenever a new entry is added, merging in any
+ entries that another process has written since we loaded it.
+*/
+
+typedef std::map<std::string, std::string> TuningProfile;
+
+static TuningProfile tuningProfile;
+static bool tuningProfileLoaded = false;
+
+// FFT objects choose their implementations on first use, possibly on
+// several threads at once. One lock covers the profile from loading
+// through to saving, and is held while tuning too, so that no two
+// threads time the same size and precision
+
+#ifndef NO_THREADING
+#ifdef _WIN32
+static HANDLE tuningMutex = 0;
+#else
+static pthread_mutex_t tuningMutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+#endif
+
+class TuningLock
+{
+public:
+    TuningLock() {
+#ifndef NO_THREADING
+#ifdef _WIN32
+        if (!tuningMutex) {
+            HANDLE h = CreateMutex(NULL, FALSE, NULL);
+            if (InterlockedCompareExchangePointer
+                ((PVOID volatile *)&tuningMutex, h, NULL) != NULL) {
+                CloseHandle(h);
+            }
+        }
+        WaitForSingleObject(tuningMutex, INFINITE);
+#else
+        pthread_mutex_lock(&tuningMutex);
+#endif
+#endif
+    }
+    ~TuningLock() {
+#ifndef NO_THREADING
+#ifdef _WIN32
+        ReleaseMutex(tuningMutex);
+#else
+        pthread_mutex_unlock(&tuningMutex);
+#endif
+#endif
+    }
+};
+
+static std::string
+tuningKey(int size, FFT::Precision precision)
+{
+    char prefix[32];
+    snprintf(prefix, 32, "%d %c ", size,
+             precision == FFT::SinglePrecision ? 'f' : 'd');
+    std::string key = prefix;
+    std::set<std::string> impls = FFT::getImplementations();
+    for (std::set<std::string>::const_iterator i = impls.begin();
+         i != impls.end(); ++i) {
+        if (i != impls.begin()) key += ",";
+        key += *i;
+    }
+    return key;
+}
+
+static bool
+tuningFile(std::string &fn)
+{
+    const char *home = getenv("HOME");
+    if (!home) return false;
+    fn = std::string(home) + "/.bqfft.tuning";
+    return true;
+}
+
+static void
+loadTuningProfile()
+{
+    tuningProfileLoaded = true;
+
+    std::string fn;
+    if (!tuningFile(fn)) return;
+
+    FILE *f = fopen(fn.c_str(), "r");
+    if (!f) return;
+
+    char line[512];
+    while (fgets(line, 512, f)) {
+        std::string entry(line);
+        while (!entry.empty() && (entry[entry.size()-1] == '\n' ||
+                                  entry[entry.size()-1] == '\r')) {
+            entry.erase(entry.size()-1);
+        }
+        std::string::size_type sp = entry.rfind(' ');
+        if (sp == std::string::npos) continue;
+        std::string key = entry.substr(0, sp);
+        if (tuningProfile.find(key) == tuningProfile.end()) {
+            tuningProfile[key] = entry.substr(sp + 1);
+        }
+    }
+
+    fclose(f);
+}
+
+// The profile is written to a temporary file alongside it and then
+// renamed over it, so that a reader in another process never sees it
+// half-written. The process id keeps temporary files apart; threads
+// within the process are kept apart by the tuning lock
+
+static void
+saveTuningProfile()
+{
+    loadTuningProfile();
+
+    std::string fn;
+    if (!tuningFile(fn)) return;
+
+    char pid[32];
+#ifdef _WIN32
+    snprintf(pid, 32, ".%d.tmp", int(_getpid()));
+#else
+    snprintf(pid, 32, ".%d.tmp", int(getpid()));
+#endif
+    std::string tmp = fn + pid;
+
+    FILE *f = fopen(tmp.c_str(), "w");
+    if (!f) return;
+
+    bool ok = true;
+    for (TuningProfile::const_iterator i = tuningProfile.begin();
+         i != tuningProfile.end(); ++i) {
+        if (fprintf(f, "%s %s\n", i->first.c_str(), i->second.c_str()) < 0) {
+            ok = false;
+        }
+    }
+
+    if (fclose(f) != 0) ok = false;
+
+#ifdef _WIN32
+    // rename() will not replace an existing file here
+    if (ok) ok = MoveFileExA(tmp.c_str(), fn.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    if (ok) ok = (rename(tmp.c_str(), fn.c_str()) == 0);
+#endif
+
+    if (!ok) remove(tmp.c_str());
+}
+
+static double
+tuningTime()
+{
+#ifdef _WIN32
+    LARGE_INTEGER t, freq;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&freq);
+    return double(t.QuadPart) / double(freq.QuadPart);
+#else
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+static double
+timeImplementation(FFTImpl *d, int size, FFT::Precision precision)
+{
+    // Time a forward and inverse transform pair, in batches that
+    // double in length until one takes long enough to time reliably
+    // (the short batches before that serve as warm-up). Return the
+    // best time per pair from three batches of that length
+
+    const int hs = size/2;
+
+    std::vector<double> din(size), dre(hs + 1), dim(hs + 1), dout(size);
+    std::vector<float> fin(size), fre(hs + 1), fim(hs + 1), fout(size);
+
+    for (int i = 0; i < size; ++i) {
+        din[i] = sin(i * 0.1) + 0.5 * cos(i * 1.3);
+        fin[i] = float(din[i]);
+    }
+
+    if (precision == FFT::SinglePrecision) d->initFloat();
+    else d->initDouble();
+
+    int iterations = 1;
+    double best = 0.0;
+
+    for (int run = 0; run < 3; ) {
+
+        double start = tuningTime();
+
+        for (int i = 0; i < iterations; ++i) {
+            if (precision == FFT::SinglePrecision) {
+                d->forward(&fin[0], &fre[0], &fim[0]);
+                d->inverse(&fre[0], &fim[0], &fout[0]);
+            } else {
+                d->forward(&din[0], &dre[0], &dim[0]);
+                d->inverse(&dre[0], &dim[0], &dout[0]);
+            }
+        }
+
+        double t = tuningTime() - start;
+
+        if (t < 0.002 && iterations < (1 << 20)) {
+            iterations *= 2;
+            continue;
+        }
+
+        t /= iterations;
+        if (run == 0 || t < best) best = t;
+        ++run;
+    }
+
+    return best;
+}
+
+// Time the implementations and record the fastest. The caller holds
+// the tuning lock
+
+static std::string
+tuneLocked(int size, FFT::Precision precision)
+{
+    std::set<std::string> impls = FFT::getImplementations();
+
+    // An implementation lacking the precision natively would convert
+    // to and from the other one, so only time those that have it,
+    // unless there are none
+
+    std::vector<std::string> candidates;
+    for (std::set<std::string>::const_iterator i = impls.begin();
+         i != impls.end(); ++i) {
+        if (nativePrecisions(*i) & precision) candidates.push_back(*i);
+    }
+    if (candidates.empty()) {
+        candidates = std::vector<std::string>(impls.begin(), impls.end());
+    }
+
+    std::string best;
+    double bestTime = 0.0;
+
+    for (int i = 0; i < (int)candidates.size(); ++i) {
+        FFTImpl *d = createImplementation(candidates[i], size);
+        if (!d) continue;
+        double t = timeImplementation(d, size, precision);
+        delete d;
+        if (best == "" || t < bestTime) {
+            best = candidates[i];
+            bestTime = t;
+        }
+    }
+
+    if (!tuningProfileLoaded) loadTuningProfile();
+    tuningProfile[tuningKey(size, precision)] = best;
+    saveTuningProfile();
+
+    return best;
+}
+
+std::string
+FFT::tune(int size, Precision precision)
+{
+    TuningLock lock;
+    return tuneLocked(size, precision);
+}
+
+// The profile entry for this size and precision, tuning first if
+// there is none. An entry naming an implementation we don't have
+// (from a hand-edited or damaged file) is replaced
+
+static std::string
+tunedImplementation(int size, FFT::Precision precision)
+{
+    TuningLock lock;
+
+    if (!tuningProfileLoaded) loadTuningProfile();
+
+    TuningProfile::const_iterator i =
+        tuningProfile.find(tuningKey(size, precision));
+    if (i != tuningProfile.end() &&
+        FFT::getImplementations().count(i->second)) {
+        return i->second;
+    }
+
+    return tuneLocked(size, precision);
+}
+
+static PolarAccuracy
+vectorPolarAccuracy(FFT::PolarAccuracy accuracy)
+{
+    switch (accuracy) {
+    case FFT::PrecisePolar: return PolarPrecise;
+    case FFT::FastPolar: return PolarFast;
+    default: return PolarExact;
+    }
+}
+
+FFT::FFT(int size, int debugLevel) :
+    d(0),
+    df(0),
+    m_size(size),
+    m_debugLevel(debugLevel),
+    m_polarAccuracy(ExactPolar),
+    m_realtime(false)
+{
+    if (size < 2) {
+        std::cerr << "FFT::FFT(" << size << "): minimum size is 2" << std::endl;
+#ifndef NO_EXCEPTIONS
+        throw InvalidSize;
+#else
+        abort();
+#endif
+    }
+
+    std::string impl = m_implementation;
+
+    if (impl == "") {
+        // Chosen separately for each precision, on first use: see
+        // initFloat and initDouble
+        if (debugLevel > 0) {
+            std::cerr << "FFT::FFT(" << size << "): implementation "
+                      << "will be chosen by tuning" << std::endl;
+        }
+        return;
+    }
+
+    if (debugLevel > 0) {
+        std::cerr << "FFT::FFT(" << size << "): using implementation: "
+                  << impl;
+        if (size & (size-1) && !(getSupportedSizes(impl) & OtherSizes)) {
+            std::cerr << " (via Bluestein)";
+        }
+        std::cerr << std::endl;
+    }
+
+    d = createImplementation(impl, size);
+
+    if (!d) {
+        std::cerr << "FFT::FFT(" << size << "): ERROR: implementation "
+                  << impl << " is not compiled in" << std::endl;
+#ifndef NO_EXCEPTIONS
+        throw InvalidImplementation;
+#else
+        abort();
+#endif
+    }
+
+    df = d;
+}
+
+FFT::~FFT()
+{
+    if (df != d) delete df;
+    delete d;
+}
+
+#ifndef NO_EXCEPTIONS
+#define CHECK_NOT_NULL(x) \
+    if (!(x)) { \
+        std::cerr << "FFT: ERROR: Null argument " #x << std::endl;  \
+        throw NullArgument; \
+    }
+#else
+#define CHECK_NOT_NULL(x) \
+    if (!(x)) { \
+        std::cerr << "FFT: ERROR: Null argument " #x << std::endl;  \
+        std::cerr << "FFT: Would be throwing NullArgument here, if exceptions were not disabled" << std::endl;  \
+        return; \
+    }
+#endif
+
+void
+FFT::forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(realOut);
+    CHECK_NOT_NULL(imagOut);
+    if (!d) initDouble();
+    d->forward(realIn, realOut, imagOut);
+}
+
+void
+FFT::forwardInterleaved(const double *BQ_R__ realIn, double *BQ_R__ complexOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(complexOut);
+    if (!d) initDouble();
+    d->forwardInterleaved(realIn, complexOut);
+}
+
+void
+FFT::forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    CHECK_NOT_NULL(phaseOut);
+    if (!d) initDouble();
+    d->forwardPolar(realIn, magOut, phaseOut);
+}
+
+void
+FFT::forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    if (!d) initDouble();
+    d->forwardMagnitude(realIn, magOut);
+}
+
+void
+FFT::forward(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(realOut);
+    CHECK_NOT_NULL(imagOut);
+    if (!df) initFloat();
+    df->forward(realIn, realOut, imagOut);
+}
+
+void
+FFT::forwardInterleaved(const float *BQ_R__ realIn, float *BQ_R__ complexOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(complexOut);
+    if (!df) initFloat();
+    df->forwardInterleaved(realIn, complexOut);
+}
+
+void
+FFT::forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    CHECK_NOT_NULL(phaseOut);
+    if (!df) initFloat();
+    df->forwardPolar(realIn, magOut, phaseOut);
+}
+
+void
+FFT::forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    if (!df) initFloat();
+    df->forwardMagnitude(realIn, magOut);
+}
+
+void
+FFT::inverse(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(imagIn);
+    CHECK_NOT_NULL(realOut);
+    if (!d) initDouble();
+    d->inverse(realIn, imagIn, realOut);
+}
+
+void
+FFT::inverseInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(complexIn);
+    CHECK_NOT_NULL(realOut);
+    if (!d) initDouble();
+    d->inverseInterleaved(complexIn, realOut);
+}
+
+void
+FFT::inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(magIn);
+    CHECK_NOT_NULL(phaseIn);
+    CHECK_NOT_NULL(realOut);
+    if (!d) initDouble();
+    d->inversePolar(magIn, phaseIn, realOut);
+}
+
+void
+FFT::inverseCepstral(const double *BQ_R__ magIn, double *BQ_R__ cepOut)
+{
+    CHECK_NOT_NULL(magIn);
+    CHECK_NOT_NULL(cepOut);
+    if (!d) initDouble();
+    d->inverseCepstral(magIn, cepOut);
+}
+
+void
+FFT::inverse(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(imagIn);
+    CHECK_NOT_NULL(realOut);
+    if (!df) initFloat();
+    df->inverse(realIn, imagIn, realOut);
+}
+
+void
+FFT::inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(complexIn);
+    CHECK_NOT_NULL(realOut);
+    if (!df) initFloat();
+    df->inverseInterleaved(complexIn, realOut);
+}
+
+void
+FFT::inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(magIn);
+    CHECK_NOT_NULL(phaseIn);
+    CHECK_NOT_NULL(realOut);
+    if (!df) initFloat();
+    df->inversePolar(magIn, phaseIn, realOut);
+}
+
+void
+FFT::inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut)
+{
+    CHECK_NOT_NULL(magIn);
+    CHECK_NOT_NULL(cepOut);
+    if (!df) initFloat();
+    df->inverseCepstral(magIn, cepOut);
+}
+
+// Conversions from the power spectra returned by FFTImpl::forwardPower,
+// in place
+
+template <typename T>
+static void powerToMagnitude(T *BQ_R__ data, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        data[i] = sqrt(data[i]);
+    }
+}
+
+template <typename T>
+static void powerToDecibels(T *BQ_R__ data, int count)
+{
+    const T floor = T(1e-20);
+    for (int i = 0; i < count; ++i) {
+        if (data[i] < floor) data[i] = floor;
+    }
+    v_log(data, count);
+    v_scale(data, T(10.0 / log(10.0)), count);
+}
+
+void
+FFT::forwardWindowed(const double *BQ_R__ realIn, const double *BQ_R__ window,
+                     double *BQ_R__ realOut, double *BQ_R__ imagOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(window);
+    CHECK_NOT_NULL(realOut);
+    CHECK_NOT_NULL(imagOut);
+    if (!d) initDouble();
+    d->forwardWindowed(realIn, window, realOut, imagOut);
+}
+
+void
+FFT::forwardWindowedMagnitude(const double *BQ_R__ realIn, const double *BQ_R__ window,
+                              double *BQ_R__ magOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(window);
+    CHECK_NOT_NULL(magOut);
+    if (!d) initDouble();
+    d->forwardPower(realIn, window, magOut);
+    powerToMagnitude(magOut, m_size/2 + 1);
+}
+
+void
+FFT::forwardPower(const double *BQ_R__ realIn, double *BQ_R__ powerOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(powerOut);
+    if (!d) initDouble();
+    d->forwardPower(realIn, 0, powerOut);
+}
+
+void
+FFT::forwardWindowedPower(const double *BQ_R__ realIn, const double *BQ_R__ window,
+                          double *BQ_R__ powerOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(window);
+    CHECK_NOT_NULL(powerOut);
+    if (!d) initDouble();
+    d->forwardPower(realIn, window, powerOut);
+}
+
+void
+FFT::forwardDecibels(const double *BQ_R__ realIn, double *BQ_R__ dbOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(dbOut);
+    if (!d) initDouble();
+    d->forwardPower(realIn, 0, dbOut);
+    powerToDecibels(dbOut, m_size/2 + 1);
+}
+
+void
+FFT::forwardWindowedDecibels(const double *BQ_R__ realIn, const double *BQ_R__ window,
+                             double *BQ_R__ dbOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(window);
+    CHECK_NOT_NULL(dbOut);
+    if (!d) initDouble();
+    d->forwardPower(realIn, window, dbOut);
+    powerToDecibels(dbOut, m_size/2 + 1);
+}
+
+void
+FFT::forwardWindowed(const float *BQ_R__ realIn, const float *BQ_R__ window,
+                     float *BQ_R__ realOut, float *BQ_R__ imagOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(window);
+    CHECK_NOT_NULL(realOut);
+    CHECK_NOT_NULL(imagOut);
+    if (!df) initFloat();
+    df->forwardWindowed(realIn, window, realOut, imagOut);
+}
+
+void
+FFT::forwardWindowedMagnitude(const float *BQ_R__ realIn, const float *BQ_R__ window,
+                              float *BQ_R__ magOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(window);
+    CHECK_NOT_NULL(magOut);
+    if (!df) initFloat();
+    df->forwardPower(realIn, window, magOut);
+    powerToMagnitude(magOut, m_size/2 + 1);
+}
+
+void
+FFT::forwardPower(const float *BQ_R__ realIn, float *BQ_R__ powerOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(powerOut);
+    if (!df) initFloat();
+    df->forwardPower(realIn, 0, powerOut);
 }
 
-FFT::~FFT()
+void
+FFT::forwardWindowedPower(const float *BQ_R__ realIn, const float *BQ_R__ window,
+                          float *BQ_R__ powerOut)
 {
-    delete d;
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(window);
+    CHECK_NOT_NULL(powerOut);
+    if (!df) initFloat();
+    df->forwardPower(realIn, window, powerOut);
+}
+
+void
+FFT::forwardDecibels(const float *BQ_R__ realIn, float *BQ_R__ dbOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(dbOut);
+    if (!df) initFloat();
+    df->forwardPower(realIn, 0, dbOut);
+    powerToDecibels(dbOut, m_size/2 + 1);
+}
+
+void
+FFT::forwardWindowedDecibels(const float *BQ_R__ realIn, const float *BQ_R__ window,
+                             float *BQ_R__ dbOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(window);
+    CHECK_NOT_NULL(dbOut);
+    if (!df) initFloat();
+    df->forwardPower(realIn, window, dbOut);
+    powerToDecibels(dbOut, m_size/2 + 1);
+}
+
+// Goertzel's algorithm, for bins first to first+count-1 of a real
+// transform of size n. Bins are taken four at a time, their
+// recurrences being independent so that they overlap in the
+// pipeline, accumulating in double whatever the input type. Results
+// go to re and im if they are non-null, and to mag and phase if those
+// are. A bin costs about a multiply-add per sample, so this is only
+// quicker than a full transform for a few bins: see
+// FFTImpl::getGoertzelLimit
+
+template <typename T>
+static void goertzel(const T *BQ_R__ in, int n, int first, int count,
+                     T *BQ_R__ re, T *BQ_R__ im,
+                     T *BQ_R__ mag, T *BQ_R__ phase)
+{
+    for (int k = 0; k < count; k += 4) {
+        const int bin = first + k;
+        const double c0 = 2.0 * cos(2.0 * M_PI * bin / n);
+        const double c1 = 2.0 * cos(2.0 * M_PI * (bin + 1) / n);
+        const double c2 = 2.0 * cos(2.0 * M_PI * (bin + 2) / n);
+        const double c3 = 2.0 * cos(2.0 * M_PI * (bin + 3) / n);
+        double a0 = 0.0, a1 = 0.0, a2 = 0.0, a3 = 0.0;
+        double b0 = 0.0, b1 = 0.0, b2 = 0.0, b3 = 0.0;
+        for (int j = 0; j < n; ++j) {
+            const double x = in[j];
+            const double t0 = x - b0 + c0 * a0; b0 = a0; a0 = t0;
+            const double t1 = x - b1 + c1 * a1; b1 = a1; a1 = t1;
+            const double t2 = x - b2 + c2 * a2; b2 = a2; a2 = t2;
+            const double t3 = x - b3 + c3 * a3; b3 = a3; a3 = t3;
+        }
+        const double a[] = { a0, a1, a2, a3 };
+        const double b[] = { b0, b1, b2, b3 };
+        for (int i = 0; i < 4 && k + i < count; ++i) {
+            const double w = 2.0 * M_PI * (bin + i) / n;
+            const double xr = cos(w) * a[i] - b[i];
+            double xi = sin(w) * a[i];
+            if (bin + i == 0 || (bin + i) * 2 == n) xi = 0.0;
+            if (re) {
+                re[k + i] = T(xr);
+                im[k + i] = T(xi);
+            }
+            if (mag) mag[k + i] = T(sqrt(xr * xr + xi * xi));
+            if (phase) phase[k + i] = T(atan2(xi, xr));
+        }
+    }
 }
 
 #ifndef NO_EXCEPTIONS
-#define CHECK_NOT_NULL(x) \
-    if (!(x)) { \
-        std::cerr << "FFT: ERROR: Null argument " #x << std::endl;  \
-        throw NullArgument; \
+#define CHECK_BINS(first, count) \
+    if ((first) < 0 || (count) < 0 || (first) + (count) > m_size/2 + 1) { \
+        std::cerr << "FFT: ERROR: Invalid bin range (first " << (first) \
+                  << ", count " << (count) << ")" << std::endl; \
+        throw InvalidSize; \
     }
 #else
-#define CHECK_NOT_NULL(x) \
-    if (!(x)) { \
-        std::cerr << "FFT: ERROR: Null argument " #x << std::endl;  \
-        std::cerr << "FFT: Would be throwing NullArgument here, if exceptions were not disabled" << std::endl;  \
+#define CHECK_BINS(first, count) \
+    if ((first) < 0 || (count) < 0 || (first) + (count) > m_size/2 + 1) { \
+        std::cerr << "FFT: ERROR: Invalid bin range (first " << (first) \
+                  << ", count " << (count) << ")" << std::endl; \
+        std::cerr << "FFT: Would be throwing InvalidSize here, if exceptions were not disabled" << std::endl;  \
         return; \
     }
 #endif
 
 void
-FFT::forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut)
+FFT::forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut,
+             int firstBin, int binCount)
 {
     CHECK_NOT_NULL(realIn);
     CHECK_NOT_NULL(realOut);
     CHECK_NOT_NULL(imagOut);
-    d->forward(realIn, realOut, imagOut);
+    CHECK_BINS(firstBin, binCount);
+    if (!d) initDouble();
+    if (binCount <= d->getGoertzelLimit()) {
+        goertzel(realIn, m_size, firstBin, binCount, realOut, imagOut,
+                 (double *)0, (double *)0);
+        return;
+    }
+    d->forwardBins(realIn, realOut, imagOut, firstBin, binCount);
 }
 
 void
-FFT::forwardInterleaved(const double *BQ_R__ realIn, double *BQ_R__ complexOut)
+FFT::forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut,
+                  int firstBin, int binCount)
 {
     CHECK_NOT_NULL(realIn);
-    CHECK_NOT_NULL(complexOut);
-    d->forwardInterleaved(realIn, complexOut);
+    CHECK_NOT_NULL(magOut);
+    CHECK_NOT_NULL(phaseOut);
+    CHECK_BINS(firstBin, binCount);
+    if (!d) initDouble();
+    if (binCount <= d->getGoertzelLimit()) {
+        goertzel(realIn, m_size, firstBin, binCount, (double *)0, (double *)0,
+                 magOut, phaseOut);
+        return;
+    }
+    d->forwardBinsPolar(realIn, magOut, phaseOut, firstBin, binCount);
 }
 
 void
-FFT::forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut)
+FFT::forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut,
+                      int firstBin, int binCount)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    CHECK_BINS(firstBin, binCount);
+    if (!d) initDouble();
+    if (binCount <= d->getGoertzelLimit()) {
+        goertzel(realIn, m_size, firstBin, binCount, (double *)0, (double *)0,
+                 magOut, (double *)0);
+        return;
+    }
+    d->forwardBinsMagnitude(realIn, magOut, firstBin, binCount);
+}
+
+void
+FFT::forward(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut,
+             int firstBin, int binCount)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(realOut);
+    CHECK_NOT_NULL(imagOut);
+    CHECK_BINS(firstBin, binCount);
+    if (!df) initFloat();
+    if (binCount <= df->getGoertzelLimit()) {
+        goertzel(realIn, m_size, firstBin, binCount, realOut, imagOut,
+                 (float *)0, (float *)0);
+        return;
+    }
+    df->forwardBins(realIn, realOut, imagOut, firstBin, binCount);
+}
+
+void
+FFT::forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut,
+                  int firstBin, int binCount)
 {
     CHECK_NOT_NULL(realIn);
     CHECK_NOT_NULL(magOut);
     CHECK_NOT_NULL(phaseOut);
-    d->forwardPolar(realIn, magOut, phaseOut);
+    CHECK_BINS(firstBin, binCount);
+    if (!df) initFloat();
+    if (binCount <= df->getGoertzelLimit()) {
+        goertzel(realIn, m_size, firstBin, binCount, (float *)0, (float *)0,
+                 magOut, phaseOut);
+        return;
+    }
+    df->forwardBinsPolar(realIn, magOut, phaseOut, firstBin, binCount);
 }
 
 void
-FFT::forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut)
+FFT::forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut,
+                      int firstBin, int binCount)
 {
     CHECK_NOT_NULL(realIn);
     CHECK_NOT_NULL(magOut);
-    d->forwardMagnitude(realIn, magOut);
+    CHECK_BINS(firstBin, binCount);
+    if (!df) initFloat();
+    if (binCount <= df->getGoertzelLimit()) {
+        goertzel(realIn, m_size, firstBin, binCount, (float *)0, (float *)0,
+                 magOut, (float *)0);
+        return;
+    }
+    df->forwardBinsMagnitude(realIn, magOut, firstBin, binCount);
 }
 
+#ifndef NO_EXCEPTIONS
+#define CHECK_PADDED(count) \
+    if ((count) < 0 || (count) > m_size) { \
+        std::cerr << "FFT: ERROR: Invalid input count " << (count) \
+                  << " for size " << m_size << std::endl; \
+        throw InvalidSize; \
+    }
+#else
+#define CHECK_PADDED(count) \
+    if ((count) < 0 || (count) > m_size) { \
+        std::cerr << "FFT: ERROR: Invalid input count " << (count) \
+                  << " for size " << m_size << std::endl; \
+        std::cerr << "FFT: Would be throwing InvalidSize here, if exceptions were not disabled" << std::endl;  \
+        return; \
+    }
+#endif
+
 void
-FFT::forward(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut)
+FFT::forwardPadded(const double *BQ_R__ realIn, int inCount,
+                   double *BQ_R__ realOut, double *BQ_R__ imagOut)
 {
     CHECK_NOT_NULL(realIn);
     CHECK_NOT_NULL(realOut);
     CHECK_NOT_NULL(imagOut);
-    d->forward(realIn, realOut, imagOut);
+    CHECK_PADDED(inCount);
+    if (!d) initDouble();
+    d->forwardPadded(realIn, inCount, realOut, imagOut);
 }
 
 void
-FFT::forwardInterleaved(const float *BQ_R__ realIn, float *BQ_R__ complexOut)
+FFT::forwardPadded(const float *BQ_R__ realIn, int inCount,
+                   float *BQ_R__ realOut, float *BQ_R__ imagOut)
 {
     CHECK_NOT_NULL(realIn);
-    CHECK_NOT_NULL(complexOut);
-    d->forwardInterleaved(realIn, complexOut);
+    CHECK_NOT_NULL(realOut);
+    CHECK_NOT_NULL(imagOut);
+    CHECK_PADDED(inCount);
+    if (!df) initFloat();
+    df->forwardPadded(realIn, inCount, realOut, imagOut);
 }
 
+#ifndef NO_EXCEPTIONS
+#define CHECK_BATCH(inStride, inMin, outStride, outMin, count) \
+    if ((count) < 0 || (inStride) < (inMin) || (outStride) < (outMin)) { \
+        std::cerr << "FFT: ERROR: Invalid batch (count " << (count) \
+                  << ", strides " << (inStride) << ", " << (outStride) \
+                  << ")" << std::endl;                                 \
+        throw InvalidSize; \
+    }
+#else
+#define CHECK_BATCH(inStride, inMin, outStride, outMin, count) \
+    if ((count) < 0 || (inStride) < (inMin) || (outStride) < (outMin)) { \
+        std::cerr << "FFT: ERROR: Invalid batch (count " << (count) \
+                  << ", strides " << (inStride) << ", " << (outStride) \
+                  << ")" << std::endl;                                 \
+        std::cerr << "FFT: Would be throwing InvalidSize here, if exceptions were not disabled" << std::endl;  \
+        return; \
+    }
+#endif
+
 void
-FFT::forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut)
+FFT::forwardMany(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut,
+                 int inStride, int outStride, int count)
 {
     CHECK_NOT_NULL(realIn);
-    CHECK_NOT_NULL(magOut);
-    CHECK_NOT_NULL(phaseOut);
-    d->forwardPolar(realIn, magOut, phaseOut);
+    CHECK_NOT_NULL(realOut);
+    CHECK_NOT_NULL(imagOut);
+    CHECK_BATCH(inStride, m_size, outStride, m_size/2 + 1, count);
+    if (!d) initDouble();
+    d->forwardMany(realIn, realOut, imagOut, inStride, outStride, count);
 }
 
 void
-FFT::forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut)
+FFT::forwardMany(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut,
+                 int inStride, int outStride, int count)
 {
     CHECK_NOT_NULL(realIn);
-    CHECK_NOT_NULL(magOut);
-    d->forwardMagnitude(realIn, magOut);
+    CHECK_NOT_NULL(realOut);
+    CHECK_NOT_NULL(imagOut);
+    CHECK_BATCH(inStride, m_size, outStride, m_size/2 + 1, count);
+    if (!df) initFloat();
+    df->forwardMany(realIn, realOut, imagOut, inStride, outStride, count);
 }
 
 void
-FFT::inverse(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut)
+FFT::inverseMany(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut,
+                 int inStride, int outStride, int count)
 {
     CHECK_NOT_NULL(realIn);
     CHECK_NOT_NULL(imagIn);
     CHECK_NOT_NULL(realOut);
-    d->inverse(realIn, imagIn, realOut);
+    CHECK_BATCH(inStride, m_size/2 + 1, outStride, m_size, count);
+    if (!d) initDouble();
+    d->inverseMany(realIn, imagIn, realOut, inStride, outStride, count);
 }
 
 void
-FFT::inverseInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ realOut)
+FFT::inverseMany(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut,
+                 int inStride, int outStride, int count)
 {
-    CHECK_NOT_NULL(complexIn);
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(imagIn);
     CHECK_NOT_NULL(realOut);
-    d->inverseInterleaved(complexIn, realOut);
+    CHECK_BATCH(inStride, m_size/2 + 1, outStride, m_size, count);
+    if (!df) initFloat();
+    df->inverseMany(realIn, imagIn, realOut, inStride, outStride, count);
 }
 
 void
-FFT::inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut)
+FFT::forwardComplex(const double *BQ_R__ realIn, const double *BQ_R__ imagIn,
+                    double *BQ_R__ realOut, double *BQ_R__ imagOut)
 {
-    CHECK_NOT_NULL(magIn);
-    CHECK_NOT_NULL(phaseIn);
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(imagIn);
     CHECK_NOT_NULL(realOut);
-    d->inversePolar(magIn, phaseIn, realOut);
+    CHECK_NOT_NULL(imagOut);
+    if (!d) initDouble();
+    d->initDoubleComplex(m_size);
+    d->forwardComplex(realIn, imagIn, realOut, imagOut);
 }
 
 void
-FFT::inverseCepstral(const double *BQ_R__ magIn, double *BQ_R__ cepOut)
+FFT::forwardComplexInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ complexOut)
 {
-    CHECK_NOT_NULL(magIn);
-    CHECK_NOT_NULL(cepOut);
-    d->inverseCepstral(magIn, cepOut);
+    CHECK_NOT_NULL(complexIn);
+    CHECK_NOT_NULL(complexOut);
+    if (!d) initDouble();
+    d->initDoubleComplex(m_size);
+    d->forwardComplexInterleaved(complexIn, complexOut);
 }
 
 void
-FFT::inverse(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut)
+FFT::inverseComplex(const double *BQ_R__ realIn, const double *BQ_R__ imagIn,
+                    double *BQ_R__ realOut, double *BQ_R__ imagOut)
 {
     CHECK_NOT_NULL(realIn);
     CHECK_NOT_NULL(imagIn);
     CHECK_NOT_NULL(realOut);
-    d->inverse(realIn, imagIn, realOut);
+    CHECK_NOT_NULL(imagOut);
+    if (!d) initDouble();
+    d->initDoubleComplex(m_size);
+    d->inverseComplex(realIn, imagIn, realOut, imagOut);
 }
 
 void
-FFT::inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut)
+FFT::inverseComplexInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ complexOut)
 {
     CHECK_NOT_NULL(complexIn);
+    CHECK_NOT_NULL(complexOut);
+    if (!d) initDouble();
+    d->initDoubleComplex(m_size);
+    d->inverseComplexInterleaved(complexIn, complexOut);
+}
+
+void
+FFT::forwardComplex(const float *BQ_R__ realIn, const float *BQ_R__ imagIn,
+                    float *BQ_R__ realOut, float *BQ_R__ imagOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(imagIn);
     CHECK_NOT_NULL(realOut);
-    d->inverseInterleaved(complexIn, realOut);
+    CHECK_NOT_NULL(imagOut);
+    if (!df) initFloat();
+    df->initFloatComplex(m_size);
+    df->forwardComplex(realIn, imagIn, realOut, imagOut);
 }
 
 void
-FFT::inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut)
+FFT::forwardComplexInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ complexOut)
 {
-    CHECK_NOT_NULL(magIn);
-    CHECK_NOT_NULL(phaseIn);
+    CHECK_NOT_NULL(complexIn);
+    CHECK_NOT_NULL(complexOut);
+    if (!df) initFloat();
+    df->initFloatComplex(m_size);
+    df->forwardComplexInterleaved(complexIn, complexOut);
+}
+
+void
+FFT::inverseComplex(const float *BQ_R__ realIn, const float *BQ_R__ imagIn,
+                    float *BQ_R__ realOut, float *BQ_R__ imagOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(imagIn);
     CHECK_NOT_NULL(realOut);
-    d->inversePolar(magIn, phaseIn, realOut);
+    CHECK_NOT_NULL(imagOut);
+    if (!df) initFloat();
+    df->initFloatComplex(m_size);
+    df->inverseComplex(realIn, imagIn, realOut, imagOut);
 }
 
 void
-FFT::inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut)
+FFT::inverseComplexInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ complexOut)
 {
-    CHECK_NOT_NULL(magIn);
-    CHECK_NOT_NULL(cepOut);
-    d->inverseCepstral(magIn, cepOut);
+    CHECK_NOT_NULL(complexIn);
+    CHECK_NOT_NULL(complexOut);
+    if (!df) initFloat();
+    df->initFloatComplex(m_size);
+    df->inverseComplexInterleaved(complexIn, complexOut);
 }
 
 void
 FFT::initFloat() 
 {
-    d->initFloat();
+    if (!df) {
+        if (m_realtime) realtimeViolation("setup");
+        std::string impl = tunedImplementation(m_size, SinglePrecision);
+        if (m_debugLevel > 0) {
+            std::cerr << "FFT::initFloat: size " << m_size
+                      << ": using implementation: " << impl << std::endl;
+        }
+        df = createImplementation(impl, m_size);
+        if (!df) {
+            std::cerr << "FFT::initFloat: size " << m_size << ": ERROR: "
+                      << "implementation \"" << impl
+                      << "\" is not available" << std::endl;
+#ifndef NO_EXCEPTIONS
+            throw InvalidImplementation;
+#else
+            abort();
+#endif
+        }
+        df->setPolarAccuracy(vectorPolarAccuracy(m_polarAccuracy));
+    }
+    df->initFloat();
+    df->initFloatSpectra(m_size);
 }
 
 void
 FFT::initDouble() 
 {
+    if (!d) {
+        if (m_realtime) realtimeViolation("setup");
+        std::string impl = tunedImplementation(m_size, DoublePrecision);
+        if (m_debugLevel > 0) {
+            std::cerr << "FFT::initDouble: size " << m_size
+                      << ": using implementation: " << impl << std::endl;
+        }
+        d = createImplementation(impl, m_size);
+        if (!d) {
+            std::cerr << "FFT::initDouble: size " << m_size << ": ERROR: "
+                      << "implementation \"" << impl
+                      << "\" is not available" << std::endl;
+#ifndef NO_EXCEPTIONS
+            throw InvalidImplementation;
+#else
+            abort();
+#endif
+        }
+        d->setPolarAccuracy(vectorPolarAccuracy(m_polarAccuracy));
+    }
     d->initDouble();
+    d->initDoubleSpectra(m_size);
 }
 
-FFT::Precisions
-FFT::getSupportedPrecisions() const
+void
+FFT::initFloatComplex()
 {
-    return d->getSupportedPrecisions();
+    initFloat();
+    df->initFloatComplex(m_size);
 }
 
-#ifdef FFT_MEASUREMENT
-
-std::string
-FFT::tune()
+void
+FFT::initDoubleComplex()
 {
-    std::ostringstream os;
-    os << "FFT::tune()..." << std::endl;
-
-    std::vector<int> sizes;
-    std::map<FFTImpl *, int> candidates;
-    std::map<int, int> wins;
-
-    sizes.push_back(512);
-    sizes.push_back(1024);
-    sizes.push_back(4096);
-    
-    for (unsigned int si = 0; si < sizes.size(); ++si) {
-
-        int size = sizes[si];
-
-        while (!candidates.empty()) {
-            delete candidates.begin()->first;
-            candidates.erase(candidates.begin());
-        }
-
-        FFTImpl *d;
-        
-#ifdef HAVE_IPP
-        std::cerr << "Constructing new IPP FFT object for size " << size << "..." << std::endl;
-        d = new FFTs::D_IPP(size);
-        d->initFloat();
-        d->initDouble();
-        candidates[d] = 0;
-#endif
-        
-#ifdef HAVE_FFTW3
-        os << "Constructing new FFTW3 FFT object for size " << size << "..." << std::endl;
-        d = new FFTs::D_FFTW(size);
-        d->initFloat();
-        d->initDouble();
-        candidates[d] = 1;
-#endif
-
-#ifdef HAVE_KISSFFT
-        os << "Constructing new KISSFFT object for size " << size << "..." << std::endl;
-        d = new FFTs::D_KISSFFT(size);
-        d->initFloat();
-        d->initDouble();
-        candidates[d] = 2;
-#endif        
-
-#ifdef USE_BUILTIN_FFT
-        os << "Constructing new Cross FFT object for size " << size << "..." << std::endl;
-        d = new FFTs::D_Cross(size);
-        d->initFloat();
-        d->initDouble();
-        candidates[d] = 3;
-#endif
-        
-#ifdef HAVE_VDSP
-        os << "Constructing new vDSP FFT object for size " << size << "..." << std::endl;
-        d = new FFTs::D_VDSP(size);
-        d->initFloat();
-        d->initDouble();
-        candidates[d] = 4;
-#endif
-        
-#ifdef HAVE_MEDIALIB
-        std::cerr << "Constructing new MediaLib FFT object for size " << size << "..." << std::endl;
-        d = new FFTs::D_MEDIALIB(size);
-        d->initFloat();
-        d->initDouble();
-        candidates[d] = 5;
-#endif
-        
-#ifdef HAVE_OPENMAX
-        os << "Constructing new OpenMAX FFT object for size " << size << "..." << std::endl;
-        d = new FFTs::D_OPENMAX(size);
-        d->initFloat();
-        d->initDouble();
-        candidates[d] = 6;
-#endif
-        
-#ifdef HAVE_SFFT
-        os << "Constructing new SFFT FFT object for size " << size << "..." << std::endl;
-        d = new FFTs::D_SFFT(size);
-//        d->initFloat();
-        d->initDouble();
-        candidates[d] = 6;
-#endif
-
-        os << "CLOCKS_PER_SEC = " << CLOCKS_PER_SEC << std::endl;
-        float divisor = float(CLOCKS_PER_SEC) / 1000.f;
-        
-        os << "Timing order is: ";
-        for (std::map<FFTImpl *, int>::iterator ci = candidates.begin();
-             ci != candidates.end(); ++ci) {
-            os << ci->second << " ";
-        }
-        os << std::endl;
-
-        int iterations = 500;
-        os << "Iterations: " << iterations << std::endl;
-
-        double *da = new double[size];
-        double *db = new double[size];
-        double *dc = new double[size];
-        double *dd = new double[size];
-        double *di = new double[size + 2];
-        double *dj = new double[size + 2];
-
-        float *fa = new float[size];
-        float *fb = new float[size];
-        float *fc = new float[size];
-        float *fd = new float[size];
-        float *fi = new float[size + 2];
-        float *fj = new float[size + 2];
-
-        for (int type = 0; type < 16; ++type) {
-    
-            //!!!
-            if ((type > 3 && type < 8) ||
-                (type > 11)) {
-                continue;
-            }
-
-            if (type > 7) {
-                // inverse transform: bigger inputs, to simulate the
-                // fact that the forward transform is unscaled
-                for (int i = 0; i < size; ++i) {
-                    da[i] = drand48() * size;
-                    fa[i] = da[i];
-                    db[i] = drand48() * size;
-                    fb[i] = db[i];
-                }
-            } else {    
-                for (int i = 0; i < size; ++i) {
-                    da[i] = drand48();
-                    fa[i] = da[i];
-                    db[i] = drand48();
-                    fb[i] = db[i];
-                }
-            }
-                
-            for (int i = 0; i < size + 2; ++i) {
-                di[i] = drand48();
-                fi[i] = di[i];
-            }
-
-            int low = -1;
-            int lowscore = 0;
-
-            const char *names[] = {
-
-                "Forward Cartesian Double",
-                "Forward Interleaved Double",
-                "Forward Polar Double",
-                "Forward Magnitude Double",
-                "Forward Cartesian Float",
-                "Forward Interleaved Float",
-                "Forward Polar Float",
-                "Forward Magnitude Float",
-
-                "Inverse Cartesian Double",
-                "Inverse Interleaved Double",
-                "Inverse Polar Double",
-                "Inverse Cepstral Double",
-                "Inverse Cartesian Float",
-                "Inverse Interleaved Float",
-                "Inverse Polar Float",
-                "Inverse Cepstral Float"
-            };
-            os << names[type] << " :: ";
-
-            for (std::map<FFTImpl *, int>::iterator ci = candidates.begin();
-                 ci != candidates.end(); ++ci) {
-
-                FFTImpl *d = ci->first;
-
-                double mean = 0;
-
-                clock_t start = clock();
-                
-                for (int i = 0; i < iterations; ++i) {
-
-                    if (i == 0) {
-                        for (int j = 0; j < size; ++j) {
-                            dc[j] = 0;
-                            dd[j] = 0;
-                            fc[j] = 0;
-                            fd[j] = 0;
-                            fj[j] = 0;
-                            dj[j] = 0;
-                        }
-                    }
-
-                    switch (type) {
-                    case 0: d->forward(da, dc, dd); break;
-                    case 1: d->forwardInterleaved(da, dj); break;
-                    case 2: d->forwardPolar(da, dc, dd); break;
-                    case 3: d->forwardMagnitude(da, dc); break;
-                    case 4: d->forward(fa, fc, fd); break;
-                    case 5: d->forwardInterleaved(fa, fj); break;
-                    case 6: d->forwardPolar(fa, fc, fd); break;
-                    case 7: d->forwardMagnitude(fa, fc); break;
-                    case 8: d->inverse(da, db, dc); break;
-                    case 9: d->inverseInterleaved(di, dc); break;
-                    case 10: d->inversePolar(da, db, dc); break;
-                    case 11: d->inverseCepstral(da, dc); break;
-                    case 12: d->inverse(fa, fb, fc); break;
-                    case 13: d->inverseInterleaved(fi, fc); break;
-                    case 14: d->inversePolar(fa, fb, fc); break;
-                    case 15: d->inverseCepstral(fa, fc); break;
-                    }
-
-                    if (i == 0) {
-                        mean = 0;
-                        for (int j = 0; j < size; ++j) {
-                            mean += dc[j];
-                            mean += dd[j];
-                            mean += fc[j];
-                            mean += fd[j];
-                            mean += fj[j];
-                            mean += dj[j];
-                        }
-                        mean /= size * 6;
-                    }
-                }
+    initDouble();
+    d->initDoubleComplex(m_size);
+}
 
-                clock_t end = clock();
+void
+FFT::setPolarAccuracy(PolarAccuracy accuracy)
+{
+    m_polarAccuracy = accuracy;
+    if (d) d->setPolarAccuracy(vectorPolarAccuracy(accuracy));
+    if (df && df != d) df->setPolarAccuracy(vectorPolarAccuracy(accuracy));
+}
 
-                os << float(end - start)/divisor << " (" << mean << ") ";
+FFT::PolarAccuracy
+FFT::getPolarAccuracy() const
+{
+    return m_polarAccuracy;
+}
 
-                if (low == -1 || (end - start) < lowscore) {
-                    low = ci->second;
-                    lowscore = end - start;
-                }
-            }
+void
+FFT::setRealtime(bool realtime)
+{
+    m_realtime = realtime;
+    if (d) d->setRealtime(realtime);
+    if (df && df != d) df->setRealtime(realtime);
+}
 
-            os << std::endl;
+bool
+FFT::getRealtime() const
+{
+    return m_realtime;
+}
 
-            os << "  size " << size << ", type " << type << ": fastest is " << low << " (time " << float(lowscore)/divisor << ")" << std::endl;
+int
+FFT::getAllocationCount() const
+{
+    int n = 0;
+    if (d) n += d->getAllocationCount();
+    if (df && df != d) n += df->getAllocationCount();
+    return n;
+}
 
-            wins[low]++;
-        }
-        
-        delete[] fa;
-        delete[] fb;
-        delete[] fc;
-        delete[] fd;
-        delete[] da;
-        delete[] db;
-        delete[] dc;
-        delete[] dd;
-    }
+int
+FFT::getLockCount() const
+{
+    int n = 0;
+    if (d) n += d->getLockCount();
+    if (df && df != d) n += df->getLockCount();
+    return n;
+}
 
-    while (!candidates.empty()) {
-        delete candidates.begin()->first;
-        candidates.erase(candidates.begin());
-    }
+void
+FFT::resetCounts()
+{
+    if (d) d->resetCounts();
+    if (df && df != d) df->resetCounts();
+}
 
-    int bestscore = 0;
-    int best = -1;
+FFT::Precisions
+FFT::getSupportedPrecisions() const
+{
+    if (d && d == df) return d->getSupportedPrecisions();
 
-    for (std::map<int, int>::iterator wi = wins.begin(); wi != wins.end(); ++wi) {
-        if (best == -1 || wi->second > bestscore) {
-            best = wi->first;
-            bestscore = wi->second;
-        }
+    // Tuned: each precision is timed only among the implementations
+    // that have it, if any do
+    Precisions p = 0;
+    std::set<std::string> impls = getImplementations();
+    for (std::set<std::string>::const_iterator i = impls.begin();
+         i != impls.end(); ++i) {
+        p |= nativePrecisions(*i);
     }
-
-    os << "overall winner is " << best << " with " << bestscore << " wins" << std::endl;
-
-    return os.str();
+    return p;
 }
 
-#endif
 
 }
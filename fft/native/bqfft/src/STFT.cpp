@@ -0,0 +1,345 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    bqfft
+
+    A small library wrapping various FFT implementations for some
+    common audio processing use cases.
+
+    Copyright 2007-2015 Particular Programs Ltd.
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of Chris Cannam and
+    Particular Programs Ltd shall not be used in advertising or
+    otherwise to promote the sale, use or other dealings in this
+    Software without prior written authorization.
+*/
+
+#include "bqfft/STFT.h"
+
+#include <bqvec/Allocators.h>
+#include <bqvec/VectorOps.h>
+#include <bqvec/VectorOpsComplex.h>
+
+#include <cmath>
+#include <iostream>
+#include <cstdlib>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace breakfastquay {
+
+STFT::STFT(int fftSize, int hop, WindowType window,
+           int batchSize, int bufferSize) :
+    m_fftSize(fftSize),
+    m_hop(hop),
+    m_bins(fftSize/2 + 1),
+    m_batchSize(batchSize),
+    m_fft(fftSize),
+    m_window(0),
+    m_scale(0),
+    m_frames(0),
+    m_re(0),
+    m_im(0),
+    m_accumulator(0),
+    m_input(0),
+    m_output(0)
+{
+    if (hop < 1 || hop > fftSize || batchSize < 1) {
+        std::cerr << "STFT::STFT(" << fftSize << ", " << hop << "): "
+                  << "hop must be between 1 and the FFT size, and batch "
+                  << "size at least 1" << std::endl;
+#ifndef NO_EXCEPTIONS
+        throw FFT::InvalidSize;
+#else
+        abort();
+#endif
+    }
+
+    if (bufferSize <= 0) {
+        bufferSize = fftSize + batchSize * hop;
+    }
+
+    m_window = allocate<float>(m_fftSize);
+    m_scale = allocate<float>(m_hop);
+    m_frames = allocate_and_zero<float>(m_batchSize * m_fftSize);
+    m_re = allocate_and_zero<float>(m_batchSize * m_bins);
+    m_im = allocate_and_zero<float>(m_batchSize * m_bins);
+    m_accumulator = allocate_and_zero<float>(m_fftSize);
+    m_input = new RingBuffer<float>(bufferSize);
+    m_output = new RingBuffer<float>(bufferSize);
+
+    // Periodic rather than symmetric windows, as those are the ones
+    // that overlap-add to a constant at the usual hops
+
+    for (int i = 0; i < m_fftSize; ++i) {
+        double phase = (2.0 * M_PI * i) / m_fftSize;
+        double w = 1.0;
+        switch (window) {
+        case RectangularWindow:
+            break;
+        case HannWindow:
+            w = 0.5 - 0.5 * cos(phase);
+            break;
+        case HammingWindow:
+            w = 0.54 - 0.46 * cos(phase);
+            break;
+        case BlackmanWindow:
+            w = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2.0 * phase);
+            break;
+        }
+        m_window[i] = float(w);
+    }
+
+    // The window is applied twice, on analysis and on synthesis, and
+    // the inverse transform is unscaled. Rather than rely on the
+    // window's squares summing to a constant at this hop, compensate
+    // for their actual sum at each position within the hop
+
+    for (int i = 0; i < m_hop; ++i) {
+        double sum = 0.0;
+        for (int j = i; j < m_fftSize; j += m_hop) {
+            sum += double(m_window[j]) * double(m_window[j]);
+        }
+        if (sum > 1e-6) {
+            m_scale[i] = float(1.0 / (sum * m_fftSize));
+        } else {
+            m_scale[i] = 0.f;
+        }
+    }
+
+    // Set up the FFT for the batch size now, as some implementations
+    // would otherwise allocate on the first batch call
+
+    m_fft.initFloat();
+    m_fft.forwardMany(m_frames, m_re, m_im, m_fftSize, m_bins, m_batchSize);
+    m_fft.inverseMany(m_re, m_im, m_frames, m_bins, m_fftSize, m_batchSize);
+    v_zero(m_frames, m_batchSize * m_fftSize);
+}
+
+STFT::~STFT()
+{
+    delete m_input;
+    delete m_output;
+    deallocate(m_window);
+    deallocate(m_scale);
+    deallocate(m_frames);
+    deallocate(m_re);
+    deallocate(m_im);
+    deallocate(m_accumulator);
+}
+
+int
+STFT::write(const float *BQ_R__ input, int n)
+{
+    return m_input->write(input, n);
+}
+
+int
+STFT::getWriteSpace() const
+{
+    return m_input->getWriteSpace();
+}
+
+int
+STFT::getAvailableFrames() const
+{
+    int available = m_input->getReadSpace();
+    if (available < m_fftSize) return 0;
+    return (available - m_fftSize) / m_hop + 1;
+}
+
+int
+STFT::gather(RingBuffer<float> &input, int maxFrames)
+{
+    // Fill m_frames with up to one batch of windowed frames, windowing
+    // straight from the ring buffer's storage
+
+    int count = 0;
+    const float *region1 = 0, *region2 = 0;
+    int count1 = 0, count2 = 0;
+
+    while (count < maxFrames && count < m_batchSize &&
+           input.getReadRegions(m_fftSize, region1, count1,
+                                region2, count2) == m_fftSize) {
+        float *frame = m_frames + count * m_fftSize;
+        v_multiply(frame, region1, m_window, count1);
+        v_multiply(frame + count1, region2, m_window + count1, count2);
+        input.commitRead(m_hop);
+        ++count;
+    }
+
+    return count;
+}
+
+int
+STFT::analyse(float *BQ_R__ realOut, float *BQ_R__ imagOut, int maxFrames)
+{
+    return analyse(*m_input, realOut, imagOut, maxFrames);
+}
+
+int
+STFT::analyse(RingBuffer<float> &input,
+              float *BQ_R__ realOut, float *BQ_R__ imagOut, int maxFrames)
+{
+    int done = 0;
+
+    while (done < maxFrames) {
+        int count = gather(input, maxFrames - done);
+        if (count == 0) break;
+        m_fft.forwardMany(m_frames,
+                          realOut + done * m_bins, imagOut + done * m_bins,
+                          m_fftSize, m_bins, count);
+        done += count;
+    }
+
+    return done;
+}
+
+int
+STFT::analysePolar(float *BQ_R__ magOut, float *BQ_R__ phaseOut, int maxFrames)
+{
+    return analysePolar(*m_input, magOut, phaseOut, maxFrames);
+}
+
+int
+STFT::analysePolar(RingBuffer<float> &input,
+                   float *BQ_R__ magOut, float *BQ_R__ phaseOut, int maxFrames)
+{
+    int done = 0;
+
+    while (done < maxFrames) {
+        int count = gather(input, maxFrames - done);
+        if (count == 0) break;
+        m_fft.forwardMany(m_frames, m_re, m_im, m_fftSize, m_bins, count);
+        v_cartesian_to_polar(magOut + done * m_bins, phaseOut + done * m_bins,
+                             m_re, m_im, count * m_bins);
+        done += count;
+    }
+
+    return done;
+}
+
+int
+STFT::overlapAdd(const float *BQ_R__ realIn, const float *BQ_R__ imagIn,
+                 int count, RingBuffer<float> &output)
+{
+    // Resynthesise up to one batch of frames from the given spectra,
+    // as far as there is room in the output
+
+    int space = output.getWriteSpace() / m_hop;
+    if (count > space) count = space;
+    if (count > m_batchSize) count = m_batchSize;
+    if (count <= 0) return 0;
+
+    m_fft.inverseMany(realIn, imagIn, m_frames, m_bins, m_fftSize, count);
+
+    float *region1 = 0, *region2 = 0;
+    int count1 = 0, count2 = 0;
+
+    for (int i = 0; i < count; ++i) {
+        float *frame = m_frames + i * m_fftSize;
+        v_multiply(frame, m_window, m_fftSize);
+        v_add(m_accumulator, frame, m_fftSize);
+        // Scale the completed hop straight into the output's storage
+        output.getWriteRegions(m_hop, region1, count1, region2, count2);
+        v_multiply(region1, m_accumulator, m_scale, count1);
+        v_multiply(region2, m_accumulator + count1, m_scale + count1, count2);
+        output.commitWrite(m_hop);
+        v_move(m_accumulator, m_accumulator + m_hop, m_fftSize - m_hop);
+        v_zero(m_accumulator + m_fftSize - m_hop, m_hop);
+    }
+
+    return count;
+}
+
+int
+STFT::synthesise(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, int count)
+{
+    return synthesise(realIn, imagIn, count, *m_output);
+}
+
+int
+STFT::synthesise(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, int count,
+                 RingBuffer<float> &output)
+{
+    int done = 0;
+
+    while (done < count) {
+        int n = overlapAdd(realIn + done * m_bins, imagIn + done * m_bins,
+                           count - done, output);
+        if (n == 0) break;
+        done += n;
+    }
+
+    return done;
+}
+
+int
+STFT::synthesisePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, int count)
+{
+    return synthesisePolar(magIn, phaseIn, count, *m_output);
+}
+
+int
+STFT::synthesisePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, int count,
+                      RingBuffer<float> &output)
+{
+    int done = 0;
+
+    while (done < count) {
+        int n = count - done;
+        if (n > m_batchSize) n = m_batchSize;
+        int space = output.getWriteSpace() / m_hop;
+        if (n > space) n = space;
+        if (n <= 0) break;
+        v_polar_to_cartesian(m_re, m_im,
+                             magIn + done * m_bins, phaseIn + done * m_bins,
+                             n * m_bins);
+        done += overlapAdd(m_re, m_im, n, output);
+    }
+
+    return done;
+}
+
+int
+STFT::getOutputAvailable() const
+{
+    return m_output->getReadSpace();
+}
+
+int
+STFT::read(float *BQ_R__ output, int n)
+{
+    return m_output->read(output, n);
+}
+
+void
+STFT::reset()
+{
+    m_input->reset();
+    m_output->reset();
+    v_zero(m_accumulator, m_fftSize);
+}
+
+}
@@ -37,9 +37,13 @@
 #define TEST_FFT_H
 
 #include "bqfft/FFT.h"
+#include "bqfft/STFT.h"
+
+#include <bqvec/Allocators.h>
 
 #include <QObject>
 #include <QtTest>
+#include <QTemporaryDir>
 
 #include <cstdio>
 
@@ -47,6 +51,31 @@
 
 namespace breakfastquay {
 
+// Points HOME at a temporary directory for as long as it exists, so
+// that tuning doesn't write to the user's own profile
+
+class TemporaryHome
+{
+public:
+    TemporaryHome() :
+        m_hadHome(qEnvironmentVariableIsSet("HOME")),
+        m_home(qgetenv("HOME")) {
+        if (m_dir.isValid()) {
+            qputenv("HOME", m_dir.path().toLocal8Bit());
+        }
+    }
+    ~TemporaryHome() {
+        if (m_hadHome) qputenv("HOME", m_home);
+        else qunsetenv("HOME");
+    }
+    bool isValid() const { return m_dir.isValid(); }
+
+private:
+    QTemporaryDir m_dir;
+    bool m_hadHome;
+    QByteArray m_home;
+};
+
 class TestFFT : public QObject
 {
     Q_OBJECT
@@ -273,6 +302,573 @@ private slots:
 	QCOMPARE(out[5], 999.0);
     }
 
+    void many() {
+        ifetch();
+	// DC, sine, cosine and Nyquist frames, with padding between
+	// them to check that the strides are respected
+	double in[] = { 1, 1, 1, 1, 999,
+		      0, 1, 0, -1, 999,
+		      1, 0, -1, 0, 999,
+		      1, -1, 1, -1, 999 };
+	double re[16], im[16];
+	for (int i = 0; i < 16; ++i) re[i] = im[i] = 999;
+	FFT fft(4);
+	fft.forwardMany(in, re, im, 5, 4, 4);
+	for (int f = 0; f < 4; ++f) {
+	    double fre[3], fim[3];
+	    fft.forward(in + f*5, fre, fim);
+	    for (int i = 0; i < 3; ++i) {
+		COMPARE_FUZZIER(re[f*4 + i], fre[i]);
+		COMPARE_FUZZIER(im[f*4 + i], fim[i]);
+	    }
+	    QCOMPARE(re[f*4 + 3], 999.0);
+	    QCOMPARE(im[f*4 + 3], 999.0);
+	}
+	double back[20];
+	for (int i = 0; i < 20; ++i) back[i] = 999;
+	fft.inverseMany(re, im, back, 4, 5, 4);
+	for (int f = 0; f < 4; ++f) {
+	    for (int i = 0; i < 4; ++i) {
+		COMPARE_FUZZIER(back[f*5 + i] / 4, in[f*5 + i]);
+	    }
+	    QCOMPARE(back[f*5 + 4], 999.0);
+	}
+    }
+
+    void alignment() {
+        ifetch();
+	// Implementations may take different paths depending on
+	// whether the caller's buffers are aligned, so check that an
+	// aligned and a misaligned set give the same results
+	const int n = 16;
+	double *a = allocate_and_zero<double>(n * 4 + 4);
+	double *b = allocate_and_zero<double>(n * 4 + 4);
+	for (int i = 0; i < n; ++i) {
+	    a[i] = b[i+1] = double(sin(i * 0.7) + cos(i * 0.2));
+	}
+	FFT fft(n);
+	fft.forward(a, a + n, a + n*2);
+	fft.forward(b + 1, b + n + 1, b + n*2 + 1);
+	for (int i = 0; i <= n/2; ++i) {
+	    COMPARE_FUZZIER(a[n + i], b[n + i + 1]);
+	    COMPARE_FUZZIER(a[n*2 + i], b[n*2 + i + 1]);
+	}
+	fft.forwardInterleaved(a, a + n*2);
+	fft.forwardInterleaved(b + 1, b + n*2 + 1);
+	for (int i = 0; i < n + 2; ++i) {
+	    COMPARE_FUZZIER(a[n*2 + i], b[n*2 + i + 1]);
+	}
+	fft.inverseInterleaved(a + n*2, a + n);
+	fft.inverseInterleaved(b + n*2 + 1, b + n + 1);
+	for (int i = 0; i < n; ++i) {
+	    COMPARE_FUZZIER(a[n + i], b[n + i + 1]);
+	}
+	deallocate(a);
+	deallocate(b);
+    }
+
+    void sharedInstances() {
+        ifetch();
+	// Several instances of the same size, which may share plans
+	// internally, created and destroyed in an overlapping order
+	double in[] = { 0.5, 1, -0.5, -1 };
+	double re[3], im[3];
+	FFT *a = new FFT(4);
+	FFT *b = new FFT(4);
+	a->forward(in, re, im);
+	QCOMPARE(re[1], 1.0);
+	QCOMPARE(im[1], -2.0);
+	delete a;
+	b->forward(in, re, im);
+	QCOMPARE(re[1], 1.0);
+	QCOMPARE(im[1], -2.0);
+	FFT *c = new FFT(4);
+	delete b;
+	c->forward(in, re, im);
+	QCOMPARE(re[1], 1.0);
+	QCOMPARE(im[1], -2.0);
+	double back[4];
+	c->inverse(re, im, back);
+	COMPARE_SCALED(back, in, 4);
+	delete c;
+    }
+
+    void nonPowerOfTwo() {
+        ifetch();
+	// Odd and even sizes that are not powers of two, compared
+	// against a direct DFT. Size 5 has no Nyquist bin. Compared
+	// only to single precision, as not every implementation has
+	// double precision available
+	int sizes[] = { 5, 6, 12 };
+	for (int si = 0; si < 3; ++si) {
+	    int n = sizes[si];
+	    int hs = n/2;
+	    double in[12], re[7], im[7], back[12];
+	    for (int i = 0; i < n; ++i) in[i] = sin(i * 0.7) + 0.25 * i;
+	    FFT fft(n);
+	    fft.forward(in, re, im);
+	    for (int k = 0; k <= hs; ++k) {
+		double xr = 0, xi = 0;
+		for (int i = 0; i < n; ++i) {
+		    xr += in[i] * cos(2 * M_PI * i * k / n);
+		    xi -= in[i] * sin(2 * M_PI * i * k / n);
+		}
+		COMPARE_FUZZIER_F(float(re[k]), float(xr));
+		COMPARE_FUZZIER_F(float(im[k]), float(xi));
+	    }
+	    fft.inverse(re, im, back);
+	    for (int i = 0; i < n; ++i) {
+		COMPARE_FUZZIER_F(float(back[i] / n), float(in[i]));
+	    }
+	}
+    }
+
+    void nextFastSize() {
+        ifetch();
+	int sizes[] = { 1, 2, 7, 64, 100, 1000, 1025 };
+	for (int si = 0; si < 7; ++si) {
+	    int n = sizes[si];
+	    int m = FFT::nextFastSize(n);
+	    QVERIFY(m >= n);
+	    QVERIFY(m >= 2);
+	    QVERIFY(m % 2 == 0);
+	    FFT fft(m);
+	}
+	QCOMPARE(FFT::nextFastSize(64), 64);
+	QCOMPARE(FFT::nextFastSize(1 << 30), 1 << 30);
+	// Beyond 2^30 the result would overflow
+	bool thrown = false;
+	try {
+	    FFT::nextFastSize((1 << 30) + 1);
+	} catch (FFT::Exception e) {
+	    QVERIFY(e == FFT::InvalidSize);
+	    thrown = true;
+	}
+	QVERIFY(thrown);
+    }
+
+    void longer() {
+        ifetch();
+	// Long enough for implementations to use their vectorised or
+	// multi-stage code paths, compared against a direct DFT
+	int sizes[] = { 64, 2048 };
+	for (int si = 0; si < 2; ++si) {
+	    int n = sizes[si];
+	    int hs = n/2;
+	    double *in = allocate<double>(n);
+	    double *re = allocate<double>(hs + 1);
+	    double *im = allocate<double>(hs + 1);
+	    double *back = allocate<double>(n);
+	    for (int i = 0; i < n; ++i) in[i] = sin(i * 0.37) + 0.5 * cos(i * 2.1);
+	    FFT fft(n);
+	    fft.forward(in, re, im);
+	    for (int k = 0; k <= hs; ++k) {
+		double xr = 0, xi = 0;
+		for (int i = 0; i < n; ++i) {
+		    double arg = 2 * M_PI * double((i * k) % n) / n;
+		    xr += in[i] * cos(arg);
+		    xi -= in[i] * sin(arg);
+		}
+		QVERIFY(fabs(re[k] - xr) < 1e-3);
+		QVERIFY(fabs(im[k] - xi) < 1e-3);
+	    }
+	    fft.inverse(re, im, back);
+	    for (int i = 0; i < n; ++i) {
+		QVERIFY(fabs(back[i] / n - in[i]) < 1e-5);
+	    }
+	    deallocate(in);
+	    deallocate(re);
+	    deallocate(im);
+	    deallocate(back);
+	}
+    }
+
+    void stft() {
+        ifetch();
+	// Frames should match windowed forward transforms, and
+	// resynthesis should reproduce the input once the overlap is
+	// complete. Go through both the internal and caller's buffers,
+	// in more frames than one batch
+	const int n = 16, hop = 4, bins = n/2 + 1, len = 160;
+	const int frames = (len - n) / hop + 1;
+	float in[len], out[len], frame[n];
+	float re[frames * bins], im[frames * bins];
+	float mag[frames * bins], phase[frames * bins];
+	float fre[bins], fim[bins];
+	for (int i = 0; i < len; ++i) in[i] = sinf(i * 0.3f) + 0.2f * cosf(i * 1.7f);
+	STFT stft(n, hop, STFT::HannWindow, 3, len);
+	QCOMPARE(stft.write(in, len), len);
+	QCOMPARE(stft.getAvailableFrames(), frames);
+	QCOMPARE(stft.analyse(re, im, frames), frames);
+	QCOMPARE(stft.getAvailableFrames(), 0);
+	FFT fft(n);
+	for (int f = 0; f < frames; f += 5) {
+	    for (int i = 0; i < n; ++i) {
+		frame[i] = in[f * hop + i] * stft.getWindow()[i];
+	    }
+	    fft.forward(frame, fre, fim);
+	    for (int i = 0; i < bins; ++i) {
+		COMPARE_FUZZIER_F(re[f * bins + i], fre[i]);
+		COMPARE_FUZZIER_F(im[f * bins + i], fim[i]);
+	    }
+	}
+	QCOMPARE(stft.synthesise(re, im, frames), frames);
+	QCOMPARE(stft.read(out, frames * hop), frames * hop);
+	for (int i = n - hop; i < frames * hop; ++i) {
+	    QVERIFY(fabsf(out[i] - in[i]) < 1e-5f);
+	}
+	RingBuffer<float> input(len), output(len);
+	input.write(in, len);
+	stft.reset();
+	QCOMPARE(stft.analysePolar(input, mag, phase, frames), frames);
+	QCOMPARE(stft.synthesisePolar(mag, phase, frames, output), frames);
+	QCOMPARE(output.read(out, frames * hop), frames * hop);
+	for (int i = n - hop; i < frames * hop; ++i) {
+	    QVERIFY(fabsf(out[i] - in[i]) < 1e-5f);
+	}
+    }
+
+    void polarAccuracy() {
+        ifetch();
+	// The approximate polar conversions against the exact ones,
+	// at both precisions. Phases are compared modulo 2pi, as the
+	// approximations need not agree on the sign of pi for a
+	// negative real part with a zero imaginary one. Size 100 is
+	// not a power of two, and goes through Bluestein where the
+	// implementation has no transform of its own for it
+	const int mn = 256, mhs = mn/2;
+	double in[mn], mag[mhs + 1], phase[mhs + 1], back[mn];
+	double amag[mhs + 1], aphase[mhs + 1], aback[mn];
+	float fin[mn], fmag[mhs + 1], fphase[mhs + 1], fback[mn];
+	float famag[mhs + 1], faphase[mhs + 1], faback[mn];
+	int sizes[] = { 256, 100 };
+	for (int si = 0; si < 2; ++si) {
+	    const int n = sizes[si], hs = n/2;
+	    for (int i = 0; i < n; ++i) {
+		in[i] = sin(i * 0.37) + 0.5 * cos(i * 2.1) + 0.1;
+		fin[i] = float(in[i]);
+	    }
+	    FFT fft(n);
+	    fft.forwardPolar(in, mag, phase);
+	    fft.inversePolar(mag, phase, back);
+	    fft.forwardPolar(fin, fmag, fphase);
+	    fft.inversePolar(fmag, fphase, fback);
+	    QCOMPARE(fft.getPolarAccuracy(), FFT::ExactPolar);
+	    FFT::PolarAccuracy accuracies[] = { FFT::PrecisePolar, FFT::FastPolar };
+	    double tolerances[] = { 1e-5, 2e-3 };
+	    for (int a = 0; a < 2; ++a) {
+		fft.setPolarAccuracy(accuracies[a]);
+		QCOMPARE(fft.getPolarAccuracy(), accuracies[a]);
+		double tol = tolerances[a];
+		fft.forwardPolar(in, amag, aphase);
+		fft.inversePolar(mag, phase, aback);
+		fft.forwardPolar(fin, famag, faphase);
+		fft.inversePolar(fmag, fphase, faback);
+		for (int i = 0; i <= hs; ++i) {
+		    QVERIFY(fabs(amag[i] - mag[i]) <= tol * (mag[i] + 1e-3));
+		    QVERIFY(fabs(famag[i] - fmag[i]) <= tol * (fmag[i] + 1e-3));
+		    double d = fabs(aphase[i] - phase[i]);
+		    if (d > M_PI) d = 2 * M_PI - d;
+		    QVERIFY(d < tol);
+		    d = fabs(double(faphase[i]) - double(fphase[i]));
+		    if (d > M_PI) d = 2 * M_PI - d;
+		    QVERIFY(d < tol);
+		}
+		for (int i = 0; i < n; ++i) {
+		    QVERIFY(fabs(aback[i] - back[i]) < tol * n);
+		    QVERIFY(fabs(double(faback[i]) - double(fback[i])) < tol * n);
+		}
+	    }
+	}
+    }
+
+    void complex() {
+        ifetch();
+	// Complex input with no symmetry, compared against a direct
+	// DFT in both layouts. The interleaved transforms go between
+	// an aligned and a misaligned buffer in each direction, as
+	// implementations may take different paths for each. Size 12
+	// is not a power of two
+	int sizes[] = { 4, 16, 12 };
+	for (int si = 0; si < 3; ++si) {
+	    int n = sizes[si];
+	    double *ri = allocate<double>(n);
+	    double *ii = allocate<double>(n);
+	    double *ro = allocate<double>(n);
+	    double *io = allocate<double>(n);
+	    double *br = allocate<double>(n);
+	    double *bi = allocate<double>(n);
+	    double *a = allocate<double>(n * 2);
+	    double *b = allocate<double>(n * 2 + 1);
+	    for (int i = 0; i < n; ++i) {
+		ri[i] = sin(i * 0.7) + 0.25 * i;
+		ii[i] = cos(i * 0.3) - 0.5;
+		a[i*2] = ri[i];
+		a[i*2+1] = ii[i];
+	    }
+	    FFT fft(n);
+	    fft.forwardComplex(ri, ii, ro, io);
+	    fft.forwardComplexInterleaved(a, b + 1);
+	    for (int k = 0; k < n; ++k) {
+		double xr = 0, xi = 0;
+		for (int i = 0; i < n; ++i) {
+		    double arg = 2 * M_PI * double((i * k) % n) / n;
+		    xr += ri[i] * cos(arg) + ii[i] * sin(arg);
+		    xi += ii[i] * cos(arg) - ri[i] * sin(arg);
+		}
+		QVERIFY(fabs(ro[k] - xr) < 1e-3);
+		QVERIFY(fabs(io[k] - xi) < 1e-3);
+		QVERIFY(fabs(b[k*2+1] - xr) < 1e-3);
+		QVERIFY(fabs(b[k*2+2] - xi) < 1e-3);
+	    }
+	    fft.inverseComplex(ro, io, br, bi);
+	    fft.inverseComplexInterleaved(b + 1, a);
+	    for (int i = 0; i < n; ++i) {
+		QVERIFY(fabs(br[i] / n - ri[i]) < 1e-5);
+		QVERIFY(fabs(bi[i] / n - ii[i]) < 1e-5);
+		QVERIFY(fabs(a[i*2] / n - ri[i]) < 1e-5);
+		QVERIFY(fabs(a[i*2+1] / n - ii[i]) < 1e-5);
+	    }
+	    deallocate(ri);
+	    deallocate(ii);
+	    deallocate(ro);
+	    deallocate(io);
+	    deallocate(br);
+	    deallocate(bi);
+	    deallocate(a);
+	    deallocate(b);
+	}
+    }
+
+    void windowed() {
+        ifetch();
+	// The windowed, power and decibel spectra against a separate
+	// window multiply and forward transform, to single precision
+	// as not every implementation has double. Size 12 is not a
+	// power of two
+	int sizes[] = { 16, 12 };
+	for (int si = 0; si < 2; ++si) {
+	    int n = sizes[si];
+	    int hs = n/2;
+	    double in[16], win[16], wout[16], re[9], im[9], wre[9], wim[9];
+	    double mag[9], power[9], wpower[9], db[9], wdb[9];
+	    for (int i = 0; i < n; ++i) {
+		in[i] = sin(i * 0.7) + 0.25 * i;
+		win[i] = 0.5 - 0.5 * cos(2 * double(M_PI) * i / n);
+		wout[i] = in[i] * win[i];
+	    }
+	    FFT fft(n);
+	    fft.forward(wout, re, im);
+	    fft.forwardWindowed(in, win, wre, wim);
+	    fft.forwardWindowedMagnitude(in, win, mag);
+	    fft.forwardWindowedPower(in, win, wpower);
+	    fft.forwardWindowedDecibels(in, win, wdb);
+	    for (int k = 0; k <= hs; ++k) {
+		double p = re[k] * re[k] + im[k] * im[k];
+		QVERIFY(fabs(wre[k] - re[k]) < 1e-4);
+		QVERIFY(fabs(wim[k] - im[k]) < 1e-4);
+		QVERIFY(fabs(mag[k] - sqrt(p)) < 1e-4 * (mag[k] + 1));
+		QVERIFY(fabs(wpower[k] - p) < 1e-4 * (p + 1));
+		QVERIFY(fabs(wdb[k] - 10 * log10(p > 1e-20 ? p : 1e-20)) < 1e-2);
+	    }
+	    fft.forward(in, re, im);
+	    fft.forwardPower(in, power);
+	    fft.forwardDecibels(in, db);
+	    for (int k = 0; k <= hs; ++k) {
+		double p = re[k] * re[k] + im[k] * im[k];
+		QVERIFY(fabs(power[k] - p) < 1e-4 * (p + 1));
+		QVERIFY(fabs(db[k] - 10 * log10(p > 1e-20 ? p : 1e-20)) < 1e-2);
+	    }
+	}
+    }
+
+    void bins() {
+        ifetch();
+	// Bin ranges against the corresponding part of a full
+	// transform. Short ranges may be computed differently, and the
+	// implementations with a single-precision transform only are
+	// compared to single precision
+	int sizes[] = { 16, 12, 64 };
+	for (int si = 0; si < 3; ++si) {
+	    int n = sizes[si];
+	    int hs = n/2;
+	    double in[64], re[33], im[33], mag[33], phase[33];
+	    double bre[33], bim[33], bmag[33], bphase[33];
+	    for (int i = 0; i < n; ++i) {
+		in[i] = sin(i * 0.7) + 0.25 * i;
+	    }
+	    FFT fft(n);
+	    fft.forward(in, re, im);
+	    fft.forwardPolar(in, mag, phase);
+	    int ranges[][2] = { { 0, 1 }, { hs, 1 }, { 1, 3 }, { 2, hs - 2 },
+				{ 0, hs + 1 }, { hs/2, hs/2 + 1 } };
+	    for (int ri = 0; ri < 6; ++ri) {
+		int first = ranges[ri][0], count = ranges[ri][1];
+		fft.forward(in, bre, bim, first, count);
+		fft.forwardPolar(in, bmag, bphase, first, count);
+		for (int i = 0; i < count; ++i) {
+		    int k = first + i;
+		    QVERIFY(fabs(bre[i] - re[k]) < 1e-4 * (fabs(re[k]) + 1));
+		    QVERIFY(fabs(bim[i] - im[k]) < 1e-4 * (fabs(im[k]) + 1));
+		    QVERIFY(fabs(bmag[i] - mag[k]) < 1e-4 * (mag[k] + 1));
+		    if (mag[k] > 1e-2) {
+			double dp = fabs(bphase[i] - phase[k]);
+			if (dp > M_PI) dp = 2 * M_PI - dp;
+			QVERIFY(dp < 1e-3);
+		    }
+		}
+		fft.forwardMagnitude(in, bmag, first, count);
+		for (int i = 0; i < count; ++i) {
+		    QVERIFY(fabs(bmag[i] - mag[first + i]) < 1e-4 * (mag[first + i] + 1));
+		}
+	    }
+	}
+	// The range has to be within the size/2+1 bins
+	FFT fft(16);
+	double in[16] = { 0 }, re[9], im[9];
+	bool thrown = false;
+	try {
+	    fft.forward(in, re, im, 5, 5);
+	} catch (FFT::Exception e) {
+	    QVERIFY(e == FFT::InvalidSize);
+	    thrown = true;
+	}
+	QVERIFY(thrown);
+    }
+
+    void padded() {
+        ifetch();
+	// Against forward() of the same input explicitly padded. What
+	// lies beyond the count in the input is not zero, to show it
+	// isn't read. The counts include those either side of the
+	// quarter boundaries where the built-in transform stops pruning
+	int sizes[] = { 16, 12, 64, 256 };
+	for (int si = 0; si < 4; ++si) {
+	    int n = sizes[si];
+	    int hs = n/2;
+	    int counts[] = { 0, 1, 2, n/4, n/4 + 1, hs - 1, hs, 3*n/4 - 1, n - 3, n };
+	    for (int ci = 0; ci < 10; ++ci) {
+		int count = counts[ci];
+		double in[256], padded[256], re[129], im[129], pre[129], pim[129];
+		for (int i = 0; i < n; ++i) {
+		    in[i] = (i < count ? sin(i * 0.7) + 0.25 * (i % 8) : 99.0);
+		    padded[i] = (i < count ? in[i] : 0);
+		}
+		FFT fft(n);
+		fft.forward(padded, re, im);
+		fft.forwardPadded(in, count, pre, pim);
+		for (int i = 0; i <= hs; ++i) {
+		    QVERIFY(fabs(pre[i] - re[i]) < 1e-4 * (fabs(re[i]) + 1));
+		    QVERIFY(fabs(pim[i] - im[i]) < 1e-4 * (fabs(im[i]) + 1));
+		}
+	    }
+	}
+	// The count can't exceed the size
+	FFT fft(16);
+	double in[16] = { 0 }, re[9], im[9];
+	bool thrown = false;
+	try {
+	    fft.forwardPadded(in, 17, re, im);
+	} catch (FFT::Exception e) {
+	    QVERIFY(e == FFT::InvalidSize);
+	    thrown = true;
+	}
+	QVERIFY(thrown);
+    }
+
+    void realtime() {
+        ifetch();
+	// Once initialised, no entry point should need to allocate,
+	// plan or take a lock. Batch transforms set up for the largest
+	// count they have been called with. Size 12 is not a power of
+	// two
+	int sizes[] = { 16, 12 };
+	for (int si = 0; si < 2; ++si) {
+	    int n = sizes[si];
+	    int hs = n/2;
+	    double in[48], win[16], re[27], im[27], mag[9], phase[9];
+	    double cxin[32], cxout[32], out[48];
+	    for (int i = 0; i < 48; ++i) in[i] = sin(i * 0.3);
+	    for (int i = 0; i < 32; ++i) cxin[i] = cos(i * 0.2);
+	    for (int i = 0; i < 16; ++i) win[i] = 0.5;
+	    FFT fft(n);
+	    fft.initDouble();
+	    fft.initDoubleComplex();
+	    fft.forwardMany(in, re, im, n, hs + 1, 3);
+	    fft.inverseMany(re, im, out, hs + 1, n, 3);
+	    fft.setRealtime(true);
+	    fft.resetCounts();
+	    fft.forward(in, re, im);
+	    fft.forwardInterleaved(in, cxout);
+	    fft.forwardPolar(in, mag, phase);
+	    fft.forwardMagnitude(in, mag);
+	    fft.inverse(re, im, out);
+	    fft.inverseInterleaved(cxout, out);
+	    fft.inversePolar(mag, phase, out);
+	    fft.inverseCepstral(mag, out);
+	    fft.forwardMany(in, re, im, n, hs + 1, 3);
+	    fft.inverseMany(re, im, out, hs + 1, n, 3);
+	    fft.forwardComplex(cxin, cxin + 16, re, im);
+	    fft.inverseComplex(re, im, cxout, cxout + 16);
+	    fft.forwardComplexInterleaved(cxin, cxout);
+	    fft.inverseComplexInterleaved(cxout, cxin);
+	    fft.forwardWindowed(in, win, re, im);
+	    fft.forwardWindowedMagnitude(in, win, mag);
+	    fft.forwardPower(in, mag);
+	    fft.forwardWindowedPower(in, win, mag);
+	    fft.forwardDecibels(in, mag);
+	    fft.forwardWindowedDecibels(in, win, mag);
+	    fft.forward(in, re, im, 1, 2);
+	    fft.forward(in, re, im, 0, hs + 1);
+	    fft.forwardPolar(in, mag, phase, 0, hs + 1);
+	    fft.forwardMagnitude(in, mag, 1, hs);
+	    fft.forwardPadded(in, hs - 1, re, im);
+	    QCOMPARE(fft.getAllocationCount(), 0);
+	    QCOMPARE(fft.getLockCount(), 0);
+	}
+	// Without initialisation, the complex transform has setup to
+	// do on first use with every implementation, which realtime
+	// mode refuses
+	double cxin[32] = { 0 }, cxout[32];
+	FFT fft(16);
+	fft.setRealtime(true);
+	bool thrown = false;
+	try {
+	    fft.forwardComplexInterleaved(cxin, cxout);
+	} catch (FFT::Exception e) {
+	    QVERIFY(e == FFT::RealtimeViolation);
+	    thrown = true;
+	}
+	QVERIFY(thrown);
+	fft.setRealtime(false);
+	fft.forwardComplexInterleaved(cxin, cxout);
+	QVERIFY(fft.getAllocationCount() > 0);
+    }
+
+    void tuned() {
+	// With no default implementation set, the implementation for
+	// each precision is chosen by timing them all. The profile
+	// goes to a temporary home directory, not the real one
+	TemporaryHome home;
+	QVERIFY(home.isValid());
+	std::string prior = FFT::getDefaultImplementation();
+	FFT::setDefaultImplementation("");
+	std::string best = FFT::tune(8, FFT::DoublePrecision);
+	QVERIFY(FFT::getImplementations().count(best) == 1);
+	double in[] = { 0, 1, 0, -1, 0, 1, 0, -1 };
+	double re[5], im[5];
+	FFT fft(8);
+	fft.forward(in, re, im);
+	COMPARE_ZERO(re[2]);
+	COMPARE_FUZZIER(im[2], -4.0);
+	float fin[] = { 0, 1, 0, -1, 0, 1, 0, -1 };
+	float fre[5], fim[5];
+	fft.forward(fin, fre, fim);
+	COMPARE_ZERO_F(fre[2]);
+	COMPARE_FUZZIER_F(fim[2], -4.0f);
+	FFT::setDefaultImplementation(prior);
+    }
+
     void checkF() {
         QString impl = ifetch();
     }
@@ -472,6 +1068,300 @@ private slots:
 	QCOMPARE(out[5], 999.0f);
     }
 
+    void manyF() {
+        ifetch();
+	// DC, sine, cosine and Nyquist frames, with padding between
+	// them to check that the strides are respected
+	float in[] = { 1, 1, 1, 1, 999,
+		      0, 1, 0, -1, 999,
+		      1, 0, -1, 0, 999,
+		      1, -1, 1, -1, 999 };
+	float re[16], im[16];
+	for (int i = 0; i < 16; ++i) re[i] = im[i] = 999;
+	FFT fft(4);
+	fft.forwardMany(in, re, im, 5, 4, 4);
+	for (int f = 0; f < 4; ++f) {
+	    float fre[3], fim[3];
+	    fft.forward(in + f*5, fre, fim);
+	    for (int i = 0; i < 3; ++i) {
+		COMPARE_FUZZIER_F(re[f*4 + i], fre[i]);
+		COMPARE_FUZZIER_F(im[f*4 + i], fim[i]);
+	    }
+	    QCOMPARE(re[f*4 + 3], 999.0f);
+	    QCOMPARE(im[f*4 + 3], 999.0f);
+	}
+	float back[20];
+	for (int i = 0; i < 20; ++i) back[i] = 999;
+	fft.inverseMany(re, im, back, 4, 5, 4);
+	for (int f = 0; f < 4; ++f) {
+	    for (int i = 0; i < 4; ++i) {
+		COMPARE_FUZZIER_F(back[f*5 + i] / 4, in[f*5 + i]);
+	    }
+	    QCOMPARE(back[f*5 + 4], 999.0f);
+	}
+    }
+
+    void alignmentF() {
+        ifetch();
+	// Implementations may take different paths depending on
+	// whether the caller's buffers are aligned, so check that an
+	// aligned and a misaligned set give the same results
+	const int n = 16;
+	float *a = allocate_and_zero<float>(n * 4 + 4);
+	float *b = allocate_and_zero<float>(n * 4 + 4);
+	for (int i = 0; i < n; ++i) {
+	    a[i] = b[i+1] = float(sin(i * 0.7) + cos(i * 0.2));
+	}
+	FFT fft(n);
+	fft.forward(a, a + n, a + n*2);
+	fft.forward(b + 1, b + n + 1, b + n*2 + 1);
+	for (int i = 0; i <= n/2; ++i) {
+	    COMPARE_FUZZIER_F(a[n + i], b[n + i + 1]);
+	    COMPARE_FUZZIER_F(a[n*2 + i], b[n*2 + i + 1]);
+	}
+	fft.forwardInterleaved(a, a + n*2);
+	fft.forwardInterleaved(b + 1, b + n*2 + 1);
+	for (int i = 0; i < n + 2; ++i) {
+	    COMPARE_FUZZIER_F(a[n*2 + i], b[n*2 + i + 1]);
+	}
+	fft.inverseInterleaved(a + n*2, a + n);
+	fft.inverseInterleaved(b + n*2 + 1, b + n + 1);
+	for (int i = 0; i < n; ++i) {
+	    COMPARE_FUZZIER_F(a[n + i], b[n + i + 1]);
+	}
+	deallocate(a);
+	deallocate(b);
+    }
+
+    void nonPowerOfTwoF() {
+        ifetch();
+	int sizes[] = { 5, 6, 12 };
+	for (int si = 0; si < 3; ++si) {
+	    int n = sizes[si];
+	    int hs = n/2;
+	    float in[12], re[7], im[7], back[12];
+	    for (int i = 0; i < n; ++i) in[i] = sinf(i * 0.7f) + 0.25f * i;
+	    FFT fft(n);
+	    fft.forward(in, re, im);
+	    for (int k = 0; k <= hs; ++k) {
+		double xr = 0, xi = 0;
+		for (int i = 0; i < n; ++i) {
+		    xr += in[i] * cos(2 * M_PI * i * k / n);
+		    xi -= in[i] * sin(2 * M_PI * i * k / n);
+		}
+		COMPARE_FUZZIER_F(re[k], float(xr));
+		COMPARE_FUZZIER_F(im[k], float(xi));
+	    }
+	    fft.inverse(re, im, back);
+	    for (int i = 0; i < n; ++i) {
+		COMPARE_FUZZIER_F(back[i] / n, in[i]);
+	    }
+	}
+    }
+
+    void complexF() {
+        ifetch();
+	int sizes[] = { 4, 16, 12 };
+	for (int si = 0; si < 3; ++si) {
+	    int n = sizes[si];
+	    float *ri = allocate<float>(n);
+	    float *ii = allocate<float>(n);
+	    float *ro = allocate<float>(n);
+	    float *io = allocate<float>(n);
+	    float *br = allocate<float>(n);
+	    float *bi = allocate<float>(n);
+	    float *a = allocate<float>(n * 2);
+	    float *b = allocate<float>(n * 2 + 1);
+	    for (int i = 0; i < n; ++i) {
+		ri[i] = sinf(i * 0.7f) + 0.25f * i;
+		ii[i] = cosf(i * 0.3f) - 0.5f;
+		a[i*2] = ri[i];
+		a[i*2+1] = ii[i];
+	    }
+	    FFT fft(n);
+	    fft.forwardComplex(ri, ii, ro, io);
+	    fft.forwardComplexInterleaved(a, b + 1);
+	    for (int k = 0; k < n; ++k) {
+		double xr = 0, xi = 0;
+		for (int i = 0; i < n; ++i) {
+		    double arg = 2 * M_PI * double((i * k) % n) / n;
+		    xr += ri[i] * cos(arg) + ii[i] * sin(arg);
+		    xi += ii[i] * cos(arg) - ri[i] * sin(arg);
+		}
+		QVERIFY(fabs(ro[k] - xr) < 1e-3);
+		QVERIFY(fabs(io[k] - xi) < 1e-3);
+		QVERIFY(fabs(b[k*2+1] - xr) < 1e-3);
+		QVERIFY(fabs(b[k*2+2] - xi) < 1e-3);
+	    }
+	    fft.inverseComplex(ro, io, br, bi);
+	    fft.inverseComplexInterleaved(b + 1, a);
+	    for (int i = 0; i < n; ++i) {
+		QVERIFY(fabs(br[i] / n - ri[i]) < 1e-4);
+		QVERIFY(fabs(bi[i] / n - ii[i]) < 1e-4);
+		QVERIFY(fabs(a[i*2] / n - ri[i]) < 1e-4);
+		QVERIFY(fabs(a[i*2+1] / n - ii[i]) < 1e-4);
+	    }
+	    deallocate(ri);
+	    deallocate(ii);
+	    deallocate(ro);
+	    deallocate(io);
+	    deallocate(br);
+	    deallocate(bi);
+	    deallocate(a);
+	    deallocate(b);
+	}
+    }
+
+    void windowedF() {
+        ifetch();
+	int sizes[] = { 16, 12 };
+	for (int si = 0; si < 2; ++si) {
+	    int n = sizes[si];
+	    int hs = n/2;
+	    float in[16], win[16], wout[16], re[9], im[9], wre[9], wim[9];
+	    float mag[9], power[9], wpower[9], db[9], wdb[9];
+	    for (int i = 0; i < n; ++i) {
+		in[i] = sinf(i * 0.7f) + 0.25f * i;
+		win[i] = 0.5f - 0.5f * cosf(2 * float(M_PI) * i / n);
+		wout[i] = in[i] * win[i];
+	    }
+	    FFT fft(n);
+	    fft.forward(wout, re, im);
+	    fft.forwardWindowed(in, win, wre, wim);
+	    fft.forwardWindowedMagnitude(in, win, mag);
+	    fft.forwardWindowedPower(in, win, wpower);
+	    fft.forwardWindowedDecibels(in, win, wdb);
+	    for (int k = 0; k <= hs; ++k) {
+		float p = re[k] * re[k] + im[k] * im[k];
+		QVERIFY(fabs(wre[k] - re[k]) < 1e-4);
+		QVERIFY(fabs(wim[k] - im[k]) < 1e-4);
+		QVERIFY(fabs(mag[k] - sqrt(p)) < 1e-4 * (mag[k] + 1));
+		QVERIFY(fabs(wpower[k] - p) < 1e-4 * (p + 1));
+		QVERIFY(fabs(wdb[k] - 10 * log10(p > 1e-20 ? p : 1e-20)) < 1e-2);
+	    }
+	    fft.forward(in, re, im);
+	    fft.forwardPower(in, power);
+	    fft.forwardDecibels(in, db);
+	    for (int k = 0; k <= hs; ++k) {
+		float p = re[k] * re[k] + im[k] * im[k];
+		QVERIFY(fabs(power[k] - p) < 1e-4 * (p + 1));
+		QVERIFY(fabs(db[k] - 10 * log10(p > 1e-20 ? p : 1e-20)) < 1e-2);
+	    }
+	}
+    }
+
+    void binsF() {
+        ifetch();
+	int sizes[] = { 16, 12, 64 };
+	for (int si = 0; si < 3; ++si) {
+	    int n = sizes[si];
+	    int hs = n/2;
+	    float in[64], re[33], im[33], mag[33], phase[33];
+	    float bre[33], bim[33], bmag[33], bphase[33];
+	    for (int i = 0; i < n; ++i) {
+		in[i] = sinf(i * 0.7f) + 0.25f * i;
+	    }
+	    FFT fft(n);
+	    fft.forward(in, re, im);
+	    fft.forwardPolar(in, mag, phase);
+	    int ranges[][2] = { { 0, 1 }, { hs, 1 }, { 1, 3 }, { 2, hs - 2 },
+				{ 0, hs + 1 }, { hs/2, hs/2 + 1 } };
+	    for (int ri = 0; ri < 6; ++ri) {
+		int first = ranges[ri][0], count = ranges[ri][1];
+		fft.forward(in, bre, bim, first, count);
+		fft.forwardPolar(in, bmag, bphase, first, count);
+		for (int i = 0; i < count; ++i) {
+		    int k = first + i;
+		    QVERIFY(fabs(bre[i] - re[k]) < 1e-4 * (fabs(re[k]) + 1));
+		    QVERIFY(fabs(bim[i] - im[k]) < 1e-4 * (fabs(im[k]) + 1));
+		    QVERIFY(fabs(bmag[i] - mag[k]) < 1e-4 * (mag[k] + 1));
+		    if (mag[k] > 1e-2) {
+			double dp = fabs(bphase[i] - phase[k]);
+			if (dp > M_PI) dp = 2 * M_PI - dp;
+			QVERIFY(dp < 1e-3);
+		    }
+		}
+		fft.forwardMagnitude(in, bmag, first, count);
+		for (int i = 0; i < count; ++i) {
+		    QVERIFY(fabs(bmag[i] - mag[first + i]) < 1e-4 * (mag[first + i] + 1));
+		}
+	    }
+	}
+    }
+
+    void paddedF() {
+        ifetch();
+	int sizes[] = { 16, 12, 64, 256 };
+	for (int si = 0; si < 4; ++si) {
+	    int n = sizes[si];
+	    int hs = n/2;
+	    int counts[] = { 0, 1, 2, n/4, n/4 + 1, hs - 1, hs, 3*n/4 - 1, n - 3, n };
+	    for (int ci = 0; ci < 10; ++ci) {
+		int count = counts[ci];
+		float in[256], padded[256], re[129], im[129], pre[129], pim[129];
+		for (int i = 0; i < n; ++i) {
+		    in[i] = (i < count ? sinf(i * 0.7f) + 0.25f * (i % 8) : 99.f);
+		    padded[i] = (i < count ? in[i] : 0);
+		}
+		FFT fft(n);
+		fft.forward(padded, re, im);
+		fft.forwardPadded(in, count, pre, pim);
+		for (int i = 0; i <= hs; ++i) {
+		    QVERIFY(fabs(pre[i] - re[i]) < 1e-4 * (fabs(re[i]) + 1));
+		    QVERIFY(fabs(pim[i] - im[i]) < 1e-4 * (fabs(im[i]) + 1));
+		}
+	    }
+	}
+    }
+
+    void realtimeF() {
+        ifetch();
+	int sizes[] = { 16, 12 };
+	for (int si = 0; si < 2; ++si) {
+	    int n = sizes[si];
+	    int hs = n/2;
+	    float in[48], win[16], re[27], im[27], mag[9], phase[9];
+	    float cxin[32], cxout[32], out[48];
+	    for (int i = 0; i < 48; ++i) in[i] = sinf(i * 0.3f);
+	    for (int i = 0; i < 32; ++i) cxin[i] = cosf(i * 0.2f);
+	    for (int i = 0; i < 16; ++i) win[i] = 0.5f;
+	    FFT fft(n);
+	    fft.initFloat();
+	    fft.initFloatComplex();
+	    fft.forwardMany(in, re, im, n, hs + 1, 3);
+	    fft.inverseMany(re, im, out, hs + 1, n, 3);
+	    fft.setRealtime(true);
+	    fft.resetCounts();
+	    fft.forward(in, re, im);
+	    fft.forwardInterleaved(in, cxout);
+	    fft.forwardPolar(in, mag, phase);
+	    fft.forwardMagnitude(in, mag);
+	    fft.inverse(re, im, out);
+	    fft.inverseInterleaved(cxout, out);
+	    fft.inversePolar(mag, phase, out);
+	    fft.inverseCepstral(mag, out);
+	    fft.forwardMany(in, re, im, n, hs + 1, 3);
+	    fft.inverseMany(re, im, out, hs + 1, n, 3);
+	    fft.forwardComplex(cxin, cxin + 16, re, im);
+	    fft.inverseComplex(re, im, cxout, cxout + 16);
+	    fft.forwardComplexInterleaved(cxin, cxout);
+	    fft.inverseComplexInterleaved(cxout, cxin);
+	    fft.forwardWindowed(in, win, re, im);
+	    fft.forwardWindowedMagnitude(in, win, mag);
+	    fft.forwardPower(in, mag);
+	    fft.forwardWindowedPower(in, win, mag);
+	    fft.forwardDecibels(in, mag);
+	    fft.forwardWindowedDecibels(in, win, mag);
+	    fft.forward(in, re, im, 1, 2);
+	    fft.forward(in, re, im, 0, hs + 1);
+	    fft.forwardPolar(in, mag, phase, 0, hs + 1);
+	    fft.forwardMagnitude(in, mag, 1, hs);
+	    fft.forwardPadded(in, hs - 1, re, im);
+	    QCOMPARE(fft.getAllocationCount(), 0);
+	    QCOMPARE(fft.getLockCount(), 0);
+	}
+    }
+
     void checkD_data() { idat(); }
     void dc_data() { idat(); }
     void sine_data() { idat(); }
@@ -487,6 +1377,20 @@ private slots:
     void cepstrum_data() { idat(); }
     void forwardArrayBounds_data() { idat(); }
     void inverseArrayBounds_data() { idat(); }
+    void many_data() { idat(); }
+    void alignment_data() { idat(); }
+    void sharedInstances_data() { idat(); }
+
+    void nonPowerOfTwo_data() { idat(); }
+    void nextFastSize_data() { idat(); }
+    void longer_data() { idat(); }
+    void stft_data() { idat(); }
+    void polarAccuracy_data() { idat(); }
+    void complex_data() { idat(); }
+    void windowed_data() { idat(); }
+    void bins_data() { idat(); }
+    void padded_data() { idat(); }
+    void realtime_data() { idat(); }
 
     void checkF_data() { idat(); }
     void dcF_data() { idat(); }
@@ -503,6 +1407,14 @@ private slots:
     void cepstrumF_data() { idat(); }
     void forwardArrayBoundsF_data() { idat(); }
     void inverseArrayBoundsF_data() { idat(); }
+    void manyF_data() { idat(); }
+    void alignmentF_data() { idat(); }
+    void nonPowerOfTwoF_data() { idat(); }
+    void complexF_data() { idat(); }
+    void windowedF_data() { idat(); }
+    void binsF_data() { idat(); }
+    void paddedF_data() { idat(); }
+    void realtimeF_data() { idat(); }
 };
 
 }
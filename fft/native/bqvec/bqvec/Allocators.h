@@ -39,23 +39,34 @@
 /*
  * Aligned and per-channel allocators and deallocators for raw C array
  * buffers.
+ *
+ * Allocations are aligned to BQ_ALLOCATION_ALIGNMENT bytes, 64 unless
+ * defined otherwise, which suits the widest vector loads and keeps
+ * buffers on cache line boundaries. If USE_ALLOCATION_POOL is
+ * defined, allocations are drawn from the pool described below.
  */
 
 #include <new> // for std::bad_alloc
 #include <stdlib.h>
 
+#ifndef BQ_ALLOCATION_ALIGNMENT
+#define BQ_ALLOCATION_ALIGNMENT 64
+#endif
+
+// The system malloc is aligned only to 16 bytes on the platforms
+// where it is aligned at all, so posix_memalign is preferred
+// wherever it exists, including OS/X
+
 #ifndef HAVE_POSIX_MEMALIGN
 #ifndef _WIN32
-#ifndef __APPLE__
 #ifndef LACK_POSIX_MEMALIGN
 #define HAVE_POSIX_MEMALIGN
 #endif
 #endif
 #endif
-#endif
 
 #ifndef MALLOC_IS_NOT_ALIGNED
-#ifdef __APPLE_
+#ifdef __APPLE__
 #ifndef MALLOC_IS_ALIGNED
 #define MALLOC_IS_ALIGNED
 #endif
@@ -70,14 +81,60 @@
 namespace std { struct bad_alloc { }; }
 #endif
 
+#if defined USE_ALLOCATION_POOL && defined _WIN32
+#error "USE_ALLOCATION_POOL is not supported on Windows"
+#endif
+
 namespace breakfastquay {
 
+#ifdef USE_ALLOCATION_POOL
+
+/**
+ * The allocation pool, used by allocate() and deallocate() when
+ * USE_ALLOCATION_POOL is defined.
+ *
+ * Each thread keeps its own cache of freed blocks, in size classes
+ * a quarter of a power of two apart, and an allocation of a size
+ * recently freed on the same thread is served from it without a
+ * system call or a lock. A block may be freed on a different thread
+ * from the one that allocated it, in which case it joins the freeing
+ * thread's cache. Each cache holds up to 8MB per size class and is
+ * emptied when its thread exits. Blocks of more than 8MB are not
+ * cached, and are returned to the system as soon as they are freed.
+ *
+ * Blocks of BQ_LARGE_ALLOCATION bytes (2MB unless defined otherwise)
+ * or more are mapped directly from the system rather than taken from
+ * the heap, and are advised to use transparent huge pages where the
+ * system supports them. With USE_HUGETLB defined they are first
+ * requested from the reserved huge page pool (MAP_HUGETLB). allocate()
+ * does not touch these pages, so on a NUMA system each is placed on
+ * the node of the thread that first writes to it: allocate large
+ * buffers with allocate() rather than allocate_and_zero() and fill
+ * them from the thread that will use them.
+ *
+ * Every block carries a header of BQ_ALLOCATION_ALIGNMENT bytes. A
+ * cached block is also rounded up to its size class, wasting at most
+ * a quarter of what was asked for, which trades memory for speed.
+ */
+void *pool_allocate(size_t bytes);
+void pool_deallocate(void *ptr);
+
+/**
+ * Return all blocks cached by the calling thread to the system.
+ */
+void pool_release_thread_cache();
+
+#endif
+
 template <typename T>
 T *allocate(size_t count)
 {
+#ifdef USE_ALLOCATION_POOL
+    return (T *)pool_allocate(count * sizeof(T));
+#else /* !USE_ALLOCATION_POOL */
     void *ptr = 0;
-    // 32-byte alignment is required for at least OpenMAX
-    static const int alignment = 32;
+    // At least 32-byte alignment is required for OpenMAX and AVX
+    static const int alignment = BQ_ALLOCATION_ALIGNMENT;
 #ifdef USE_OWN_ALIGNED_MALLOC
     // Alignment must be a power of two, bigger than the pointer
     // size. Stuff the actual malloc'd pointer in just before the
@@ -117,6 +174,7 @@ T *allocate(size_t count)
 #endif
     }
     return (T *)ptr;
+#endif /* !USE_ALLOCATION_POOL */
 }
 
 #ifdef HAVE_IPP
@@ -142,6 +200,9 @@ T *allocate_and_zero(size_t count)
 template <typename T>
 void deallocate(T *ptr)
 {
+#ifdef USE_ALLOCATION_POOL
+    if (ptr) pool_deallocate((void *)ptr);
+#else /* !USE_ALLOCATION_POOL */
 #ifdef USE_OWN_ALIGNED_MALLOC
     if (ptr) free(((void **)ptr)[-1]);
 #else /* !USE_OWN_ALIGNED_MALLOC */
@@ -151,6 +212,7 @@ void deallocate(T *ptr)
     if (ptr) free((void *)ptr);
 #endif /* !__MSVC__ */
 #endif /* !USE_OWN_ALIGNED_MALLOC */
+#endif /* !USE_ALLOCATION_POOL */
 }
 
 #ifdef HAVE_IPP
@@ -59,4 +59,114 @@ namespace breakfastquay {
 
 #endif
 
+/**
+ * The granularity at which writes from different threads contend,
+ * used to keep data written by different threads apart.
+ */
+#ifndef BQ_CACHE_LINE_SIZE
+#define BQ_CACHE_LINE_SIZE 64
+#endif
+
+#if (__cplusplus >= 201103L) || (defined _MSC_VER && _MSC_VER >= 1700)
+#define BQ_HAVE_STD_ATOMIC 1
+#include <atomic>
+#elif defined __ATOMIC_ACQUIRE
+#define BQ_HAVE_ATOMIC_BUILTINS 1
+#elif defined _MSC_VER
+#include <intrin.h>
+#elif !((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1))
+#error "No atomic compare-and-swap available"
+#endif
+
+namespace breakfastquay {
+
+/**
+ * AtomicIndex is an unsigned integer shared between threads, with
+ * the operations a lock-free buffer needs to hand data from one
+ * thread to another: a load that acquires, so that data published
+ * before the matching store is visible after it; a store that
+ * releases; and compare-and-swap, for indices several threads may
+ * advance.
+ *
+ * It uses std::atomic when compiled as C++11 or newer, the compiler's
+ * atomic builtins with GCC or clang otherwise, and full memory
+ * barriers around plain accesses as a last resort.
+ */
+class AtomicIndex
+{
+public:
+    AtomicIndex() : m_value(0) { }
+
+    /**
+     * Load without ordering. Suitable only for the thread that is
+     * the sole writer of the index, or where the value is advisory.
+     */
+    unsigned int load() const {
+#if defined BQ_HAVE_STD_ATOMIC
+        return m_value.load(std::memory_order_relaxed);
+#elif defined BQ_HAVE_ATOMIC_BUILTINS
+        return __atomic_load_n(&m_value, __ATOMIC_RELAXED);
+#else
+        return m_value;
+#endif
+    }
+
+    unsigned int loadAcquire() const {
+#if defined BQ_HAVE_STD_ATOMIC
+        return m_value.load(std::memory_order_acquire);
+#elif defined BQ_HAVE_ATOMIC_BUILTINS
+        return __atomic_load_n(&m_value, __ATOMIC_ACQUIRE);
+#else
+        unsigned int value = m_value;
+        BQ_MBARRIER();
+        return value;
+#endif
+    }
+
+    void storeRelease(unsigned int value) {
+#if defined BQ_HAVE_STD_ATOMIC
+        m_value.store(value, std::memory_order_release);
+#elif defined BQ_HAVE_ATOMIC_BUILTINS
+        __atomic_store_n(&m_value, value, __ATOMIC_RELEASE);
+#else
+        BQ_MBARRIER();
+        m_value = value;
+#endif
+    }
+
+    /**
+     * If the index is equal to expected, replace it with desired and
+     * return true; otherwise return false. Acquires and releases.
+     */
+    bool compareAndSwap(unsigned int expected, unsigned int desired) {
+#if defined BQ_HAVE_STD_ATOMIC
+        return m_value.compare_exchange_strong(expected, desired,
+                                               std::memory_order_acq_rel);
+#elif defined BQ_HAVE_ATOMIC_BUILTINS
+        return __atomic_compare_exchange_n(&m_value, &expected, desired, false,
+                                           __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#elif defined _MSC_VER
+        return (unsigned int)_InterlockedCompareExchange
+            ((volatile long *)&m_value, long(desired), long(expected))
+            == expected;
+#else
+        return __sync_bool_compare_and_swap(&m_value, expected, desired);
+#endif
+    }
+
+private:
+#if defined BQ_HAVE_STD_ATOMIC
+    std::atomic<unsigned int> m_value;
+#elif defined BQ_HAVE_ATOMIC_BUILTINS
+    unsigned int m_value;
+#else
+    volatile unsigned int m_value;
+#endif
+
+    AtomicIndex(const AtomicIndex &); // not provided
+    AtomicIndex &operator=(const AtomicIndex &); // not provided
+};
+
+}
+
 #endif
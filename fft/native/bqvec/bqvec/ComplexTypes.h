@@ -40,11 +40,18 @@ namespace breakfastquay {
 
 #ifndef NO_COMPLEX_TYPES
 // Convertible with other complex types that store re+im consecutively
-typedef double bq_complex_element_t;
-struct bq_complex_t {
-    bq_complex_element_t re;
-    bq_complex_element_t im;
+template <typename T>
+struct bq_complex {
+    T re;
+    T im;
 };
+
+// Single and double precision. The unqualified names are double, as
+// they were before the type was a template
+typedef bq_complex<float> bq_complex_float_t;
+typedef bq_complex<double> bq_complex_double_t;
+typedef double bq_complex_element_t;
+typedef bq_complex<bq_complex_element_t> bq_complex_t;
 #endif
 
 }
@@ -0,0 +1,188 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    bqvec
+
+    A small library for vector arithmetic and allocation in C++ using
+    raw C pointer arrays.
+
+    Copyright 2007-2015 Particular Programs Ltd.
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of Chris Cannam and
+    Particular Programs Ltd shall not be used in advertising or
+    otherwise to promote the sale, use or other dealings in this
+    Software without prior written authorization.
+*/
+
+#ifndef BQVEC_MPSC_RINGBUFFER_H
+#define BQVEC_MPSC_RINGBUFFER_H
+
+#include "SPSCRingBuffer.h"
+
+namespace breakfastquay {
+
+/**
+ * MPSCRingBuffer is a ring buffer for any number of writers and one
+ * reader, storing a sample type T. Reading is as for SPSCRingBuffer.
+ *
+ * A writer first reserves space by advancing a reservation index
+ * with compare-and-swap, so that concurrent writers claim disjoint
+ * regions without taking a lock, then copies its samples in, then
+ * publishes them. Publication happens in reservation order: a writer
+ * whose region follows one still being copied waits, spinning, until
+ * that one has been published. The reader never waits, and never
+ * sees a region before it is complete. Since a waiting writer spins,
+ * writers should not be given a higher priority than one another on
+ * the same core.
+ *
+ * Each call to write() or zero() is placed contiguously, so the
+ * samples from one call are never interleaved with another's.
+ */
+template <typename T>
+class MPSCRingBuffer : public SPSCRingBuffer<T>
+{
+public:
+    /**
+     * Create a ring buffer with room to write n samples.
+     */
+    MPSCRingBuffer(int n) : SPSCRingBuffer<T>(n) { }
+
+    virtual ~MPSCRingBuffer() { }
+
+    /**
+     * Reset read and write pointers, thus emptying the buffer. Must
+     * not be called while any other thread is reading or writing.
+     */
+    void reset();
+
+    /**
+     * Return the amount of space available for writing, in samples,
+     * after the regions currently reserved by writers.
+     */
+    int getWriteSpace() const {
+        return this->m_size -
+            int(m_reserved.loadAcquire() - this->m_reader.loadAcquire());
+    }
+
+    /**
+     * Write n samples to the buffer. May be called from several
+     * threads at once. If insufficient space is available, not all
+     * samples may actually be written. Returns the number of samples
+     * actually written.
+     */
+    template <typename S>
+    int write(const S *const BQ_R__ source, int n);
+
+    /**
+     * Write n zero-value samples to the buffer. May be called from
+     * several threads at once. Returns the number of zeroes actually
+     * written.
+     */
+    int zero(int n);
+
+protected:
+    AtomicIndex m_reserved;
+    char m_pad3[BQ_CACHE_LINE_SIZE];
+
+    // Reserve up to n samples, returning the number reserved and the
+    // index at which they start
+    int reserve(int n, unsigned int &w) {
+        int count;
+        do {
+            w = m_reserved.load();
+            // If the reader has moved past w, w is stale and the CAS
+            // below will fail
+            int available =
+                this->m_size - int(w - this->m_reader.loadAcquire());
+            count = (n < available ? n : available);
+            if (count <= 0) return 0;
+        } while (!m_reserved.compareAndSwap(w, w + count));
+        return count;
+    }
+
+    // Publish count samples reserved at w, once those reserved before
+    // them are published. The acquire here followed by our release
+    // makes the earlier writers' samples visible to the reader along
+    // with ours
+    void publish(unsigned int w, int count) {
+        while (this->m_writer.loadAcquire() != w) ;
+        this->m_writer.storeRelease(w + count);
+    }
+
+private:
+    // Writing in place cannot be shared between writers
+    int getWriteRegions(int, T *&, int &, T *&, int &);
+    int commitWrite(int);
+
+    MPSCRingBuffer(const MPSCRingBuffer &); // not provided
+    MPSCRingBuffer &operator=(const MPSCRingBuffer &); // not provided
+};
+
+template <typename T>
+void
+MPSCRingBuffer<T>::reset()
+{
+    unsigned int r = this->m_reader.load();
+    this->m_writerSeen = r;
+    m_reserved.storeRelease(r);
+    this->m_writer.storeRelease(r);
+}
+
+template <typename T>
+template <typename S>
+int
+MPSCRingBuffer<T>::write(const S *const BQ_R__ source, int n)
+{
+    unsigned int w = 0;
+    int count = reserve(n, w);
+    if (count == 0) return 0;
+
+    this->copyIn(w, source, count);
+
+    publish(w, count);
+    return count;
+}
+
+template <typename T>
+int
+MPSCRingBuffer<T>::zero(int n)
+{
+    unsigned int w = 0;
+    int count = reserve(n, w);
+    if (count == 0) return 0;
+
+    int at = int(w & this->m_mask);
+    int here = int(this->m_mask + 1) - at;
+    if (here >= count) {
+        v_zero(this->m_buffer + at, count);
+    } else {
+        v_zero(this->m_buffer + at, here);
+        v_zero(this->m_buffer, count - here);
+    }
+
+    publish(w, count);
+    return count;
+}
+
+}
+
+#endif
@@ -0,0 +1,419 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    bqvec
+
+    A small library for vector arithmetic and allocation in C++ using
+    raw C pointer arrays.
+
+    Copyright 2007-2015 Particular Programs Ltd.
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of Chris Cannam and
+    Particular Programs Ltd shall not be used in advertising or
+    otherwise to promote the sale, use or other dealings in this
+    Software without prior written authorization.
+*/
+
+#ifndef BQVEC_MULTICHANNEL_RINGBUFFER_H
+#define BQVEC_MULTICHANNEL_RINGBUFFER_H
+
+#include "Barrier.h"
+#include "Allocators.h"
+#include "VectorOps.h"
+
+namespace breakfastquay {
+
+/**
+ * MultiChannelRingBuffer is a lock-free ring buffer for one writer
+ * and one reader, storing a fixed number of channels of a sample
+ * type T that are always read and written together.
+ *
+ * The channels share one pair of indices, so a read or write of any
+ * number of channels costs one index update. Samples may be written
+ * and read either channel-planar, as one array per channel, or
+ * channel-interleaved, as a single array of frames. Storage is
+ * planar, one array per channel, so planar access is a copy per
+ * channel and interleaved access an interleave or deinterleave.
+ *
+ * Sizes and counts are in sample frames, i.e. samples per channel.
+ * The indices are shared as for SPSCRingBuffer, and as there, a read
+ * or write that is cut short is not reported except through the
+ * returned count.
+ */
+template <typename T>
+class MultiChannelRingBuffer
+{
+public:
+    /**
+     * Create a ring buffer with the given number of channels and
+     * room to write n sample frames.
+     */
+    MultiChannelRingBuffer(int channels, int n);
+
+    virtual ~MultiChannelRingBuffer();
+
+    int getChannelCount() const { return m_channels; }
+
+    /**
+     * Return the total capacity of the ring buffer in sample frames.
+     */
+    int getSize() const { return m_size; }
+
+    /**
+     * Reset read and write pointers, thus emptying the buffer. Must
+     * not be called while the other thread is reading or writing.
+     */
+    void reset();
+
+    /**
+     * Return the amount of data available for reading, in frames.
+     */
+    int getReadSpace() const {
+        return int(m_writer.loadAcquire() - m_reader.loadAcquire());
+    }
+
+    /**
+     * Return the amount of space available for writing, in frames.
+     */
+    int getWriteSpace() const {
+        return m_size - int(m_writer.loadAcquire() - m_reader.loadAcquire());
+    }
+
+    /**
+     * Read n frames into the channel arrays of destination. Returns
+     * the number of frames actually read; if fewer than n, the
+     * remainder of each array is left unchanged.
+     */
+    template <typename S>
+    int read(S *const BQ_R__ *const BQ_R__ destination, int n);
+
+    /**
+     * Read n frames into destination, interleaved, i.e. channel c of
+     * frame i is at index i * channels + c. Returns the number of
+     * frames actually read.
+     */
+    int readInterleaved(T *const BQ_R__ destination, int n);
+
+    /**
+     * Read n frames, adding them to the channel arrays of
+     * destination. Returns the number of frames actually read.
+     */
+    template <typename S>
+    int readAdding(S *const BQ_R__ *const BQ_R__ destination, int n);
+
+    /**
+     * Read n frames into the channel arrays of destination without
+     * advancing the read pointer. If fewer than n are available, the
+     * remainder of each array is zeroed out. Returns the number of
+     * frames actually read.
+     */
+    int peek(T *const BQ_R__ *const BQ_R__ destination, int n) const;
+
+    /**
+     * Discard the next n frames. Returns the number of frames
+     * actually available for discarding.
+     */
+    int skip(int n);
+
+    /**
+     * Write n frames from the channel arrays of source. Returns the
+     * number of frames actually written.
+     */
+    template <typename S>
+    int write(const S *const BQ_R__ *const BQ_R__ source, int n);
+
+    /**
+     * Write n frames from source, interleaved. Returns the number of
+     * frames actually written.
+     */
+    int writeInterleaved(const T *const BQ_R__ source, int n);
+
+    /**
+     * Write n frames of zeros. Returns the number of frames actually
+     * written.
+     */
+    int zero(int n);
+
+protected:
+    const int m_channels;
+    const int m_size;
+    const unsigned int m_mask;
+    T *const BQ_R__ *const BQ_R__ m_buffers;
+
+    // Channel pointers for the interleave and deinterleave calls,
+    // one set for each thread
+    const T **m_readPtrs;
+    T **m_writePtrs;
+
+    // Indices, and each thread's copy of the other's, as for
+    // SPSCRingBuffer
+    char m_pad0[BQ_CACHE_LINE_SIZE];
+    AtomicIndex m_writer;
+    unsigned int m_readerSeen;
+    char m_pad1[BQ_CACHE_LINE_SIZE];
+    AtomicIndex m_reader;
+    mutable unsigned int m_writerSeen;
+    char m_pad2[BQ_CACHE_LINE_SIZE];
+
+    static unsigned int storageFor(int n) {
+        unsigned int storage = 1;
+        while (storage < (unsigned int)n) storage <<= 1;
+        return storage;
+    }
+
+    int readSpaceFrom(unsigned int r, int n) const {
+        int space = int(m_writerSeen - r);
+        if (space < n) {
+            m_writerSeen = m_writer.loadAcquire();
+            space = int(m_writerSeen - r);
+        }
+        return space;
+    }
+
+    int writeSpaceFrom(unsigned int w, int n) {
+        int space = m_size - int(w - m_readerSeen);
+        if (space < n) {
+            m_readerSeen = m_reader.loadAcquire();
+            space = m_size - int(w - m_readerSeen);
+        }
+        return space;
+    }
+
+    // Split n frames from index i into the part before the end of
+    // the storage, starting at position at, and the part after
+    void split(unsigned int i, int n, int &at, int &here) const {
+        at = int(i & m_mask);
+        here = int(m_mask + 1) - at;
+        if (here > n) here = n;
+    }
+
+private:
+    MultiChannelRingBuffer(const MultiChannelRingBuffer &); // not provided
+    MultiChannelRingBuffer &operator=(const MultiChannelRingBuffer &); // not provided
+};
+
+template <typename T>
+MultiChannelRingBuffer<T>::MultiChannelRingBuffer(int channels, int n) :
+    m_channels(channels),
+    m_size(n),
+    m_mask(storageFor(n) - 1),
+    m_buffers(allocate_and_zero_channels<T>(channels, storageFor(n))),
+    m_readPtrs(new const T *[channels]),
+    m_writePtrs(new T *[channels]),
+    m_readerSeen(0),
+    m_writerSeen(0)
+{
+}
+
+template <typename T>
+MultiChannelRingBuffer<T>::~MultiChannelRingBuffer()
+{
+    deallocate_channels(const_cast<T **>(m_buffers), m_channels);
+    delete[] m_readPtrs;
+    delete[] m_writePtrs;
+}
+
+template <typename T>
+void
+MultiChannelRingBuffer<T>::reset()
+{
+    unsigned int r = m_reader.load();
+    m_readerSeen = r;
+    m_writerSeen = r;
+    m_writer.storeRelease(r);
+}
+
+template <typename T>
+template <typename S>
+int
+MultiChannelRingBuffer<T>::read(S *const BQ_R__ *const BQ_R__ destination,
+                                int n)
+{
+    unsigned int r = m_reader.load();
+    int available = readSpaceFrom(r, n);
+    if (n > available) n = available;
+    if (n <= 0) return 0;
+
+    int at, here;
+    split(r, n, at, here);
+    for (int c = 0; c < m_channels; ++c) {
+        v_convert(destination[c], m_buffers[c] + at, here);
+        v_convert(destination[c] + here, m_buffers[c], n - here);
+    }
+
+    m_reader.storeRelease(r + n);
+    return n;
+}
+
+template <typename T>
+int
+MultiChannelRingBuffer<T>::readInterleaved(T *const BQ_R__ destination,
+                                           int n)
+{
+    unsigned int r = m_reader.load();
+    int available = readSpaceFrom(r, n);
+    if (n > available) n = available;
+    if (n <= 0) return 0;
+
+    int at, here;
+    split(r, n, at, here);
+    for (int c = 0; c < m_channels; ++c) m_readPtrs[c] = m_buffers[c] + at;
+    v_interleave(destination, m_readPtrs, m_channels, here);
+    if (n > here) {
+        for (int c = 0; c < m_channels; ++c) m_readPtrs[c] = m_buffers[c];
+        v_interleave(destination + here * m_channels, m_readPtrs,
+                     m_channels, n - here);
+    }
+
+    m_reader.storeRelease(r + n);
+    return n;
+}
+
+template <typename T>
+template <typename S>
+int
+MultiChannelRingBuffer<T>::readAdding(S *const BQ_R__ *const BQ_R__ destination,
+                                      int n)
+{
+    unsigned int r = m_reader.load();
+    int available = readSpaceFrom(r, n);
+    if (n > available) n = available;
+    if (n <= 0) return 0;
+
+    int at, here;
+    split(r, n, at, here);
+    for (int c = 0; c < m_channels; ++c) {
+        v_add(destination[c], m_buffers[c] + at, here);
+        v_add(destination[c] + here, m_buffers[c], n - here);
+    }
+
+    m_reader.storeRelease(r + n);
+    return n;
+}
+
+template <typename T>
+int
+MultiChannelRingBuffer<T>::peek(T *const BQ_R__ *const BQ_R__ destination,
+                                int n) const
+{
+    unsigned int r = m_reader.load();
+    int available = readSpaceFrom(r, n);
+    if (n > available) {
+        for (int c = 0; c < m_channels; ++c) {
+            v_zero(destination[c] + available, n - available);
+        }
+        n = available;
+    }
+    if (n <= 0) return 0;
+
+    int at, here;
+    split(r, n, at, here);
+    for (int c = 0; c < m_channels; ++c) {
+        v_copy(destination[c], m_buffers[c] + at, here);
+        v_copy(destination[c] + here, m_buffers[c], n - here);
+    }
+
+    return n;
+}
+
+template <typename T>
+int
+MultiChannelRingBuffer<T>::skip(int n)
+{
+    unsigned int r = m_reader.load();
+    int available = readSpaceFrom(r, n);
+    if (n > available) n = available;
+    if (n <= 0) return 0;
+
+    m_reader.storeRelease(r + n);
+    return n;
+}
+
+template <typename T>
+template <typename S>
+int
+MultiChannelRingBuffer<T>::write(const S *const BQ_R__ *const BQ_R__ source,
+                                 int n)
+{
+    unsigned int w = m_writer.load();
+    int available = writeSpaceFrom(w, n);
+    if (n > available) n = available;
+    if (n <= 0) return 0;
+
+    int at, here;
+    split(w, n, at, here);
+    for (int c = 0; c < m_channels; ++c) {
+        v_convert<S, T>(m_buffers[c] + at, source[c], here);
+        v_convert<S, T>(m_buffers[c], source[c] + here, n - here);
+    }
+
+    m_writer.storeRelease(w + n);
+    return n;
+}
+
+template <typename T>
+int
+MultiChannelRingBuffer<T>::writeInterleaved(const T *const BQ_R__ source,
+                                            int n)
+{
+    unsigned int w = m_writer.load();
+    int available = writeSpaceFrom(w, n);
+    if (n > available) n = available;
+    if (n <= 0) return 0;
+
+    int at, here;
+    split(w, n, at, here);
+    for (int c = 0; c < m_channels; ++c) m_writePtrs[c] = m_buffers[c] + at;
+    v_deinterleave(m_writePtrs, source, m_channels, here);
+    if (n > here) {
+        for (int c = 0; c < m_channels; ++c) m_writePtrs[c] = m_buffers[c];
+        v_deinterleave(m_writePtrs, source + here * m_channels,
+                       m_channels, n - here);
+    }
+
+    m_writer.storeRelease(w + n);
+    return n;
+}
+
+template <typename T>
+int
+MultiChannelRingBuffer<T>::zero(int n)
+{
+    unsigned int w = m_writer.load();
+    int available = writeSpaceFrom(w, n);
+    if (n > available) n = available;
+    if (n <= 0) return 0;
+
+    int at, here;
+    split(w, n, at, here);
+    for (int c = 0; c < m_channels; ++c) {
+        v_zero(m_buffers[c] + at, here);
+        v_zero(m_buffers[c], n - here);
+    }
+
+    m_writer.storeRelease(w + n);
+    return n;
+}
+
+}
+
+#endif
@@ -42,6 +42,7 @@
 
 #include "Barrier.h"
 #include "Allocators.h"
+#include "VectorOps.h"
 
 #include <iostream>
 
@@ -178,6 +179,42 @@ public:
      */
     int zero(int n);
 
+    /**
+     * Return up to n of the samples available for reading, in place
+     * in the buffer, without advancing the read pointer. They are
+     * returned as up to two contiguous regions, region1 of count1
+     * samples followed by region2 of count2 samples, the second being
+     * empty unless the samples wrap round the end of the buffer.
+     * Returns count1 + count2. The regions remain valid until the
+     * read pointer is next advanced, for example by commitRead().
+     */
+    int getReadRegions(int n, const T *&region1, int &count1,
+                       const T *&region2, int &count2) const;
+
+    /**
+     * Advance the read pointer by n samples, following a call to
+     * getReadRegions() that returned at least n. Returns the number
+     * of samples actually available for advancing over.
+     */
+    int commitRead(int n);
+
+    /**
+     * Return up to n samples of the space available for writing, in
+     * place in the buffer, as up to two contiguous regions as for
+     * getReadRegions(). Returns count1 + count2. Samples written into
+     * the regions become readable when commitWrite() is called.
+     */
+    int getWriteRegions(int n, T *&region1, int &count1,
+                        T *&region2, int &count2);
+
+    /**
+     * Advance the write pointer by n samples, making that many
+     * samples written into the regions from getWriteRegions()
+     * available for reading. Returns the number of samples actually
+     * committed, which is limited by the space available.
+     */
+    int commitWrite(int n);
+
 protected:
     T *const BQ_R__ m_buffer;
     int             m_writer;
@@ -511,6 +548,115 @@ RingBuffer<T>::zero(int n)
     return n;
 }
 
+template <typename T>
+int
+RingBuffer<T>::getReadRegions(int n, const T *&region1, int &count1,
+                              const T *&region2, int &count2) const
+{
+    int w = m_writer;
+    int r = m_reader;
+
+    int available = readSpaceFor(w, r);
+    if (n > available) n = available;
+
+    // The caller reads the data directly after this, so make sure
+    // it is there
+    BQ_MBARRIER();
+
+    int here = m_size - r;
+    region1 = m_buffer + r;
+    region2 = m_buffer;
+    if (here >= n) {
+        count1 = n;
+        count2 = 0;
+    } else {
+        count1 = here;
+        count2 = n - here;
+    }
+
+    return n;
+}
+
+template <typename T>
+int
+RingBuffer<T>::commitRead(int n)
+{
+    int w = m_writer;
+    int r = m_reader;
+
+    int available = readSpaceFor(w, r);
+    if (n > available) {
+	std::cerr << "WARNING: RingBuffer::commitRead: " << n
+                  << " requested, only " << available << " available"
+                  << std::endl;
+	n = available;
+    }
+    if (n == 0) return n;
+
+    r += n;
+    while (r >= m_size) r -= m_size;
+
+    // Unlike skip(), the caller has read data, which must be done
+    // with before the writer may reuse its space
+    BQ_MBARRIER();
+    m_reader = r;
+
+    return n;
+}
+
+template <typename T>
+int
+RingBuffer<T>::getWriteRegions(int n, T *&region1, int &count1,
+                               T *&region2, int &count2)
+{
+    int w = m_writer;
+    int r = m_reader;
+
+    int available = writeSpaceFor(w, r);
+    if (n > available) n = available;
+
+    // Likewise, the reader must be done with the space before the
+    // caller writes to it
+    BQ_MBARRIER();
+
+    int here = m_size - w;
+    region1 = m_buffer + w;
+    region2 = m_buffer;
+    if (here >= n) {
+        count1 = n;
+        count2 = 0;
+    } else {
+        count1 = here;
+        count2 = n - here;
+    }
+
+    return n;
+}
+
+template <typename T>
+int
+RingBuffer<T>::commitWrite(int n)
+{
+    int w = m_writer;
+    int r = m_reader;
+
+    int available = writeSpaceFor(w, r);
+    if (n > available) {
+	std::cerr << "WARNING: RingBuffer::commitWrite: " << n
+                  << " requested, only room for " << available << std::endl;
+	n = available;
+    }
+    if (n == 0) return n;
+
+    w += n;
+    while (w >= m_size) w -= m_size;
+
+    BQ_MBARRIER();
+    m_writer = w;
+
+    return n;
+}
+
 }
 
 #endif // BQVEC_RINGBUFFER_H
@@ -0,0 +1,491 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    bqvec
+
+    A small library for vector arithmetic and allocation in C++ using
+    raw C pointer arrays.
+
+    Copyright 2007-2015 Particular Programs Ltd.
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of Chris Cannam and
+    Particular Programs Ltd shall not be used in advertising or
+    otherwise to promote the sale, use or other dealings in this
+    Software without prior written authorization.
+*/
+
+#ifndef BQVEC_SPSC_RINGBUFFER_H
+#define BQVEC_SPSC_RINGBUFFER_H
+
+#include "Barrier.h"
+#include "Allocators.h"
+#include "VectorOps.h"
+
+namespace breakfastquay {
+
+/**
+ * SPSCRingBuffer is a lock-free ring buffer for one writer and one
+ * reader, storing a sample type T, with the same interface as
+ * RingBuffer.
+ *
+ * It differs from RingBuffer in the way the two threads share their
+ * indices. These are AtomicIndex counters, published with release
+ * stores and read with acquire loads rather than ordered by full
+ * memory barriers, and each is kept on its own cache line, with a
+ * private copy of the other thread's index, so that a thread touches
+ * the other's line only when its copy no longer shows enough data or
+ * space. The storage is rounded up to a power of two internally, and
+ * every slot of the requested size is usable.
+ *
+ * Unlike RingBuffer, it prints no warning when a read or write is
+ * cut short: callers should check the returned counts.
+ */
+template <typename T>
+class SPSCRingBuffer
+{
+public:
+    /**
+     * Create a ring buffer with room to write n samples.
+     */
+    SPSCRingBuffer(int n);
+
+    virtual ~SPSCRingBuffer();
+
+    /**
+     * Return the total capacity of the ring buffer in samples.
+     * (This is the argument n passed to the constructor.)
+     */
+    int getSize() const { return m_size; }
+
+    /**
+     * Reset read and write pointers, thus emptying the buffer. Must
+     * not be called while the other thread is reading or writing.
+     */
+    void reset();
+
+    /**
+     * Return the amount of data available for reading, in samples.
+     */
+    int getReadSpace() const {
+        return int(m_writer.loadAcquire() - m_reader.loadAcquire());
+    }
+
+    /**
+     * Return the amount of space available for writing, in samples.
+     */
+    int getWriteSpace() const {
+        return m_size - int(m_writer.loadAcquire() - m_reader.loadAcquire());
+    }
+
+    /**
+     * Read n samples from the buffer. If fewer than n are available,
+     * the remainder of the destination is left unchanged. Returns the
+     * number of samples actually read.
+     */
+    template <typename S>
+    int read(S *const BQ_R__ destination, int n);
+
+    /**
+     * Read n samples from the buffer, adding them to the destination.
+     * Returns the number of samples actually read.
+     */
+    template <typename S>
+    int readAdding(S *const BQ_R__ destination, int n);
+
+    /**
+     * Read one sample from the buffer. If no sample is available,
+     * return zero.
+     */
+    T readOne();
+
+    /**
+     * Read n samples from the buffer, if available, without advancing
+     * the read pointer. If fewer than n are available, the remainder
+     * will be zeroed out. Returns the number of samples actually
+     * read.
+     */
+    int peek(T *const BQ_R__ destination, int n) const;
+
+    /**
+     * Read one sample from the buffer, if available, without
+     * advancing the read pointer. Returns zero if no sample was
+     * available.
+     */
+    T peekOne() const;
+
+    /**
+     * Discard the next n samples. Returns the number of samples
+     * actually available for discarding.
+     */
+    int skip(int n);
+
+    /**
+     * Write n samples to the buffer. If insufficient space is
+     * available, not all samples may actually be written. Returns
+     * the number of samples actually written.
+     */
+    template <typename S>
+    int write(const S *const BQ_R__ source, int n);
+
+    /**
+     * Write n zero-value samples to the buffer. Returns the number
+     * of zeroes actually written.
+     */
+    int zero(int n);
+
+    /**
+     * Return up to n of the samples available for reading, in place
+     * in the buffer, without advancing the read pointer. They are
+     * returned as up to two contiguous regions, region1 of count1
+     * samples followed by region2 of count2 samples, the second being
+     * empty unless the samples wrap round the end of the buffer.
+     * Returns count1 + count2. The regions remain valid until the
+     * read pointer is next advanced, for example by commitRead().
+     */
+    int getReadRegions(int n, const T *&region1, int &count1,
+                       const T *&region2, int &count2) const;
+
+    /**
+     * Advance the read pointer by n samples, following a call to
+     * getReadRegions() that returned at least n. Returns the number
+     * of samples actually available for advancing over.
+     */
+    int commitRead(int n);
+
+    /**
+     * Return up to n samples of the space available for writing, in
+     * place in the buffer, as up to two contiguous regions as for
+     * getReadRegions(). Returns count1 + count2. Samples written into
+     * the regions become readable when commitWrite() is called.
+     */
+    int getWriteRegions(int n, T *&region1, int &count1,
+                        T *&region2, int &count2);
+
+    /**
+     * Advance the write pointer by n samples, making that many
+     * samples written into the regions from getWriteRegions()
+     * available for reading. Returns the number of samples actually
+     * committed, which is limited by the space available.
+     */
+    int commitWrite(int n);
+
+protected:
+    T *const BQ_R__ m_buffer;
+    const int m_size;
+    const unsigned int m_mask;
+
+    // The writer's line, then the reader's. The indices count
+    // samples written and read since construction, wrapping at
+    // 2^32, so their difference is the read space and they may be
+    // reduced to a position in m_buffer by masking
+
+    char m_pad0[BQ_CACHE_LINE_SIZE];
+    AtomicIndex m_writer;
+    unsigned int m_readerSeen;
+    char m_pad1[BQ_CACHE_LINE_SIZE];
+    AtomicIndex m_reader;
+    mutable unsigned int m_writerSeen;
+    char m_pad2[BQ_CACHE_LINE_SIZE];
+
+    static unsigned int storageFor(int n) {
+        unsigned int storage = 1;
+        while (storage < (unsigned int)n) storage <<= 1;
+        return storage;
+    }
+
+    // Return the read space from reader index r, looking at the
+    // writer's index only if our copy of it shows fewer than n
+    int readSpaceFrom(unsigned int r, int n) const {
+        int space = int(m_writerSeen - r);
+        if (space < n) {
+            m_writerSeen = m_writer.loadAcquire();
+            space = int(m_writerSeen - r);
+        }
+        return space;
+    }
+
+    // Return the write space from writer index w, likewise
+    int writeSpaceFrom(unsigned int w, int n) {
+        int space = m_size - int(w - m_readerSeen);
+        if (space < n) {
+            m_readerSeen = m_reader.loadAcquire();
+            space = m_size - int(w - m_readerSeen);
+        }
+        return space;
+    }
+
+    template <typename S>
+    void copyIn(unsigned int w, const S *const BQ_R__ source, int n) {
+        int at = int(w & m_mask);
+        int here = int(m_mask + 1) - at;
+        if (here >= n) {
+            v_convert<S, T>(m_buffer + at, source, n);
+        } else {
+            v_convert<S, T>(m_buffer + at, source, here);
+            v_convert<S, T>(m_buffer, source + here, n - here);
+        }
+    }
+
+    template <typename S>
+    void copyOut(unsigned int r, S *const BQ_R__ destination, int n) const {
+        int at = int(r & m_mask);
+        int here = int(m_mask + 1) - at;
+        if (here >= n) {
+            v_convert(destination, m_buffer + at, n);
+        } else {
+            v_convert(destination, m_buffer + at, here);
+            v_convert(destination + here, m_buffer, n - here);
+        }
+    }
+
+private:
+    SPSCRingBuffer(const SPSCRingBuffer &); // not provided
+    SPSCRingBuffer &operator=(const SPSCRingBuffer &); // not provided
+};
+
+template <typename T>
+SPSCRingBuffer<T>::SPSCRingBuffer(int n) :
+    m_buffer(allocate_and_zero<T>(storageFor(n))),
+    m_size(n),
+    m_mask(storageFor(n) - 1),
+    m_readerSeen(0),
+    m_writerSeen(0)
+{
+}
+
+template <typename T>
+SPSCRingBuffer<T>::~SPSCRingBuffer()
+{
+    deallocate(m_buffer);
+}
+
+template <typename T>
+void
+SPSCRingBuffer<T>::reset()
+{
+    unsigned int r = m_reader.load();
+    m_readerSeen = r;
+    m_writerSeen = r;
+    m_writer.storeRelease(r);
+}
+
+template <typename T>
+template <typename S>
+int
+SPSCRingBuffer<T>::read(S *const BQ_R__ destination, int n)
+{
+    unsigned int r = m_reader.load();
+    int available = readSpaceFrom(r, n);
+    if (n > available) n = available;
+    if (n <= 0) return 0;
+
+    copyOut(r, destination, n);
+
+    m_reader.storeRelease(r + n);
+    return n;
+}
+
+template <typename T>
+template <typename S>
+int
+SPSCRingBuffer<T>::readAdding(S *const BQ_R__ destination, int n)
+{
+    unsigned int r = m_reader.load();
+    int available = readSpaceFrom(r, n);
+    if (n > available) n = available;
+    if (n <= 0) return 0;
+
+    int at = int(r & m_mask);
+    int here = int(m_mask + 1) - at;
+    if (here >= n) {
+        v_add(destination, m_buffer + at, n);
+    } else {
+        v_add(destination, m_buffer + at, here);
+        v_add(destination + here, m_buffer, n - here);
+    }
+
+    m_reader.storeRelease(r + n);
+    return n;
+}
+
+template <typename T>
+T
+SPSCRingBuffer<T>::readOne()
+{
+    unsigned int r = m_reader.load();
+    if (readSpaceFrom(r, 1) < 1) return T();
+
+    T value = m_buffer[r & m_mask];
+
+    m_reader.storeRelease(r + 1);
+    return value;
+}
+
+template <typename T>
+int
+SPSCRingBuffer<T>::peek(T *const BQ_R__ destination, int n) const
+{
+    unsigned int r = m_reader.load();
+    int available = readSpaceFrom(r, n);
+    if (n > available) {
+        v_zero(destination + available, n - available);
+        n = available;
+    }
+    if (n <= 0) return 0;
+
+    copyOut(r, destination, n);
+    return n;
+}
+
+template <typename T>
+T
+SPSCRingBuffer<T>::peekOne() const
+{
+    unsigned int r = m_reader.load();
+    if (readSpaceFrom(r, 1) < 1) return T();
+    return m_buffer[r & m_mask];
+}
+
+template <typename T>
+int
+SPSCRingBuffer<T>::skip(int n)
+{
+    unsigned int r = m_reader.load();
+    int available = readSpaceFrom(r, n);
+    if (n > available) n = available;
+    if (n <= 0) return 0;
+
+    m_reader.storeRelease(r + n);
+    return n;
+}
+
+template <typename T>
+template <typename S>
+int
+SPSCRingBuffer<T>::write(const S *const BQ_R__ source, int n)
+{
+    unsigned int w = m_writer.load();
+    int available = writeSpaceFrom(w, n);
+    if (n > available) n = available;
+    if (n <= 0) return 0;
+
+    copyIn(w, source, n);
+
+    m_writer.storeRelease(w + n);
+    return n;
+}
+
+template <typename T>
+int
+SPSCRingBuffer<T>::zero(int n)
+{
+    unsigned int w = m_writer.load();
+    int available = writeSpaceFrom(w, n);
+    if (n > available) n = available;
+    if (n <= 0) return 0;
+
+    int at = int(w & m_mask);
+    int here = int(m_mask + 1) - at;
+    if (here >= n) {
+        v_zero(m_buffer + at, n);
+    } else {
+        v_zero(m_buffer + at, here);
+        v_zero(m_buffer, n - here);
+    }
+
+    m_writer.storeRelease(w + n);
+    return n;
+}
+
+template <typename T>
+int
+SPSCRingBuffer<T>::getReadRegions(int n, const T *&region1, int &count1,
+                                  const T *&region2, int &count2) const
+{
+    unsigned int r = m_reader.load();
+    int available = readSpaceFrom(r, n);
+    if (n > available) n = available;
+    if (n < 0) n = 0;
+
+    int at = int(r & m_mask);
+    int here = int(m_mask + 1) - at;
+    region1 = m_buffer + at;
+    region2 = m_buffer;
+    if (here >= n) {
+        count1 = n;
+        count2 = 0;
+    } else {
+        count1 = here;
+        count2 = n - here;
+    }
+
+    return n;
+}
+
+template <typename T>
+int
+SPSCRingBuffer<T>::commitRead(int n)
+{
+    return skip(n);
+}
+
+template <typename T>
+int
+SPSCRingBuffer<T>::getWriteRegions(int n, T *&region1, int &count1,
+                                   T *&region2, int &count2)
+{
+    unsigned int w = m_writer.load();
+    int available = writeSpaceFrom(w, n);
+    if (n > available) n = available;
+    if (n < 0) n = 0;
+
+    int at = int(w & m_mask);
+    int here = int(m_mask + 1) - at;
+    region1 = m_buffer + at;
+    region2 = m_buffer;
+    if (here >= n) {
+        count1 = n;
+        count2 = 0;
+    } else {
+        count1 = here;
+        count2 = n - here;
+    }
+
+    return n;
+}
+
+template <typename T>
+int
+SPSCRingBuffer<T>::commitWrite(int n)
+{
+    unsigned int w = m_writer.load();
+    int available = writeSpaceFrom(w, n);
+    if (n > available) n = available;
+    if (n <= 0) return 0;
+
+    m_writer.storeRelease(w + n);
+    return n;
+}
+
+}
+
+#endif
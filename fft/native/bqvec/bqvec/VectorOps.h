@@ -49,6 +49,7 @@
 #endif
 
 #include <cstring>
+#include <cmath>
 
 #include "Restrict.h"
 
@@ -60,8 +61,9 @@ namespace breakfastquay {
  * Write basic vector-manipulation loops in such a way as to promote
  * the likelihood that a good current C++ compiler can auto-vectorize
  * them (e.g. gcc-4.x with -ftree-vectorize). Provide calls out to
- * supported vector libraries (e.g. IPP, Accelerate) where useful.
- * No intrinsics or assembly.
+ * supported vector libraries (e.g. IPP, Accelerate) where useful,
+ * or to bqvec's own SIMD code if HAVE_BQ_SIMD is defined (see
+ * below). No intrinsics or assembly in this header.
  *
  * Note that all size and index arguments are plain machine ints, to
  * facilitate compiler optimization and vectorization. In general
@@ -94,6 +96,72 @@ namespace breakfastquay {
  * except where documented.
  */
 
+#if defined HAVE_BQ_SIMD
+
+/*
+ * bqvec's own SIMD implementations, in src/VectorOpsSIMD.cpp. With
+ * HAVE_BQ_SIMD defined, the float and double specialisations below
+ * call these, except where IPP or vDSP provides the function. Each
+ * uses SSE2, AVX2 or AVX-512 code on x86, whichever is the best the
+ * CPU it is running on supports, or NEON on 64-bit ARM, and plain
+ * loops elsewhere. Results may differ in the last place from those
+ * of the generic code, as sums are accumulated in a different order
+ * and the float log and exp are polynomial approximations.
+ */
+
+void v_add_simd(float *const BQ_R__ dst, const float *const BQ_R__ src, const int count);
+void v_add_simd(double *const BQ_R__ dst, const double *const BQ_R__ src, const int count);
+void v_add_simd(float *const BQ_R__ dst, const float value, const int count);
+void v_add_simd(double *const BQ_R__ dst, const double value, const int count);
+void v_add_with_gain_simd(float *const BQ_R__ dst, const float *const BQ_R__ src, const float gain, const int count);
+void v_add_with_gain_simd(double *const BQ_R__ dst, const double *const BQ_R__ src, const double gain, const int count);
+void v_subtract_simd(float *const BQ_R__ dst, const float *const BQ_R__ src, const int count);
+void v_subtract_simd(double *const BQ_R__ dst, const double *const BQ_R__ src, const int count);
+void v_scale_simd(float *const BQ_R__ dst, const float gain, const int count);
+void v_scale_simd(double *const BQ_R__ dst, const double gain, const int count);
+void v_multiply_simd(float *const BQ_R__ dst, const float *const BQ_R__ src, const int count);
+void v_multiply_simd(double *const BQ_R__ dst, const double *const BQ_R__ src, const int count);
+void v_multiply_simd(float *const BQ_R__ dst, const float *const BQ_R__ src1, const float *const BQ_R__ src2, const int count);
+void v_multiply_simd(double *const BQ_R__ dst, const double *const BQ_R__ src1, const double *const BQ_R__ src2, const int count);
+void v_divide_simd(float *const BQ_R__ dst, const float *const BQ_R__ src, const int count);
+void v_divide_simd(double *const BQ_R__ dst, const double *const BQ_R__ src, const int count);
+void v_multiply_and_add_simd(float *const BQ_R__ dst, const float *const BQ_R__ src1, const float *const BQ_R__ src2, const int count);
+void v_multiply_and_add_simd(double *const BQ_R__ dst, const double *const BQ_R__ src1, const double *const BQ_R__ src2, const int count);
+float v_sum_simd(const float *const BQ_R__ src, const int count);
+double v_sum_simd(const double *const BQ_R__ src, const int count);
+float v_multiply_and_sum_simd(const float *const BQ_R__ src1, const float *const BQ_R__ src2, const int count);
+double v_multiply_and_sum_simd(const double *const BQ_R__ src1, const double *const BQ_R__ src2, const int count);
+float v_sum_squares_simd(const float *const BQ_R__ src, const int count);
+double v_sum_squares_simd(const double *const BQ_R__ src, const int count);
+float v_min_simd(const float *const BQ_R__ src, const int count);
+double v_min_simd(const double *const BQ_R__ src, const int count);
+float v_max_simd(const float *const BQ_R__ src, const int count);
+double v_max_simd(const double *const BQ_R__ src, const int count);
+int v_min_index_simd(const float *const BQ_R__ src, const int count);
+int v_min_index_simd(const double *const BQ_R__ src, const int count);
+int v_max_index_simd(const float *const BQ_R__ src, const int count);
+int v_max_index_simd(const double *const BQ_R__ src, const int count);
+void v_log_simd(float *const BQ_R__ dst, const int count);
+void v_exp_simd(float *const BQ_R__ dst, const int count);
+void v_sqrt_simd(float *const BQ_R__ dst, const int count);
+void v_sqrt_simd(double *const BQ_R__ dst, const int count);
+void v_square_simd(float *const BQ_R__ dst, const int count);
+void v_square_simd(double *const BQ_R__ dst, const int count);
+void v_abs_simd(float *const BQ_R__ dst, const int count);
+void v_abs_simd(double *const BQ_R__ dst, const int count);
+void v_convert_simd(double *const BQ_R__ dst, const float *const BQ_R__ src, const int count);
+void v_convert_simd(float *const BQ_R__ dst, const double *const BQ_R__ src, const int count);
+void v_interleave_simd(float *const BQ_R__ dst, const float *const BQ_R__ *const BQ_R__ src, const int channels, const int count);
+void v_deinterleave_simd(float *const BQ_R__ *const BQ_R__ dst, const float *const BQ_R__ src, const int channels, const int count);
+
+/**
+ * Return the name of the instruction set the SIMD functions are
+ * using: "sse2", "avx2", "avx512", "neon" or "none".
+ */
+const char *v_simd_instruction_set();
+
+#endif
+
 /**
  * v_zero
  *
@@ -322,6 +390,21 @@ inline void v_convert(float *const BQ_R__ dst,
 {
     vDSP_vdpsp((double *)src, 1, dst, 1, count);
 }
+#elif defined HAVE_BQ_SIMD
+template<>
+inline void v_convert(double *const BQ_R__ dst,
+                      const float *const BQ_R__ src,
+                      const int count)
+{
+    v_convert_simd(dst, src, count);
+}
+template<>
+inline void v_convert(float *const BQ_R__ dst,
+                      const double *const BQ_R__ src,
+                      const int count)
+{
+    v_convert_simd(dst, src, count);
+}
 #endif
 
 /**
@@ -397,6 +480,35 @@ inline void v_add(double *const BQ_R__ dst,
 {
     ippsAdd_64f_I(src, dst, count);
 }    
+#elif defined HAVE_BQ_SIMD
+template<>
+inline void v_add(float *const BQ_R__ dst,
+                  const float *const BQ_R__ src,
+                  const int count)
+{
+    v_add_simd(dst, src, count);
+}
+template<>
+inline void v_add(double *const BQ_R__ dst,
+                  const double *const BQ_R__ src,
+                  const int count)
+{
+    v_add_simd(dst, src, count);
+}
+template<>
+inline void v_add(float *const BQ_R__ dst,
+                  const float value,
+                  const int count)
+{
+    v_add_simd(dst, value, count);
+}
+template<>
+inline void v_add(double *const BQ_R__ dst,
+                  const double value,
+                  const int count)
+{
+    v_add_simd(dst, value, count);
+}
 #endif
 
 /**
@@ -441,6 +553,25 @@ inline void v_add_with_gain(T *const BQ_R__ dst,
     }
 }
 
+#if defined HAVE_BQ_SIMD
+template<>
+inline void v_add_with_gain(float *const BQ_R__ dst,
+                            const float *const BQ_R__ src,
+                            const float gain,
+                            const int count)
+{
+    v_add_with_gain_simd(dst, src, gain, count);
+}
+template<>
+inline void v_add_with_gain(double *const BQ_R__ dst,
+                            const double *const BQ_R__ src,
+                            const double gain,
+                            const int count)
+{
+    v_add_with_gain_simd(dst, src, gain, count);
+}
+#endif
+
 /**
  * v_add_channels_with_gain
  *
@@ -498,6 +629,21 @@ inline void v_subtract(double *const BQ_R__ dst,
 {
     ippsSub_64f_I(src, dst, count);
 }    
+#elif defined HAVE_BQ_SIMD
+template<>
+inline void v_subtract(float *const BQ_R__ dst,
+                       const float *const BQ_R__ src,
+                       const int count)
+{
+    v_subtract_simd(dst, src, count);
+}
+template<>
+inline void v_subtract(double *const BQ_R__ dst,
+                       const double *const BQ_R__ src,
+                       const int count)
+{
+    v_subtract_simd(dst, src, count);
+}
 #endif
 
 /**
@@ -531,6 +677,21 @@ inline void v_scale(double *const BQ_R__ dst,
 {
     ippsMulC_64f_I(gain, dst, count);
 }
+#elif defined HAVE_BQ_SIMD
+template<>
+inline void v_scale(float *const BQ_R__ dst,
+                    const float gain,
+                    const int count)
+{
+    v_scale_simd(dst, gain, count);
+}
+template<>
+inline void v_scale(double *const BQ_R__ dst,
+                    const double gain,
+                    const int count)
+{
+    v_scale_simd(dst, gain, count);
+}
 #endif
 
 /**
@@ -567,6 +728,21 @@ inline void v_multiply(double *const BQ_R__ dst,
 {
     ippsMul_64f_I(src, dst, count);
 }
+#elif defined HAVE_BQ_SIMD
+template<>
+inline void v_multiply(float *const BQ_R__ dst,
+                       const float *const BQ_R__ src,
+                       const int count)
+{
+    v_multiply_simd(dst, src, count);
+}
+template<>
+inline void v_multiply(double *const BQ_R__ dst,
+                       const double *const BQ_R__ src,
+                       const int count)
+{
+    v_multiply_simd(dst, src, count);
+}
 #endif
 
 /**
@@ -607,6 +783,23 @@ inline void v_multiply(double *const BQ_R__ dst,
 {
     ippsMul_64f(src1, src2, dst, count);
 }
+#elif defined HAVE_BQ_SIMD
+template<>
+inline void v_multiply(float *const BQ_R__ dst,
+                       const float *const BQ_R__ src1,
+                       const float *const BQ_R__ src2,
+                       const int count)
+{
+    v_multiply_simd(dst, src1, src2, count);
+}
+template<>
+inline void v_multiply(double *const BQ_R__ dst,
+                       const double *const BQ_R__ src1,
+                       const double *const BQ_R__ src2,
+                       const int count)
+{
+    v_multiply_simd(dst, src1, src2, count);
+}
 #endif
 
 /**
@@ -643,6 +836,21 @@ inline void v_divide(double *const BQ_R__ dst,
 {
     ippsDiv_64f_I(src, dst, count);
 }
+#elif defined HAVE_BQ_SIMD
+template<>
+inline void v_divide(float *const BQ_R__ dst,
+                     const float *const BQ_R__ src,
+                     const int count)
+{
+    v_divide_simd(dst, src, count);
+}
+template<>
+inline void v_divide(double *const BQ_R__ dst,
+                     const double *const BQ_R__ src,
+                     const int count)
+{
+    v_divide_simd(dst, src, count);
+}
 #endif
 
 /**
@@ -683,6 +891,23 @@ inline void v_multiply_and_add(double *const BQ_R__ dst,
 {
     ippsAddProduct_64f(src1, src2, dst, count);
 }
+#elif defined HAVE_BQ_SIMD
+template<>
+inline void v_multiply_and_add(float *const BQ_R__ dst,
+                               const float *const BQ_R__ src1,
+                               const float *const BQ_R__ src2,
+                               const int count)
+{
+    v_multiply_and_add_simd(dst, src1, src2, count);
+}
+template<>
+inline void v_multiply_and_add(double *const BQ_R__ dst,
+                               const double *const BQ_R__ src1,
+                               const double *const BQ_R__ src2,
+                               const int count)
+{
+    v_multiply_and_add_simd(dst, src1, src2, count);
+}
 #endif
 
 /**
@@ -695,13 +920,37 @@ template<typename T>
 inline T v_sum(const T *const BQ_R__ src,
                const int count)
 {
-    T result = T();
-    for (int i = 0; i < count; ++i) {
-        result += src[i];
+    // Four partial sums, so that each addition need not wait for the
+    // one before
+    T a = T(), b = T(), c = T(), d = T();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        a += src[i];
+        b += src[i+1];
+        c += src[i+2];
+        d += src[i+3];
     }
-    return result;
+    for (; i < count; ++i) {
+        a += src[i];
+    }
+    return (a + b) + (c + d);
 }
 
+#if defined HAVE_BQ_SIMD
+template<>
+inline float v_sum(const float *const BQ_R__ src,
+                   const int count)
+{
+    return v_sum_simd(src, count);
+}
+template<>
+inline double v_sum(const double *const BQ_R__ src,
+                    const int count)
+{
+    return v_sum_simd(src, count);
+}
+#endif
+
 /**
  * v_multiply_and_sum
  *
@@ -716,13 +965,233 @@ inline T v_multiply_and_sum(const T *const BQ_R__ src1,
                             const T *const BQ_R__ src2,
                             const int count)
 {
-    T result = T();
-    for (int i = 0; i < count; ++i) {
-        result += src1[i] * src2[i];
+    T a = T(), b = T(), c = T(), d = T();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        a += src1[i] * src2[i];
+        b += src1[i+1] * src2[i+1];
+        c += src1[i+2] * src2[i+2];
+        d += src1[i+3] * src2[i+3];
+    }
+    for (; i < count; ++i) {
+        a += src1[i] * src2[i];
+    }
+    return (a + b) + (c + d);
+}
+
+#if defined HAVE_BQ_SIMD
+template<>
+inline float v_multiply_and_sum(const float *const BQ_R__ src1,
+                                const float *const BQ_R__ src2,
+                                const int count)
+{
+    return v_multiply_and_sum_simd(src1, src2, count);
+}
+template<>
+inline double v_multiply_and_sum(const double *const BQ_R__ src1,
+                                 const double *const BQ_R__ src2,
+                                 const int count)
+{
+    return v_multiply_and_sum_simd(src1, src2, count);
+}
+#endif
+
+/**
+ * v_sum_squares
+ *
+ * Return the sum of the squares of the elements in vector \arg src,
+ * of length \arg count.
+ */
+template<typename T>
+inline T v_sum_squares(const T *const BQ_R__ src,
+                       const int count)
+{
+    T a = T(), b = T(), c = T(), d = T();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        a += src[i] * src[i];
+        b += src[i+1] * src[i+1];
+        c += src[i+2] * src[i+2];
+        d += src[i+3] * src[i+3];
+    }
+    for (; i < count; ++i) {
+        a += src[i] * src[i];
+    }
+    return (a + b) + (c + d);
+}
+
+#if defined HAVE_BQ_SIMD
+template<>
+inline float v_sum_squares(const float *const BQ_R__ src,
+                           const int count)
+{
+    return v_sum_squares_simd(src, count);
+}
+template<>
+inline double v_sum_squares(const double *const BQ_R__ src,
+                            const int count)
+{
+    return v_sum_squares_simd(src, count);
+}
+#endif
+
+/**
+ * v_sum_pairwise
+ *
+ * Return the sum of the elements in vector \arg src, of length \arg
+ * count, adding the sums of blocks of up to 256 elements in a binary
+ * tree. Rounding error grows with the logarithm of the length rather
+ * than with the length, as it does for v_sum; use this for long
+ * vectors, or where many values of similar size are summed in float.
+ * (Compensated summation is no alternative in code that may be built
+ * with -ffast-math, as the compiler is free to optimise the
+ * compensation away.)
+ */
+template<typename T>
+inline T v_sum_pairwise(const T *const BQ_R__ src,
+                        const int count)
+{
+    if (count <= 256) {
+        return v_sum(src, count);
+    }
+    const int half = ((count / 2 + 255) / 256) * 256;
+    return v_sum_pairwise(src, half) + v_sum_pairwise(src + half, count - half);
+}
+
+/**
+ * v_min
+ *
+ * Return the smallest element in vector \arg src, of length \arg
+ * count, or zero if \arg count is zero.
+ */
+template<typename T>
+inline T v_min(const T *const BQ_R__ src,
+               const int count)
+{
+    if (count < 1) return T();
+    T result = src[0];
+    for (int i = 1; i < count; ++i) {
+        if (src[i] < result) result = src[i];
     }
     return result;
 }
 
+#if defined HAVE_BQ_SIMD
+template<>
+inline float v_min(const float *const BQ_R__ src,
+                   const int count)
+{
+    return v_min_simd(src, count);
+}
+template<>
+inline double v_min(const double *const BQ_R__ src,
+                    const int count)
+{
+    return v_min_simd(src, count);
+}
+#endif
+
+/**
+ * v_max
+ *
+ * Return the largest element in vector \arg src, of length \arg
+ * count, or zero if \arg count is zero.
+ */
+template<typename T>
+inline T v_max(const T *const BQ_R__ src,
+               const int count)
+{
+    if (count < 1) return T();
+    T result = src[0];
+    for (int i = 1; i < count; ++i) {
+        if (result < src[i]) result = src[i];
+    }
+    return result;
+}
+
+#if defined HAVE_BQ_SIMD
+template<>
+inline float v_max(const float *const BQ_R__ src,
+                   const int count)
+{
+    return v_max_simd(src, count);
+}
+template<>
+inline double v_max(const double *const BQ_R__ src,
+                    const int count)
+{
+    return v_max_simd(src, count);
+}
+#endif
+
+/**
+ * v_min_index
+ *
+ * Return the index of the smallest element in vector \arg src, of
+ * length \arg count, the first if there is more than one, or -1 if
+ * \arg count is zero.
+ */
+template<typename T>
+inline int v_min_index(const T *const BQ_R__ src,
+                       const int count)
+{
+    if (count < 1) return -1;
+    int index = 0;
+    for (int i = 1; i < count; ++i) {
+        if (src[i] < src[index]) index = i;
+    }
+    return index;
+}
+
+#if defined HAVE_BQ_SIMD
+template<>
+inline int v_min_index(const float *const BQ_R__ src,
+                       const int count)
+{
+    return v_min_index_simd(src, count);
+}
+template<>
+inline int v_min_index(const double *const BQ_R__ src,
+                       const int count)
+{
+    return v_min_index_simd(src, count);
+}
+#endif
+
+/**
+ * v_max_index
+ *
+ * Return the index of the largest element in vector \arg src, of
+ * length \arg count, the first if there is more than one, or -1 if
+ * \arg count is zero.
+ */
+template<typename T>
+inline int v_max_index(const T *const BQ_R__ src,
+                       const int count)
+{
+    if (count < 1) return -1;
+    int index = 0;
+    for (int i = 1; i < count; ++i) {
+        if (src[index] < src[i]) index = i;
+    }
+    return index;
+}
+
+#if defined HAVE_BQ_SIMD
+template<>
+inline int v_max_index(const float *const BQ_R__ src,
+                       const int count)
+{
+    return v_max_index_simd(src, count);
+}
+template<>
+inline int v_max_index(const double *const BQ_R__ src,
+                       const int count)
+{
+    return v_max_index_simd(src, count);
+}
+#endif
+
 /**
  * v_log
  *
@@ -772,6 +1241,13 @@ inline void v_log(double *const BQ_R__ dst,
     vvlog(tmp, dst, &count);
     v_copy(dst, tmp, count);
 }
+#elif defined HAVE_BQ_SIMD
+template<>
+inline void v_log(float *const BQ_R__ dst,
+                  const int count)
+{
+    v_log_simd(dst, count);
+}
 #endif
 
 /**
@@ -823,6 +1299,13 @@ inline void v_exp(double *const BQ_R__ dst,
     vvexp(tmp, dst, &count);
     v_copy(dst, tmp, count);
 }
+#elif defined HAVE_BQ_SIMD
+template<>
+inline void v_exp(float *const BQ_R__ dst,
+                  const int count)
+{
+    v_exp_simd(dst, count);
+}
 #endif
 
 /**
@@ -874,6 +1357,19 @@ inline void v_sqrt(double *const BQ_R__ dst,
     vvsqrt(tmp, dst, &count);
     v_copy(dst, tmp, count);
 }
+#elif defined HAVE_BQ_SIMD
+template<>
+inline void v_sqrt(float *const BQ_R__ dst,
+                   const int count)
+{
+    v_sqrt_simd(dst, count);
+}
+template<>
+inline void v_sqrt(double *const BQ_R__ dst,
+                   const int count)
+{
+    v_sqrt_simd(dst, count);
+}
 #endif
 
 /**
@@ -904,6 +1400,19 @@ inline void v_square(double *const BQ_R__ dst,
 {
     ippsSqr_64f_I(dst, count);
 }
+#elif defined HAVE_BQ_SIMD
+template<>
+inline void v_square(float *const BQ_R__ dst,
+                     const int count)
+{
+    v_square_simd(dst, count);
+}
+template<>
+inline void v_square(double *const BQ_R__ dst,
+                     const int count)
+{
+    v_square_simd(dst, count);
+}
 #endif
 
 /**
@@ -947,6 +1456,19 @@ inline void v_abs(float *const BQ_R__ dst,
 #endif
     v_copy(dst, tmp, count);
 }
+#elif defined HAVE_BQ_SIMD
+template<>
+inline void v_abs(float *const BQ_R__ dst,
+                  const int count)
+{
+    v_abs_simd(dst, count);
+}
+template<>
+inline void v_abs(double *const BQ_R__ dst,
+                  const int count)
+{
+    v_abs_simd(dst, count);
+}
 #endif
 
 /**
@@ -997,6 +1519,15 @@ inline void v_interleave(float *const BQ_R__ dst,
     ippsInterleave_32f((const Ipp32f **)src, channels, count, dst);
 }
 // IPP does not (currently?) provide double-precision interleave
+#elif defined HAVE_BQ_SIMD
+template<>
+inline void v_interleave(float *const BQ_R__ dst,
+                         const float *const BQ_R__ *const BQ_R__ src,
+                         const int channels, 
+                         const int count)
+{
+    v_interleave_simd(dst, src, channels, count);
+}
 #endif
 
 /**
@@ -1047,6 +1578,15 @@ inline void v_deinterleave(float *const BQ_R__ *const BQ_R__ dst,
     ippsDeinterleave_32f((const Ipp32f *)src, channels, count, (Ipp32f **)dst);
 }
 // IPP does not (currently?) provide double-precision deinterleave
+#elif defined HAVE_BQ_SIMD
+template<>
+inline void v_deinterleave(float *const BQ_R__ *const BQ_R__ dst,
+                           const float *const BQ_R__ src,
+                           const int channels, 
+                           const int count)
+{
+    v_deinterleave_simd(dst, src, channels, count);
+}
 #endif
 
 /**
@@ -1077,10 +1617,7 @@ inline void v_fftshift(T *const BQ_R__ vec,
 template<typename T>
 inline T v_mean(const T *const BQ_R__ vec, const int count)
 {
-    T t = T(0);
-    for (int i = 0; i < count; ++i) {
-        t += vec[i];
-    }
+    T t = v_sum(vec, count);
     t /= T(count);
     return t;
 }
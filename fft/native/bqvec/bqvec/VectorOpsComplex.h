@@ -43,26 +43,70 @@
 
 namespace breakfastquay {
 
+/**
+ * Accuracy wanted from the polar conversion functions that take one
+ * (v_cartesian_to_polar, v_cartesian_interleaved_to_polar,
+ * v_polar_to_cartesian and v_polar_to_cartesian_interleaved).
+ *
+ * PolarExact uses the standard library, or IPP or vDSP where they
+ * are used for the conversion without an accuracy argument.
+ * PolarPrecise is within about 1e-6 radians of the exact phase, and
+ * PolarFast within about 1e-3, with magnitudes to a similar relative
+ * accuracy. The approximate tiers are faster only with HAVE_BQ_SIMD
+ * (see VectorOps.h) and with float or double throughout; otherwise
+ * they are the same as PolarExact.
+ */
+enum PolarAccuracy {
+    PolarExact,
+    PolarPrecise,
+    PolarFast
+};
+
+#if defined HAVE_BQ_SIMD
+void v_cartesian_to_polar_simd(float *const BQ_R__ mag, float *const BQ_R__ phase, const float *const BQ_R__ real, const float *const BQ_R__ imag, const int count, const PolarAccuracy accuracy);
+void v_cartesian_to_polar_simd(double *const BQ_R__ mag, double *const BQ_R__ phase, const double *const BQ_R__ real, const double *const BQ_R__ imag, const int count, const PolarAccuracy accuracy);
+void v_cartesian_interleaved_to_polar_simd(float *const BQ_R__ mag, float *const BQ_R__ phase, const float *const BQ_R__ src, const int count, const PolarAccuracy accuracy);
+void v_cartesian_interleaved_to_polar_simd(double *const BQ_R__ mag, double *const BQ_R__ phase, const double *const BQ_R__ src, const int count, const PolarAccuracy accuracy);
+void v_polar_to_cartesian_simd(float *const BQ_R__ real, float *const BQ_R__ imag, const float *const BQ_R__ mag, const float *const BQ_R__ phase, const int count, const PolarAccuracy accuracy);
+void v_polar_to_cartesian_simd(double *const BQ_R__ real, double *const BQ_R__ imag, const double *const BQ_R__ mag, const double *const BQ_R__ phase, const int count, const PolarAccuracy accuracy);
+void v_polar_to_cartesian_interleaved_simd(float *const BQ_R__ dst, const float *const BQ_R__ mag, const float *const BQ_R__ phase, const int count, const PolarAccuracy accuracy);
+void v_polar_to_cartesian_interleaved_simd(double *const BQ_R__ dst, const double *const BQ_R__ mag, const double *const BQ_R__ phase, const int count, const PolarAccuracy accuracy);
+#endif
+
 #ifndef NO_COMPLEX_TYPES
 
-template<> 
-inline void v_zero(bq_complex_t *const BQ_R__ ptr, 
+#if defined HAVE_BQ_SIMD
+void v_multiply_simd(bq_complex<float> *const BQ_R__ dst, const bq_complex<float> *const BQ_R__ src, const int count);
+void v_multiply_simd(bq_complex<double> *const BQ_R__ dst, const bq_complex<double> *const BQ_R__ src, const int count);
+void v_multiply_simd(bq_complex<float> *const BQ_R__ dst, const bq_complex<float> *const BQ_R__ src1, const bq_complex<float> *const BQ_R__ src2, const int count);
+void v_multiply_simd(bq_complex<double> *const BQ_R__ dst, const bq_complex<double> *const BQ_R__ src1, const bq_complex<double> *const BQ_R__ src2, const int count);
+void v_multiply_and_add_simd(bq_complex<float> *const BQ_R__ dst, const bq_complex<float> *const BQ_R__ src1, const bq_complex<float> *const BQ_R__ src2, const int count);
+void v_multiply_and_add_simd(bq_complex<double> *const BQ_R__ dst, const bq_complex<double> *const BQ_R__ src1, const bq_complex<double> *const BQ_R__ src2, const int count);
+#endif
+
+// The complex functions are templates over the element type of
+// bq_complex, with float and double being the types that IPP, vDSP
+// and the SIMD code support. Those dispatch on sizeof(T), as the
+// element type once was a compile-time choice
+
+template<typename T>
+inline void v_zero(bq_complex<T> *const BQ_R__ ptr, 
                    const int count)
 {
 #if defined HAVE_IPP
-    if (sizeof(bq_complex_element_t) == sizeof(float)) {
+    if (sizeof(T) == sizeof(float)) {
         ippsZero_32fc((Ipp32fc *)ptr, count);
     } else {
         ippsZero_64fc((Ipp64fc *)ptr, count);
     }
 #elif defined HAVE_VDSP
-    if (sizeof(bq_complex_element_t) == sizeof(float)) {
+    if (sizeof(T) == sizeof(float)) {
         vDSP_vclr((float *)ptr, 1, count * 2);
     } else {
         vDSP_vclrD((double *)ptr, 1, count * 2);
     }
 #else
-    const bq_complex_element_t value = 0.0;
+    const T value = T(0);
     for (int i = 0; i < count; ++i) {
         ptr[i].re = value;
         ptr[i].im = value;
@@ -71,23 +115,23 @@ inline void v_zero(bq_complex_t *const BQ_R__ ptr,
 }
 
 #if defined HAVE_IPP
-template<>
-inline void v_copy(bq_complex_t *const BQ_R__ dst,
-                   const bq_complex_t *const BQ_R__ src,
+template<typename T>
+inline void v_copy(bq_complex<T> *const BQ_R__ dst,
+                   const bq_complex<T> *const BQ_R__ src,
                    const int count)
 {
-    if (sizeof(bq_complex_element_t) == sizeof(float)) {
+    if (sizeof(T) == sizeof(float)) {
         ippsCopy_32fc((const Ipp32fc *)src, (Ipp32fc *)dst, count);
     } else {
         ippsCopy_64fc((const Ipp64fc *)src, (Ipp64fc *)dst, count);
     }
 }
-template<>
-inline void v_move(bq_complex_t *const BQ_R__ dst,
-                   const bq_complex_t *const BQ_R__ src,
+template<typename T>
+inline void v_move(bq_complex<T> *const BQ_R__ dst,
+                   const bq_complex<T> *const BQ_R__ src,
                    const int count)
 {
-    if (sizeof(bq_complex_element_t) == sizeof(float)) {
+    if (sizeof(T) == sizeof(float)) {
         ippsMove_32fc((const Ipp32fc *)src, (Ipp32fc *)dst, count);
     } else {
         ippsMove_64fc((const Ipp64fc *)src, (Ipp64fc *)dst, count);
@@ -95,9 +139,9 @@ inline void v_move(bq_complex_t *const BQ_R__ dst,
 }
 #endif
 
-template<>
-inline void v_convert(bq_complex_t *const BQ_R__ dst,
-                      const bq_complex_element_t *const BQ_R__ src,
+template<typename T>
+inline void v_convert(bq_complex<T> *const BQ_R__ dst,
+                      const T *const BQ_R__ src,
                       const int srccount)
 {
     const int targetcount = srccount / 2;
@@ -108,9 +152,9 @@ inline void v_convert(bq_complex_t *const BQ_R__ dst,
     }
 }
 
-template<>
-inline void v_convert(bq_complex_element_t *const BQ_R__ dst,
-                      const bq_complex_t *const BQ_R__ src,
+template<typename T>
+inline void v_convert(T *const BQ_R__ dst,
+                      const bq_complex<T> *const BQ_R__ src,
                       const int srccount)
 {
     int targetidx = 0;
@@ -120,24 +164,27 @@ inline void v_convert(bq_complex_element_t *const BQ_R__ dst,
     }
 }
 
-inline void c_add(bq_complex_t &dst,
-                  const bq_complex_t &src)
+template<typename T>
+inline void c_add(bq_complex<T> &dst,
+                  const bq_complex<T> &src)
 {
     dst.re += src.re;
     dst.im += src.im;
 }
 
-inline void c_add_with_gain(bq_complex_t &dst,
-                            const bq_complex_t &src,
-                            const bq_complex_element_t gain)
+template<typename T>
+inline void c_add_with_gain(bq_complex<T> &dst,
+                            const bq_complex<T> &src,
+                            const T gain)
 {
     dst.re += src.re * gain;
     dst.im += src.im * gain;
 }
 
-inline void c_multiply(bq_complex_t &dst,
-                       const bq_complex_t &src1,
-                       const bq_complex_t &src2)
+template<typename T>
+inline void c_multiply(bq_complex<T> &dst,
+                       const bq_complex<T> &src1,
+                       const bq_complex<T> &src2)
 {
     // Note dst may alias src1 or src2.
 
@@ -152,66 +199,62 @@ inline void c_multiply(bq_complex_t &dst,
     //
     // The first formulation tests marginally quicker here.
 
-    bq_complex_element_t real = src1.re * src2.re - src1.im * src2.im;
-    bq_complex_element_t imag = src1.re * src2.im + src1.im * src2.re;
+    T real = src1.re * src2.re - src1.im * src2.im;
+    T imag = src1.re * src2.im + src1.im * src2.re;
 
     dst.re = real;
     dst.im = imag;
 }
 
-inline void c_multiply(bq_complex_t &dst,
-                       const bq_complex_t &src)
+template<typename T>
+inline void c_multiply(bq_complex<T> &dst,
+                       const bq_complex<T> &src)
 {
     c_multiply(dst, dst, src);
 }
 
-inline void c_multiply_and_add(bq_complex_t &dst,
-                               const bq_complex_t &src1,
-                               const bq_complex_t &src2)
+template<typename T>
+inline void c_multiply_and_add(bq_complex<T> &dst,
+                               const bq_complex<T> &src1,
+                               const bq_complex<T> &src2)
 {
-    bq_complex_t tmp;
+    bq_complex<T> tmp;
     c_multiply(tmp, src1, src2);
     c_add(dst, tmp);
 }
 
-template<>
-inline void v_add(bq_complex_t *const BQ_R__ dst,
-                  const bq_complex_t *const BQ_R__ src,
+template<typename T>
+inline void v_add(bq_complex<T> *const BQ_R__ dst,
+                  const bq_complex<T> *const BQ_R__ src,
                   const int count)
 {
 #if defined HAVE_IPP
-    if (sizeof(bq_complex_element_t) == sizeof(float)) {
+    if (sizeof(T) == sizeof(float)) {
         ippsAdd_32fc_I((Ipp32fc *)src, (Ipp32fc *)dst, count);
     } else {
         ippsAdd_64fc_I((Ipp64fc *)src, (Ipp64fc *)dst, count);
     }
 #else
-    for (int i = 0; i < count; ++i) {
-        dst[i].re += src[i].re;
-        dst[i].im += src[i].im;
-    }
+    v_add((T *)dst, (const T *)src, count * 2);
 #endif
 }    
 
-template<>
-inline void v_add_with_gain(bq_complex_t *const BQ_R__ dst,
-                            const bq_complex_t *const BQ_R__ src,
-                            const bq_complex_element_t gain,
+template<typename T>
+inline void v_add_with_gain(bq_complex<T> *const BQ_R__ dst,
+                            const bq_complex<T> *const BQ_R__ src,
+                            const T gain,
                             const int count)
 {
-    for (int i = 0; i < count; ++i) {
-        dst[i].re += src[i].re * gain;
-        dst[i].im += src[i].im * gain;
-    }
+    v_add_with_gain((T *)dst, (const T *)src, gain, count * 2);
 }
 
-template<>
-inline void v_multiply(bq_complex_t *const BQ_R__ dst,
-                       const bq_complex_t *const BQ_R__ src,
+template<typename T>
+inline void v_multiply(bq_complex<T> *const BQ_R__ dst,
+                       const bq_complex<T> *const BQ_R__ src,
                        const int count)
 {
 #ifdef HAVE_IPP
-    if (sizeof(bq_complex_element_t) == sizeof(float)) {
+    if (sizeof(T) == sizeof(float)) {
         ippsMul_32fc_I((const Ipp32fc *)src, (Ipp32fc *)dst, count);
     } else {
         ippsMul_64fc_I((const Ipp64fc *)src, (Ipp64fc *)dst, count);
@@ -223,14 +266,14 @@ inline void v_multiply(bq_complex_t *const BQ_R__ dst,
 #endif
 }
 
-template<>
-inline void v_multiply(bq_complex_t *const BQ_R__ dst,
-                       const bq_complex_t *const BQ_R__ src1,
-                       const bq_complex_t *const BQ_R__ src2,
+template<typename T>
+inline void v_multiply(bq_complex<T> *const BQ_R__ dst,
+                       const bq_complex<T> *const BQ_R__ src1,
+                       const bq_complex<T> *const BQ_R__ src2,
                        const int count)
 {
 #ifdef HAVE_IPP
-    if (sizeof(bq_complex_element_t) == sizeof(float)) {
+    if (sizeof(T) == sizeof(float)) {
         ippsMul_32fc((const Ipp32fc *)src1, (const Ipp32fc *)src2,
                      (Ipp32fc *)dst, count);
     } else {
@@ -244,14 +287,14 @@ inline void v_multiply(bq_complex_t *const BQ_R__ dst,
 #endif
 }
 
-template<>
-inline void v_multiply_and_add(bq_complex_t *const BQ_R__ dst,
-                               const bq_complex_t *const BQ_R__ src1,
-                               const bq_complex_t *const BQ_R__ src2,
+template<typename T>
+inline void v_multiply_and_add(bq_complex<T> *const BQ_R__ dst,
+                               const bq_complex<T> *const BQ_R__ src1,
+                               const bq_complex<T> *const BQ_R__ src2,
                                const int count)
 {
 #ifdef HAVE_IPP
-    if (sizeof(bq_complex_element_t) == sizeof(float)) {
+    if (sizeof(T) == sizeof(float)) {
         ippsAddProduct_32fc((const Ipp32fc *)src1, (const Ipp32fc *)src2,
                             (Ipp32fc *)dst, count);
     } else {
@@ -265,6 +308,55 @@ inline void v_multiply_and_add(bq_complex_t *const BQ_R__ dst,
 #endif
 }
 
+#if defined HAVE_BQ_SIMD && !defined HAVE_IPP
+template<>
+inline void v_multiply(bq_complex<float> *const BQ_R__ dst,
+                       const bq_complex<float> *const BQ_R__ src,
+                       const int count)
+{
+    v_multiply_simd(dst, src, count);
+}
+template<>
+inline void v_multiply(bq_complex<double> *const BQ_R__ dst,
+                       const bq_complex<double> *const BQ_R__ src,
+                       const int count)
+{
+    v_multiply_simd(dst, src, count);
+}
+template<>
+inline void v_multiply(bq_complex<float> *const BQ_R__ dst,
+                       const bq_complex<float> *const BQ_R__ src1,
+                       const bq_complex<float> *const BQ_R__ src2,
+                       const int count)
+{
+    v_multiply_simd(dst, src1, src2, count);
+}
+template<>
+inline void v_multiply(bq_complex<double> *const BQ_R__ dst,
+                       const bq_complex<double> *const BQ_R__ src1,
+                       const bq_complex<double> *const BQ_R__ src2,
+                       const int count)
+{
+    v_multiply_simd(dst, src1, src2, count);
+}
+template<>
+inline void v_multiply_and_add(bq_complex<float> *const BQ_R__ dst,
+                               const bq_complex<float> *const BQ_R__ src1,
+                               const bq_complex<float> *const BQ_R__ src2,
+                               const int count)
+{
+    v_multiply_and_add_simd(dst, src1, src2, count);
+}
+template<>
+inline void v_multiply_and_add(bq_complex<double> *const BQ_R__ dst,
+                               const bq_complex<double> *const BQ_R__ src1,
+                               const bq_complex<double> *const BQ_R__ src2,
+                               const int count)
+{
+    v_multiply_and_add_simd(dst, src1, src2, count);
+}
+#endif
+
 #if defined( __GNUC__ ) && defined( _WIN32 )
 // MinGW doesn't appear to have sincos, so define it -- it's
 // a single x87 instruction anyway
@@ -346,45 +438,56 @@ inline void c_magphase(float *mag, float *phase, float real, float imag)
 
 #ifndef NO_COMPLEX_TYPES
 
-inline bq_complex_t c_phasor(bq_complex_element_t phase)
+template<typename T>
+inline bq_complex<T> c_phasor(T phase)
 {
-    bq_complex_t c;
-    c_phasor<bq_complex_element_t>(&c.re, &c.im, phase);
+    bq_complex<T> c;
+    c_phasor<T>(&c.re, &c.im, phase);
     return c;
 }
 
-inline void c_magphase(bq_complex_element_t *mag, bq_complex_element_t *phase,
-                       bq_complex_t c)
+template<typename T>
+inline void c_magphase(T *mag, T *phase, bq_complex<T> c)
 {
-    c_magphase<bq_complex_element_t>(mag, phase, c.re, c.im);
+    c_magphase<T>(mag, phase, c.re, c.im);
 }
 
-void v_polar_to_cartesian(bq_complex_t *const BQ_R__ dst,
-                          const bq_complex_element_t *const BQ_R__ mag,
-                          const bq_complex_element_t *const BQ_R__ phase,
+void v_polar_to_cartesian(bq_complex<float> *const BQ_R__ dst,
+                          const float *const BQ_R__ mag,
+                          const float *const BQ_R__ phase,
+                          const int count);
+
+void v_polar_to_cartesian(bq_complex<double> *const BQ_R__ dst,
+                          const double *const BQ_R__ mag,
+                          const double *const BQ_R__ phase,
                           const int count);
 
-void v_polar_interleaved_to_cartesian(bq_complex_t *const BQ_R__ dst,
-                                      const bq_complex_element_t *const BQ_R__ src,
+void v_polar_interleaved_to_cartesian(bq_complex<float> *const BQ_R__ dst,
+                                      const float *const BQ_R__ src,
+                                      const int count);
+
+void v_polar_interleaved_to_cartesian(bq_complex<double> *const BQ_R__ dst,
+                                      const double *const BQ_R__ src,
                                       const int count);
 
-inline void v_cartesian_to_polar(bq_complex_element_t *const BQ_R__ mag,
-                                 bq_complex_element_t *const BQ_R__ phase,
-                                 const bq_complex_t *const BQ_R__ src,
+template<typename T>
+inline void v_cartesian_to_polar(T *const BQ_R__ mag,
+                                 T *const BQ_R__ phase,
+                                 const bq_complex<T> *const BQ_R__ src,
                                  const int count)
 {
     for (int i = 0; i < count; ++i) {
-        c_magphase<bq_complex_element_t>(mag + i, phase + i, src[i].re, src[i].im);
+        c_magphase<T>(mag + i, phase + i, src[i].re, src[i].im);
     }
 }
 
-inline void v_cartesian_to_polar_interleaved(bq_complex_element_t *const BQ_R__ dst,
-                                             const bq_complex_t *const BQ_R__ src,
+template<typename T>
+inline void v_cartesian_to_polar_interleaved(T *const BQ_R__ dst,
+                                             const bq_complex<T> *const BQ_R__ src,
                                              const int count)
 {
     for (int i = 0; i < count; ++i) {
-        c_magphase<bq_complex_element_t>(&dst[i*2], &dst[i*2+1],
-                                    src[i].re, src[i].im);
+        c_magphase<T>(&dst[i*2], &dst[i*2+1], src[i].re, src[i].im);
     }
 }
 
@@ -530,6 +633,162 @@ inline void v_cartesian_to_polar(double *const BQ_R__ mag,
 }
 #endif
 
+// The polar conversions again, with an accuracy (see PolarAccuracy
+// above)
+
+template<typename S, typename T> // S source, T target
+void v_cartesian_to_polar(T *const BQ_R__ mag,
+                          T *const BQ_R__ phase,
+                          const S *const BQ_R__ real,
+                          const S *const BQ_R__ imag,
+                          const int count,
+                          const PolarAccuracy)
+{
+    v_cartesian_to_polar(mag, phase, real, imag, count);
+}
+
+template<typename S, typename T> // S source, T target
+void v_cartesian_interleaved_to_polar(T *const BQ_R__ mag,
+                                      T *const BQ_R__ phase,
+                                      const S *const BQ_R__ src,
+                                      const int count,
+                                      const PolarAccuracy)
+{
+    v_cartesian_interleaved_to_polar(mag, phase, src, count);
+}
+
+template<typename S, typename T> // S source, T target
+void v_polar_to_cartesian(T *const BQ_R__ real,
+                          T *const BQ_R__ imag,
+                          const S *const BQ_R__ mag,
+                          const S *const BQ_R__ phase,
+                          const int count,
+                          const PolarAccuracy)
+{
+    v_polar_to_cartesian(real, imag, mag, phase, count);
+}
+
+template<typename S, typename T> // S source, T target
+void v_polar_to_cartesian_interleaved(T *const BQ_R__ dst,
+                                      const S *const BQ_R__ mag,
+                                      const S *const BQ_R__ phase,
+                                      const int count,
+                                      const PolarAccuracy)
+{
+    v_polar_to_cartesian_interleaved(dst, mag, phase, count);
+}
+
+#if defined HAVE_BQ_SIMD
+template<>
+inline void v_cartesian_to_polar(float *const BQ_R__ mag,
+                                 float *const BQ_R__ phase,
+                                 const float *const BQ_R__ real,
+                                 const float *const BQ_R__ imag,
+                                 const int count,
+                                 const PolarAccuracy accuracy)
+{
+    if (accuracy == PolarExact) {
+        v_cartesian_to_polar(mag, phase, real, imag, count);
+    } else {
+        v_cartesian_to_polar_simd(mag, phase, real, imag, count, accuracy);
+    }
+}
+template<>
+inline void v_cartesian_to_polar(double *const BQ_R__ mag,
+                                 double *const BQ_R__ phase,
+                                 const double *const BQ_R__ real,
+                                 const double *const BQ_R__ imag,
+                                 const int count,
+                                 const PolarAccuracy accuracy)
+{
+    if (accuracy == PolarExact) {
+        v_cartesian_to_polar(mag, phase, real, imag, count);
+    } else {
+        v_cartesian_to_polar_simd(mag, phase, real, imag, count, accuracy);
+    }
+}
+template<>
+inline void v_cartesian_interleaved_to_polar(float *const BQ_R__ mag,
+                                             float *const BQ_R__ phase,
+                                             const float *const BQ_R__ src,
+                                             const int count,
+                                             const PolarAccuracy accuracy)
+{
+    if (accuracy == PolarExact) {
+        v_cartesian_interleaved_to_polar(mag, phase, src, count);
+    } else {
+        v_cartesian_interleaved_to_polar_simd(mag, phase, src, count, accuracy);
+    }
+}
+template<>
+inline void v_cartesian_interleaved_to_polar(double *const BQ_R__ mag,
+                                             double *const BQ_R__ phase,
+                                             const double *const BQ_R__ src,
+                                             const int count,
+                                             const PolarAccuracy accuracy)
+{
+    if (accuracy == PolarExact) {
+        v_cartesian_interleaved_to_polar(mag, phase, src, count);
+    } else {
+        v_cartesian_interleaved_to_polar_simd(mag, phase, src, count, accuracy);
+    }
+}
+template<>
+inline void v_polar_to_cartesian(float *const BQ_R__ real,
+                                 float *const BQ_R__ imag,
+                                 const float *const BQ_R__ mag,
+                                 const float *const BQ_R__ phase,
+                                 const int count,
+                                 const PolarAccuracy accuracy)
+{
+    if (accuracy == PolarExact) {
+        v_polar_to_cartesian(real, imag, mag, phase, count);
+    } else {
+        v_polar_to_cartesian_simd(real, imag, mag, phase, count, accuracy);
+    }
+}
+template<>
+inline void v_polar_to_cartesian(double *const BQ_R__ real,
+                                 double *const BQ_R__ imag,
+                                 const double *const BQ_R__ mag,
+                                 const double *const BQ_R__ phase,
+                                 const int count,
+                                 const PolarAccuracy accuracy)
+{
+    if (accuracy == PolarExact) {
+        v_polar_to_cartesian(real, imag, mag, phase, count);
+    } else {
+        v_polar_to_cartesian_simd(real, imag, mag, phase, count, accuracy);
+    }
+}
+template<>
+inline void v_polar_to_cartesian_interleaved(float *const BQ_R__ dst,
+                                             const float *const BQ_R__ mag,
+                                             const float *const BQ_R__ phase,
+                                             const int count,
+                                             const PolarAccuracy accuracy)
+{
+    if (accuracy == PolarExact) {
+        v_polar_to_cartesian_interleaved(dst, mag, phase, count);
+    } else {
+        v_polar_to_cartesian_interleaved_simd(dst, mag, phase, count, accuracy);
+    }
+}
+template<>
+inline void v_polar_to_cartesian_interleaved(double *const BQ_R__ dst,
+                                             const double *const BQ_R__ mag,
+                                             const double *const BQ_R__ phase,
+                                             const int count,
+                                             const PolarAccuracy accuracy)
+{
+    if (accuracy == PolarExact) {
+        v_polar_to_cartesian_interleaved(dst, mag, phase, count);
+    } else {
+        v_polar_to_cartesian_interleaved_simd(dst, mag, phase, count, accuracy);
+    }
+}
+#endif
+
 template<typename T>
 void v_cartesian_to_polar_interleaved_inplace(T *const BQ_R__ srcdst,
                                               const int count)
@@ -0,0 +1,209 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    bqvec
+
+    A small library for vector arithmetic and allocation in C++ using
+    raw C pointer arrays.
+
+    Copyright 2007-2015 Particular Programs Ltd.
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of Chris Cannam and
+    Particular Programs Ltd shall not be used in advertising or
+    otherwise to promote the sale, use or other dealings in this
+    Software without prior written authorization.
+*/
+
+#ifndef BQVEC_VECTOR_OPS_FEATURES_H
+#define BQVEC_VECTOR_OPS_FEATURES_H
+
+#include "VectorOps.h"
+
+#include <cmath>
+
+namespace breakfastquay {
+
+/**
+ * Spectral features of a single frame of magnitudes, such as those
+ * from v_cartesian_to_polar, and the flux between two frames.
+ *
+ * Each is computed in a single pass over the frame, except the
+ * rolloff, which needs the total first. Positions are returned in
+ * bins: multiply by the sample rate over the FFT size for a frequency
+ * in Hz. The functions accept any non-negative values, so power
+ * spectra may be used in place of magnitudes where a feature is
+ * wanted in terms of power.
+ *
+ * With HAVE_BQ_SIMD (see VectorOps.h) the float and double versions
+ * use bqvec's own SIMD code, and the rolloff and flatness use the
+ * SIMD sums and float log.
+ */
+
+#if defined HAVE_BQ_SIMD
+float v_spectral_centroid_simd(const float *const BQ_R__ mag, const int count);
+double v_spectral_centroid_simd(const double *const BQ_R__ mag, const int count);
+float v_spectral_flux_simd(const float *const BQ_R__ mag, const float *const BQ_R__ prev, const int count);
+double v_spectral_flux_simd(const double *const BQ_R__ mag, const double *const BQ_R__ prev, const int count);
+#endif
+
+/**
+ * v_spectral_centroid
+ *
+ * Return the centroid of the \arg count magnitudes in \arg mag, that
+ * is, the mean bin index weighted by magnitude, or zero if all the
+ * magnitudes are zero.
+ */
+template<typename T>
+inline T v_spectral_centroid(const T *const BQ_R__ mag,
+                             const int count)
+{
+    T weighted = T(), total = T();
+    for (int i = 0; i < count; ++i) {
+        weighted += T(i) * mag[i];
+        total += mag[i];
+    }
+    if (total > T()) return weighted / total;
+    return T();
+}
+
+#if defined HAVE_BQ_SIMD
+template<>
+inline float v_spectral_centroid(const float *const BQ_R__ mag,
+                                 const int count)
+{
+    return v_spectral_centroid_simd(mag, count);
+}
+template<>
+inline double v_spectral_centroid(const double *const BQ_R__ mag,
+                                  const int count)
+{
+    return v_spectral_centroid_simd(mag, count);
+}
+#endif
+
+/**
+ * v_spectral_rolloff
+ *
+ * Return the index of the first bin of the \arg count magnitudes in
+ * \arg mag at which the sum of the magnitudes up to and including
+ * that bin reaches \arg fraction (commonly 0.85 or 0.95) of their
+ * total, or -1 if \arg count is zero.
+ */
+template<typename T>
+inline int v_spectral_rolloff(const T *const BQ_R__ mag,
+                              const T fraction,
+                              const int count)
+{
+    const T target = fraction * v_sum(mag, count);
+
+    // Whole blocks until the next would reach the target, then bin
+    // by bin within that one
+    const int block = 64;
+    T sum = T();
+    int i = 0;
+    while (i + block <= count) {
+        const T s = v_sum(mag + i, block);
+        if (sum + s >= target) break;
+        sum += s;
+        i += block;
+    }
+    for (; i < count; ++i) {
+        sum += mag[i];
+        if (sum >= target) return i;
+    }
+    return count - 1;
+}
+
+/**
+ * v_spectral_flatness
+ *
+ * Return the flatness of the \arg count magnitudes in \arg mag: the
+ * ratio of their geometric mean to their arithmetic mean, between 0
+ * for a single peak and 1 for white noise. Magnitudes below 1e-10
+ * are taken as 1e-10, so that empty bins do not make the result
+ * zero. Returns zero if \arg count is zero.
+ */
+template<typename T>
+inline T v_spectral_flatness(const T *const BQ_R__ mag,
+                             const int count)
+{
+    if (count < 1) return T();
+
+    // A block at a time through a buffer small enough to stay in
+    // cache between the floor, sum, log and sum again
+    const int block = 256;
+    const T floor = T(1e-10);
+    T buf[block];
+    T sum = T(), logSum = T();
+    for (int i = 0; i < count; i += block) {
+        const int n = (count - i < block ? count - i : block);
+        for (int j = 0; j < n; ++j) {
+            buf[j] = (mag[i + j] > floor ? mag[i + j] : floor);
+        }
+        sum += v_sum(buf, n);
+        v_log(buf, n);
+        logSum += v_sum(buf, n);
+    }
+    return T(exp(logSum / T(count)) / (sum / T(count)));
+}
+
+/**
+ * v_spectral_flux
+ *
+ * Return the spectral flux from the \arg count magnitudes in \arg
+ * prev to those in \arg mag: the sum of the increases in magnitude,
+ * with decreases counting as zero (half-wave rectified), as used for
+ * onset detection.
+ */
+template<typename T>
+inline T v_spectral_flux(const T *const BQ_R__ mag,
+                         const T *const BQ_R__ prev,
+                         const int count)
+{
+    T result = T();
+    for (int i = 0; i < count; ++i) {
+        const T d = mag[i] - prev[i];
+        if (d > T()) result += d;
+    }
+    return result;
+}
+
+#if defined HAVE_BQ_SIMD
+template<>
+inline float v_spectral_flux(const float *const BQ_R__ mag,
+                             const float *const BQ_R__ prev,
+                             const int count)
+{
+    return v_spectral_flux_simd(mag, prev, count);
+}
+template<>
+inline double v_spectral_flux(const double *const BQ_R__ mag,
+                              const double *const BQ_R__ prev,
+                              const int count)
+{
+    return v_spectral_flux_simd(mag, prev, count);
+}
+#endif
+
+}
+
+#endif
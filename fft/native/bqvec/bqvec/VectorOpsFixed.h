@@ -0,0 +1,285 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    bqvec
+
+    A small library for vector arithmetic and allocation in C++ using
+    raw C pointer arrays.
+
+    Copyright 2007-2015 Particular Programs Ltd.
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of Chris Cannam and
+    Particular Programs Ltd shall not be used in advertising or
+    otherwise to promote the sale, use or other dealings in this
+    Software without prior written authorization.
+*/
+
+
+#ifndef BQVEC_VECTOR_OPS_FIXED_H
+#define BQVEC_VECTOR_OPS_FIXED_H
+
+#include "VectorOps.h"
+
+namespace breakfastquay {
+
+/**
+ * Vector functions with the length fixed at compile time.
+ *
+ * Each function here has the same name and arguments as the
+ * VectorOps function it stands in for, except that the count is a
+ * template argument instead of the last function argument, e.g.
+ *
+ *   v_multiply<1024>(frame, window);
+ *
+ * in place of v_multiply(frame, window, 1024). With the trip count
+ * known, the compiler can unroll short loops completely and
+ * vectorize longer ones without the prologue and epilogue that
+ * handle an arbitrary count, which are a noticeable part of the cost
+ * of a call at typical FFT sizes.
+ *
+ * Lengths above BQ_FIXED_SIZE_LIMIT call the runtime-length functions
+ * instead. Without a vector library or HAVE_BQ_SIMD the limit is 4096
+ * elements, just to avoid expanding very long loops inline. With one
+ * of them it is 64, as the runtime functions may then use wider
+ * vectors than the compiler is targeting (AVX2 or AVX-512 chosen at
+ * runtime, against SSE2 inline) and are faster from about that
+ * length on. Define BQ_FIXED_SIZE_LIMIT to override this, or as 0 to
+ * always call the runtime-length functions.
+ *
+ * v_interleave_complex and v_deinterleave_complex, which convert
+ * between separate real and imaginary vectors and interleaved
+ * complex pairs, have only fixed-length forms here.
+ */
+
+#ifndef BQ_FIXED_SIZE_LIMIT
+#if defined HAVE_IPP || defined HAVE_VDSP || defined HAVE_BQ_SIMD
+#define BQ_FIXED_SIZE_LIMIT 64
+#else
+#define BQ_FIXED_SIZE_LIMIT 4096
+#endif
+#endif
+
+template<int N, typename T>
+inline void v_zero(T *const BQ_R__ vec)
+{
+    if (N > BQ_FIXED_SIZE_LIMIT) { v_zero(vec, N); return; }
+    for (int i = 0; i < N; ++i) {
+        vec[i] = T(0);
+    }
+}
+
+template<int N, typename T>
+inline void v_set(T *const BQ_R__ vec,
+                  const T value)
+{
+    if (N > BQ_FIXED_SIZE_LIMIT) { v_set(vec, value, N); return; }
+    for (int i = 0; i < N; ++i) {
+        vec[i] = value;
+    }
+}
+
+template<int N, typename T>
+inline void v_copy(T *const BQ_R__ dst,
+                   const T *const BQ_R__ src)
+{
+    if (N > BQ_FIXED_SIZE_LIMIT) { v_copy(dst, src, N); return; }
+    for (int i = 0; i < N; ++i) {
+        dst[i] = src[i];
+    }
+}
+
+template<int N, typename T>
+inline void v_add(T *const BQ_R__ dst,
+                  const T *const BQ_R__ src)
+{
+    if (N > BQ_FIXED_SIZE_LIMIT) { v_add(dst, src, N); return; }
+    for (int i = 0; i < N; ++i) {
+        dst[i] += src[i];
+    }
+}
+
+template<int N, typename T, typename G>
+inline void v_add_with_gain(T *const BQ_R__ dst,
+                            const T *const BQ_R__ src,
+                            const G gain)
+{
+    if (N > BQ_FIXED_SIZE_LIMIT) { v_add_with_gain(dst, src, gain, N); return; }
+    for (int i = 0; i < N; ++i) {
+        dst[i] += src[i] * gain;
+    }
+}
+
+template<int N, typename T>
+inline void v_subtract(T *const BQ_R__ dst,
+                       const T *const BQ_R__ src)
+{
+    if (N > BQ_FIXED_SIZE_LIMIT) { v_subtract(dst, src, N); return; }
+    for (int i = 0; i < N; ++i) {
+        dst[i] -= src[i];
+    }
+}
+
+template<int N, typename T, typename G>
+inline void v_scale(T *const BQ_R__ dst,
+                    const G gain)
+{
+    if (N > BQ_FIXED_SIZE_LIMIT) { v_scale(dst, gain, N); return; }
+    for (int i = 0; i < N; ++i) {
+        dst[i] *= gain;
+    }
+}
+
+template<int N, typename T>
+inline void v_multiply(T *const BQ_R__ dst,
+                       const T *const BQ_R__ src)
+{
+    if (N > BQ_FIXED_SIZE_LIMIT) { v_multiply(dst, src, N); return; }
+    for (int i = 0; i < N; ++i) {
+        dst[i] *= src[i];
+    }
+}
+
+template<int N, typename T>
+inline void v_multiply(T *const BQ_R__ dst,
+                       const T *const BQ_R__ src1,
+                       const T *const BQ_R__ src2)
+{
+    if (N > BQ_FIXED_SIZE_LIMIT) { v_multiply(dst, src1, src2, N); return; }
+    for (int i = 0; i < N; ++i) {
+        dst[i] = src1[i] * src2[i];
+    }
+}
+
+template<int N, typename T>
+inline void v_divide(T *const BQ_R__ dst,
+                     const T *const BQ_R__ src)
+{
+    if (N > BQ_FIXED_SIZE_LIMIT) { v_divide(dst, src, N); return; }
+    for (int i = 0; i < N; ++i) {
+        dst[i] /= src[i];
+    }
+}
+
+template<int N, typename T>
+inline void v_multiply_and_add(T *const BQ_R__ dst,
+                               const T *const BQ_R__ src1,
+                               const T *const BQ_R__ src2)
+{
+    if (N > BQ_FIXED_SIZE_LIMIT) { v_multiply_and_add(dst, src1, src2, N); return; }
+    for (int i = 0; i < N; ++i) {
+        dst[i] += src1[i] * src2[i];
+    }
+}
+
+template<int N, typename T>
+inline T v_sum(const T *const BQ_R__ src)
+{
+    if (N > BQ_FIXED_SIZE_LIMIT) return v_sum(src, N);
+    // Four partial sums as in v_sum, but with the remainder known
+    T a = T(), b = T(), c = T(), d = T();
+    for (int i = 0; i + 4 <= N; i += 4) {
+        a += src[i];
+        b += src[i+1];
+        c += src[i+2];
+        d += src[i+3];
+    }
+    for (int i = N - N % 4; i < N; ++i) {
+        a += src[i];
+    }
+    return (a + b) + (c + d);
+}
+
+template<int N, typename T>
+inline T v_multiply_and_sum(const T *const BQ_R__ src1,
+                            const T *const BQ_R__ src2)
+{
+    if (N > BQ_FIXED_SIZE_LIMIT) return v_multiply_and_sum(src1, src2, N);
+    T a = T(), b = T(), c = T(), d = T();
+    for (int i = 0; i + 4 <= N; i += 4) {
+        a += src1[i] * src2[i];
+        b += src1[i+1] * src2[i+1];
+        c += src1[i+2] * src2[i+2];
+        d += src1[i+3] * src2[i+3];
+    }
+    for (int i = N - N % 4; i < N; ++i) {
+        a += src1[i] * src2[i];
+    }
+    return (a + b) + (c + d);
+}
+
+/**
+ * v_interleave_complex
+ *
+ * Interleave the \arg re and \arg im vectors, each of length N, into
+ * \arg dst as N complex pairs (2N values) with the real part first.
+ * \arg im may be null, in which case the imaginary parts are zero.
+ *
+ * Caller guarantees that \arg dst does not overlap \arg re or \arg im.
+ */
+template<int N, typename T>
+inline void v_interleave_complex(T *const BQ_R__ dst,
+                                 const T *const BQ_R__ re,
+                                 const T *const BQ_R__ im)
+{
+    if (im) {
+        for (int i = 0; i < N; ++i) {
+            dst[i*2] = re[i];
+            dst[i*2+1] = im[i];
+        }
+    } else {
+        for (int i = 0; i < N; ++i) {
+            dst[i*2] = re[i];
+            dst[i*2+1] = T(0);
+        }
+    }
+}
+
+/**
+ * v_deinterleave_complex
+ *
+ * Separate the N complex pairs in \arg src (2N values, real part
+ * first) into the \arg re and \arg im vectors, each of length N.
+ * \arg im may be null, in which case the imaginary parts are
+ * discarded.
+ *
+ * Caller guarantees that \arg src does not overlap \arg re or \arg im.
+ */
+template<int N, typename T>
+inline void v_deinterleave_complex(T *const BQ_R__ re,
+                                   T *const BQ_R__ im,
+                                   const T *const BQ_R__ src)
+{
+    if (im) {
+        for (int i = 0; i < N; ++i) {
+            re[i] = src[i*2];
+            im[i] = src[i*2+1];
+        }
+    } else {
+        for (int i = 0; i < N; ++i) {
+            re[i] = src[i*2];
+        }
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,250 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    bqvec
+
+    A small library for vector arithmetic and allocation in C++ using
+    raw C pointer arrays.
+
+    Copyright 2007-2015 Particular Programs Ltd.
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of Chris Cannam and
+    Particular Programs Ltd shall not be used in advertising or
+    otherwise to promote the sale, use or other dealings in this
+    Software without prior written authorization.
+*/
+
+
+#ifndef BQVEC_VECTOR_OPS_FUSED_H
+#define BQVEC_VECTOR_OPS_FUSED_H
+
+#include "VectorOps.h"
+
+namespace breakfastquay {
+
+/**
+ * Fused vector expressions.
+ *
+ * A chain of VectorOps calls such as v_copy, v_multiply, v_add and
+ * v_scale sweeps the whole of its buffer through the cache once for
+ * each call. An expression built here from v_expr() operands is
+ * instead evaluated by v_eval() in a single loop, reading each
+ * operand and writing the result once per element, e.g.
+ *
+ *   v_eval(out, (v_expr(in) * v_expr(window) + v_expr(prev)) * gain, n);
+ *
+ * in place of a copy, multiply, add and scale. Operands may be
+ * combined with +, -, * and /, with a scalar on either side of any
+ * of these, and with v_expr_square, v_expr_sqrt and v_expr_abs. All
+ * operands must have the same element type.
+ *
+ * As elsewhere in this header family, no intrinsics are used: the
+ * evaluation loop is written for the compiler to vectorize, and
+ * marked free of loop-carried dependencies where the compiler
+ * supports that. The destination may therefore be the same as any
+ * operand, but must not otherwise overlap one.
+ */
+
+#if defined __clang__
+#define BQ_VECTORIZE_LOOP _Pragma("clang loop vectorize(assume_safety)")
+#elif (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#define BQ_VECTORIZE_LOOP _Pragma("GCC ivdep")
+#elif defined _MSC_VER
+#define BQ_VECTORIZE_LOOP __pragma(loop(ivdep))
+#else
+#define BQ_VECTORIZE_LOOP
+#endif
+
+/**
+ * An expression node, wrapping one of the node types below. Only
+ * these take part in the operators.
+ */
+template <typename E>
+class VExpr
+{
+public:
+    typedef typename E::value_type value_type;
+    explicit VExpr(const E &e) : m_e(e) { }
+    value_type operator[](int i) const { return m_e[i]; }
+private:
+    const E m_e;
+};
+
+template <typename T>
+struct VExprVector
+{
+    typedef T value_type;
+    explicit VExprVector(const T *v) : m_v(v) { }
+    T operator[](int i) const { return m_v[i]; }
+    const T *const m_v;
+};
+
+template <typename T>
+struct VExprScalar
+{
+    typedef T value_type;
+    explicit VExprScalar(T s) : m_s(s) { }
+    T operator[](int) const { return m_s; }
+    const T m_s;
+};
+
+template <typename A, typename B, typename Op>
+struct VExprBinary
+{
+    typedef typename A::value_type value_type;
+    VExprBinary(const A &a, const B &b) : m_a(a), m_b(b) { }
+    value_type operator[](int i) const { return Op::apply(m_a[i], m_b[i]); }
+    const A m_a;
+    const B m_b;
+};
+
+template <typename A, typename Op>
+struct VExprUnary
+{
+    typedef typename A::value_type value_type;
+    explicit VExprUnary(const A &a) : m_a(a) { }
+    value_type operator[](int i) const { return Op::apply(m_a[i]); }
+    const A m_a;
+};
+
+struct VExprAdd { template <typename T> static T apply(T a, T b) { return a + b; } };
+struct VExprSubtract { template <typename T> static T apply(T a, T b) { return a - b; } };
+struct VExprMultiply { template <typename T> static T apply(T a, T b) { return a * b; } };
+struct VExprDivide { template <typename T> static T apply(T a, T b) { return a / b; } };
+struct VExprSquare { template <typename T> static T apply(T a) { return a * a; } };
+struct VExprSqrt { template <typename T> static T apply(T a) { return std::sqrt(a); } };
+struct VExprAbs { template <typename T> static T apply(T a) { return a < T(0) ? -a : a; } };
+
+/**
+ * v_expr
+ *
+ * Return an expression operand reading the vector \arg src. The
+ * vector must remain valid until the expression is evaluated.
+ */
+template <typename T>
+inline VExpr<VExprVector<T> > v_expr(const T *const src)
+{
+    return VExpr<VExprVector<T> >(VExprVector<T>(src));
+}
+
+#define BQ_VEXPR_BINARY_OPERATOR(OP, NAME)                              \
+template <typename A, typename B>                                       \
+inline VExpr<VExprBinary<VExpr<A>, VExpr<B>, NAME> >                    \
+operator OP(const VExpr<A> &a, const VExpr<B> &b)                       \
+{                                                                       \
+    return VExpr<VExprBinary<VExpr<A>, VExpr<B>, NAME> >                \
+        (VExprBinary<VExpr<A>, VExpr<B>, NAME>(a, b));                  \
+}                                                                       \
+template <typename A>                                                   \
+inline VExpr<VExprBinary<VExpr<A>,                                      \
+                         VExprScalar<typename A::value_type>, NAME> >   \
+operator OP(const VExpr<A> &a, const typename A::value_type s)          \
+{                                                                       \
+    typedef VExprScalar<typename A::value_type> S;                      \
+    return VExpr<VExprBinary<VExpr<A>, S, NAME> >                       \
+        (VExprBinary<VExpr<A>, S, NAME>(a, S(s)));                      \
+}                                                                       \
+template <typename B>                                                   \
+inline VExpr<VExprBinary<VExprScalar<typename B::value_type>,           \
+                         VExpr<B>, NAME> >                              \
+operator OP(const typename B::value_type s, const VExpr<B> &b)          \
+{                                                                       \
+    typedef VExprScalar<typename B::value_type> S;                      \
+    return VExpr<VExprBinary<S, VExpr<B>, NAME> >                       \
+        (VExprBinary<S, VExpr<B>, NAME>(S(s), b));                      \
+}
+
+BQ_VEXPR_BINARY_OPERATOR(+, VExprAdd)
+BQ_VEXPR_BINARY_OPERATOR(-, VExprSubtract)
+BQ_VEXPR_BINARY_OPERATOR(*, VExprMultiply)
+BQ_VEXPR_BINARY_OPERATOR(/, VExprDivide)
+
+#undef BQ_VEXPR_BINARY_OPERATOR
+
+#define BQ_VEXPR_UNARY_FUNCTION(FN, NAME)                               \
+template <typename A>                                                   \
+inline VExpr<VExprUnary<VExpr<A>, NAME> > FN(const VExpr<A> &a)         \
+{                                                                       \
+    return VExpr<VExprUnary<VExpr<A>, NAME> >                           \
+        (VExprUnary<VExpr<A>, NAME>(a));                                \
+}
+
+BQ_VEXPR_UNARY_FUNCTION(v_expr_square, VExprSquare)
+BQ_VEXPR_UNARY_FUNCTION(v_expr_sqrt, VExprSqrt)
+BQ_VEXPR_UNARY_FUNCTION(v_expr_abs, VExprAbs)
+
+#undef BQ_VEXPR_UNARY_FUNCTION
+
+/**
+ * v_eval
+ *
+ * Evaluate the expression \arg expr for each of \arg count elements,
+ * writing the results to \arg dst.
+ */
+template <typename T, typename E>
+inline void v_eval(T *const dst,
+                   const VExpr<E> &expr,
+                   const int count)
+{
+    BQ_VECTORIZE_LOOP
+    for (int i = 0; i < count; ++i) {
+        dst[i] = expr[i];
+    }
+}
+
+/**
+ * v_eval_adding
+ *
+ * Evaluate the expression \arg expr for each of \arg count elements,
+ * adding the results to \arg dst.
+ */
+template <typename T, typename E>
+inline void v_eval_adding(T *const dst,
+                          const VExpr<E> &expr,
+                          const int count)
+{
+    BQ_VECTORIZE_LOOP
+    for (int i = 0; i < count; ++i) {
+        dst[i] += expr[i];
+    }
+}
+
+/**
+ * v_sum
+ *
+ * Return the sum of the \arg count elements of the expression \arg
+ * expr, without storing them.
+ */
+template <typename E>
+inline typename E::value_type v_sum(const VExpr<E> &expr,
+                                    const int count)
+{
+    typename E::value_type result = typename E::value_type();
+    for (int i = 0; i < count; ++i) {
+        result += expr[i];
+    }
+    return result;
+}
+
+}
+
+#endif
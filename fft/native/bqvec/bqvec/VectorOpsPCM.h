@@ -0,0 +1,350 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    bqvec
+
+    A small library for vector arithmetic and allocation in C++ using
+    raw C pointer arrays.
+
+    Copyright 2007-2015 Particular Programs Ltd.
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of Chris Cannam and
+    Particular Programs Ltd shall not be used in advertising or
+    otherwise to promote the sale, use or other dealings in this
+    Software without prior written authorization.
+*/
+
+#ifndef BQVEC_VECTOR_OPS_PCM_H
+#define BQVEC_VECTOR_OPS_PCM_H
+
+#include "VectorOps.h"
+
+#include <stdint.h>
+
+namespace breakfastquay {
+
+/**
+ * Conversion between interleaved integer PCM and separate channels
+ * of floating-point samples.
+ *
+ * Each function deinterleaves and converts, or converts and
+ * interleaves, in a single pass. The interleaved side has \arg
+ * channels * \arg count samples, frame by frame, and the channel
+ * side \arg channels vectors of \arg count samples each. Sample
+ * formats are signed 16-bit, signed 32-bit, and signed 24-bit packed
+ * into three bytes, least significant first.
+ *
+ * Integer full scale corresponds to floating-point 1.0 multiplied by
+ * \arg gain, in both directions. Conversion to integer rounds to the
+ * nearest value and clips to the range of the format. If \arg
+ * ditherState is non-NULL, triangular (TPDF) dither of plus or minus
+ * one least significant bit is added before rounding, from a
+ * pseudo-random sequence whose state is kept in the unsigned int it
+ * points to. Give each stream its own state, initialised to any
+ * value.
+ *
+ * With HAVE_BQ_SIMD (see VectorOps.h) the float versions use bqvec's
+ * own SIMD code; as there, results may differ in the last place, and
+ * values exactly halfway between two integers may round either way.
+ */
+
+#if defined HAVE_BQ_SIMD
+void v_deinterleave_from_int16_simd(float *const BQ_R__ *const BQ_R__ dst, const int16_t *const BQ_R__ src, const float gain, const int channels, const int count);
+void v_deinterleave_from_int24_simd(float *const BQ_R__ *const BQ_R__ dst, const unsigned char *const BQ_R__ src, const float gain, const int channels, const int count);
+void v_deinterleave_from_int32_simd(float *const BQ_R__ *const BQ_R__ dst, const int32_t *const BQ_R__ src, const float gain, const int channels, const int count);
+void v_interleave_to_int16_simd(int16_t *const BQ_R__ dst, const float *const BQ_R__ *const BQ_R__ src, const float gain, unsigned int *const ditherState, const int channels, const int count);
+void v_interleave_to_int24_simd(unsigned char *const BQ_R__ dst, const float *const BQ_R__ *const BQ_R__ src, const float gain, unsigned int *const ditherState, const int channels, const int count);
+void v_interleave_to_int32_simd(int32_t *const BQ_R__ dst, const float *const BQ_R__ *const BQ_R__ src, const float gain, unsigned int *const ditherState, const int channels, const int count);
+#endif
+
+/**
+ * pcm_tpdf_dither
+ *
+ * Return the next value, between -1 and 1 with a triangular
+ * distribution, from the dither sequence whose state is at \arg
+ * state.
+ */
+inline float pcm_tpdf_dither(unsigned int *const state)
+{
+    unsigned int s = *state * 1664525u + 1013904223u;
+    const int a = int((s >> 9) & 0x7fffff);
+    s = s * 1664525u + 1013904223u;
+    const int b = int((s >> 9) & 0x7fffff);
+    *state = s;
+    return float(a - b) * (1.f / 8388608.f);
+}
+
+/**
+ * pcm_quantise
+ *
+ * Return \arg v, plus dither if \arg ditherState is non-NULL,
+ * clipped to the range \arg lo to \arg hi and rounded to the nearest
+ * integer.
+ */
+template<typename T>
+inline int32_t pcm_quantise(T v, const T lo, const T hi,
+                            unsigned int *const ditherState)
+{
+    if (ditherState) v += T(pcm_tpdf_dither(ditherState));
+    if (v < lo) v = lo;
+    if (v > hi) v = hi;
+    return int32_t(v < T(0) ? v - T(0.5) : v + T(0.5));
+}
+
+/**
+ * v_deinterleave_from_int16
+ *
+ * Deinterleave the 16-bit PCM samples in \arg src into the \arg
+ * channels vectors in \arg dst, converting and scaling so that full
+ * scale becomes \arg gain.
+ */
+template<typename T>
+inline void v_deinterleave_from_int16(T *const BQ_R__ *const BQ_R__ dst,
+                                      const int16_t *const BQ_R__ src,
+                                      const T gain,
+                                      const int channels,
+                                      const int count)
+{
+    const T scale = gain / T(32768.0);
+    int idx = 0;
+    for (int i = 0; i < count; ++i) {
+        for (int c = 0; c < channels; ++c) {
+            dst[c][i] = T(src[idx++]) * scale;
+        }
+    }
+}
+
+#if defined HAVE_BQ_SIMD
+template<>
+inline void v_deinterleave_from_int16(float *const BQ_R__ *const BQ_R__ dst,
+                                      const int16_t *const BQ_R__ src,
+                                      const float gain,
+                                      const int channels,
+                                      const int count)
+{
+    v_deinterleave_from_int16_simd(dst, src, gain, channels, count);
+}
+#endif
+
+/**
+ * v_deinterleave_from_int24
+ *
+ * Deinterleave the packed 24-bit PCM samples in \arg src, three
+ * bytes each, into the \arg channels vectors in \arg dst, converting
+ * and scaling so that full scale becomes \arg gain.
+ */
+template<typename T>
+inline void v_deinterleave_from_int24(T *const BQ_R__ *const BQ_R__ dst,
+                                      const unsigned char *const BQ_R__ src,
+                                      const T gain,
+                                      const int channels,
+                                      const int count)
+{
+    // Assemble each sample in the top three bytes of an int32, so
+    // that its sign comes out right without a shift
+    const T scale = gain / T(2147483648.0);
+    int idx = 0;
+    for (int i = 0; i < count; ++i) {
+        for (int c = 0; c < channels; ++c) {
+            const int32_t s = int32_t((uint32_t(src[idx]) << 8) |
+                                      (uint32_t(src[idx+1]) << 16) |
+                                      (uint32_t(src[idx+2]) << 24));
+            dst[c][i] = T(s) * scale;
+            idx += 3;
+        }
+    }
+}
+
+#if defined HAVE_BQ_SIMD
+template<>
+inline void v_deinterleave_from_int24(float *const BQ_R__ *const BQ_R__ dst,
+                                      const unsigned char *const BQ_R__ src,
+                                      const float gain,
+                                      const int channels,
+                                      const int count)
+{
+    v_deinterleave_from_int24_simd(dst, src, gain, channels, count);
+}
+#endif
+
+/**
+ * v_deinterleave_from_int32
+ *
+ * Deinterleave the 32-bit PCM samples in \arg src into the \arg
+ * channels vectors in \arg dst, converting and scaling so that full
+ * scale becomes \arg gain.
+ */
+template<typename T>
+inline void v_deinterleave_from_int32(T *const BQ_R__ *const BQ_R__ dst,
+                                      const int32_t *const BQ_R__ src,
+                                      const T gain,
+                                      const int channels,
+                                      const int count)
+{
+    const T scale = gain / T(2147483648.0);
+    int idx = 0;
+    for (int i = 0; i < count; ++i) {
+        for (int c = 0; c < channels; ++c) {
+            dst[c][i] = T(src[idx++]) * scale;
+        }
+    }
+}
+
+#if defined HAVE_BQ_SIMD
+template<>
+inline void v_deinterleave_from_int32(float *const BQ_R__ *const BQ_R__ dst,
+                                      const int32_t *const BQ_R__ src,
+                                      const float gain,
+                                      const int channels,
+                                      const int count)
+{
+    v_deinterleave_from_int32_simd(dst, src, gain, channels, count);
+}
+#endif
+
+/**
+ * v_interleave_to_int16
+ *
+ * Interleave the \arg channels vectors in \arg src into \arg dst as
+ * 16-bit PCM, scaling so that \arg gain becomes full scale, with
+ * optional dither and with clipping.
+ */
+template<typename T>
+inline void v_interleave_to_int16(int16_t *const BQ_R__ dst,
+                                  const T *const BQ_R__ *const BQ_R__ src,
+                                  const T gain,
+                                  unsigned int *const ditherState,
+                                  const int channels,
+                                  const int count)
+{
+    const T scale = gain * T(32768.0);
+    int idx = 0;
+    for (int i = 0; i < count; ++i) {
+        for (int c = 0; c < channels; ++c) {
+            dst[idx++] = int16_t(pcm_quantise(src[c][i] * scale,
+                                              T(-32768.0), T(32767.0),
+                                              ditherState));
+        }
+    }
+}
+
+#if defined HAVE_BQ_SIMD
+template<>
+inline void v_interleave_to_int16(int16_t *const BQ_R__ dst,
+                                  const float *const BQ_R__ *const BQ_R__ src,
+                                  const float gain,
+                                  unsigned int *const ditherState,
+                                  const int channels,
+                                  const int count)
+{
+    v_interleave_to_int16_simd(dst, src, gain, ditherState, channels, count);
+}
+#endif
+
+/**
+ * v_interleave_to_int24
+ *
+ * Interleave the \arg channels vectors in \arg src into \arg dst as
+ * packed 24-bit PCM, three bytes per sample, scaling so that \arg
+ * gain becomes full scale, with optional dither and with clipping.
+ */
+template<typename T>
+inline void v_interleave_to_int24(unsigned char *const BQ_R__ dst,
+                                  const T *const BQ_R__ *const BQ_R__ src,
+                                  const T gain,
+                                  unsigned int *const ditherState,
+                                  const int channels,
+                                  const int count)
+{
+    const T scale = gain * T(8388608.0);
+    int idx = 0;
+    for (int i = 0; i < count; ++i) {
+        for (int c = 0; c < channels; ++c) {
+            const uint32_t s = uint32_t(pcm_quantise(src[c][i] * scale,
+                                                     T(-8388608.0),
+                                                     T(8388607.0),
+                                                     ditherState));
+            dst[idx] = (unsigned char)(s & 0xff);
+            dst[idx+1] = (unsigned char)((s >> 8) & 0xff);
+            dst[idx+2] = (unsigned char)((s >> 16) & 0xff);
+            idx += 3;
+        }
+    }
+}
+
+#if defined HAVE_BQ_SIMD
+template<>
+inline void v_interleave_to_int24(unsigned char *const BQ_R__ dst,
+                                  const float *const BQ_R__ *const BQ_R__ src,
+                                  const float gain,
+                                  unsigned int *const ditherState,
+                                  const int channels,
+                                  const int count)
+{
+    v_interleave_to_int24_simd(dst, src, gain, ditherState, channels, count);
+}
+#endif
+
+/**
+ * v_interleave_to_int32
+ *
+ * Interleave the \arg channels vectors in \arg src into \arg dst as
+ * 32-bit PCM, scaling so that \arg gain becomes full scale, with
+ * optional dither and with clipping.
+ */
+template<typename T>
+inline void v_interleave_to_int32(int32_t *const BQ_R__ dst,
+                                  const T *const BQ_R__ *const BQ_R__ src,
+                                  const T gain,
+                                  unsigned int *const ditherState,
+                                  const int channels,
+                                  const int count)
+{
+    // The top of the range is the largest float below 2^31, so that
+    // it converts to int32 in either precision
+    const T scale = gain * T(2147483648.0);
+    int idx = 0;
+    for (int i = 0; i < count; ++i) {
+        for (int c = 0; c < channels; ++c) {
+            dst[idx++] = pcm_quantise(src[c][i] * scale,
+                                      T(-2147483648.0), T(2147483520.0),
+                                      ditherState);
+        }
+    }
+}
+
+#if defined HAVE_BQ_SIMD
+template<>
+inline void v_interleave_to_int32(int32_t *const BQ_R__ dst,
+                                  const float *const BQ_R__ *const BQ_R__ src,
+                                  const float gain,
+                                  unsigned int *const ditherState,
+                                  const int channels,
+                                  const int count)
+{
+    v_interleave_to_int32_simd(dst, src, gain, ditherState, channels, count);
+}
+#endif
+
+}
+
+#endif
@@ -39,6 +39,17 @@
 #include <ipps.h>
 #endif
 
+#ifdef USE_ALLOCATION_POOL
+#include <pthread.h>
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#ifndef BQ_LARGE_ALLOCATION
+#define BQ_LARGE_ALLOCATION (2 * 1024 * 1024)
+#endif
+#endif
+
 #include <iostream>
 using std::cerr;
 using std::endl;
@@ -77,5 +88,220 @@ void deallocate(double *ptr)
 
 #endif
 
+#ifdef USE_ALLOCATION_POOL
+
+// Size classes run from 2^minPower to 2^maxPower bytes, counting the
+// header, in steps of a quarter of a power of two, so that a block
+// is at most a quarter bigger than needed even when the size
+// requested is itself a power of two. Anything bigger is not cached
+static const int minPower = 6;
+static const int maxPower = 23;
+static const int classCount = 1 + 4 * (maxPower - minPower);
+
+// Each thread caches up to this many bytes in each class. A block
+// of the largest class fills it alone
+static const size_t cacheBytesPerClass = size_t(1) << maxPower;
+
+struct BlockHeader
+{
+    BlockHeader *next;  // while in a thread's cache
+    size_t length;      // of the whole block, including this header
+    int sizeClass;      // or -1 if not to be cached
+    bool mapped;        // from mmap rather than the heap
+};
+
+typedef char BlockHeaderFitsInAlignment
+[(sizeof(BlockHeader) <= BQ_ALLOCATION_ALIGNMENT) ? 1 : -1];
+
+struct ThreadCache
+{
+    BlockHeader *head[classCount];
+    int count[classCount];
+};
+
+static pthread_key_t cacheKey;
+static pthread_once_t cacheKeyOnce = PTHREAD_ONCE_INIT;
+
+#ifdef __GNUC__
+// Saves looking the cache up through the key on every call
+static __thread ThreadCache *localCache = 0;
+#endif
+
+// Return the size class for a block of the given length, including
+// header, and set classLength to the length of blocks in that class;
+// or return -1 if the length is too big to cache
+static int
+sizeClassFor(size_t length, size_t &classLength)
+{
+    int k = minPower;
+    while (k <= maxPower && (size_t(1) << k) < length) ++k;
+    if (k > maxPower) return -1;
+    if (k == minPower) {
+        classLength = size_t(1) << k;
+        return 0;
+    }
+    size_t half = size_t(1) << (k - 1), step = half >> 2;
+    size_t quarters = (length - half + step - 1) / step;
+    classLength = half + quarters * step;
+    return (k - minPower - 1) * 4 + int(quarters);
+}
+
+static void *
+systemAllocate(size_t &length, bool &mapped)
+{
+    if (length >= BQ_LARGE_ALLOCATION) {
+        void *ptr = MAP_FAILED;
+#if defined USE_HUGETLB && defined MAP_HUGETLB
+        // Fails unless huge pages are reserved. Round up to a whole
+        // number of them, assuming they are BQ_LARGE_ALLOCATION bytes
+        size_t huge = ((length + BQ_LARGE_ALLOCATION - 1) /
+                       BQ_LARGE_ALLOCATION) * BQ_LARGE_ALLOCATION;
+        ptr = mmap(0, huge, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) length = huge;
+#endif
+        if (ptr == MAP_FAILED) {
+            ptr = mmap(0, length, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if (ptr != MAP_FAILED) madvise(ptr, length, MADV_HUGEPAGE);
+#endif
+        }
+        if (ptr != MAP_FAILED) {
+            mapped = true;
+            return ptr;
+        }
+    }
+    mapped = false;
+    void *ptr = 0;
+    if (posix_memalign(&ptr, BQ_ALLOCATION_ALIGNMENT, length)) return 0;
+    return ptr;
+}
+
+static void
+systemDeallocate(BlockHeader *block)
+{
+    if (block->mapped) munmap((void *)block, block->length);
+    else free((void *)block);
+}
+
+static void
+emptyCache(ThreadCache *cache)
+{
+    for (int k = 0; k < classCount; ++k) {
+        while (cache->head[k]) {
+            BlockHeader *block = cache->head[k];
+            cache->head[k] = block->next;
+            systemDeallocate(block);
+        }
+        cache->count[k] = 0;
+    }
+}
+
+static void
+destroyCache(void *arg)
+{
+    ThreadCache *cache = (ThreadCache *)arg;
+    emptyCache(cache);
+    free(cache);
+#ifdef __GNUC__
+    localCache = 0;
+#endif
+}
+
+static void
+createCacheKey()
+{
+    pthread_key_create(&cacheKey, destroyCache);
+}
+
+static ThreadCache *
+threadCache()
+{
+#ifdef __GNUC__
+    if (localCache) return localCache;
+#endif
+    pthread_once(&cacheKeyOnce, createCacheKey);
+    ThreadCache *cache = (ThreadCache *)pthread_getspecific(cacheKey);
+    if (!cache) {
+        // If this fails, the thread just goes without a cache
+        cache = (ThreadCache *)calloc(1, sizeof(ThreadCache));
+        if (cache) pthread_setspecific(cacheKey, cache);
+    }
+#ifdef __GNUC__
+    localCache = cache;
+#endif
+    return cache;
+}
+
+void *
+pool_allocate(size_t bytes)
+{
+    size_t length = bytes + BQ_ALLOCATION_ALIGNMENT;
+    size_t classLength = length;
+    int k = sizeClassFor(length, classLength);
+
+    BlockHeader *block = 0;
+
+    if (k >= 0) {
+        ThreadCache *cache = threadCache();
+        if (cache && cache->head[k]) {
+            block = cache->head[k];
+            cache->head[k] = block->next;
+            --cache->count[k];
+        }
+        length = classLength;
+    }
+
+    if (!block) {
+        bool mapped = false;
+        block = (BlockHeader *)systemAllocate(length, mapped);
+        if (!block) {
+#ifndef NO_EXCEPTIONS
+            throw(std::bad_alloc());
+#else
+            abort();
+#endif
+        }
+        block->length = length;
+        block->sizeClass = k;
+        block->mapped = mapped;
+    }
+
+    block->next = 0;
+    return (char *)block + BQ_ALLOCATION_ALIGNMENT;
+}
+
+void
+pool_deallocate(void *ptr)
+{
+    BlockHeader *block =
+        (BlockHeader *)((char *)ptr - BQ_ALLOCATION_ALIGNMENT);
+    int k = block->sizeClass;
+
+    if (k >= 0) {
+        ThreadCache *cache = threadCache();
+        int limit = int(cacheBytesPerClass / block->length);
+        if (cache && cache->count[k] < limit) {
+            block->next = cache->head[k];
+            cache->head[k] = block;
+            ++cache->count[k];
+            return;
+        }
+    }
+
+    systemDeallocate(block);
+}
+
+void
+pool_release_thread_cache()
+{
+    pthread_once(&cacheKeyOnce, createCacheKey);
+    ThreadCache *cache = (ThreadCache *)pthread_getspecific(cacheKey);
+    if (cache) emptyCache(cache);
+}
+
+#endif
+
 }
 
@@ -218,13 +218,14 @@ v_polar_to_cartesian_interleaved_pommier(float *const BQ_R__ dst,
 
 #if defined HAVE_IPP
 
-void
-v_polar_to_cartesian(bq_complex_t *const BQ_R__ dst,
-		     const bq_complex_element_t *const BQ_R__ mag,
-		     const bq_complex_element_t *const BQ_R__ phase,
-		     const int count)
+template<typename T>
+static void
+polar_to_cartesian(bq_complex<T> *const BQ_R__ dst,
+                   const T *const BQ_R__ mag,
+                   const T *const BQ_R__ phase,
+                   const int count)
 {
-    if (sizeof(bq_complex_element_t) == sizeof(float)) {
+    if (sizeof(T) == sizeof(float)) {
 	ippsPolarToCart_32fc((const float *)mag, (const float *)phase,
                              (Ipp32fc *)dst, count);
     } else {
@@ -235,16 +236,16 @@ v_polar_to_cartesian(bq_complex_t *const BQ_R__ dst,
 
 #elif defined HAVE_VDSP
 
-void
-v_polar_to_cartesian(bq_complex_t *const BQ_R__ dst,
-		     const bq_complex_element_t *const BQ_R__ mag,
-		     const bq_complex_element_t *const BQ_R__ phase,
-		     const int count)
+template<typename T>
+static void
+polar_to_cartesian(bq_complex<T> *const BQ_R__ dst,
+                   const T *const BQ_R__ mag,
+                   const T *const BQ_R__ phase,
+                   const int count)
 {
-    bq_complex_element_t *sc = (bq_complex_element_t *)
-	alloca(count * 2 * sizeof(bq_complex_element_t));
+    T *sc = (T *)alloca(count * 2 * sizeof(T));
 
-    if (sizeof(bq_complex_element_t) == sizeof(float)) {
+    if (sizeof(T) == sizeof(float)) {
         vvsincosf((float *)sc, (float *)(sc + count), (float *)phase, &count);
     } else {
         vvsincos((double *)sc, (double *)(sc + count), (double *)phase, &count);
@@ -261,11 +262,12 @@ v_polar_to_cartesian(bq_complex_t *const BQ_R__ dst,
 
 #else
 
-void
-v_polar_to_cartesian(bq_complex_t *const BQ_R__ dst,
-		     const bq_complex_element_t *const BQ_R__ mag,
-		     const bq_complex_element_t *const BQ_R__ phase,
-		     const int count)
+template<typename T>
+static void
+polar_to_cartesian(bq_complex<T> *const BQ_R__ dst,
+                   const T *const BQ_R__ mag,
+                   const T *const BQ_R__ phase,
+                   const int count)
 {
     for (int i = 0; i < count; ++i) {
 	dst[i] = c_phasor(phase[i]);
@@ -278,6 +280,24 @@ v_polar_to_cartesian(bq_complex_t *const BQ_R__ dst,
 
 #endif
 
+void
+v_polar_to_cartesian(bq_complex<float> *const BQ_R__ dst,
+		     const float *const BQ_R__ mag,
+		     const float *const BQ_R__ phase,
+		     const int count)
+{
+    polar_to_cartesian(dst, mag, phase, count);
+}
+
+void
+v_polar_to_cartesian(bq_complex<double> *const BQ_R__ dst,
+		     const double *const BQ_R__ mag,
+		     const double *const BQ_R__ phase,
+		     const int count)
+{
+    polar_to_cartesian(dst, mag, phase, count);
+}
+
 #if defined USE_POMMIER_MATHFUN
 
 //!!! further tests reqd.  This is only single precision but it seems
@@ -285,10 +305,11 @@ v_polar_to_cartesian(bq_complex_t *const BQ_R__ dst,
 //!!! note that precision suffers for high arguments to sincos though,
 //!!! and that is probably a common case for us
 
-void
-v_polar_interleaved_to_cartesian(bq_complex_t *const BQ_R__ dst,
-				 const bq_complex_element_t *const BQ_R__ src,
-				 const int count)
+template<typename T>
+static void
+polar_interleaved_to_cartesian(bq_complex<T> *const BQ_R__ dst,
+                               const T *const BQ_R__ src,
+                               const int count)
 {
     int idx = 0, tidx = 0;
 
@@ -315,16 +336,15 @@ v_polar_interleaved_to_cartesian(bq_complex_t *const BQ_R__ dst,
 // with a vector library, it should be faster to deinterleave and call
 // the basic fn
 
-void
-v_polar_interleaved_to_cartesian(bq_complex_t *const BQ_R__ dst,
-				 const bq_complex_element_t *const BQ_R__ src,
-				 const int count)
+template<typename T>
+static void
+polar_interleaved_to_cartesian(bq_complex<T> *const BQ_R__ dst,
+                               const T *const BQ_R__ src,
+                               const int count)
 {
-    bq_complex_element_t *mag = (bq_complex_element_t *)
-	alloca(count * sizeof(bq_complex_element_t));
-    bq_complex_element_t *phase = (bq_complex_element_t *)
-	alloca(count * sizeof(bq_complex_element_t));
-    bq_complex_element_t *magphase[] = { mag, phase };
+    T *mag = (T *)alloca(count * sizeof(T));
+    T *phase = (T *)alloca(count * sizeof(T));
+    T *magphase[] = { mag, phase };
 
     v_deinterleave(magphase, src, 2, count);
     v_polar_to_cartesian(dst, mag, phase, count);
@@ -334,12 +354,13 @@ v_polar_interleaved_to_cartesian(bq_complex_t *const BQ_R__ dst,
 
 // without a vector library, better avoid the deinterleave step
 
-void
-v_polar_interleaved_to_cartesian(bq_complex_t *const BQ_R__ dst,
-				 const bq_complex_element_t *const BQ_R__ src,
-				 const int count)
+template<typename T>
+static void
+polar_interleaved_to_cartesian(bq_complex<T> *const BQ_R__ dst,
+                               const T *const BQ_R__ src,
+                               const int count)
 {
-    bq_complex_element_t mag, phase;
+    T mag, phase;
     int idx = 0;
     for (int i = 0; i < count; ++i) {
         mag = src[idx++];
@@ -352,6 +373,22 @@ v_polar_interleaved_to_cartesian(bq_complex_t *const BQ_R__ dst,
 
 #endif
 
+void
+v_polar_interleaved_to_cartesian(bq_complex<float> *const BQ_R__ dst,
+				 const float *const BQ_R__ src,
+				 const int count)
+{
+    polar_interleaved_to_cartesian(dst, src, count);
+}
+
+void
+v_polar_interleaved_to_cartesian(bq_complex<double> *const BQ_R__ dst,
+				 const double *const BQ_R__ src,
+				 const int count)
+{
+    polar_interleaved_to_cartesian(dst, src, count);
+}
+
 void
 v_polar_interleaved_to_cartesian_inplace(bq_complex_element_t *const BQ_R__ srcdst,
                                          const int count)
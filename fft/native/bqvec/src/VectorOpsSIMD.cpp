@@ -0,0 +1,2251 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    bqvec
+
+    A small library for vector arithmetic and allocation in C++ using
+    raw C pointer arrays.
+
+    Copyright 2007-2015 Particular Programs Ltd.
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of Chris Cannam and
+    Particular Programs Ltd shall not be used in advertising or
+    otherwise to promote the sale, use or other dealings in this
+    Software without prior written authorization.
+*/
+
+#include "VectorOpsComplex.h"
+#include "VectorOpsPCM.h"
+#include "VectorOpsFeatures.h"
+
+#if defined HAVE_BQ_SIMD
+
+#include <cmath>
+#include <cfloat>
+#include <limits>
+
+#ifndef NO_THREADING
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BQ_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define BQ_SIMD_AVX2 1
+#define BQ_SIMD_AVX2_TARGET
+#include <immintrin.h>
+#elif defined(BQ_SIMD_SSE2) && defined(__GNUC__)
+#define BQ_SIMD_AVX2 1
+#define BQ_SIMD_AVX2_RUNTIME 1
+#define BQ_SIMD_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX512F__)
+#define BQ_SIMD_AVX512 1
+#define BQ_SIMD_AVX512_TARGET
+#include <immintrin.h>
+#elif defined(BQ_SIMD_SSE2) && defined(__GNUC__)
+#define BQ_SIMD_AVX512 1
+#define BQ_SIMD_AVX512_RUNTIME 1
+#define BQ_SIMD_AVX512_TARGET __attribute__((target("avx512f")))
+#include <immintrin.h>
+#endif
+
+// NEON is used only on 64-bit ARM, which has vector division and
+// square root, and double precision
+#if defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define BQ_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if (defined(BQ_SIMD_AVX2_RUNTIME) || defined(BQ_SIMD_AVX512_RUNTIME)) && \
+    defined(__GNUC__) && !defined(__clang__)
+// The AVX kernels are instantiated from templates that are not
+// themselves built for AVX, which GCC warns about although they are
+// only ever inlined into functions that are
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+#if defined(BQ_SIMD_AVX512) && defined(__GNUC__) && !defined(__clang__)
+// GCC's own AVX-512 headers trip its maybe-uninitialized warning
+// wherever they use a deliberately undefined vector as a mask source
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#if defined(_MSC_VER)
+#define BQ_SIMD_INLINE __forceinline
+#else
+#define BQ_SIMD_INLINE inline __attribute__((always_inline))
+#endif
+
+// Hide a vector's value from the optimiser, so that it cannot
+// reassociate arithmetic across this point (as it may with
+// -ffast-math, which would undo the argument reduction in exp). The
+// constraint is the register class of the vector type
+#if defined(__GNUC__)
+#define BQ_SIMD_OPAQUE(v, c) __asm__("" : "+" c (v))
+#else
+#define BQ_SIMD_OPAQUE(v, c)
+#endif
+
+namespace breakfastquay {
+
+/*
+ Each instruction set is described by a traits struct giving its
+ vector type V, its width, and the operations the kernels below are
+ written in terms of. A mask type M is the result of a comparison,
+ used with select, and opaque returns its argument unchanged but
+ unknown to the optimiser. The float traits also provide what the log
+ and exp kernels need to take floats apart and put them back
+ together. The scalar traits are used for the elements left over at
+ the end of the polar conversions, so that those come out the same
+ as the rest. The vector traits also have what complex multiplication
+ of interleaved re/im pairs needs: the real or imaginary part of each
+ pair copied across it (reals, imags), each pair swapped, and a
+ multiply from which a third vector is subtracted in the real places
+ and to which it is added in the imaginary ones (mulAddSub, fused
+ where the instruction set has it). The four-wide float traits, for
+ SSE2 and NEON, have what the PCM conversions need: loads from and
+ stores to 16- and 32-bit integers (rounding to nearest on the way
+ out, and saturating to 16 bits), and the unzip, zip and 4x4
+ transpose that move samples between frames and channels.
+
+ Kernels are templates over the traits, always inlined into one
+ wrapper function per instruction set, so that the wrappers for AVX2
+ and AVX-512 can be compiled for those instruction sets alone (with
+ GCC or Clang on x86) and chosen at runtime if the CPU supports them.
+ Elements left over at the end of a vector are handled with scalar
+ code.
+*/
+
+template <typename T>
+struct SIMDScalar
+{
+    typedef T V;
+    typedef bool M;
+    enum { width = 1 };
+    static BQ_SIMD_INLINE V load(const T *p) { return *p; }
+    static BQ_SIMD_INLINE void store(T *p, V v) { *p = v; }
+    static BQ_SIMD_INLINE V set(T x) { return x; }
+    static BQ_SIMD_INLINE V add(V a, V b) { return a + b; }
+    static BQ_SIMD_INLINE V sub(V a, V b) { return a - b; }
+    static BQ_SIMD_INLINE V mul(V a, V b) { return a * b; }
+    static BQ_SIMD_INLINE V div(V a, V b) { return a / b; }
+    static BQ_SIMD_INLINE V sqrt(V a) { return std::sqrt(a); }
+    static BQ_SIMD_INLINE V abs(V a) { return std::fabs(a); }
+    static BQ_SIMD_INLINE V min(V a, V b) { return a < b ? a : b; }
+    static BQ_SIMD_INLINE V max(V a, V b) { return a < b ? b : a; }
+    static BQ_SIMD_INLINE T sum(V a) { return a; }
+    static BQ_SIMD_INLINE M lt(V a, V b) { return a < b; }
+    static BQ_SIMD_INLINE V select(M m, V a, V b) { return m ? a : b; }
+    static BQ_SIMD_INLINE bool within(V a, T lo, T hi) { return a >= lo && a <= hi; }
+    static BQ_SIMD_INLINE V floor(V a) { return std::floor(a); }
+    static BQ_SIMD_INLINE V opaque(V a) { BQ_SIMD_OPAQUE(a, "m"); return a; }
+};
+
+#ifdef BQ_SIMD_SSE2
+
+struct SIMDSSE2f
+{
+    typedef __m128 V;
+    typedef __m128 M;
+    enum { width = 4 };
+    static BQ_SIMD_INLINE V load(const float *p) { return _mm_loadu_ps(p); }
+    static BQ_SIMD_INLINE void store(float *p, V v) { _mm_storeu_ps(p, v); }
+    static BQ_SIMD_INLINE V set(float x) { return _mm_set1_ps(x); }
+    static BQ_SIMD_INLINE V add(V a, V b) { return _mm_add_ps(a, b); }
+    static BQ_SIMD_INLINE V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static BQ_SIMD_INLINE V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static BQ_SIMD_INLINE V div(V a, V b) { return _mm_div_ps(a, b); }
+    static BQ_SIMD_INLINE V sqrt(V a) { return _mm_sqrt_ps(a); }
+    static BQ_SIMD_INLINE V abs(V a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+    static BQ_SIMD_INLINE V min(V a, V b) { return _mm_min_ps(a, b); }
+    static BQ_SIMD_INLINE V max(V a, V b) { return _mm_max_ps(a, b); }
+    static BQ_SIMD_INLINE float sum(V a) {
+        float f[4]; _mm_storeu_ps(f, a); return (f[0] + f[1]) + (f[2] + f[3]);
+    }
+    static BQ_SIMD_INLINE M lt(V a, V b) { return _mm_cmplt_ps(a, b); }
+    static BQ_SIMD_INLINE V select(M m, V a, V b) {
+        return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+    }
+    static BQ_SIMD_INLINE bool within(V a, float lo, float hi) {
+        return _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(a, _mm_set1_ps(lo)),
+                                          _mm_cmple_ps(a, _mm_set1_ps(hi))))
+            == 0xf;
+    }
+    static BQ_SIMD_INLINE V floor(V a) {
+        V t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+        return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.f)));
+    }
+    static BQ_SIMD_INLINE V pow2(V n) {
+        __m128i e = _mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127));
+        return _mm_castsi128_ps(_mm_slli_epi32(e, 23));
+    }
+    static BQ_SIMD_INLINE V opaque(V a) { BQ_SIMD_OPAQUE(a, "x"); return a; }
+    static BQ_SIMD_INLINE V reals(V a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 0, 0)); }
+    static BQ_SIMD_INLINE V imags(V a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 1, 1)); }
+    static BQ_SIMD_INLINE V swapPairs(V a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)); }
+    static BQ_SIMD_INLINE V mulAddSub(V a, V b, V c) {
+        return _mm_add_ps(_mm_mul_ps(a, b), _mm_xor_ps(c, _mm_set_ps(0.f, -0.f, 0.f, -0.f)));
+    }
+    static BQ_SIMD_INLINE V frexp(V a, V &e) {
+        __m128i i = _mm_castps_si128(a);
+        e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(i, 23), _mm_set1_epi32(126)));
+        i = _mm_or_si128(_mm_and_si128(i, _mm_set1_epi32(0x807fffff)),
+                         _mm_set1_epi32(0x3f000000));
+        return _mm_castsi128_ps(i);
+    }
+    static BQ_SIMD_INLINE V fromInt16(const int16_t *p) {
+        __m128i i = _mm_loadl_epi64((const __m128i *)p);
+        return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(i, i), 16));
+    }
+    static BQ_SIMD_INLINE V fromInt32(const int32_t *p) {
+        return _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)p));
+    }
+    static BQ_SIMD_INLINE void toInt16(int16_t *p, V v) {
+        __m128i i = _mm_cvtps_epi32(v);
+        _mm_storel_epi64((__m128i *)p, _mm_packs_epi32(i, i));
+    }
+    static BQ_SIMD_INLINE void toInt32(int32_t *p, V v) {
+        _mm_storeu_si128((__m128i *)p, _mm_cvtps_epi32(v));
+    }
+    static BQ_SIMD_INLINE void unzip(V a, V b, V &even, V &odd) {
+        even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        odd = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    }
+    static BQ_SIMD_INLINE void zip(V even, V odd, V &a, V &b) {
+        a = _mm_unpacklo_ps(even, odd);
+        b = _mm_unpackhi_ps(even, odd);
+    }
+    static BQ_SIMD_INLINE void transpose(V &a, V &b, V &c, V &d) {
+        _MM_TRANSPOSE4_PS(a, b, c, d);
+    }
+};
+
+struct SIMDSSE2d
+{
+    typedef __m128d V;
+    typedef __m128d M;
+    enum { width = 2 };
+    static BQ_SIMD_INLINE V load(const double *p) { return _mm_loadu_pd(p); }
+    static BQ_SIMD_INLINE void store(double *p, V v) { _mm_storeu_pd(p, v); }
+    static BQ_SIMD_INLINE V set(double x) { return _mm_set1_pd(x); }
+    static BQ_SIMD_INLINE V add(V a, V b) { return _mm_add_pd(a, b); }
+    static BQ_SIMD_INLINE V sub(V a, V b) { return _mm_sub_pd(a, b); }
+    static BQ_SIMD_INLINE V mul(V a, V b) { return _mm_mul_pd(a, b); }
+    static BQ_SIMD_INLINE V div(V a, V b) { return _mm_div_pd(a, b); }
+    static BQ_SIMD_INLINE V sqrt(V a) { return _mm_sqrt_pd(a); }
+    static BQ_SIMD_INLINE V abs(V a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+    static BQ_SIMD_INLINE V min(V a, V b) { return _mm_min_pd(a, b); }
+    static BQ_SIMD_INLINE V max(V a, V b) { return _mm_max_pd(a, b); }
+    static BQ_SIMD_INLINE double sum(V a) {
+        double d[2]; _mm_storeu_pd(d, a); return d[0] + d[1];
+    }
+    static BQ_SIMD_INLINE M lt(V a, V b) { return _mm_cmplt_pd(a, b); }
+    static BQ_SIMD_INLINE V select(M m, V a, V b) {
+        return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b));
+    }
+    static BQ_SIMD_INLINE bool within(V a, double lo, double hi) {
+        return _mm_movemask_pd(_mm_and_pd(_mm_cmpge_pd(a, _mm_set1_pd(lo)),
+                                          _mm_cmple_pd(a, _mm_set1_pd(hi))))
+            == 0x3;
+    }
+    static BQ_SIMD_INLINE V floor(V a) {
+        // SSE2 has no double rounding, so truncate through int32,
+        // which limits this to arguments within int range
+        V t = _mm_cvtepi32_pd(_mm_cvttpd_epi32(a));
+        return _mm_sub_pd(t, _mm_and_pd(_mm_cmpgt_pd(t, a), _mm_set1_pd(1.0)));
+    }
+    static BQ_SIMD_INLINE V opaque(V a) { BQ_SIMD_OPAQUE(a, "x"); return a; }
+    static BQ_SIMD_INLINE V reals(V a) { return _mm_unpacklo_pd(a, a); }
+    static BQ_SIMD_INLINE V imags(V a) { return _mm_unpackhi_pd(a, a); }
+    static BQ_SIMD_INLINE V swapPairs(V a) { return _mm_shuffle_pd(a, a, 1); }
+    static BQ_SIMD_INLINE V mulAddSub(V a, V b, V c) {
+        return _mm_add_pd(_mm_mul_pd(a, b), _mm_xor_pd(c, _mm_set_pd(0.0, -0.0)));
+    }
+};
+
+#endif
+
+#ifdef BQ_SIMD_AVX2
+
+#define T_ BQ_SIMD_AVX2_TARGET
+
+struct SIMDAVX2f
+{
+    typedef __m256 V;
+    typedef __m256 M;
+    enum { width = 8 };
+    static T_ inline V load(const float *p) { return _mm256_loadu_ps(p); }
+    static T_ inline void store(float *p, V v) { _mm256_storeu_ps(p, v); }
+    static T_ inline V set(float x) { return _mm256_set1_ps(x); }
+    static T_ inline V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static T_ inline V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static T_ inline V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static T_ inline V div(V a, V b) { return _mm256_div_ps(a, b); }
+    static T_ inline V sqrt(V a) { return _mm256_sqrt_ps(a); }
+    static T_ inline V abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+    static T_ inline V min(V a, V b) { return _mm256_min_ps(a, b); }
+    static T_ inline V max(V a, V b) { return _mm256_max_ps(a, b); }
+    static T_ inline float sum(V a) {
+        float f[8]; _mm256_storeu_ps(f, a);
+        return ((f[0] + f[1]) + (f[2] + f[3])) + ((f[4] + f[5]) + (f[6] + f[7]));
+    }
+    static T_ inline M lt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static T_ inline V select(M m, V a, V b) { return _mm256_blendv_ps(b, a, m); }
+    static T_ inline bool within(V a, float lo, float hi) {
+        return _mm256_movemask_ps
+            (_mm256_and_ps(_mm256_cmp_ps(a, _mm256_set1_ps(lo), _CMP_GE_OQ),
+                           _mm256_cmp_ps(a, _mm256_set1_ps(hi), _CMP_LE_OQ)))
+            == 0xff;
+    }
+    static T_ inline V floor(V a) { return _mm256_floor_ps(a); }
+    static T_ inline V pow2(V n) {
+        __m256i e = _mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(e, 23));
+    }
+    static T_ inline V opaque(V a) { BQ_SIMD_OPAQUE(a, "x"); return a; }
+    static T_ inline V reals(V a) { return _mm256_moveldup_ps(a); }
+    static T_ inline V imags(V a) { return _mm256_movehdup_ps(a); }
+    static T_ inline V swapPairs(V a) { return _mm256_permute_ps(a, 0xb1); }
+    static T_ inline V mulAddSub(V a, V b, V c) { return _mm256_addsub_ps(_mm256_mul_ps(a, b), c); }
+    static T_ inline V frexp(V a, V &e) {
+        __m256i i = _mm256_castps_si256(a);
+        e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(i, 23),
+                                                _mm256_set1_epi32(126)));
+        i = _mm256_or_si256(_mm256_and_si256(i, _mm256_set1_epi32(0x807fffff)),
+                            _mm256_set1_epi32(0x3f000000));
+        return _mm256_castsi256_ps(i);
+    }
+};
+
+struct SIMDAVX2d
+{
+    typedef __m256d V;
+    typedef __m256d M;
+    enum { width = 4 };
+    static T_ inline V load(const double *p) { return _mm256_loadu_pd(p); }
+    static T_ inline void store(double *p, V v) { _mm256_storeu_pd(p, v); }
+    static T_ inline V set(double x) { return _mm256_set1_pd(x); }
+    static T_ inline V add(V a, V b) { return _mm256_add_pd(a, b); }
+    static T_ inline V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+    static T_ inline V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+    static T_ inline V div(V a, V b) { return _mm256_div_pd(a, b); }
+    static T_ inline V sqrt(V a) { return _mm256_sqrt_pd(a); }
+    static T_ inline V abs(V a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    static T_ inline V min(V a, V b) { return _mm256_min_pd(a, b); }
+    static T_ inline V max(V a, V b) { return _mm256_max_pd(a, b); }
+    static T_ inline double sum(V a) {
+        double d[4]; _mm256_storeu_pd(d, a); return (d[0] + d[1]) + (d[2] + d[3]);
+    }
+    static T_ inline M lt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static T_ inline V select(M m, V a, V b) { return _mm256_blendv_pd(b, a, m); }
+    static T_ inline bool within(V a, double lo, double hi) {
+        return _mm256_movemask_pd
+            (_mm256_and_pd(_mm256_cmp_pd(a, _mm256_set1_pd(lo), _CMP_GE_OQ),
+                           _mm256_cmp_pd(a, _mm256_set1_pd(hi), _CMP_LE_OQ)))
+            == 0xf;
+    }
+    static T_ inline V floor(V a) { return _mm256_floor_pd(a); }
+    static T_ inline V opaque(V a) { BQ_SIMD_OPAQUE(a, "x"); return a; }
+    static T_ inline V reals(V a) { return _mm256_movedup_pd(a); }
+    static T_ inline V imags(V a) { return _mm256_permute_pd(a, 0xf); }
+    static T_ inline V swapPairs(V a) { return _mm256_permute_pd(a, 0x5); }
+    static T_ inline V mulAddSub(V a, V b, V c) { return _mm256_addsub_pd(_mm256_mul_pd(a, b), c); }
+};
+
+#undef T_
+
+#endif
+
+#ifdef BQ_SIMD_AVX512
+
+#define T_ BQ_SIMD_AVX512_TARGET
+
+struct SIMDAVX512f
+{
+    typedef __m512 V;
+    typedef __mmask16 M;
+    enum { width = 16 };
+    static T_ inline V load(const float *p) { return _mm512_loadu_ps(p); }
+    static T_ inline void store(float *p, V v) { _mm512_storeu_ps(p, v); }
+    static T_ inline V set(float x) { return _mm512_set1_ps(x); }
+    static T_ inline V add(V a, V b) { return _mm512_add_ps(a, b); }
+    static T_ inline V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+    static T_ inline V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+    static T_ inline V div(V a, V b) { return _mm512_div_ps(a, b); }
+    static T_ inline V sqrt(V a) { return _mm512_sqrt_ps(a); }
+    static T_ inline V abs(V a) { return _mm512_abs_ps(a); }
+    static T_ inline V min(V a, V b) { return _mm512_min_ps(a, b); }
+    static T_ inline V max(V a, V b) { return _mm512_max_ps(a, b); }
+    static T_ inline float sum(V a) {
+        float f[16]; _mm512_storeu_ps(f, a);
+        float s = 0.f;
+        for (int i = 0; i < 16; i += 2) s += f[i] + f[i+1];
+        return s;
+    }
+    static T_ inline M lt(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static T_ inline V select(M m, V a, V b) { return _mm512_mask_blend_ps(m, b, a); }
+    static T_ inline bool within(V a, float lo, float hi) {
+        return (_mm512_cmp_ps_mask(a, _mm512_set1_ps(lo), _CMP_GE_OQ) &
+                _mm512_cmp_ps_mask(a, _mm512_set1_ps(hi), _CMP_LE_OQ))
+            == 0xffff;
+    }
+    static T_ inline V floor(V a) {
+        return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    }
+    static T_ inline V pow2(V n) {
+        __m512i e = _mm512_add_epi32(_mm512_cvttps_epi32(n), _mm512_set1_epi32(127));
+        return _mm512_castsi512_ps(_mm512_slli_epi32(e, 23));
+    }
+    static T_ inline V opaque(V a) { BQ_SIMD_OPAQUE(a, "v"); return a; }
+    static T_ inline V reals(V a) { return _mm512_moveldup_ps(a); }
+    static T_ inline V imags(V a) { return _mm512_movehdup_ps(a); }
+    static T_ inline V swapPairs(V a) { return _mm512_permute_ps(a, 0xb1); }
+    static T_ inline V mulAddSub(V a, V b, V c) { return _mm512_fmaddsub_ps(a, b, c); }
+    static T_ inline V frexp(V a, V &e) {
+        __m512i i = _mm512_castps_si512(a);
+        e = _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_srli_epi32(i, 23),
+                                                _mm512_set1_epi32(126)));
+        i = _mm512_or_si512(_mm512_and_si512(i, _mm512_set1_epi32(0x807fffff)),
+                            _mm512_set1_epi32(0x3f000000));
+        return _mm512_castsi512_ps(i);
+    }
+};
+
+struct SIMDAVX512d
+{
+    typedef __m512d V;
+    typedef __mmask8 M;
+    enum { width = 8 };
+    static T_ inline V load(const double *p) { return _mm512_loadu_pd(p); }
+    static T_ inline void store(double *p, V v) { _mm512_storeu_pd(p, v); }
+    static T_ inline V set(double x) { return _mm512_set1_pd(x); }
+    static T_ inline V add(V a, V b) { return _mm512_add_pd(a, b); }
+    static T_ inline V sub(V a, V b) { return _mm512_sub_pd(a, b); }
+    static T_ inline V mul(V a, V b) { return _mm512_mul_pd(a, b); }
+    static T_ inline V div(V a, V b) { return _mm512_div_pd(a, b); }
+    static T_ inline V sqrt(V a) { return _mm512_sqrt_pd(a); }
+    static T_ inline V abs(V a) { return _mm512_abs_pd(a); }
+    static T_ inline V min(V a, V b) { return _mm512_min_pd(a, b); }
+    static T_ inline V max(V a, V b) { return _mm512_max_pd(a, b); }
+    static T_ inline double sum(V a) {
+        double d[8]; _mm512_storeu_pd(d, a);
+        return ((d[0] + d[1]) + (d[2] + d[3])) + ((d[4] + d[5]) + (d[6] + d[7]));
+    }
+    static T_ inline M lt(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+    static T_ inline V select(M m, V a, V b) { return _mm512_mask_blend_pd(m, b, a); }
+    static T_ inline bool within(V a, double lo, double hi) {
+        return (_mm512_cmp_pd_mask(a, _mm512_set1_pd(lo), _CMP_GE_OQ) &
+                _mm512_cmp_pd_mask(a, _mm512_set1_pd(hi), _CMP_LE_OQ))
+            == 0xff;
+    }
+    static T_ inline V floor(V a) {
+        return _mm512_roundscale_pd(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    }
+    static T_ inline V opaque(V a) { BQ_SIMD_OPAQUE(a, "v"); return a; }
+    static T_ inline V reals(V a) { return _mm512_movedup_pd(a); }
+    static T_ inline V imags(V a) { return _mm512_permute_pd(a, 0xff); }
+    static T_ inline V swapPairs(V a) { return _mm512_permute_pd(a, 0x55); }
+    static T_ inline V mulAddSub(V a, V b, V c) { return _mm512_fmaddsub_pd(a, b, c); }
+};
+
+#undef T_
+
+#endif
+
+#ifdef BQ_SIMD_NEON
+
+struct SIMDNEONf
+{
+    typedef float32x4_t V;
+    typedef uint32x4_t M;
+    enum { width = 4 };
+    static BQ_SIMD_INLINE V load(const float *p) { return vld1q_f32(p); }
+    static BQ_SIMD_INLINE void store(float *p, V v) { vst1q_f32(p, v); }
+    static BQ_SIMD_INLINE V set(float x) { return vdupq_n_f32(x); }
+    static BQ_SIMD_INLINE V add(V a, V b) { return vaddq_f32(a, b); }
+    static BQ_SIMD_INLINE V sub(V a, V b) { return vsubq_f32(a, b); }
+    static BQ_SIMD_INLINE V mul(V a, V b) { return vmulq_f32(a, b); }
+    static BQ_SIMD_INLINE V div(V a, V b) { return vdivq_f32(a, b); }
+    static BQ_SIMD_INLINE V sqrt(V a) { return vsqrtq_f32(a); }
+    static BQ_SIMD_INLINE V abs(V a) { return vabsq_f32(a); }
+    static BQ_SIMD_INLINE V min(V a, V b) { return vminq_f32(a, b); }
+    static BQ_SIMD_INLINE V max(V a, V b) { return vmaxq_f32(a, b); }
+    static BQ_SIMD_INLINE float sum(V a) { return vaddvq_f32(a); }
+    static BQ_SIMD_INLINE M lt(V a, V b) { return vcltq_f32(a, b); }
+    static BQ_SIMD_INLINE V select(M m, V a, V b) { return vbslq_f32(m, a, b); }
+    static BQ_SIMD_INLINE bool within(V a, float lo, float hi) {
+        return vminvq_u32(vandq_u32(vcgeq_f32(a, vdupq_n_f32(lo)),
+                                    vcleq_f32(a, vdupq_n_f32(hi)))) != 0;
+    }
+    static BQ_SIMD_INLINE V floor(V a) { return vrndmq_f32(a); }
+    static BQ_SIMD_INLINE V pow2(V n) {
+        int32x4_t e = vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127));
+        return vreinterpretq_f32_s32(vshlq_n_s32(e, 23));
+    }
+    static BQ_SIMD_INLINE V opaque(V a) { BQ_SIMD_OPAQUE(a, "w"); return a; }
+    static BQ_SIMD_INLINE V reals(V a) { return vtrn1q_f32(a, a); }
+    static BQ_SIMD_INLINE V imags(V a) { return vtrn2q_f32(a, a); }
+    static BQ_SIMD_INLINE V swapPairs(V a) { return vrev64q_f32(a); }
+    static BQ_SIMD_INLINE V mulAddSub(V a, V b, V c) {
+        static const float sign[4] = { -1.f, 1.f, -1.f, 1.f };
+        return vfmaq_f32(vmulq_f32(c, vld1q_f32(sign)), a, b);
+    }
+    static BQ_SIMD_INLINE V frexp(V a, V &e) {
+        uint32x4_t i = vreinterpretq_u32_f32(a);
+        e = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(i, 23)),
+                                    vdupq_n_s32(126)));
+        i = vorrq_u32(vandq_u32(i, vdupq_n_u32(0x807fffff)),
+                      vdupq_n_u32(0x3f000000));
+        return vreinterpretq_f32_u32(i);
+    }
+    static BQ_SIMD_INLINE V fromInt16(const int16_t *p) {
+        return vcvtq_f32_s32(vmovl_s16(vld1_s16(p)));
+    }
+    static BQ_SIMD_INLINE V fromInt32(const int32_t *p) {
+        return vcvtq_f32_s32(vld1q_s32(p));
+    }
+    static BQ_SIMD_INLINE void toInt16(int16_t *p, V v) {
+        vst1_s16(p, vqmovn_s32(vcvtnq_s32_f32(v)));
+    }
+    static BQ_SIMD_INLINE void toInt32(int32_t *p, V v) {
+        vst1q_s32(p, vcvtnq_s32_f32(v));
+    }
+    static BQ_SIMD_INLINE void unzip(V a, V b, V &even, V &odd) {
+        even = vuzp1q_f32(a, b);
+        odd = vuzp2q_f32(a, b);
+    }
+    static BQ_SIMD_INLINE void zip(V even, V odd, V &a, V &b) {
+        a = vzip1q_f32(even, odd);
+        b = vzip2q_f32(even, odd);
+    }
+    static BQ_SIMD_INLINE void transpose(V &a, V &b, V &c, V &d) {
+        float64x2_t t0 = vreinterpretq_f64_f32(vtrn1q_f32(a, b));
+        float64x2_t t1 = vreinterpretq_f64_f32(vtrn2q_f32(a, b));
+        float64x2_t t2 = vreinterpretq_f64_f32(vtrn1q_f32(c, d));
+        float64x2_t t3 = vreinterpretq_f64_f32(vtrn2q_f32(c, d));
+        a = vreinterpretq_f32_f64(vtrn1q_f64(t0, t2));
+        b = vreinterpretq_f32_f64(vtrn1q_f64(t1, t3));
+        c = vreinterpretq_f32_f64(vtrn2q_f64(t0, t2));
+        d = vreinterpretq_f32_f64(vtrn2q_f64(t1, t3));
+    }
+};
+
+struct SIMDNEONd
+{
+    typedef float64x2_t V;
+    typedef uint64x2_t M;
+    enum { width = 2 };
+    static BQ_SIMD_INLINE V load(const double *p) { return vld1q_f64(p); }
+    static BQ_SIMD_INLINE void store(double *p, V v) { vst1q_f64(p, v); }
+    static BQ_SIMD_INLINE V set(double x) { return vdupq_n_f64(x); }
+    static BQ_SIMD_INLINE V add(V a, V b) { return vaddq_f64(a, b); }
+    static BQ_SIMD_INLINE V sub(V a, V b) { return vsubq_f64(a, b); }
+    static BQ_SIMD_INLINE V mul(V a, V b) { return vmulq_f64(a, b); }
+    static BQ_SIMD_INLINE V div(V a, V b) { return vdivq_f64(a, b); }
+    static BQ_SIMD_INLINE V sqrt(V a) { return vsqrtq_f64(a); }
+    static BQ_SIMD_INLINE V abs(V a) { return vabsq_f64(a); }
+    static BQ_SIMD_INLINE V min(V a, V b) { return vminq_f64(a, b); }
+    static BQ_SIMD_INLINE V max(V a, V b) { return vmaxq_f64(a, b); }
+    static BQ_SIMD_INLINE double sum(V a) { return vaddvq_f64(a); }
+    static BQ_SIMD_INLINE M lt(V a, V b) { return vcltq_f64(a, b); }
+    static BQ_SIMD_INLINE V select(M m, V a, V b) { return vbslq_f64(m, a, b); }
+    static BQ_SIMD_INLINE bool within(V a, double lo, double hi) {
+        uint64x2_t m = vandq_u64(vcgeq_f64(a, vdupq_n_f64(lo)),
+                                 vcleq_f64(a, vdupq_n_f64(hi)));
+        return (vgetq_lane_u64(m, 0) & vgetq_lane_u64(m, 1)) != 0;
+    }
+    static BQ_SIMD_INLINE V floor(V a) { return vrndmq_f64(a); }
+    static BQ_SIMD_INLINE V opaque(V a) { BQ_SIMD_OPAQUE(a, "w"); return a; }
+    static BQ_SIMD_INLINE V reals(V a) { return vtrn1q_f64(a, a); }
+    static BQ_SIMD_INLINE V imags(V a) { return vtrn2q_f64(a, a); }
+    static BQ_SIMD_INLINE V swapPairs(V a) { return vextq_f64(a, a, 1); }
+    static BQ_SIMD_INLINE V mulAddSub(V a, V b, V c) {
+        static const double sign[2] = { -1.0, 1.0 };
+        return vfmaq_f64(vmulq_f64(c, vld1q_f64(sign)), a, b);
+    }
+};
+
+#endif
+
+// The kernels. Each is written for a traits struct S with element
+// type T
+
+#define BQ_SIMD_LOOP(S, i, n) \
+    int i = 0; \
+    for (; i + int(S::width) <= n; i += S::width)
+
+template <typename S, typename T>
+BQ_SIMD_INLINE void
+k_add(T *const BQ_R__ dst, const T *const BQ_R__ src, const int n)
+{
+    BQ_SIMD_LOOP(S, i, n) {
+        S::store(dst + i, S::add(S::load(dst + i), S::load(src + i)));
+    }
+    for (; i < n; ++i) dst[i] += src[i];
+}
+
+template <typename S, typename T>
+BQ_SIMD_INLINE void
+k_add_value(T *const BQ_R__ dst, const T value, const int n)
+{
+    const typename S::V v = S::set(value);
+    BQ_SIMD_LOOP(S, i, n) {
+        S::store(dst + i, S::add(S::load(dst + i), v));
+    }
+    for (; i < n; ++i) dst[i] += value;
+}
+
+template <typename S, typename T>
+BQ_SIMD_INLINE void
+k_add_with_gain(T *const BQ_R__ dst, const T *const BQ_R__ src, const T gain, const int n)
+{
+    const typename S::V g = S::set(gain);
+    BQ_SIMD_LOOP(S, i, n) {
+        S::store(dst + i, S::add(S::load(dst + i), S::mul(S::load(src + i), g)));
+    }
+    for (; i < n; ++i) dst[i] += src[i] * gain;
+}
+
+template <typename S, typename T>
+BQ_SIMD_INLINE void
+k_subtract(T *const BQ_R__ dst, const T *const BQ_R__ src, const int n)
+{
+    BQ_SIMD_LOOP(S, i, n) {
+        S::store(dst + i, S::sub(S::load(dst + i), S::load(src + i)));
+    }
+    for (; i < n; ++i) dst[i] -= src[i];
+}
+
+template <typename S, typename T>
+BQ_SIMD_INLINE void
+k_scale(T *const BQ_R__ dst, const T gain, const int n)
+{
+    const typename S::V g = S::set(gain);
+    BQ_SIMD_LOOP(S, i, n) {
+        S::store(dst + i, S::mul(S::load(dst + i), g));
+    }
+    for (; i < n; ++i) dst[i] *= gain;
+}
+
+template <typename S, typename T>
+BQ_SIMD_INLINE void
+k_multiply(T *const BQ_R__ dst, const T *const BQ_R__ src, const int n)
+{
+    BQ_SIMD_LOOP(S, i, n) {
+        S::store(dst + i, S::mul(S::load(dst + i), S::load(src + i)));
+    }
+    for (; i < n; ++i) dst[i] *= src[i];
+}
+
+template <typename S, typename T>
+BQ_SIMD_INLINE void
+k_multiply_to(T *const BQ_R__ dst, const T *const BQ_R__ src1,
+              const T *const BQ_R__ src2, const int n)
+{
+    BQ_SIMD_LOOP(S, i, n) {
+        S::store(dst + i, S::mul(S::load(src1 + i), S::load(src2 + i)));
+    }
+    for (; i < n; ++i) dst[i] = src1[i] * src2[i];
+}
+
+template <typename S, typename T>
+BQ_SIMD_INLINE void
+k_divide(T *const BQ_R__ dst, const T *const BQ_R__ src, const int n)
+{
+    BQ_SIMD_LOOP(S, i, n) {
+        S::store(dst + i, S::div(S::load(dst + i), S::load(src + i)));
+    }
+    for (; i < n; ++i) dst[i] /= src[i];
+}
+
+template <typename S, typename T>
+BQ_SIMD_INLINE void
+k_multiply_and_add(T *const BQ_R__ dst, const T *const BQ_R__ src1,
+                   const T *const BQ_R__ src2, const int n)
+{
+    BQ_SIMD_LOOP(S, i, n) {
+        S::store(dst + i, S::add(S::load(dst + i),
+                                 S::mul(S::load(src1 + i), S::load(src2 + i))));
+    }
+    for (; i < n; ++i) dst[i] += src1[i] * src2[i];
+}
+
+// Complex multiplication over n interleaved re/im pairs. dst may be
+// the same as src1, as each vector is loaded before it is stored
+
+template <typename S, typename T>
+BQ_SIMD_INLINE void
+k_complex_multiply(T *dst, const T *src1, const T *src2, const int n)
+{
+    const int m = n * 2;
+    BQ_SIMD_LOOP(S, i, m) {
+        // (ar*br - ai*bi, ar*bi + ai*br)
+        const typename S::V a = S::load(src1 + i), b = S::load(src2 + i);
+        S::store(dst + i, S::mulAddSub(S::reals(a), b,
+                                       S::mul(S::imags(a), S::swapPairs(b))));
+    }
+    for (; i < m; i += 2) {
+        const T re = src1[i] * src2[i] - src1[i+1] * src2[i+1];
+        const T im = src1[i] * src2[i+1] + src1[i+1] * src2[i];
+        dst[i] = re;
+        dst[i+1] = im;
+    }
+}
+
+template <typename S, typename T>
+BQ_SIMD_INLINE void
+k_complex_multiply_and_add(T *const BQ_R__ dst, const T *const BQ_R__ src1,
+                           const T *const BQ_R__ src2, const int n)
+{
+    const int m = n * 2;
+    BQ_SIMD_LOOP(S, i, m) {
+        const typename S::V a = S::load(src1 + i), b = S::load(src2 + i);
+        S::store(dst + i, S::add(S::load(dst + i),
+                                 S::mulAddSub(S::reals(a), b,
+                                              S::mul(S::imags(a), S::swapPairs(b)))));
+    }
+    for (; i < m; i += 2) {
+        dst[i] += src1[i] * src2[i] - src1[i+1] * src2[i+1];
+        dst[i+1] += src1[i] * src2[i+1] + src1[i+1] * src2[i];
+    }
+}
+
+// The sums have four accumulators, to overlap the latency of the
+// additions
+
+template <typename S, typename T>
+BQ_SIMD_INLINE T
+k_sum(const T *const BQ_R__ src, const int n)
+{
+    typename S::V a = S::set(T()), b = a, c = a, d = a;
+    const int w = S::width;
+    int i = 0;
+    for (; i + 4 * w <= n; i += 4 * w) {
+        a = S::add(a, S::load(src + i));
+        b = S::add(b, S::load(src + i + w));
+        c = S::add(c, S::load(src + i + 2 * w));
+        d = S::add(d, S::load(src + i + 3 * w));
+    }
+    for (; i + w <= n; i += w) {
+        a = S::add(a, S::load(src + i));
+    }
+    T result = S::sum(S::add(S::add(a, b), S::add(c, d)));
+    for (; i < n; ++i) result += src[i];
+    return result;
+}
+
+template <typename S, typename T>
+BQ_SIMD_INLINE T
+k_multiply_and_sum(const T *const BQ_R__ src1, const T *const BQ_R__ src2, const int n)
+{
+    typename S::V a = S::set(T()), b = a, c = a, d = a;
+    const int w = S::width;
+    int i = 0;
+    for (; i + 4 * w <= n; i += 4 * w) {
+        a = S::add(a, S::mul(S::load(src1 + i), S::load(src2 + i)));
+        b = S::add(b, S::mul(S::load(src1 + i + w), S::load(src2 + i + w)));
+        c = S::add(c, S::mul(S::load(src1 + i + 2 * w), S::load(src2 + i + 2 * w)));
+        d = S::add(d, S::mul(S::load(src1 + i + 3 * w), S::load(src2 + i + 3 * w)));
+    }
+    for (; i + w <= n; i += w) {
+        a = S::add(a, S::mul(S::load(src1 + i), S::load(src2 + i)));
+    }
+    T result = S::sum(S::add(S::add(a, b), S::add(c, d)));
+    for (; i < n; ++i) result += src1[i] * src2[i];
+    return result;
+}
+
+template <typename S, typename T>
+BQ_SIMD_INLINE T
+k_sum_squares(const T *const BQ_R__ src, const int n)
+{
+    typename S::V a = S::set(T()), b = a, c = a, d = a;
+    const int w = S::width;
+    int i = 0;
+    for (; i + 4 * w <= n; i += 4 * w) {
+        typename S::V x = S::load(src + i), y = S::load(src + i + w);
+        a = S::add(a, S::mul(x, x));
+        b = S::add(b, S::mul(y, y));
+        x = S::load(src + i + 2 * w);
+        y = S::load(src + i + 3 * w);
+        c = S::add(c, S::mul(x, x));
+        d = S::add(d, S::mul(y, y));
+    }
+    for (; i + w <= n; i += w) {
+        typename S::V x = S::load(src + i);
+        a = S::add(a, S::mul(x, x));
+    }
+    T result = S::sum(S::add(S::add(a, b), S::add(c, d)));
+    for (; i < n; ++i) result += src[i] * src[i];
+    return result;
+}
+
+// Smallest or (if greater) largest element, with two accumulators
+
+template <typename S, bool greater, typename T>
+BQ_SIMD_INLINE T
+k_extreme(const T *const BQ_R__ src, const int n)
+{
+    if (n < 1) return T();
+    const int w = S::width;
+    T result = src[0];
+    int i = 0;
+    if (n >= 2 * w) {
+        typename S::V a = S::load(src), b = S::load(src + w);
+        for (i = 2 * w; i + 2 * w <= n; i += 2 * w) {
+            if (greater) {
+                a = S::max(a, S::load(src + i));
+                b = S::max(b, S::load(src + i + w));
+            } else {
+                a = S::min(a, S::load(src + i));
+                b = S::min(b, S::load(src + i + w));
+            }
+        }
+        T lanes[S::width];
+        S::store(lanes, greater ? S::max(a, b) : S::min(a, b));
+        result = lanes[0];
+        for (int j = 1; j < w; ++j) {
+            if (greater ? (result < lanes[j]) : (lanes[j] < result)) {
+                result = lanes[j];
+            }
+        }
+    }
+    for (; i < n; ++i) {
+        if (greater ? (result < src[i]) : (src[i] < result)) result = src[i];
+    }
+    return result;
+}
+
+// Index of the first smallest or largest element. Each lane keeps
+// its best value and the index it was found at, as a vector of the
+// element type, which represents indices exactly up to 2^24 for
+// float; longer vectors go in blocks of that length
+
+template <typename S, bool greater, typename T>
+BQ_SIMD_INLINE int
+k_extreme_index_block(const T *const BQ_R__ src, const int n)
+{
+    typedef typename S::V V;
+    const int w = S::width;
+    int index = 0;
+    int i = 1;
+    if (n >= 2 * w) {
+        T lanes[S::width], indices[S::width];
+        for (int j = 0; j < w; ++j) indices[j] = T(j);
+        V at = S::load(indices);
+        const V step = S::set(T(w));
+        V best = S::load(src), bestAt = at;
+        for (i = w; i + w <= n; i += w) {
+            at = S::add(at, step);
+            const V v = S::load(src + i);
+            const typename S::M m = (greater ? S::lt(best, v) : S::lt(v, best));
+            best = S::select(m, v, best);
+            bestAt = S::select(m, at, bestAt);
+        }
+        S::store(lanes, best);
+        S::store(indices, bestAt);
+        index = int(indices[0]);
+        for (int j = 1; j < w; ++j) {
+            const T x = lanes[j], y = src[index];
+            if ((greater ? (y < x) : (x < y)) ||
+                (x == y && int(indices[j]) < index)) {
+                index = int(indices[j]);
+            }
+        }
+    }
+    for (; i < n; ++i) {
+        if (greater ? (src[index] < src[i]) : (src[i] < src[index])) index = i;
+    }
+    return index;
+}
+
+template <typename S, bool greater, typename T>
+BQ_SIMD_INLINE int
+k_extreme_index(const T *const BQ_R__ src, const int n)
+{
+    if (n < 1) return -1;
+    const int block = (sizeof(T) == sizeof(float) ? (1 << 24) : n);
+    int index = 0;
+    for (int i = 0; i < n; i += block) {
+        const int j = i + k_extreme_index_block<S, greater>
+            (src + i, (n - i < block ? n - i : block));
+        if (greater ? (src[index] < src[j]) : (src[j] < src[index])) index = j;
+    }
+    return index;
+}
+
+// Spectral centroid, with two pairs of accumulators for the weighted
+// and plain sums. Bin indices are counted in a vector as above
+
+template <typename S, typename T>
+BQ_SIMD_INLINE T
+k_spectral_centroid(const T *const BQ_R__ mag, const int n)
+{
+    typedef typename S::V V;
+    const int w = S::width;
+    T indices[S::width];
+    for (int j = 0; j < w; ++j) indices[j] = T(j);
+    V at = S::load(indices);
+    const V step = S::set(T(w));
+    V wa = S::set(T()), wb = wa, ta = wa, tb = wa;
+    int i = 0;
+    for (; i + 2 * w <= n; i += 2 * w) {
+        const V a = S::load(mag + i), b = S::load(mag + i + w);
+        const V atb = S::add(at, step);
+        wa = S::add(wa, S::mul(a, at));
+        wb = S::add(wb, S::mul(b, atb));
+        ta = S::add(ta, a);
+        tb = S::add(tb, b);
+        at = S::add(atb, step);
+    }
+    T weighted = S::sum(S::add(wa, wb)), total = S::sum(S::add(ta, tb));
+    for (; i < n; ++i) {
+        weighted += T(i) * mag[i];
+        total += mag[i];
+    }
+    if (total > T()) return weighted / total;
+    return T();
+}
+
+template <typename S, typename T>
+BQ_SIMD_INLINE T
+k_spectral_flux(const T *const BQ_R__ mag, const T *const BQ_R__ prev, const int n)
+{
+    typedef typename S::V V;
+    const int w = S::width;
+    const V zero = S::set(T());
+    V a = zero, b = zero;
+    int i = 0;
+    for (; i + 2 * w <= n; i += 2 * w) {
+        a = S::add(a, S::max(S::sub(S::load(mag + i), S::load(prev + i)), zero));
+        b = S::add(b, S::max(S::sub(S::load(mag + i + w), S::load(prev + i + w)), zero));
+    }
+    T result = S::sum(S::add(a, b));
+    for (; i < n; ++i) {
+        const T d = mag[i] - prev[i];
+        if (d > T()) result += d;
+    }
+    return result;
+}
+
+template <typename S, typename T>
+BQ_SIMD_INLINE void
+k_sqrt(T *const BQ_R__ dst, const int n)
+{
+    BQ_SIMD_LOOP(S, i, n) {
+        S::store(dst + i, S::sqrt(S::load(dst + i)));
+    }
+    for (; i < n; ++i) dst[i] = std::sqrt(dst[i]);
+}
+
+template <typename S, typename T>
+BQ_SIMD_INLINE void
+k_square(T *const BQ_R__ dst, const int n)
+{
+    BQ_SIMD_LOOP(S, i, n) {
+        typename S::V v = S::load(dst + i);
+        S::store(dst + i, S::mul(v, v));
+    }
+    for (; i < n; ++i) dst[i] = dst[i] * dst[i];
+}
+
+template <typename S, typename T>
+BQ_SIMD_INLINE void
+k_abs(T *const BQ_R__ dst, const int n)
+{
+    BQ_SIMD_LOOP(S, i, n) {
+        S::store(dst + i, S::abs(S::load(dst + i)));
+    }
+    for (; i < n; ++i) dst[i] = std::fabs(dst[i]);
+}
+
+/*
+ Single-precision log and exp, using the Cephes polynomials (as do the
+ Pommier functions used elsewhere in bqvec). They are accurate to
+ within a couple of units in the last place. Any vector containing an
+ argument outside the range where the polynomials are valid -- zero,
+ negative, denormal, infinite or NaN for log, or large enough to
+ overflow or underflow for exp -- is computed with the standard
+ library instead, so that special cases come out the same as from
+ the generic code.
+*/
+
+template <typename S>
+BQ_SIMD_INLINE void
+k_logf(float *const BQ_R__ dst, const int n)
+{
+    typedef typename S::V V;
+    BQ_SIMD_LOOP(S, i, n) {
+        V x = S::load(dst + i);
+        if (!S::within(x, FLT_MIN, FLT_MAX)) {
+            for (int j = 0; j < int(S::width); ++j) {
+                dst[i + j] = logf(dst[i + j]);
+            }
+            continue;
+        }
+        V e;
+        x = S::frexp(x, e);
+        // x in [0.5, 1): fold into [sqrt(1/2), sqrt(2)) by doubling
+        // below sqrt(1/2)
+        typename S::M m = S::lt(x, S::set(0.707106781186547524f));
+        x = S::sub(S::select(m, S::add(x, x), x), S::set(1.f));
+        e = S::select(m, S::sub(e, S::set(1.f)), e);
+        V z = S::mul(x, x);
+        V y = S::set(7.0376836292e-2f);
+        y = S::add(S::mul(y, x), S::set(-1.1514610310e-1f));
+        y = S::add(S::mul(y, x), S::set(1.1676998740e-1f));
+        y = S::add(S::mul(y, x), S::set(-1.2420140846e-1f));
+        y = S::add(S::mul(y, x), S::set(1.4249322787e-1f));
+        y = S::add(S::mul(y, x), S::set(-1.6668057665e-1f));
+        y = S::add(S::mul(y, x), S::set(2.0000714765e-1f));
+        y = S::add(S::mul(y, x), S::set(-2.4999993993e-1f));
+        y = S::add(S::mul(y, x), S::set(3.3333331174e-1f));
+        y = S::mul(S::mul(y, x), z);
+        y = S::add(y, S::mul(e, S::set(-2.12194440e-4f)));
+        y = S::sub(y, S::mul(z, S::set(0.5f)));
+        x = S::add(S::add(x, y), S::mul(e, S::set(0.693359375f)));
+        S::store(dst + i, x);
+    }
+    for (; i < n; ++i) dst[i] = logf(dst[i]);
+}
+
+template <typename S>
+BQ_SIMD_INLINE void
+k_expf(float *const BQ_R__ dst, const int n)
+{
+    typedef typename S::V V;
+    BQ_SIMD_LOOP(S, i, n) {
+        V x = S::load(dst + i);
+        if (!S::within(x, -87.3f, 88.7f)) {
+            for (int j = 0; j < int(S::width); ++j) {
+                dst[i + j] = expf(dst[i + j]);
+            }
+            continue;
+        }
+        // exp(x) = 2^k * exp(r), with k = round(x / log 2) and r the
+        // remainder, in two parts for accuracy
+        V k = S::floor(S::add(S::mul(x, S::set(1.44269504088896341f)),
+                              S::set(0.5f)));
+        x = S::opaque(S::sub(x, S::mul(k, S::set(0.693359375f))));
+        x = S::sub(x, S::mul(k, S::set(-2.12194440e-4f)));
+        V z = S::mul(x, x);
+        V y = S::set(1.9875691500e-4f);
+        y = S::add(S::mul(y, x), S::set(1.3981999507e-3f));
+        y = S::add(S::mul(y, x), S::set(8.3334519073e-3f));
+        y = S::add(S::mul(y, x), S::set(4.1665795894e-2f));
+        y = S::add(S::mul(y, x), S::set(1.6666665459e-1f));
+        y = S::add(S::mul(y, x), S::set(5.0000001201e-1f));
+        y = S::add(S::add(S::mul(y, z), x), S::set(1.f));
+        S::store(dst + i, S::mul(y, S::pow2(k)));
+    }
+    for (; i < n; ++i) dst[i] = expf(dst[i]);
+}
+
+/*
+ Polar conversion, in two tiers of accuracy chosen by the template
+ argument fast: within about 1e-6 radians of the exact phase (and as
+ close in relative magnitude) or, if fast, within about 1e-3. Both
+ use minimax polynomials, the same ones for float and double, so
+ double is no more accurate than float here.
+
+ atan2 reduces to atan of min(|x|,|y|) / max(|x|,|y|), in [0, 1],
+ and then restores the octant. The signed zero of an imaginary part
+ is not distinguished, so a negative real with an imaginary part of
+ -0 gives pi rather than -pi.
+
+ sincos reduces the phase by the nearest multiple k of pi/2, with pi/2
+ in three parts so that the remainder is exact for phases up to the
+ limit below, beyond which a vector is computed with the standard
+ library instead, as is any containing a NaN. The first two parts
+ have few enough significant bits that their products with k are
+ exact. The remainder, in [-pi/4, pi/4], goes to separate sin and cos
+ polynomials, which are then swapped and negated according to k mod 4.
+*/
+
+template <typename T> struct SIMDHalfPi;
+
+template <>
+struct SIMDHalfPi<float>
+{
+    static BQ_SIMD_INLINE float limit() { return 8192.f; }
+    static BQ_SIMD_INLINE float p1() { return 1.5703125f; }
+    static BQ_SIMD_INLINE float p2() { return 4.837512969970703125e-4f; }
+    static BQ_SIMD_INLINE float p3() { return 7.54978995489188216e-8f; }
+};
+
+template <>
+struct SIMDHalfPi<double>
+{
+    static BQ_SIMD_INLINE double limit() { return 1.0e6; }
+    static BQ_SIMD_INLINE double p1() { return 1.57079632673412561417e+00; }
+    static BQ_SIMD_INLINE double p2() { return 6.07710050630396597660e-11; }
+    static BQ_SIMD_INLINE double p3() { return 2.02226624879595063154e-21; }
+};
+
+template <typename S, bool fast, typename T>
+BQ_SIMD_INLINE void
+k_magphase_block(T *const BQ_R__ mag, T *const BQ_R__ phase,
+                 const T *const BQ_R__ real, const T *const BQ_R__ imag)
+{
+    typedef typename S::V V;
+    const V zero = S::set(T(0));
+    V x = S::load(real);
+    V y = S::load(imag);
+    S::store(mag, S::sqrt(S::add(S::mul(x, x), S::mul(y, y))));
+    V ax = S::abs(x), ay = S::abs(y);
+    V a = S::div(S::min(ax, ay),
+                 S::max(S::max(ax, ay), S::set(std::numeric_limits<T>::min())));
+    V z = S::mul(a, a);
+    V r;
+    if (fast) {
+        r = S::set(T(7.9339031815e-2));
+        r = S::add(S::mul(r, z), S::set(T(-2.8869023026e-1)));
+        r = S::add(S::mul(r, z), S::set(T(9.9535795516e-1)));
+    } else {
+        r = S::set(T(6.8117963252e-3));
+        r = S::add(S::mul(r, z), S::set(T(-3.3604231379e-2)));
+        r = S::add(S::mul(r, z), S::set(T(7.9623687405e-2)));
+        r = S::add(S::mul(r, z), S::set(T(-1.3233343119e-1)));
+        r = S::add(S::mul(r, z), S::set(T(1.9807815914e-1)));
+        r = S::add(S::mul(r, z), S::set(T(-3.3317368108e-1)));
+        r = S::add(S::mul(r, z), S::set(T(9.9999611158e-1)));
+    }
+    r = S::mul(r, a);
+    r = S::select(S::lt(ax, ay), S::sub(S::set(T(M_PI / 2)), r), r);
+    r = S::select(S::lt(x, zero), S::sub(S::set(T(M_PI)), r), r);
+    r = S::select(S::lt(y, zero), S::sub(zero, r), r);
+    S::store(phase, r);
+}
+
+template <typename S, bool fast, typename T>
+BQ_SIMD_INLINE void
+k_phasor_block(T *const BQ_R__ real, T *const BQ_R__ imag,
+               const T *const BQ_R__ mag, const T *const BQ_R__ phase)
+{
+    typedef typename S::V V;
+    V x = S::load(phase);
+    if (!S::within(x, -SIMDHalfPi<T>::limit(), SIMDHalfPi<T>::limit())) {
+        for (int j = 0; j < int(S::width); ++j) {
+            c_phasor(real + j, imag + j, phase[j]);
+            real[j] *= mag[j];
+            imag[j] *= mag[j];
+        }
+        return;
+    }
+    const V zero = S::set(T(0));
+    const V half = S::set(T(0.5));
+    V k = S::floor(S::add(S::mul(x, S::set(T(2.0 / M_PI))), half));
+    x = S::opaque(S::sub(x, S::mul(k, S::set(SIMDHalfPi<T>::p1()))));
+    x = S::opaque(S::sub(x, S::mul(k, S::set(SIMDHalfPi<T>::p2()))));
+    x = S::sub(x, S::mul(k, S::set(SIMDHalfPi<T>::p3())));
+    V z = S::mul(x, x);
+    V s, c;
+    if (fast) {
+        s = S::mul(x, S::add(S::mul(z, S::set(T(-1.6034401649e-1))),
+                             S::set(T(9.9903142281e-1))));
+        c = S::set(T(4.0398535937e-2));
+        c = S::add(S::mul(c, z), S::set(T(-4.9970814034e-1)));
+        c = S::add(S::mul(c, z), S::set(T(9.9999003495e-1)));
+    } else {
+        s = S::set(T(-1.9515295891e-4));
+        s = S::add(S::mul(s, z), S::set(T(8.3321608736e-3)));
+        s = S::add(S::mul(s, z), S::set(T(-1.6666654611e-1)));
+        s = S::add(S::mul(S::mul(s, z), x), x);
+        c = S::set(T(2.443315711809948e-5));
+        c = S::add(S::mul(c, z), S::set(T(-1.388731625493765e-3)));
+        c = S::add(S::mul(c, z), S::set(T(4.166664568298827e-2)));
+        c = S::add(S::sub(S::mul(S::mul(c, z), z), S::mul(z, half)),
+                   S::set(T(1)));
+    }
+    // With q = k mod 4, sin is negated for q = 2 or 3, cos for q = 1
+    // or 2, and the two are swapped for odd q
+    const V quarter = S::set(T(0.25));
+    const V four = S::set(T(4));
+    V q = S::sub(k, S::mul(S::floor(S::mul(k, quarter)), four));
+    k = S::add(k, S::set(T(1)));
+    V qc = S::sub(k, S::mul(S::floor(S::mul(k, quarter)), four));
+    V odd = S::sub(q, S::mul(S::floor(S::mul(q, half)), S::set(T(2))));
+    typename S::M swap = S::lt(half, odd);
+    V sv = S::select(swap, c, s);
+    V cv = S::select(swap, s, c);
+    const V threshold = S::set(T(1.5));
+    sv = S::select(S::lt(threshold, q), S::sub(zero, sv), sv);
+    cv = S::select(S::lt(threshold, qc), S::sub(zero, cv), cv);
+    V m = S::load(mag);
+    S::store(real, S::mul(cv, m));
+    S::store(imag, S::mul(sv, m));
+}
+
+template <typename S, bool fast, typename T>
+BQ_SIMD_INLINE void
+k_cartesian_to_polar(T *const BQ_R__ mag, T *const BQ_R__ phase,
+                     const T *const BQ_R__ real, const T *const BQ_R__ imag,
+                     const int n)
+{
+    BQ_SIMD_LOOP(S, i, n) {
+        k_magphase_block<S, fast>(mag + i, phase + i, real + i, imag + i);
+    }
+    for (; i < n; ++i) {
+        k_magphase_block<SIMDScalar<T>, fast>(mag + i, phase + i, real + i, imag + i);
+    }
+}
+
+template <typename S, bool fast, typename T>
+BQ_SIMD_INLINE void
+k_polar_to_cartesian(T *const BQ_R__ real, T *const BQ_R__ imag,
+                     const T *const BQ_R__ mag, const T *const BQ_R__ phase,
+                     const int n)
+{
+    BQ_SIMD_LOOP(S, i, n) {
+        k_phasor_block<S, fast>(real + i, imag + i, mag + i, phase + i);
+    }
+    for (; i < n; ++i) {
+        k_phasor_block<SIMDScalar<T>, fast>(real + i, imag + i, mag + i, phase + i);
+    }
+}
+
+// The interleaved forms go through split buffers on the stack, a
+// block at a time
+
+enum { polarBlock = 256 };
+
+template <typename S, bool fast, typename T>
+BQ_SIMD_INLINE void
+k_cartesian_interleaved_to_polar(T *const BQ_R__ mag, T *const BQ_R__ phase,
+                                 const T *const BQ_R__ src, const int n)
+{
+    T real[polarBlock], imag[polarBlock];
+    for (int i = 0; i < n; i += polarBlock) {
+        const int m = (n - i < int(polarBlock) ? n - i : int(polarBlock));
+        for (int j = 0; j < m; ++j) {
+            real[j] = src[(i + j) * 2];
+            imag[j] = src[(i + j) * 2 + 1];
+        }
+        k_cartesian_to_polar<S, fast>(mag + i, phase + i, real, imag, m);
+    }
+}
+
+template <typename S, bool fast, typename T>
+BQ_SIMD_INLINE void
+k_polar_to_cartesian_interleaved(T *const BQ_R__ dst,
+                                 const T *const BQ_R__ mag,
+                                 const T *const BQ_R__ phase,
+                                 const int n)
+{
+    T real[polarBlock], imag[polarBlock];
+    for (int i = 0; i < n; i += polarBlock) {
+        const int m = (n - i < int(polarBlock) ? n - i : int(polarBlock));
+        k_polar_to_cartesian<S, fast>(real, imag, mag + i, phase + i, m);
+        for (int j = 0; j < m; ++j) {
+            dst[(i + j) * 2] = real[j];
+            dst[(i + j) * 2 + 1] = imag[j];
+        }
+    }
+}
+
+// Interleaving and PCM conversion. Each sample format has a policy
+// giving its full scale and (for output) its largest value, with
+// loads and stores of a vector of samples and conversions of a single
+// one. Float is a format too, without scaling or clipping, so that
+// v_interleave and v_deinterleave share the kernels. 24-bit samples
+// are held one to an int32 here; the kernels for packed 24-bit data
+// below go through a block of those at a time
+
+struct PCMFloat
+{
+    typedef float sample;
+    enum { integer = 0 };
+    static BQ_SIMD_INLINE float full() { return 1.f; }
+    static BQ_SIMD_INLINE float top() { return 1.f; }
+    template <typename S>
+    static BQ_SIMD_INLINE typename S::V load(const float *p) { return S::load(p); }
+    template <typename S>
+    static BQ_SIMD_INLINE void store(float *p, typename S::V v) { S::store(p, v); }
+    static BQ_SIMD_INLINE float in(float s) { return s; }
+    static BQ_SIMD_INLINE float out(float v, unsigned int *) { return v; }
+};
+
+struct PCMInt16
+{
+    typedef int16_t sample;
+    enum { integer = 1 };
+    static BQ_SIMD_INLINE float full() { return 32768.f; }
+    static BQ_SIMD_INLINE float top() { return 32767.f; }
+    template <typename S>
+    static BQ_SIMD_INLINE typename S::V load(const int16_t *p) { return S::fromInt16(p); }
+    template <typename S>
+    static BQ_SIMD_INLINE void store(int16_t *p, typename S::V v) { S::toInt16(p, v); }
+    static BQ_SIMD_INLINE float in(int16_t s) { return float(s); }
+    static BQ_SIMD_INLINE int16_t out(float v, unsigned int *dither) {
+        return int16_t(pcm_quantise(v, -full(), top(), dither));
+    }
+};
+
+struct PCMInt24
+{
+    typedef int32_t sample;
+    enum { integer = 1 };
+    static BQ_SIMD_INLINE float full() { return 8388608.f; }
+    static BQ_SIMD_INLINE float top() { return 8388607.f; }
+    template <typename S>
+    static BQ_SIMD_INLINE typename S::V load(const int32_t *p) { return S::fromInt32(p); }
+    template <typename S>
+    static BQ_SIMD_INLINE void store(int32_t *p, typename S::V v) { S::toInt32(p, v); }
+    static BQ_SIMD_INLINE float in(int32_t s) { return float(s); }
+    static BQ_SIMD_INLINE int32_t out(float v, unsigned int *dither) {
+        return pcm_quantise(v, -full(), top(), dither);
+    }
+};
+
+struct PCMInt32
+{
+    typedef int32_t sample;
+    enum { integer = 1 };
+    static BQ_SIMD_INLINE float full() { return 2147483648.f; }
+    static BQ_SIMD_INLINE float top() { return 2147483520.f; }
+    template <typename S>
+    static BQ_SIMD_INLINE typename S::V load(const int32_t *p) { return S::fromInt32(p); }
+    template <typename S>
+    static BQ_SIMD_INLINE void store(int32_t *p, typename S::V v) { S::toInt32(p, v); }
+    static BQ_SIMD_INLINE float in(int32_t s) { return float(s); }
+    static BQ_SIMD_INLINE int32_t out(float v, unsigned int *dither) {
+        return pcm_quantise(v, -full(), top(), dither);
+    }
+};
+
+// The vector part of each conversion, for four-wide traits, returning
+// the number of frames done. One or two channels go a vector at a
+// time; four or more go as groups of four channels of four frames,
+// transposed between frames and channels, with the last group moved
+// back to overlap the one before if the channel count is not a
+// multiple of four. Three channels are left to the scalar code
+
+template <typename S, typename P>
+struct PCMVector
+{
+    typedef typename S::V V;
+    typedef typename P::sample sample;
+
+    static BQ_SIMD_INLINE V scaleIn(V v, V g) {
+        return P::integer ? S::mul(v, g) : v;
+    }
+
+    static BQ_SIMD_INLINE V scaleOut(V v, V g, V lo, V hi, unsigned int *dither) {
+        if (!P::integer) return v;
+        v = S::mul(v, g);
+        if (dither) {
+            float d[4];
+            for (int j = 0; j < 4; ++j) d[j] = pcm_tpdf_dither(dither);
+            v = S::add(v, S::load(d));
+        }
+        return S::min(S::max(v, lo), hi);
+    }
+
+    static BQ_SIMD_INLINE int
+    deinterleave(float *const *const BQ_R__ dst, const int offset,
+                 const sample *const BQ_R__ src,
+                 const float scale, const int channels, const int n) {
+        const V g = S::set(scale);
+        int i = 0;
+        if (channels == 1) {
+            for (; i + 4 <= n; i += 4) {
+                S::store(dst[0] + offset + i,
+                         scaleIn(P::template load<S>(src + i), g));
+            }
+        } else if (channels == 2) {
+            for (; i + 4 <= n; i += 4) {
+                V a, b;
+                S::unzip(P::template load<S>(src + i * 2),
+                         P::template load<S>(src + i * 2 + 4), a, b);
+                S::store(dst[0] + offset + i, scaleIn(a, g));
+                S::store(dst[1] + offset + i, scaleIn(b, g));
+            }
+        } else if (channels >= 4) {
+            const int last = channels - 4;
+            for (; i + 4 <= n; i += 4) {
+                const sample *const f = src + i * channels;
+                for (int c = 0; ; ) {
+                    V a = P::template load<S>(f + c);
+                    V b = P::template load<S>(f + channels + c);
+                    V cc = P::template load<S>(f + channels * 2 + c);
+                    V d = P::template load<S>(f + channels * 3 + c);
+                    S::transpose(a, b, cc, d);
+                    S::store(dst[c] + offset + i, scaleIn(a, g));
+                    S::store(dst[c+1] + offset + i, scaleIn(b, g));
+                    S::store(dst[c+2] + offset + i, scaleIn(cc, g));
+                    S::store(dst[c+3] + offset + i, scaleIn(d, g));
+                    if (c == last) break;
+                    c += 4;
+                    if (c > last) c = last;
+                }
+            }
+        }
+        return i;
+    }
+
+    static BQ_SIMD_INLINE int
+    interleave(sample *const BQ_R__ dst,
+               const float *const *const BQ_R__ src, const int offset,
+               const float scale, unsigned int *const dither,
+               const int channels, const int n) {
+        const V g = S::set(scale);
+        const V lo = S::set(-P::full());
+        const V hi = S::set(P::top());
+        int i = 0;
+        if (channels == 1) {
+            for (; i + 4 <= n; i += 4) {
+                P::template store<S>
+                    (dst + i, scaleOut(S::load(src[0] + offset + i),
+                                       g, lo, hi, dither));
+            }
+        } else if (channels == 2) {
+            for (; i + 4 <= n; i += 4) {
+                V a, b;
+                S::zip(S::load(src[0] + offset + i),
+                       S::load(src[1] + offset + i), a, b);
+                P::template store<S>(dst + i * 2, scaleOut(a, g, lo, hi, dither));
+                P::template store<S>(dst + i * 2 + 4, scaleOut(b, g, lo, hi, dither));
+            }
+        } else if (channels >= 4) {
+            const int last = channels - 4;
+            for (; i + 4 <= n; i += 4) {
+                sample *const f = dst + i * channels;
+                for (int c = 0; ; ) {
+                    V a = S::load(src[c] + offset + i);
+                    V b = S::load(src[c+1] + offset + i);
+                    V cc = S::load(src[c+2] + offset + i);
+                    V d = S::load(src[c+3] + offset + i);
+                    S::transpose(a, b, cc, d);
+                    P::template store<S>(f + c, scaleOut(a, g, lo, hi, dither));
+                    P::template store<S>(f + channels + c, scaleOut(b, g, lo, hi, dither));
+                    P::template store<S>(f + channels * 2 + c, scaleOut(cc, g, lo, hi, dither));
+                    P::template store<S>(f + channels * 3 + c, scaleOut(d, g, lo, hi, dither));
+                    if (c == last) break;
+                    c += 4;
+                    if (c > last) c = last;
+                }
+            }
+        }
+        return i;
+    }
+};
+
+template <typename P>
+struct PCMVector<SIMDScalar<float>, P>
+{
+    typedef typename P::sample sample;
+    static BQ_SIMD_INLINE int
+    deinterleave(float *const *, int, const sample *, float, int, int) {
+        return 0;
+    }
+    static BQ_SIMD_INLINE int
+    interleave(sample *, const float *const *, int, float, unsigned int *,
+               int, int) {
+        return 0;
+    }
+};
+
+template <typename S, typename P>
+BQ_SIMD_INLINE void
+k_deinterleave_pcm(float *const *const BQ_R__ dst, const int offset,
+                   const typename P::sample *const BQ_R__ src,
+                   const float gain, const int channels, const int n)
+{
+    const float scale = gain / P::full();
+    int i = PCMVector<S, P>::deinterleave(dst, offset, src, scale, channels, n);
+    for (; i < n; ++i) {
+        for (int c = 0; c < channels; ++c) {
+            const float v = P::in(src[i * channels + c]);
+            dst[c][offset + i] = (P::integer ? v * scale : v);
+        }
+    }
+}
+
+template <typename S, typename P>
+BQ_SIMD_INLINE void
+k_interleave_pcm(typename P::sample *const BQ_R__ dst,
+                 const float *const *const BQ_R__ src, const int offset,
+                 const float gain, unsigned int *const dither,
+                 const int channels, const int n)
+{
+    const float scale = gain * P::full();
+    int i = PCMVector<S, P>::interleave(dst, src, offset, scale, dither,
+                                        channels, n);
+    // Separate loops with and without dither, so that the compiler
+    // can see that the one without has no state to carry
+    if (dither) {
+        for (; i < n; ++i) {
+            for (int c = 0; c < channels; ++c) {
+                const float v = src[c][offset + i];
+                dst[i * channels + c] = P::out(P::integer ? v * scale : v, dither);
+            }
+        }
+    } else {
+        for (; i < n; ++i) {
+            for (int c = 0; c < channels; ++c) {
+                const float v = src[c][offset + i];
+                dst[i * channels + c] = P::out(P::integer ? v * scale : v, 0);
+            }
+        }
+    }
+}
+
+enum { pcmBlock = 1024 };
+
+static BQ_SIMD_INLINE int32_t
+pcm_int24_in(const unsigned char *p)
+{
+    // In the top three bytes, so that the sign comes out right
+    return int32_t((uint32_t(p[0]) << 8) | (uint32_t(p[1]) << 16) |
+                   (uint32_t(p[2]) << 24));
+}
+
+template <typename S>
+BQ_SIMD_INLINE void
+k_deinterleave_from_int24(float *const *const BQ_R__ dst,
+                          const unsigned char *const BQ_R__ src,
+                          const float gain, const int channels, const int n)
+{
+    if (channels > int(pcmBlock)) {
+        const float scale = gain / PCMInt32::full();
+        for (int i = 0; i < n; ++i) {
+            for (int c = 0; c < channels; ++c) {
+                const int j = i * channels + c;
+                dst[c][i] = float(pcm_int24_in(src + j * 3)) * scale;
+            }
+        }
+        return;
+    }
+    int32_t buf[pcmBlock];
+    const int frames = int(pcmBlock) / channels;
+    for (int i = 0; i < n; i += frames) {
+        const int m = (n - i < frames ? n - i : frames);
+        const unsigned char *const s = src + i * channels * 3;
+        for (int j = 0; j < m * channels; ++j) {
+            buf[j] = pcm_int24_in(s + j * 3);
+        }
+        k_deinterleave_pcm<S, PCMInt32>(dst, i, buf, gain, channels, m);
+    }
+}
+
+static BQ_SIMD_INLINE void
+pcm_int24_out(unsigned char *p, int32_t v)
+{
+    const uint32_t u = uint32_t(v);
+    p[0] = (unsigned char)(u & 0xff);
+    p[1] = (unsigned char)((u >> 8) & 0xff);
+    p[2] = (unsigned char)((u >> 16) & 0xff);
+}
+
+template <typename S>
+BQ_SIMD_INLINE void
+k_interleave_to_int24(unsigned char *const BQ_R__ dst,
+                      const float *const *const BQ_R__ src,
+                      const float gain, unsigned int *const dither,
+                      const int channels, const int n)
+{
+    if (channels > int(pcmBlock)) {
+        const float scale = gain * PCMInt24::full();
+        for (int i = 0; i < n; ++i) {
+            for (int c = 0; c < channels; ++c) {
+                const int j = i * channels + c;
+                pcm_int24_out(dst + j * 3,
+                              PCMInt24::out(src[c][i] * scale, dither));
+            }
+        }
+        return;
+    }
+    int32_t buf[pcmBlock];
+    const int frames = int(pcmBlock) / channels;
+    for (int i = 0; i < n; i += frames) {
+        const int m = (n - i < frames ? n - i : frames);
+        k_interleave_pcm<S, PCMInt24>(buf, src, i, gain, dither, channels, m);
+        unsigned char *const d = dst + i * channels * 3;
+        for (int j = 0; j < m * channels; ++j) {
+            pcm_int24_out(d + j * 3, buf[j]);
+        }
+    }
+}
+
+/*
+ The dispatch tables, one per element type. They are filled in for
+ the best instruction set available, on first use or during static
+ initialisation, whichever comes first. Filling them in more than
+ once (from more than one thread at a time, say) is harmless, as the
+ same pointers are written each time. The float table also has log,
+ exp and conversion to double; the double table has conversion to
+ float. The polar conversions are indexed by tier, precise then fast.
+ The complex functions take interleaved pairs and a count of pairs.
+ Interleaving and the PCM conversions are in the float table only.
+*/
+
+template <typename T, typename U>
+struct SIMDKernels
+{
+    void (*add)(T *, const T *, int);
+    void (*addValue)(T *, T, int);
+    void (*addWithGain)(T *, const T *, T, int);
+    void (*subtract)(T *, const T *, int);
+    void (*scale)(T *, T, int);
+    void (*multiply)(T *, const T *, int);
+    void (*multiplyTo)(T *, const T *, const T *, int);
+    void (*divide)(T *, const T *, int);
+    void (*multiplyAndAdd)(T *, const T *, const T *, int);
+    T (*sum)(const T *, int);
+    T (*multiplyAndSum)(const T *, const T *, int);
+    T (*sumSquares)(const T *, int);
+    T (*min)(const T *, int);
+    T (*max)(const T *, int);
+    int (*minIndex)(const T *, int);
+    int (*maxIndex)(const T *, int);
+    T (*centroid)(const T *, int);
+    T (*flux)(const T *, const T *, int);
+    void (*sqrt)(T *, int);
+    void (*square)(T *, int);
+    void (*abs)(T *, int);
+    void (*log)(T *, int);
+    void (*exp)(T *, int);
+    void (*convert)(U *, const T *, int);
+    void (*toPolar[2])(T *, T *, const T *, const T *, int);
+    void (*interleavedToPolar[2])(T *, T *, const T *, int);
+    void (*toCartesian[2])(T *, T *, const T *, const T *, int);
+    void (*toCartesianInterleaved[2])(T *, const T *, const T *, int);
+    void (*complexMultiply)(T *, const T *, const T *, int);
+    void (*complexMultiplyAndAdd)(T *, const T *, const T *, int);
+    void (*interleave)(T *, const T *const *, int, int);
+    void (*deinterleave)(T *const *, const T *, int, int);
+    void (*deinterleaveInt16)(T *const *, const int16_t *, T, int, int);
+    void (*deinterleaveInt24)(T *const *, const unsigned char *, T, int, int);
+    void (*deinterleaveInt32)(T *const *, const int32_t *, T, int, int);
+    void (*interleaveInt16)(int16_t *, const T *const *, T, unsigned int *, int, int);
+    void (*interleaveInt24)(unsigned char *, const T *const *, T, unsigned int *, int, int);
+    void (*interleaveInt32)(int32_t *, const T *const *, T, unsigned int *, int, int);
+};
+
+typedef SIMDKernels<float, double> SIMDKernelsF;
+typedef SIMDKernels<double, float> SIMDKernelsD;
+
+#define BQ_SIMD_DEFINE(name, TARGET, S, T) \
+static TARGET void name##_add(T *d, const T *s, int n) { k_add<S>(d, s, n); } \
+static TARGET void name##_addValue(T *d, T v, int n) { k_add_value<S>(d, v, n); } \
+static TARGET void name##_addWithGain(T *d, const T *s, T g, int n) { k_add_with_gain<S>(d, s, g, n); } \
+static TARGET void name##_subtract(T *d, const T *s, int n) { k_subtract<S>(d, s, n); } \
+static TARGET void name##_scale(T *d, T g, int n) { k_scale<S>(d, g, n); } \
+static TARGET void name##_multiply(T *d, const T *s, int n) { k_multiply<S>(d, s, n); } \
+static TARGET void name##_multiplyTo(T *d, const T *s1, const T *s2, int n) { k_multiply_to<S>(d, s1, s2, n); } \
+static TARGET void name##_divide(T *d, const T *s, int n) { k_divide<S>(d, s, n); } \
+static TARGET void name##_multiplyAndAdd(T *d, const T *s1, const T *s2, int n) { k_multiply_and_add<S>(d, s1, s2, n); } \
+static TARGET T name##_sum(const T *s, int n) { return k_sum<S>(s, n); } \
+static TARGET T name##_multiplyAndSum(const T *s1, const T *s2, int n) { return k_multiply_and_sum<S>(s1, s2, n); } \
+static TARGET T name##_sumSquares(const T *s, int n) { return k_sum_squares<S>(s, n); } \
+static TARGET T name##_min(const T *s, int n) { return k_extreme<S, false>(s, n); } \
+static TARGET T name##_max(const T *s, int n) { return k_extreme<S, true>(s, n); } \
+static TARGET int name##_minIndex(const T *s, int n) { return k_extreme_index<S, false>(s, n); } \
+static TARGET int name##_maxIndex(const T *s, int n) { return k_extreme_index<S, true>(s, n); } \
+static TARGET T name##_centroid(const T *m, int n) { return k_spectral_centroid<S>(m, n); } \
+static TARGET T name##_flux(const T *m, const T *p, int n) { return k_spectral_flux<S>(m, p, n); } \
+static TARGET void name##_sqrt(T *d, int n) { k_sqrt<S>(d, n); } \
+static TARGET void name##_square(T *d, int n) { k_square<S>(d, n); } \
+static TARGET void name##_abs(T *d, int n) { k_abs<S>(d, n); } \
+template <typename K> static void name##_fill(K &k) { \
+    k.add = name##_add; k.addValue = name##_addValue; \
+    k.addWithGain = name##_addWithGain; k.subtract = name##_subtract; \
+    k.scale = name##_scale; k.multiply = name##_multiply; \
+    k.multiplyTo = name##_multiplyTo; k.divide = name##_divide; \
+    k.multiplyAndAdd = name##_multiplyAndAdd; k.sum = name##_sum; \
+    k.multiplyAndSum = name##_multiplyAndSum; k.sqrt = name##_sqrt; \
+    k.sumSquares = name##_sumSquares; k.min = name##_min; \
+    k.max = name##_max; k.minIndex = name##_minIndex; \
+    k.maxIndex = name##_maxIndex; k.centroid = name##_centroid; \
+    k.flux = name##_flux; \
+    k.square = name##_square; k.abs = name##_abs; \
+}
+
+#define BQ_SIMD_DEFINE_LOGEXP(name, TARGET, S) \
+static TARGET void name##_log(float *d, int n) { k_logf<S>(d, n); } \
+static TARGET void name##_exp(float *d, int n) { k_expf<S>(d, n); }
+
+#define BQ_SIMD_DEFINE_POLAR_TIER(name, tier, fast, TARGET, S, T) \
+static TARGET void name##_toPolar##tier(T *m, T *p, const T *r, const T *i, int n) { k_cartesian_to_polar<S, fast>(m, p, r, i, n); } \
+static TARGET void name##_interleavedToPolar##tier(T *m, T *p, const T *s, int n) { k_cartesian_interleaved_to_polar<S, fast>(m, p, s, n); } \
+static TARGET void name##_toCartesian##tier(T *r, T *i, const T *m, const T *p, int n) { k_polar_to_cartesian<S, fast>(r, i, m, p, n); } \
+static TARGET void name##_toCartesianInterleaved##tier(T *d, const T *m, const T *p, int n) { k_polar_to_cartesian_interleaved<S, fast>(d, m, p, n); }
+
+#define BQ_SIMD_DEFINE_POLAR(name, TARGET, S, T) \
+BQ_SIMD_DEFINE_POLAR_TIER(name, Precise, false, TARGET, S, T) \
+BQ_SIMD_DEFINE_POLAR_TIER(name, Fast, true, TARGET, S, T) \
+template <typename K> static void name##_fillPolar(K &k) { \
+    k.toPolar[0] = name##_toPolarPrecise; \
+    k.toPolar[1] = name##_toPolarFast; \
+    k.interleavedToPolar[0] = name##_interleavedToPolarPrecise; \
+    k.interleavedToPolar[1] = name##_interleavedToPolarFast; \
+    k.toCartesian[0] = name##_toCartesianPrecise; \
+    k.toCartesian[1] = name##_toCartesianFast; \
+    k.toCartesianInterleaved[0] = name##_toCartesianInterleavedPrecise; \
+    k.toCartesianInterleaved[1] = name##_toCartesianInterleavedFast; \
+}
+
+#define BQ_SIMD_DEFINE_COMPLEX(name, TARGET, S, T) \
+static TARGET void name##_complexMultiply(T *d, const T *s1, const T *s2, int n) { k_complex_multiply<S>(d, s1, s2, n); } \
+static TARGET void name##_complexMultiplyAndAdd(T *d, const T *s1, const T *s2, int n) { k_complex_multiply_and_add<S>(d, s1, s2, n); } \
+template <typename K> static void name##_fillComplex(K &k) { \
+    k.complexMultiply = name##_complexMultiply; \
+    k.complexMultiplyAndAdd = name##_complexMultiplyAndAdd; \
+}
+
+#define BQ_SIMD_DEFINE_PCM(name, TARGET, S) \
+static TARGET void name##_interleave(float *d, const float *const *s, int c, int n) { k_interleave_pcm<S, PCMFloat>(d, s, 0, 1.f, 0, c, n); } \
+static TARGET void name##_deinterleave(float *const *d, const float *s, int c, int n) { k_deinterleave_pcm<S, PCMFloat>(d, 0, s, 1.f, c, n); } \
+static TARGET void name##_deinterleaveInt16(float *const *d, const int16_t *s, float g, int c, int n) { k_deinterleave_pcm<S, PCMInt16>(d, 0, s, g, c, n); } \
+static TARGET void name##_deinterleaveInt24(float *const *d, const unsigned char *s, float g, int c, int n) { k_deinterleave_from_int24<S>(d, s, g, c, n); } \
+static TARGET void name##_deinterleaveInt32(float *const *d, const int32_t *s, float g, int c, int n) { k_deinterleave_pcm<S, PCMInt32>(d, 0, s, g, c, n); } \
+static TARGET void name##_interleaveInt16(int16_t *d, const float *const *s, float g, unsigned int *r, int c, int n) { k_interleave_pcm<S, PCMInt16>(d, s, 0, g, r, c, n); } \
+static TARGET void name##_interleaveInt24(unsigned char *d, const float *const *s, float g, unsigned int *r, int c, int n) { k_interleave_to_int24<S>(d, s, g, r, c, n); } \
+static TARGET void name##_interleaveInt32(int32_t *d, const float *const *s, float g, unsigned int *r, int c, int n) { k_interleave_pcm<S, PCMInt32>(d, s, 0, g, r, c, n); } \
+template <typename K> static void name##_fillPCM(K &k) { \
+    k.interleave = name##_interleave; k.deinterleave = name##_deinterleave; \
+    k.deinterleaveInt16 = name##_deinterleaveInt16; \
+    k.deinterleaveInt24 = name##_deinterleaveInt24; \
+    k.deinterleaveInt32 = name##_deinterleaveInt32; \
+    k.interleaveInt16 = name##_interleaveInt16; \
+    k.interleaveInt24 = name##_interleaveInt24; \
+    k.interleaveInt32 = name##_interleaveInt32; \
+}
+
+BQ_SIMD_DEFINE(scalarf, , SIMDScalar<float>, float)
+BQ_SIMD_DEFINE(scalard, , SIMDScalar<double>, double)
+BQ_SIMD_DEFINE_POLAR(scalarf, , SIMDScalar<float>, float)
+BQ_SIMD_DEFINE_POLAR(scalard, , SIMDScalar<double>, double)
+BQ_SIMD_DEFINE_PCM(scalarf, , SIMDScalar<float>)
+
+static void scalarf_log(float *d, int n) { for (int i = 0; i < n; ++i) d[i] = logf(d[i]); }
+static void scalarf_exp(float *d, int n) { for (int i = 0; i < n; ++i) d[i] = expf(d[i]); }
+static void scalard_log(double *d, int n) { for (int i = 0; i < n; ++i) d[i] = log(d[i]); }
+static void scalard_exp(double *d, int n) { for (int i = 0; i < n; ++i) d[i] = exp(d[i]); }
+
+// The complex kernels have no use for a vector of one element, so the
+// scalar versions are just their remainder loops
+
+template <typename T>
+static void
+scalar_complexMultiply(T *d, const T *s1, const T *s2, int n)
+{
+    for (int i = 0; i < n * 2; i += 2) {
+        const T re = s1[i] * s2[i] - s1[i+1] * s2[i+1];
+        const T im = s1[i] * s2[i+1] + s1[i+1] * s2[i];
+        d[i] = re;
+        d[i+1] = im;
+    }
+}
+
+template <typename T>
+static void
+scalar_complexMultiplyAndAdd(T *d, const T *s1, const T *s2, int n)
+{
+    for (int i = 0; i < n * 2; i += 2) {
+        d[i] += s1[i] * s2[i] - s1[i+1] * s2[i+1];
+        d[i+1] += s1[i] * s2[i+1] + s1[i+1] * s2[i];
+    }
+}
+
+static void
+scalar_convert(double *d, const float *s, int n)
+{
+    for (int i = 0; i < n; ++i) d[i] = s[i];
+}
+
+static void
+scalar_convert(float *d, const double *s, int n)
+{
+    for (int i = 0; i < n; ++i) d[i] = float(s[i]);
+}
+
+#ifdef BQ_SIMD_SSE2
+
+BQ_SIMD_DEFINE(sse2f, , SIMDSSE2f, float)
+BQ_SIMD_DEFINE(sse2d, , SIMDSSE2d, double)
+BQ_SIMD_DEFINE_LOGEXP(sse2f, , SIMDSSE2f)
+BQ_SIMD_DEFINE_POLAR(sse2f, , SIMDSSE2f, float)
+BQ_SIMD_DEFINE_POLAR(sse2d, , SIMDSSE2d, double)
+BQ_SIMD_DEFINE_COMPLEX(sse2f, , SIMDSSE2f, float)
+BQ_SIMD_DEFINE_COMPLEX(sse2d, , SIMDSSE2d, double)
+BQ_SIMD_DEFINE_PCM(sse2f, , SIMDSSE2f)
+
+static void
+sse2_convert(double *d, const float *s, int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 f = _mm_loadu_ps(s + i);
+        _mm_storeu_pd(d + i, _mm_cvtps_pd(f));
+        _mm_storeu_pd(d + i + 2, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+    }
+    for (; i < n; ++i) d[i] = s[i];
+}
+
+static void
+sse2_convert(float *d, const double *s, int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(s + i));
+        __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(s + i + 2));
+        _mm_storeu_ps(d + i, _mm_movelh_ps(lo, hi));
+    }
+    for (; i < n; ++i) d[i] = float(s[i]);
+}
+
+#endif
+
+#ifdef BQ_SIMD_AVX2
+
+BQ_SIMD_DEFINE(avx2f, BQ_SIMD_AVX2_TARGET, SIMDAVX2f, float)
+BQ_SIMD_DEFINE(avx2d, BQ_SIMD_AVX2_TARGET, SIMDAVX2d, double)
+BQ_SIMD_DEFINE_LOGEXP(avx2f, BQ_SIMD_AVX2_TARGET, SIMDAVX2f)
+BQ_SIMD_DEFINE_POLAR(avx2f, BQ_SIMD_AVX2_TARGET, SIMDAVX2f, float)
+BQ_SIMD_DEFINE_POLAR(avx2d, BQ_SIMD_AVX2_TARGET, SIMDAVX2d, double)
+BQ_SIMD_DEFINE_COMPLEX(avx2f, BQ_SIMD_AVX2_TARGET, SIMDAVX2f, float)
+BQ_SIMD_DEFINE_COMPLEX(avx2d, BQ_SIMD_AVX2_TARGET, SIMDAVX2d, double)
+
+static BQ_SIMD_AVX2_TARGET void
+avx2_convert(double *d, const float *s, int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(d + i, _mm256_cvtps_pd(_mm_loadu_ps(s + i)));
+    }
+    for (; i < n; ++i) d[i] = s[i];
+}
+
+static BQ_SIMD_AVX2_TARGET void
+avx2_convert(float *d, const double *s, int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(d + i, _mm256_cvtpd_ps(_mm256_loadu_pd(s + i)));
+    }
+    for (; i < n; ++i) d[i] = float(s[i]);
+}
+
+static bool
+haveAVX2()
+{
+#ifdef BQ_SIMD_AVX2_RUNTIME
+    return __builtin_cpu_supports("avx2");
+#else
+    return true;
+#endif
+}
+
+#endif
+
+#ifdef BQ_SIMD_AVX512
+
+BQ_SIMD_DEFINE(avx512f, BQ_SIMD_AVX512_TARGET, SIMDAVX512f, float)
+BQ_SIMD_DEFINE(avx512d, BQ_SIMD_AVX512_TARGET, SIMDAVX512d, double)
+BQ_SIMD_DEFINE_LOGEXP(avx512f, BQ_SIMD_AVX512_TARGET, SIMDAVX512f)
+BQ_SIMD_DEFINE_POLAR(avx512f, BQ_SIMD_AVX512_TARGET, SIMDAVX512f, float)
+BQ_SIMD_DEFINE_POLAR(avx512d, BQ_SIMD_AVX512_TARGET, SIMDAVX512d, double)
+BQ_SIMD_DEFINE_COMPLEX(avx512f, BQ_SIMD_AVX512_TARGET, SIMDAVX512f, float)
+BQ_SIMD_DEFINE_COMPLEX(avx512d, BQ_SIMD_AVX512_TARGET, SIMDAVX512d, double)
+
+static BQ_SIMD_AVX512_TARGET void
+avx512_convert(double *d, const float *s, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_pd(d + i, _mm512_cvtps_pd(_mm256_loadu_ps(s + i)));
+    }
+    for (; i < n; ++i) d[i] = s[i];
+}
+
+static BQ_SIMD_AVX512_TARGET void
+avx512_convert(float *d, const double *s, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(d + i, _mm512_cvtpd_ps(_mm512_loadu_pd(s + i)));
+    }
+    for (; i < n; ++i) d[i] = float(s[i]);
+}
+
+static bool
+haveAVX512()
+{
+#ifdef BQ_SIMD_AVX512_RUNTIME
+    return __builtin_cpu_supports("avx512f");
+#else
+    return true;
+#endif
+}
+
+#endif
+
+#ifdef BQ_SIMD_NEON
+
+BQ_SIMD_DEFINE(neonf, , SIMDNEONf, float)
+BQ_SIMD_DEFINE(neond, , SIMDNEONd, double)
+BQ_SIMD_DEFINE_LOGEXP(neonf, , SIMDNEONf)
+BQ_SIMD_DEFINE_POLAR(neonf, , SIMDNEONf, float)
+BQ_SIMD_DEFINE_POLAR(neond, , SIMDNEONd, double)
+BQ_SIMD_DEFINE_COMPLEX(neonf, , SIMDNEONf, float)
+BQ_SIMD_DEFINE_COMPLEX(neond, , SIMDNEONd, double)
+BQ_SIMD_DEFINE_PCM(neonf, , SIMDNEONf)
+
+static void
+neon_convert(double *d, const float *s, int n)
+{
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        vst1q_f64(d + i, vcvt_f64_f32(vld1_f32(s + i)));
+    }
+    for (; i < n; ++i) d[i] = s[i];
+}
+
+static void
+neon_convert(float *d, const double *s, int n)
+{
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        vst1_f32(d + i, vcvt_f32_f64(vld1q_f64(s + i)));
+    }
+    for (; i < n; ++i) d[i] = float(s[i]);
+}
+
+#endif
+
+static SIMDKernelsF kernelsF;
+static SIMDKernelsD kernelsD;
+
+static void
+selectKernels()
+{
+    SIMDKernelsF &f = kernelsF;
+    SIMDKernelsD &d = kernelsD;
+
+    scalarf_fill(f);
+    scalard_fill(d);
+    scalarf_fillPolar(f);
+    scalard_fillPolar(d);
+    scalarf_fillPCM(f);
+    f.complexMultiply = scalar_complexMultiply<float>;
+    d.complexMultiply = scalar_complexMultiply<double>;
+    f.complexMultiplyAndAdd = scalar_complexMultiplyAndAdd<float>;
+    d.complexMultiplyAndAdd = scalar_complexMultiplyAndAdd<double>;
+    f.log = scalarf_log;
+    f.exp = scalarf_exp;
+    d.log = scalard_log;
+    d.exp = scalard_exp;
+    f.convert = scalar_convert;
+    d.convert = scalar_convert;
+
+#if defined(BQ_SIMD_SSE2)
+    sse2f_fill(f);
+    sse2d_fill(d);
+    sse2f_fillPolar(f);
+    sse2d_fillPolar(d);
+    sse2f_fillComplex(f);
+    sse2d_fillComplex(d);
+    sse2f_fillPCM(f);
+    f.log = sse2f_log;
+    f.exp = sse2f_exp;
+    f.convert = sse2_convert;
+    d.convert = sse2_convert;
+#elif defined(BQ_SIMD_NEON)
+    neonf_fill(f);
+    neond_fill(d);
+    neonf_fillPolar(f);
+    neond_fillPolar(d);
+    neonf_fillComplex(f);
+    neond_fillComplex(d);
+    neonf_fillPCM(f);
+    f.log = neonf_log;
+    f.exp = neonf_exp;
+    f.convert = neon_convert;
+    d.convert = neon_convert;
+#endif
+
+#ifdef BQ_SIMD_AVX512
+    if (haveAVX512()) {
+        avx512f_fill(f);
+        avx512d_fill(d);
+        avx512f_fillPolar(f);
+        avx512d_fillPolar(d);
+        avx512f_fillComplex(f);
+        avx512d_fillComplex(d);
+        f.log = avx512f_log;
+        f.exp = avx512f_exp;
+        f.convert = avx512_convert;
+        d.convert = avx512_convert;
+        return;
+    }
+#endif
+
+#ifdef BQ_SIMD_AVX2
+    if (haveAVX2()) {
+        avx2f_fill(f);
+        avx2d_fill(d);
+        avx2f_fillPolar(f);
+        avx2d_fillPolar(d);
+        avx2f_fillComplex(f);
+        avx2d_fillComplex(d);
+        f.log = avx2f_log;
+        f.exp = avx2f_exp;
+        f.convert = avx2_convert;
+        d.convert = avx2_convert;
+    }
+#endif
+}
+
+// The tables are filled exactly once, by whichever comes first of
+// the static initialiser below and a call from another translation
+// unit's static initialiser. The once-only primitive also orders the
+// table writes before any thread's reads of them
+
+#ifdef NO_THREADING
+
+static bool kernelsReady = false;
+
+static inline void
+ensureKernels()
+{
+    if (!kernelsReady) {
+        selectKernels();
+        kernelsReady = true;
+    }
+}
+
+#elif defined _WIN32
+
+static INIT_ONCE kernelsOnce = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK
+selectKernelsOnce(PINIT_ONCE, PVOID, PVOID *)
+{
+    selectKernels();
+    return TRUE;
+}
+
+static inline void
+ensureKernels()
+{
+    InitOnceExecuteOnce(&kernelsOnce, selectKernelsOnce, NULL, NULL);
+}
+
+#else
+
+static pthread_once_t kernelsOnce = PTHREAD_ONCE_INIT;
+
+#if defined(__clang__) || \
+    (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)))
+
+// pthread_once costs as much as a short kernel, so check a flag
+// first, with an acquire load to pair with the release store that
+// follows the table writes
+
+static int kernelsSelected = 0;
+
+static void
+selectKernelsOnce()
+{
+    selectKernels();
+    __atomic_store_n(&kernelsSelected, 1, __ATOMIC_RELEASE);
+}
+
+static inline void
+ensureKernels()
+{
+    if (__atomic_load_n(&kernelsSelected, __ATOMIC_ACQUIRE)) return;
+    pthread_once(&kernelsOnce, selectKernelsOnce);
+}
+
+#else
+
+static inline void
+ensureKernels()
+{
+    pthread_once(&kernelsOnce, selectKernels);
+}
+
+#endif
+
+#endif
+
+static struct SIMDKernelSelector {
+    SIMDKernelSelector() { ensureKernels(); }
+} kernelSelector;
+
+static inline const SIMDKernelsF &
+kf()
+{
+    ensureKernels();
+    return kernelsF;
+}
+
+static inline const SIMDKernelsD &
+kd()
+{
+    ensureKernels();
+    return kernelsD;
+}
+
+void v_add_simd(float *const BQ_R__ dst, const float *const BQ_R__ src, const int count) { kf().add(dst, src, count); }
+void v_add_simd(double *const BQ_R__ dst, const double *const BQ_R__ src, const int count) { kd().add(dst, src, count); }
+
+void v_add_simd(float *const BQ_R__ dst, const float value, const int count) { kf().addValue(dst, value, count); }
+void v_add_simd(double *const BQ_R__ dst, const double value, const int count) { kd().addValue(dst, value, count); }
+
+void v_add_with_gain_simd(float *const BQ_R__ dst, const float *const BQ_R__ src, const float gain, const int count) { kf().addWithGain(dst, src, gain, count); }
+void v_add_with_gain_simd(double *const BQ_R__ dst, const double *const BQ_R__ src, const double gain, const int count) { kd().addWithGain(dst, src, gain, count); }
+
+void v_subtract_simd(float *const BQ_R__ dst, const float *const BQ_R__ src, const int count) { kf().subtract(dst, src, count); }
+void v_subtract_simd(double *const BQ_R__ dst, const double *const BQ_R__ src, const int count) { kd().subtract(dst, src, count); }
+
+void v_scale_simd(float *const BQ_R__ dst, const float gain, const int count) { kf().scale(dst, gain, count); }
+void v_scale_simd(double *const BQ_R__ dst, const double gain, const int count) { kd().scale(dst, gain, count); }
+
+void v_multiply_simd(float *const BQ_R__ dst, const float *const BQ_R__ src, const int count) { kf().multiply(dst, src, count); }
+void v_multiply_simd(double *const BQ_R__ dst, const double *const BQ_R__ src, const int count) { kd().multiply(dst, src, count); }
+
+void v_multiply_simd(float *const BQ_R__ dst, const float *const BQ_R__ src1, const float *const BQ_R__ src2, const int count) { kf().multiplyTo(dst, src1, src2, count); }
+void v_multiply_simd(double *const BQ_R__ dst, const double *const BQ_R__ src1, const double *const BQ_R__ src2, const int count) { kd().multiplyTo(dst, src1, src2, count); }
+
+void v_divide_simd(float *const BQ_R__ dst, const float *const BQ_R__ src, const int count) { kf().divide(dst, src, count); }
+void v_divide_simd(double *const BQ_R__ dst, const double *const BQ_R__ src, const int count) { kd().divide(dst, src, count); }
+
+void v_multiply_and_add_simd(float *const BQ_R__ dst, const float *const BQ_R__ src1, const float *const BQ_R__ src2, const int count) { kf().multiplyAndAdd(dst, src1, src2, count); }
+void v_multiply_and_add_simd(double *const BQ_R__ dst, const double *const BQ_R__ src1, const double *const BQ_R__ src2, const int count) { kd().multiplyAndAdd(dst, src1, src2, count); }
+
+float v_sum_simd(const float *const BQ_R__ src, const int count) { return kf().sum(src, count); }
+double v_sum_simd(const double *const BQ_R__ src, const int count) { return kd().sum(src, count); }
+
+float v_multiply_and_sum_simd(const float *const BQ_R__ src1, const float *const BQ_R__ src2, const int count) { return kf().multiplyAndSum(src1, src2, count); }
+double v_multiply_and_sum_simd(const double *const BQ_R__ src1, const double *const BQ_R__ src2, const int count) { return kd().multiplyAndSum(src1, src2, count); }
+
+float v_sum_squares_simd(const float *const BQ_R__ src, const int count) { return kf().sumSquares(src, count); }
+double v_sum_squares_simd(const double *const BQ_R__ src, const int count) { return kd().sumSquares(src, count); }
+
+float v_min_simd(const float *const BQ_R__ src, const int count) { return kf().min(src, count); }
+double v_min_simd(const double *const BQ_R__ src, const int count) { return kd().min(src, count); }
+
+float v_max_simd(const float *const BQ_R__ src, const int count) { return kf().max(src, count); }
+double v_max_simd(const double *const BQ_R__ src, const int count) { return kd().max(src, count); }
+
+int v_min_index_simd(const float *const BQ_R__ src, const int count) { return kf().minIndex(src, count); }
+int v_min_index_simd(const double *const BQ_R__ src, const int count) { return kd().minIndex(src, count); }
+
+int v_max_index_simd(const float *const BQ_R__ src, const int count) { return kf().maxIndex(src, count); }
+int v_max_index_simd(const double *const BQ_R__ src, const int count) { return kd().maxIndex(src, count); }
+
+float v_spectral_centroid_simd(const float *const BQ_R__ mag, const int count) { return kf().centroid(mag, count); }
+double v_spectral_centroid_simd(const double *const BQ_R__ mag, const int count) { return kd().centroid(mag, count); }
+
+float v_spectral_flux_simd(const float *const BQ_R__ mag, const float *const BQ_R__ prev, const int count) { return kf().flux(mag, prev, count); }
+double v_spectral_flux_simd(const double *const BQ_R__ mag, const double *const BQ_R__ prev, const int count) { return kd().flux(mag, prev, count); }
+
+void v_log_simd(float *const BQ_R__ dst, const int count) { kf().log(dst, count); }
+void v_exp_simd(float *const BQ_R__ dst, const int count) { kf().exp(dst, count); }
+
+void v_sqrt_simd(float *const BQ_R__ dst, const int count) { kf().sqrt(dst, count); }
+void v_sqrt_simd(double *const BQ_R__ dst, const int count) { kd().sqrt(dst, count); }
+
+void v_square_simd(float *const BQ_R__ dst, const int count) { kf().square(dst, count); }
+void v_square_simd(double *const BQ_R__ dst, const int count) { kd().square(dst, count); }
+
+void v_abs_simd(float *const BQ_R__ dst, const int count) { kf().abs(dst, count); }
+void v_abs_simd(double *const BQ_R__ dst, const int count) { kd().abs(dst, count); }
+
+void v_convert_simd(double *const BQ_R__ dst, const float *const BQ_R__ src, const int count) { kf().convert(dst, src, count); }
+void v_convert_simd(float *const BQ_R__ dst, const double *const BQ_R__ src, const int count) { kd().convert(dst, src, count); }
+
+void v_interleave_simd(float *const BQ_R__ dst, const float *const BQ_R__ *const BQ_R__ src, const int channels, const int count) { kf().interleave(dst, (const float *const *)src, channels, count); }
+void v_deinterleave_simd(float *const BQ_R__ *const BQ_R__ dst, const float *const BQ_R__ src, const int channels, const int count) { kf().deinterleave((float *const *)dst, src, channels, count); }
+
+void v_deinterleave_from_int16_simd(float *const BQ_R__ *const BQ_R__ dst, const int16_t *const BQ_R__ src, const float gain, const int channels, const int count) { kf().deinterleaveInt16((float *const *)dst, src, gain, channels, count); }
+void v_deinterleave_from_int24_simd(float *const BQ_R__ *const BQ_R__ dst, const unsigned char *const BQ_R__ src, const float gain, const int channels, const int count) { kf().deinterleaveInt24((float *const *)dst, src, gain, channels, count); }
+void v_deinterleave_from_int32_simd(float *const BQ_R__ *const BQ_R__ dst, const int32_t *const BQ_R__ src, const float gain, const int channels, const int count) { kf().deinterleaveInt32((float *const *)dst, src, gain, channels, count); }
+
+void v_interleave_to_int16_simd(int16_t *const BQ_R__ dst, const float *const BQ_R__ *const BQ_R__ src, const float gain, unsigned int *const ditherState, const int channels, const int count) { kf().interleaveInt16(dst, (const float *const *)src, gain, ditherState, channels, count); }
+void v_interleave_to_int24_simd(unsigned char *const BQ_R__ dst, const float *const BQ_R__ *const BQ_R__ src, const float gain, unsigned int *const ditherState, const int channels, const int count) { kf().interleaveInt24(dst, (const float *const *)src, gain, ditherState, channels, count); }
+void v_interleave_to_int32_simd(int32_t *const BQ_R__ dst, const float *const BQ_R__ *const BQ_R__ src, const float gain, unsigned int *const ditherState, const int channels, const int count) { kf().interleaveInt32(dst, (const float *const *)src, gain, ditherState, channels, count); }
+
+void v_cartesian_to_polar_simd(float *const BQ_R__ mag, float *const BQ_R__ phase, const float *const BQ_R__ real, const float *const BQ_R__ imag, const int count, const PolarAccuracy accuracy) { kf().toPolar[accuracy == PolarFast](mag, phase, real, imag, count); }
+void v_cartesian_to_polar_simd(double *const BQ_R__ mag, double *const BQ_R__ phase, const double *const BQ_R__ real, const double *const BQ_R__ imag, const int count, const PolarAccuracy accuracy) { kd().toPolar[accuracy == PolarFast](mag, phase, real, imag, count); }
+
+void v_cartesian_interleaved_to_polar_simd(float *const BQ_R__ mag, float *const BQ_R__ phase, const float *const BQ_R__ src, const int count, const PolarAccuracy accuracy) { kf().interleavedToPolar[accuracy == PolarFast](mag, phase, src, count); }
+void v_cartesian_interleaved_to_polar_simd(double *const BQ_R__ mag, double *const BQ_R__ phase, const double *const BQ_R__ src, const int count, const PolarAccuracy accuracy) { kd().interleavedToPolar[accuracy == PolarFast](mag, phase, src, count); }
+
+void v_polar_to_cartesian_simd(float *const BQ_R__ real, float *const BQ_R__ imag, const float *const BQ_R__ mag, const float *const BQ_R__ phase, const int count, const PolarAccuracy accuracy) { kf().toCartesian[accuracy == PolarFast](real, imag, mag, phase, count); }
+void v_polar_to_cartesian_simd(double *const BQ_R__ real, double *const BQ_R__ imag, const double *const BQ_R__ mag, const double *const BQ_R__ phase, const int count, const PolarAccuracy accuracy) { kd().toCartesian[accuracy == PolarFast](real, imag, mag, phase, count); }
+
+void v_polar_to_cartesian_interleaved_simd(float *const BQ_R__ dst, const float *const BQ_R__ mag, const float *const BQ_R__ phase, const int count, const PolarAccuracy accuracy) { kf().toCartesianInterleaved[accuracy == PolarFast](dst, mag, phase, count); }
+void v_polar_to_cartesian_interleaved_simd(double *const BQ_R__ dst, const double *const BQ_R__ mag, const double *const BQ_R__ phase, const int count, const PolarAccuracy accuracy) { kd().toCartesianInterleaved[accuracy == PolarFast](dst, mag, phase, count); }
+
+#ifndef NO_COMPLEX_TYPES
+
+void v_multiply_simd(bq_complex<float> *const BQ_R__ dst, const bq_complex<float> *const BQ_R__ src, const int count) { kf().complexMultiply((float *)dst, (const float *)dst, (const float *)src, count); }
+void v_multiply_simd(bq_complex<double> *const BQ_R__ dst, const bq_complex<double> *const BQ_R__ src, const int count) { kd().complexMultiply((double *)dst, (const double *)dst, (const double *)src, count); }
+
+void v_multiply_simd(bq_complex<float> *const BQ_R__ dst, const bq_complex<float> *const BQ_R__ src1, const bq_complex<float> *const BQ_R__ src2, const int count) { kf().complexMultiply((float *)dst, (const float *)src1, (const float *)src2, count); }
+void v_multiply_simd(bq_complex<double> *const BQ_R__ dst, const bq_complex<double> *const BQ_R__ src1, const bq_complex<double> *const BQ_R__ src2, const int count) { kd().complexMultiply((double *)dst, (const double *)src1, (const double *)src2, count); }
+
+void v_multiply_and_add_simd(bq_complex<float> *const BQ_R__ dst, const bq_complex<float> *const BQ_R__ src1, const bq_complex<float> *const BQ_R__ src2, const int count) { kf().complexMultiplyAndAdd((float *)dst, (const float *)src1, (const float *)src2, count); }
+void v_multiply_and_add_simd(bq_complex<double> *const BQ_R__ dst, const bq_complex<double> *const BQ_R__ src1, const bq_complex<double> *const BQ_R__ src2, const int count) { kd().complexMultiplyAndAdd((double *)dst, (const double *)src1, (const double *)src2, count); }
+
+#endif
+
+const char *
+v_simd_instruction_set()
+{
+    kf();
+#ifdef BQ_SIMD_AVX512
+    if (kernelsF.add == avx512f_add) return "avx512";
+#endif
+#ifdef BQ_SIMD_AVX2
+    if (kernelsF.add == avx2f_add) return "avx2";
+#endif
+#ifdef BQ_SIMD_SSE2
+    if (kernelsF.add == sse2f_add) return "sse2";
+#endif
+#ifdef BQ_SIMD_NEON
+    if (kernelsF.add == neonf_add) return "neon";
+#endif
+    return "none";
+}
+
+}
+
+#endif
@@ -0,0 +1,137 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+#include "bqvec/Allocators.h"
+
+#include <iostream>
+#include <cstdlib>
+
+#include <time.h>
+
+#ifdef USE_ALLOCATION_POOL
+#include <pthread.h>
+#endif
+
+using namespace std;
+
+namespace breakfastquay {
+
+namespace Test {
+
+bool
+testAlignment()
+{
+    cerr << "testAllocators: testing alignment to "
+         << BQ_ALLOCATION_ALIGNMENT << " bytes" << endl;
+
+    // Up to and past the large allocation threshold, if pooled
+    size_t sizes[] = { 1, 3, 15, 16, 17, 100, 1000, 4096, 65537, 1000000 };
+    for (size_t i = 0; i < sizeof(sizes)/sizeof(sizes[0]); ++i) {
+        double *ptr = allocate_and_zero<double>(sizes[i]);
+        if ((size_t)ptr % BQ_ALLOCATION_ALIGNMENT != 0) {
+            cerr << "testAllocators: allocation of " << sizes[i]
+                 << " doubles is misaligned at " << ptr << endl;
+            return false;
+        }
+        for (size_t j = 0; j < sizes[i]; ++j) {
+            if (ptr[j] != 0.0) {
+                cerr << "testAllocators: allocation of " << sizes[i]
+                     << " doubles is not zeroed at " << j << endl;
+                return false;
+            }
+            ptr[j] = double(j);
+        }
+        ptr = reallocate_and_zero_extension(ptr, sizes[i], sizes[i] * 2);
+        for (size_t j = 0; j < sizes[i] * 2; ++j) {
+            if (ptr[j] != (j < sizes[i] ? double(j) : 0.0)) {
+                cerr << "testAllocators: reallocation of " << sizes[i]
+                     << " doubles differs at " << j << endl;
+                return false;
+            }
+        }
+        deallocate(ptr);
+    }
+
+    return true;
+}
+
+#ifdef USE_ALLOCATION_POOL
+
+static void *
+deallocateThread(void *arg)
+{
+    deallocate((float *)arg);
+    pool_release_thread_cache();
+    return 0;
+}
+
+bool
+testPool()
+{
+    cerr << "testAllocators: testing allocation pool" << endl;
+
+    // A freed block is reused for the next allocation of its class
+    float *a = allocate<float>(1000);
+    deallocate(a);
+    float *b = allocate<float>(900);
+    if (b != a) {
+        cerr << "testAllocators: freed block was not reused" << endl;
+        return false;
+    }
+
+    // Freeing on another thread is permitted
+    pthread_t thread;
+    pthread_create(&thread, 0, deallocateThread, b);
+    pthread_join(thread, 0);
+
+    pool_release_thread_cache();
+    return true;
+}
+
+#endif
+
+bool
+testChurn()
+{
+    // Allocate and free a set of per-stream sized buffers repeatedly,
+    // as when streams come and go
+
+    const int buffers = 1000;
+    const int iterations = 200;
+    float *ptrs[buffers];
+
+    clock_t start = clock();
+
+    for (int j = 0; j < iterations; ++j) {
+        for (int i = 0; i < buffers; ++i) {
+            ptrs[i] = allocate<float>(256 << (i % 6));
+        }
+        for (int i = 0; i < buffers; ++i) {
+            deallocate(ptrs[i]);
+        }
+    }
+
+    clock_t end = clock();
+
+    cerr << "testAllocators: time for " << buffers * iterations
+         << " allocations: "
+         << float(end - start) / (float(CLOCKS_PER_SEC) / 1000.f)
+         << "ms" << endl;
+
+    return true;
+}
+
+bool
+testAllocators()
+{
+    if (!testAlignment()) return false;
+#ifdef USE_ALLOCATION_POOL
+    if (!testPool()) return false;
+#endif
+    if (!testChurn()) return false;
+    return true;
+}
+
+}
+
+}
+
@@ -0,0 +1,380 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+#include "bqvec/RingBuffer.h"
+#include "bqvec/SPSCRingBuffer.h"
+#include "bqvec/MPSCRingBuffer.h"
+#include "bqvec/MultiChannelRingBuffer.h"
+
+#include <iostream>
+#include <cstdlib>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
+#endif
+
+using namespace std;
+
+namespace breakfastquay {
+
+namespace Test {
+
+// Write and read a counting sequence through the buffer in blocks of
+// varying sizes, so that both go round the end of the storage at
+// many different offsets
+
+template <typename B>
+bool
+testSequence(const char *name, B &rb)
+{
+    cerr << "testRingBuffer: testing " << name << " sequence" << endl;
+
+    const int size = rb.getSize();
+    double in[200], out[200];
+    double next = 0.0, expected = 0.0;
+
+    for (int iteration = 0; iteration < 1000; ++iteration) {
+
+	int n = (iteration * 7) % 53 + 1;
+	for (int i = 0; i < n; ++i) in[i] = next + i;
+	int space = rb.getWriteSpace();
+	int written = rb.write(in, n);
+	if (written != (n < space ? n : space)) {
+	    cerr << "testRingBuffer: " << name << " wrote " << written
+		 << " of " << n << " with space " << space << endl;
+	    return false;
+	}
+	next += written;
+
+	if (rb.getReadSpace() + rb.getWriteSpace() != size) {
+	    cerr << "testRingBuffer: " << name << " read and write space "
+		 << "do not add up to size" << endl;
+	    return false;
+	}
+
+	n = (iteration * 11) % 47 + 1;
+	int peeked = rb.peek(out, n);
+	int read = rb.read(out + 100, n);
+	if (peeked != read) {
+	    cerr << "testRingBuffer: " << name << " peeked " << peeked
+		 << " but read " << read << endl;
+	    return false;
+	}
+	for (int i = 0; i < read; ++i) {
+	    if (out[i] != expected || out[i + 100] != expected) {
+		cerr << "testRingBuffer: " << name << " read " << out[i + 100]
+		     << " (peeked " << out[i] << "), expected "
+		     << expected << endl;
+		return false;
+	    }
+	    expected += 1.0;
+	}
+    }
+
+    int remaining = rb.getReadSpace();
+    if (rb.skip(remaining + 10) != remaining || rb.getReadSpace() != 0) {
+	cerr << "testRingBuffer: " << name << " skip failed" << endl;
+	return false;
+    }
+
+    if (rb.zero(5) != 5 || rb.readOne() != 0.0) {
+	cerr << "testRingBuffer: " << name << " zero failed" << endl;
+	return false;
+    }
+    out[0] = out[1] = out[2] = out[3] = 1.0;
+    if (rb.readAdding(out, 10) != 4 || out[3] != 1.0) {
+	cerr << "testRingBuffer: " << name << " readAdding failed" << endl;
+	return false;
+    }
+    
+    rb.write(in, 3);
+    rb.reset();
+    if (rb.getReadSpace() != 0 || rb.getWriteSpace() != size) {
+	cerr << "testRingBuffer: " << name << " reset failed" << endl;
+	return false;
+    }
+
+    return true;
+}
+
+// As testSequence, but writing and reading in place through the
+// regions
+
+template <typename B>
+bool
+testRegions(const char *name, B &rb)
+{
+    cerr << "testRingBuffer: testing " << name << " regions" << endl;
+
+    double next = 0.0, expected = 0.0;
+    double *w1, *w2;
+    const double *r1, *r2;
+    int n1, n2;
+
+    for (int iteration = 0; iteration < 1000; ++iteration) {
+
+	int n = (iteration * 7) % 53 + 1;
+	int space = rb.getWriteSpace();
+	int got = rb.getWriteRegions(n, w1, n1, w2, n2);
+	if (got != (n < space ? n : space) || n1 + n2 != got ||
+	    (n2 > 0 && w2 + n2 > w1)) {
+	    cerr << "testRingBuffer: " << name << " write regions " << n1
+		 << " + " << n2 << " for " << n << " with space " << space
+		 << endl;
+	    return false;
+	}
+	for (int i = 0; i < n1; ++i) w1[i] = next + i;
+	for (int i = 0; i < n2; ++i) w2[i] = next + n1 + i;
+	if (rb.commitWrite(got) != got) {
+	    cerr << "testRingBuffer: " << name << " commitWrite failed" << endl;
+	    return false;
+	}
+	next += got;
+
+	n = (iteration * 11) % 47 + 1;
+	got = rb.getReadRegions(n, r1, n1, r2, n2);
+	if (n1 + n2 != got) {
+	    cerr << "testRingBuffer: " << name << " read regions " << n1
+		 << " + " << n2 << " but returned " << got << endl;
+	    return false;
+	}
+	for (int i = 0; i < got; ++i) {
+	    double value = (i < n1 ? r1[i] : r2[i - n1]);
+	    if (value != expected) {
+		cerr << "testRingBuffer: " << name << " region held " << value
+		     << ", expected " << expected << endl;
+		return false;
+	    }
+	    expected += 1.0;
+	}
+	if (rb.commitRead(got) != got) {
+	    cerr << "testRingBuffer: " << name << " commitRead failed" << endl;
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+bool
+testMultiChannel()
+{
+    cerr << "testRingBuffer: testing MultiChannelRingBuffer" << endl;
+
+    const int channels = 3;
+    MultiChannelRingBuffer<float> rb(channels, 100);
+
+    float **in = allocate_channels<float>(channels, 64);
+    float **out = allocate_channels<float>(channels, 64);
+    float interleaved[64 * channels];
+    float next = 0.f, expected = 0.f;
+
+    for (int iteration = 0; iteration < 500; ++iteration) {
+
+	int n = (iteration * 7) % 61 + 1;
+	int written;
+	if (iteration % 2) {
+	    for (int i = 0; i < n; ++i) {
+		for (int c = 0; c < channels; ++c) {
+		    in[c][i] = next + i + c * 10000.f;
+		}
+	    }
+	    written = rb.write(in, n);
+	} else {
+	    for (int i = 0; i < n; ++i) {
+		for (int c = 0; c < channels; ++c) {
+		    interleaved[i * channels + c] = next + i + c * 10000.f;
+		}
+	    }
+	    written = rb.writeInterleaved(interleaved, n);
+	}
+	next += written;
+
+	n = (iteration * 13) % 59 + 1;
+	int read;
+	if (iteration % 3) {
+	    read = rb.read(out, n);
+	} else {
+	    read = rb.readInterleaved(interleaved, n);
+	    for (int i = 0; i < read; ++i) {
+		for (int c = 0; c < channels; ++c) {
+		    out[c][i] = interleaved[i * channels + c];
+		}
+	    }
+	}
+	for (int i = 0; i < read; ++i) {
+	    for (int c = 0; c < channels; ++c) {
+		if (out[c][i] != expected + c * 10000.f) {
+		    cerr << "testRingBuffer: MultiChannelRingBuffer read "
+			 << out[c][i] << " in channel " << c << ", expected "
+			 << expected + c * 10000.f << endl;
+		    return false;
+		}
+	    }
+	    expected += 1.f;
+	}
+    }
+
+    deallocate_channels(in, channels);
+    deallocate_channels(out, channels);
+    return true;
+}
+
+#ifndef _WIN32
+
+// Threaded tests and throughput. The writers and reader spin, with a
+// yield, while there is no space or data; the yield is also what
+// obliges the compiler to look at RingBuffer's indices afresh
+
+static const int blockSize = 256;
+static const int totalBlocks = 40000;
+static const int writerCount = 4;
+
+static double
+now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+template <typename B>
+struct WriterArgs
+{
+    B *rb;
+    int id;
+    int blocks;
+};
+
+template <typename B>
+void *
+writerThread(void *arg)
+{
+    WriterArgs<B> *args = (WriterArgs<B> *)arg;
+    double block[blockSize];
+    double next = 0.0;
+    for (int b = 0; b < args->blocks; ++b) {
+	for (int i = 0; i < blockSize; ++i) {
+	    block[i] = args->id * 1e9 + next + i;
+	}
+	// With several writers, another may take the space between our
+	// check and our write, so write whatever fits and go round again
+	int done = 0;
+	while (done < blockSize) {
+	    if (args->rb->getWriteSpace() < blockSize - done) {
+		sched_yield();
+		continue;
+	    }
+	    done += args->rb->write(block + done, blockSize - done);
+	}
+	next += blockSize;
+    }
+    return 0;
+}
+
+// Read everything written by the given number of writers, each
+// writing a counting sequence offset by its id, and check that each
+// writer's sequence arrives in order
+
+template <typename B>
+bool
+readAndCheck(const char *name, B &rb, int writers, int total)
+{
+    double block[blockSize];
+    double expected[writerCount] = { 0.0 };
+    int done = 0;
+    while (done < total) {
+	int n = rb.getReadSpace();
+	if (n == 0) {
+	    sched_yield();
+	    continue;
+	}
+	if (n > blockSize) n = blockSize;
+	rb.read(block, n);
+	for (int i = 0; i < n; ++i) {
+	    int id = int(block[i] / 1e9);
+	    double value = block[i] - id * 1e9;
+	    if (id < 0 || id >= writers || value != expected[id]) {
+		cerr << "testRingBuffer: " << name << " read " << block[i]
+		     << " at " << done + i << ", expected one of";
+		for (int w = 0; w < writers; ++w) {
+		    cerr << " " << w * 1e9 + expected[w];
+		}
+		cerr << endl;
+		return false;
+	    }
+	    expected[id] += 1.0;
+	}
+	done += n;
+    }
+    return true;
+}
+
+template <typename B>
+bool
+testThroughput(const char *name, int writers)
+{
+    B rb(4095);
+    pthread_t threads[writerCount];
+    WriterArgs<B> args[writerCount];
+    int blocks = totalBlocks / writers;
+
+    double start = now();
+    for (int w = 0; w < writers; ++w) {
+	args[w].rb = &rb;
+	args[w].id = w;
+	args[w].blocks = blocks;
+	pthread_create(&threads[w], 0, writerThread<B>, &args[w]);
+    }
+    bool ok = readAndCheck(name, rb, writers, blocks * blockSize * writers);
+    for (int w = 0; w < writers; ++w) {
+	pthread_join(threads[w], 0);
+    }
+    double elapsed = now() - start;
+
+    cerr << "testRingBuffer: " << name << " with " << writers << " writer"
+	 << (writers > 1 ? "s" : "") << ": "
+	 << (blocks * blockSize * writers) / elapsed / 1e6
+	 << " Msamples/sec" << endl;
+    return ok;
+}
+
+bool
+testThreaded()
+{
+    if (!testThroughput<RingBuffer<double> >("RingBuffer", 1)) return false;
+    if (!testThroughput<SPSCRingBuffer<double> >("SPSCRingBuffer", 1)) return false;
+    if (!testThroughput<MPSCRingBuffer<double> >("MPSCRingBuffer", 1)) return false;
+    if (!testThroughput<MPSCRingBuffer<double> >("MPSCRingBuffer", writerCount)) return false;
+    return true;
+}
+
+#endif
+
+bool
+testRingBuffer()
+{
+    RingBuffer<double> rb(100);
+    if (!testRegions("RingBuffer", rb)) return false;
+
+    SPSCRingBuffer<double> spsc(100);
+    if (!testSequence("SPSCRingBuffer", spsc)) return false;
+    if (!testRegions("SPSCRingBuffer", spsc)) return false;
+
+    MPSCRingBuffer<double> mpsc(100);
+    if (!testSequence("MPSCRingBuffer", mpsc)) return false;
+
+    if (!testMultiChannel()) return false;
+
+#ifndef _WIN32
+    if (!testThreaded()) return false;
+#endif
+
+    return true;
+}
+
+}
+
+}
+
@@ -0,0 +1,12 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+namespace breakfastquay {
+
+namespace Test {
+
+bool testRingBuffer();
+
+}
+
+}
+
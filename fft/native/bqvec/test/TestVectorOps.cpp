@@ -1,9 +1,15 @@
 /* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
 
 #include "bqvec/VectorOpsComplex.h"
+#include "bqvec/VectorOpsFused.h"
+#include "bqvec/VectorOpsPCM.h"
+#include "bqvec/VectorOpsFeatures.h"
+#include "bqvec/VectorOpsFixed.h"
+#include "bqvec/Allocators.h"
 
 #include <iostream>
 #include <cstdlib>
+#include <cmath>
 
 #include <time.h>
 
@@ -238,12 +244,962 @@ testPolarToCartInterleaved()
     return true;
 }
 
+bool
+testFused()
+{
+    cerr << "testVectorOps: testing fused expressions" << endl;
+
+    // Frame processing for 64 channels of 2048 samples: window, add
+    // the previous frame, apply a gain
+    
+    const int N = 2048;
+    const int channels = 64;
+    float **in = allocate_channels<float>(channels, N);
+    float **prev = allocate_channels<float>(channels, N);
+    float **out = allocate_channels<float>(channels, N);
+    float *window = allocate<float>(N);
+    float *expected = allocate<float>(N);
+    const float gain = 0.8f;
+
+    for (int c = 0; c < channels; ++c) {
+	for (int i = 0; i < N; ++i) {
+	    in[c][i] = float(drand48());
+	    prev[c][i] = float(drand48());
+	}
+    }
+    for (int i = 0; i < N; ++i) {
+	window[i] = float(0.5 - 0.5 * cos(2.0 * M_PI * i / N));
+    }
+
+    for (int c = 0; c < channels; ++c) {
+	v_copy(expected, in[c], N);
+	v_multiply(expected, window, N);
+	v_add(expected, prev[c], N);
+	v_scale(expected, gain, N);
+	v_eval(out[c], (v_expr(in[c]) * v_expr(window) + v_expr(prev[c])) * gain, N);
+	for (int i = 0; i < N; ++i) {
+	    if (fabsf(out[c][i] - expected[i]) > 1e-6f) {
+		cerr << "testVectorOps: v_eval differs at index " << i
+		     << ": " << out[c][i] << " vs " << expected[i] << endl;
+		return false;
+	    }
+	}
+    }
+
+    // In place, scalars on the left, and the unary functions
+
+    v_copy(out[0], in[0], N);
+    v_eval(out[0], 1.f - v_expr_sqrt(v_expr_abs(2.f * v_expr(out[0]) - 1.f)), N);
+    v_eval_adding(out[0], v_expr_square(v_expr(window)) / 4.f, N);
+    for (int i = 0; i < N; ++i) {
+	float e = 1.f - sqrtf(fabsf(2.f * in[0][i] - 1.f)) +
+	    window[i] * window[i] / 4.f;
+	if (fabsf(out[0][i] - e) > 1e-6f) {
+	    cerr << "testVectorOps: v_eval in place differs at index " << i
+		 << ": " << out[0][i] << " vs " << e << endl;
+	    return false;
+	}
+    }
+
+    float sum = v_sum(v_expr_square(v_expr(in[1])), N);
+    v_copy(expected, in[1], N);
+    v_square(expected, N);
+    if (fabsf(sum - v_sum(expected, N)) > 1e-3f) {
+	cerr << "testVectorOps: fused v_sum is " << sum << ", expected "
+	     << v_sum(expected, N) << endl;
+	return false;
+    }
+
+    int iterations = 500;
+    float divisor = float(CLOCKS_PER_SEC) / 1000.f;
+
+    clock_t start = clock();
+    for (int j = 0; j < iterations; ++j) {
+	for (int c = 0; c < channels; ++c) {
+	    v_copy(out[c], in[c], N);
+	    v_multiply(out[c], window, N);
+	    v_add(out[c], prev[c], N);
+	    v_scale(out[c], gain, N);
+	}
+    }
+    clock_t end = clock();
+
+    cerr << "Time for sequential v_ calls: " << float(end - start)/divisor << endl;
+
+    start = clock();
+    for (int j = 0; j < iterations; ++j) {
+	for (int c = 0; c < channels; ++c) {
+	    v_eval(out[c], (v_expr(in[c]) * v_expr(window) + v_expr(prev[c])) * gain, N);
+	}
+    }
+    end = clock();
+
+    cerr << "Time for v_eval: " << float(end - start)/divisor << endl;
+
+    deallocate_channels(in, channels);
+    deallocate_channels(prev, channels);
+    deallocate_channels(out, channels);
+    deallocate(window);
+    deallocate(expected);
+    return true;
+}
+
+bool
+testPCM()
+{
+    cerr << "testVectorOps: testing PCM conversion" << endl;
+
+    // Odd frame count, so that every path has a remainder. The
+    // references are the generic double-precision functions
+
+    const int N = 37;
+    const int maxChannels = 16;
+    const int channelCounts[] = { 1, 2, 3, 4, 5, 6, 8, 16 };
+    const float gain = 0.9f;
+
+    int16_t i16[N * maxChannels], o16[N * maxChannels];
+    int32_t i32[N * maxChannels], o32[N * maxChannels];
+    unsigned char i24[N * maxChannels * 3], o24[N * maxChannels * 3];
+    float interleaved[N * maxChannels];
+    float **f = allocate_channels<float>(maxChannels, N);
+    float **fback = allocate_channels<float>(maxChannels, N);
+    double **d = allocate_channels<double>(maxChannels, N);
+
+    for (int k = 0; k < int(sizeof(channelCounts)/sizeof(channelCounts[0])); ++k) {
+
+	const int channels = channelCounts[k];
+	const int n = N * channels;
+
+	for (int i = 0; i < n; ++i) {
+	    i16[i] = int16_t(rand() % 65536 - 32768);
+	    i32[i] = int32_t(uint32_t(rand()) * 65536u + uint32_t(rand() % 65536));
+	    for (int j = 0; j < 3; ++j) i24[i * 3 + j] = (unsigned char)(rand() % 256);
+	    interleaved[i] = float(drand48());
+	}
+	i16[0] = -32768;
+	i16[n-1] = 32767;
+
+	v_deinterleave_from_int16(f, i16, gain, channels, N);
+	v_deinterleave_from_int16(d, i16, double(gain), channels, N);
+	for (int c = 0; c < channels; ++c) {
+	    for (int i = 0; i < N; ++i) {
+		if (fabs(f[c][i] - d[c][i]) > 1e-6) {
+		    cerr << "testVectorOps: v_deinterleave_from_int16 with "
+			 << channels << " channels differs at " << c << ", "
+			 << i << ": " << f[c][i] << " vs " << d[c][i] << endl;
+		    return false;
+		}
+	    }
+	}
+
+	v_deinterleave_from_int24(f, i24, gain, channels, N);
+	v_deinterleave_from_int24(d, i24, double(gain), channels, N);
+	for (int c = 0; c < channels; ++c) {
+	    for (int i = 0; i < N; ++i) {
+		if (fabs(f[c][i] - d[c][i]) > 1e-6) {
+		    cerr << "testVectorOps: v_deinterleave_from_int24 with "
+			 << channels << " channels differs at " << c << ", "
+			 << i << ": " << f[c][i] << " vs " << d[c][i] << endl;
+		    return false;
+		}
+	    }
+	}
+
+	v_deinterleave_from_int32(f, i32, gain, channels, N);
+	v_deinterleave_from_int32(d, i32, double(gain), channels, N);
+	for (int c = 0; c < channels; ++c) {
+	    for (int i = 0; i < N; ++i) {
+		if (fabs(f[c][i] - d[c][i]) > 1e-6) {
+		    cerr << "testVectorOps: v_deinterleave_from_int32 with "
+			 << channels << " channels differs at " << c << ", "
+			 << i << ": " << f[c][i] << " vs " << d[c][i] << endl;
+		    return false;
+		}
+	    }
+	}
+
+	// Back again, with some values out of range to be clipped and
+	// the same values in double precision for the reference
+
+	for (int c = 0; c < channels; ++c) {
+	    for (int i = 0; i < N; ++i) {
+		f[c][i] = float(drand48() * 1.2);
+		d[c][i] = f[c][i];
+	    }
+	    f[c][c % N] = 1.5f;
+	    d[c][c % N] = 1.5;
+	    f[c][(c + 1) % N] = -1.5f;
+	    d[c][(c + 1) % N] = -1.5;
+	}
+
+	v_interleave_to_int16(o16, f, 1.f, 0, channels, N);
+	v_interleave_to_int16(i16, d, 1.0, 0, channels, N);
+	v_interleave_to_int24(o24, f, 1.f, 0, channels, N);
+	v_interleave_to_int24(i24, d, 1.0, 0, channels, N);
+	v_interleave_to_int32(o32, f, 1.f, 0, channels, N);
+	v_interleave_to_int32(i32, d, 1.0, 0, channels, N);
+	for (int i = 0; i < n; ++i) {
+	    // The top byte is signed, whatever the signedness of char
+	    int s24 = o24[i*3] | (o24[i*3+1] << 8) | (int32_t(int8_t(o24[i*3+2])) * 65536);
+	    int e24 = i24[i*3] | (i24[i*3+1] << 8) | (int32_t(int8_t(i24[i*3+2])) * 65536);
+	    if (abs(o16[i] - i16[i]) > 1 || abs(s24 - e24) > 1 ||
+		fabs(double(o32[i]) - double(i32[i])) > 256.0) {
+		cerr << "testVectorOps: v_interleave_to_int* with " << channels
+		     << " channels differs at " << i << ": " << o16[i] << " vs "
+		     << i16[i] << ", " << s24 << " vs " << e24 << ", "
+		     << o32[i] << " vs " << i32[i] << endl;
+		return false;
+	    }
+	}
+	if (o16[0] != 32767 || o16[channels] != -32768 ||
+	    o32[0] < 2147483520 || o32[channels] != int32_t(-2147483647 - 1)) {
+	    cerr << "testVectorOps: v_interleave_to_int* with " << channels
+		 << " channels failed to clip: " << o16[0] << ", "
+		 << o16[channels] << ", " << o32[0] << ", "
+		 << o32[channels] << endl;
+	    return false;
+	}
+
+	// With dither, within a bit and a half of the exact value
+
+	unsigned int state = 1234;
+	v_interleave_to_int16(o16, f, 1.f, &state, channels, N);
+	for (int c = 0; c < channels; ++c) {
+	    for (int i = 0; i < N; ++i) {
+		double e = f[c][i] * 32768.0;
+		if (e > 32767.0) e = 32767.0;
+		if (e < -32768.0) e = -32768.0;
+		if (fabs(o16[i * channels + c] - e) > 1.5) {
+		    cerr << "testVectorOps: dithered v_interleave_to_int16 with "
+			 << channels << " channels is out at " << c << ", " << i
+			 << ": " << o16[i * channels + c] << " vs " << e << endl;
+		    return false;
+		}
+	    }
+	}
+
+	// Float, both ways
+
+	v_deinterleave(fback, interleaved, channels, N);
+	for (int c = 0; c < channels; ++c) {
+	    for (int i = 0; i < N; ++i) {
+		if (fback[c][i] != interleaved[i * channels + c]) {
+		    cerr << "testVectorOps: v_deinterleave with " << channels
+			 << " channels differs at " << c << ", " << i << endl;
+		    return false;
+		}
+	    }
+	}
+	v_zero(interleaved, n);
+	v_interleave(interleaved, fback, channels, N);
+	for (int c = 0; c < channels; ++c) {
+	    for (int i = 0; i < N; ++i) {
+		if (fback[c][i] != interleaved[i * channels + c]) {
+		    cerr << "testVectorOps: v_interleave with " << channels
+			 << " channels differs at " << c << ", " << i << endl;
+		    return false;
+		}
+	    }
+	}
+    }
+
+    deallocate_channels(f, maxChannels);
+    deallocate_channels(fback, maxChannels);
+    deallocate_channels(d, maxChannels);
+
+    // 16 channels of 16-bit capture, first deinterleaved, converted
+    // and copied as separate steps, then in one pass
+
+    const int channels = 16;
+    const int frames = 4096;
+    int16_t *capture = allocate<int16_t>(channels * frames);
+    float *plane = allocate<float>(frames);
+    float **out = allocate_channels<float>(channels, frames);
+    int16_t **split = allocate_channels<int16_t>(channels, frames);
+    for (int i = 0; i < channels * frames; ++i) {
+	capture[i] = int16_t(rand() % 65536 - 32768);
+    }
+
+    int iterations = 500;
+    float divisor = float(CLOCKS_PER_SEC) / 1000.f;
+
+    clock_t start = clock();
+    for (int j = 0; j < iterations; ++j) {
+	v_deinterleave(split, capture, channels, frames);
+	for (int c = 0; c < channels; ++c) {
+	    for (int i = 0; i < frames; ++i) plane[i] = split[c][i];
+	    v_scale(plane, gain / 32768.f, frames);
+	    v_copy(out[c], plane, frames);
+	}
+    }
+    clock_t end = clock();
+
+    cerr << "Time for deinterleave, convert and copy: " << float(end - start)/divisor << endl;
+
+    start = clock();
+    for (int j = 0; j < iterations; ++j) {
+	v_deinterleave_from_int16(out, capture, gain, channels, frames);
+    }
+    end = clock();
+
+    cerr << "Time for v_deinterleave_from_int16: " << float(end - start)/divisor << endl;
+
+    start = clock();
+    for (int j = 0; j < iterations; ++j) {
+	v_interleave_to_int16(capture, out, 1.f / gain, 0, channels, frames);
+    }
+    end = clock();
+
+    cerr << "Time for v_interleave_to_int16: " << float(end - start)/divisor << endl;
+
+    deallocate(capture);
+    deallocate(plane);
+    deallocate_channels(out, channels);
+    deallocate_channels(split, channels);
+    return true;
+}
+
+template <typename T>
+bool
+testReductionsType(const char *type, double tolerance)
+{
+    // Lengths either side of every vector and unrolled width, checked
+    // against sums in double precision
+
+    const int lengths[] = { 0, 1, 3, 7, 16, 37, 64, 1000, 4097 };
+    const int N = 4097;
+    T *a = allocate<T>(N);
+    T *b = allocate<T>(N);
+
+    for (int k = 0; k < int(sizeof(lengths)/sizeof(lengths[0])); ++k) {
+
+	const int n = lengths[k];
+	for (int i = 0; i < n; ++i) {
+	    a[i] = T(drand48());
+	    b[i] = T(drand48() * 2.0 - 1.0);
+	}
+
+	double sum = 0.0, dot = 0.0, squares = 0.0;
+	double weighted = 0.0, flux = 0.0;
+	for (int i = 0; i < n; ++i) {
+	    sum += a[i];
+	    dot += double(a[i]) * b[i];
+	    squares += double(b[i]) * b[i];
+	    weighted += double(i) * a[i];
+	    if (a[i] > b[i]) flux += double(a[i]) - b[i];
+	}
+	double centroid = (sum > 0.0 ? weighted / sum : 0.0);
+	double scale = (n > 0 ? n : 1);
+
+	if (fabs(v_sum(a, n) - sum) > tolerance * scale ||
+	    fabs(v_sum_pairwise(a, n) - sum) > tolerance * scale ||
+	    fabs(v_multiply_and_sum(a, b, n) - dot) > tolerance * scale ||
+	    fabs(v_sum_squares(b, n) - squares) > tolerance * scale ||
+	    fabs(v_spectral_flux(a, b, n) - flux) > tolerance * scale ||
+	    fabs(v_spectral_centroid(a, n) - centroid) > tolerance * scale) {
+	    cerr << "testVectorOps: " << type << " sums of length " << n
+		 << " differ: " << v_sum(a, n) << " vs " << sum << ", "
+		 << v_sum_pairwise(a, n) << " vs " << sum << ", "
+		 << v_multiply_and_sum(a, b, n) << " vs " << dot << ", "
+		 << v_sum_squares(b, n) << " vs " << squares << ", "
+		 << v_spectral_flux(a, b, n) << " vs " << flux << ", "
+		 << v_spectral_centroid(a, n) << " vs " << centroid << endl;
+	    return false;
+	}
+
+	// Extremes, each present twice so that the first must be found
+
+	if (n == 0) {
+	    if (v_min_index(a, n) != -1 || v_max_index(a, n) != -1) {
+		cerr << "testVectorOps: " << type << " index of empty vector "
+		     << "is not -1" << endl;
+		return false;
+	    }
+	    continue;
+	}
+	int lo = int(drand48() * n), hi = int(drand48() * n);
+	if (lo == hi) hi = (hi + 1) % n;
+	a[lo] = T(-1);
+	a[hi] = T(2);
+	if (n > 8) {
+	    a[n - 1 - (lo % 4)] = T(-1);
+	    a[n - 1 - (hi % 4)] = T(2);
+	}
+	int elo = -1, ehi = -1;
+	for (int i = 0; i < n; ++i) {
+	    if (elo < 0 && a[i] == T(-1)) elo = i;
+	    if (ehi < 0 && a[i] == T(2)) ehi = i;
+	}
+	if (n == 1) elo = ehi = 0;
+	if (v_min_index(a, n) != elo || v_max_index(a, n) != ehi ||
+	    v_min(a, n) != a[elo] || v_max(a, n) != a[ehi]) {
+	    cerr << "testVectorOps: " << type << " extremes of length " << n
+		 << " differ: " << v_min_index(a, n) << " vs " << elo << ", "
+		 << v_max_index(a, n) << " vs " << ehi << ", " << v_min(a, n)
+		 << " vs " << a[elo] << ", " << v_max(a, n) << " vs " << a[ehi]
+		 << endl;
+	    return false;
+	}
+    }
+
+    deallocate(a);
+    deallocate(b);
+    return true;
+}
+
+bool
+testReductions()
+{
+    cerr << "testVectorOps: testing reductions and spectral features" << endl;
+
+    if (!testReductionsType<float>("float", 1e-6)) return false;
+    if (!testReductionsType<double>("double", 1e-12)) return false;
+
+    // Pairwise summation of many equal floats stays close where a
+    // running sum would have lost several digits
+
+    const int N = 1 << 22;
+    float *v = allocate<float>(N);
+    for (int i = 0; i < N; ++i) v[i] = 0.1f;
+    double expected = double(0.1f) * N;
+    float pairwise = v_sum_pairwise(v, N);
+    if (fabs(pairwise - expected) > expected * 1e-6) {
+	cerr << "testVectorOps: v_sum_pairwise of " << N << " values is "
+	     << pairwise << ", expected " << expected << endl;
+	return false;
+    }
+
+    // Rolloff and flatness of a flat spectrum and of a single peak
+
+    const int bins = 1025;
+    float *mag = allocate<float>(bins);
+    double *dmag = allocate<double>(bins);
+    v_set(mag, 1.f, bins);
+    int rolloff = v_spectral_rolloff(mag, 0.85f, bins);
+    float flatness = v_spectral_flatness(mag, bins);
+    if (rolloff != int(ceil(0.85 * bins)) - 1 || fabsf(flatness - 1.f) > 1e-4f) {
+	cerr << "testVectorOps: flat spectrum has rolloff " << rolloff
+	     << " and flatness " << flatness << endl;
+	return false;
+    }
+    v_zero(mag, bins);
+    mag[300] = 1.f;
+    rolloff = v_spectral_rolloff(mag, 0.85f, bins);
+    flatness = v_spectral_flatness(mag, bins);
+    if (rolloff != 300 || flatness > 1e-3f) {
+	cerr << "testVectorOps: single peak has rolloff " << rolloff
+	     << " and flatness " << flatness << endl;
+	return false;
+    }
+    for (int i = 0; i < bins; ++i) {
+	mag[i] = float(drand48() * drand48());
+	dmag[i] = mag[i];
+    }
+    if (abs(v_spectral_rolloff(mag, 0.9f, bins) -
+	    v_spectral_rolloff(dmag, 0.9, bins)) > 1 ||
+	fabs(v_spectral_flatness(mag, bins) -
+	     v_spectral_flatness(dmag, bins)) > 1e-4) {
+	cerr << "testVectorOps: float and double features differ: "
+	     << v_spectral_rolloff(mag, 0.9f, bins) << " vs "
+	     << v_spectral_rolloff(dmag, 0.9, bins) << ", "
+	     << v_spectral_flatness(mag, bins) << " vs "
+	     << v_spectral_flatness(dmag, bins) << endl;
+	return false;
+    }
+
+    // Features of 2048 frames of 1025 bins, first with single
+    // accumulator loops, then with the functions above
+
+    const int frames = 2048;
+    float *spectra = allocate<float>(frames * bins);
+    for (int i = 0; i < frames * bins; ++i) {
+	spectra[i] = float(drand48());
+    }
+
+    int iterations = 10;
+    float divisor = float(CLOCKS_PER_SEC) / 1000.f;
+    float total = 0.f;
+
+    clock_t start = clock();
+    for (int j = 0; j < iterations; ++j) {
+	for (int f = 1; f < frames; ++f) {
+	    const float *m = spectra + f * bins, *p = m - bins;
+	    float sum = 0.f, weighted = 0.f, squares = 0.f, flux = 0.f;
+	    for (int i = 0; i < bins; ++i) {
+		sum += m[i];
+		weighted += float(i) * m[i];
+		squares += m[i] * m[i];
+		if (m[i] > p[i]) flux += m[i] - p[i];
+	    }
+	    total += weighted / sum + squares + flux;
+	}
+    }
+    clock_t end = clock();
+
+    cerr << "Time for single-accumulator loops: " << float(end - start)/divisor << endl;
+
+    start = clock();
+    for (int j = 0; j < iterations; ++j) {
+	for (int f = 1; f < frames; ++f) {
+	    const float *m = spectra + f * bins, *p = m - bins;
+	    total += v_spectral_centroid(m, bins) + v_sum_squares(m, bins) +
+		v_spectral_flux(m, p, bins);
+	}
+    }
+    end = clock();
+
+    cerr << "Time for v_spectral_centroid, v_sum_squares and v_spectral_flux: "
+	 << float(end - start)/divisor << " (" << total << ")" << endl;
+
+    deallocate(v);
+    deallocate(mag);
+    deallocate(dmag);
+    deallocate(spectra);
+    return true;
+}
+
+template <int N, typename T>
+bool
+testFixedSize()
+{
+    // Each fixed-size function against its runtime-size counterpart
+
+    T *a = allocate<T>(N), *b = allocate<T>(N);
+    T *x = allocate<T>(N), *y = allocate<T>(N);
+    T *pairs = allocate<T>(N * 2);
+    for (int i = 0; i < N; ++i) {
+	a[i] = T(drand48());
+	b[i] = T(drand48() + 0.5);
+    }
+
+    bool good = true;
+    const char *what = "";
+
+#define FIXED_COMPARE(name, fixed, runtime)                     \
+    if (good) {                                                 \
+        v_copy(x, a, N); v_copy(y, a, N);                       \
+        fixed; runtime;                                         \
+        for (int i = 0; i < N; ++i) {                           \
+            if (fabs(x[i] - y[i]) > 1e-6) {                     \
+                what = name; good = false; break;               \
+            }                                                   \
+        }                                                       \
+    }
+
+    FIXED_COMPARE("v_zero", v_zero<N>(x), v_zero(y, N));
+    FIXED_COMPARE("v_set", v_set<N>(x, T(3)), v_set(y, T(3), N));
+    FIXED_COMPARE("v_copy", v_copy<N>(x, b), v_copy(y, b, N));
+    FIXED_COMPARE("v_add", v_add<N>(x, b), v_add(y, b, N));
+    FIXED_COMPARE("v_add_with_gain", v_add_with_gain<N>(x, b, T(0.5)),
+		  v_add_with_gain(y, b, T(0.5), N));
+    FIXED_COMPARE("v_subtract", v_subtract<N>(x, b), v_subtract(y, b, N));
+    FIXED_COMPARE("v_scale", v_scale<N>(x, T(0.25)), v_scale(y, T(0.25), N));
+    FIXED_COMPARE("v_multiply", v_multiply<N>(x, b), v_multiply(y, b, N));
+    FIXED_COMPARE("v_multiply (3-arg)", v_multiply<N>(x, a, b),
+		  v_multiply(y, a, b, N));
+    FIXED_COMPARE("v_divide", v_divide<N>(x, b), v_divide(y, b, N));
+    FIXED_COMPARE("v_multiply_and_add", v_multiply_and_add<N>(x, a, b),
+		  v_multiply_and_add(y, a, b, N));
+
+#undef FIXED_COMPARE
+
+    if (good && fabs(v_sum<N>(a) - v_sum(a, N)) > 1e-6 * N) {
+	what = "v_sum"; good = false;
+    }
+    if (good && fabs(v_multiply_and_sum<N>(a, b) -
+		     v_multiply_and_sum(a, b, N)) > 1e-6 * N) {
+	what = "v_multiply_and_sum"; good = false;
+    }
+
+    if (good) {
+	v_interleave_complex<N>(pairs, a, b);
+	v_deinterleave_complex<N>(x, y, pairs);
+	for (int i = 0; i < N; ++i) {
+	    if (pairs[i*2] != a[i] || pairs[i*2+1] != b[i] ||
+		x[i] != a[i] || y[i] != b[i]) {
+		what = "v_interleave_complex"; good = false; break;
+	    }
+	}
+	v_interleave_complex<N>(pairs, b, (const T *)0);
+	v_deinterleave_complex<N>(x, (T *)0, pairs);
+	for (int i = 0; i < N; ++i) {
+	    if (pairs[i*2+1] != T(0) || x[i] != b[i]) {
+		what = "v_interleave_complex with no imaginary part";
+		good = false; break;
+	    }
+	}
+    }
+
+    if (!good) {
+	cerr << "testVectorOps: fixed-size " << what << " at size " << N
+	     << " differs from runtime-size version" << endl;
+    }
+
+    deallocate(a);
+    deallocate(b);
+    deallocate(x);
+    deallocate(y);
+    deallocate(pairs);
+    return good;
+}
+
+bool
+testFixed()
+{
+    if (!testFixedSize<3, float>()) return false;
+    if (!testFixedSize<256, float>()) return false;
+    if (!testFixedSize<1025, double>()) return false;
+    if (!testFixedSize<BQ_FIXED_SIZE_LIMIT + 7, float>()) return false;
+
+    // Pack and unpack the 129 bins of a 256-point spectrum, as the
+    // FFT implementations do, with loops of runtime length and then
+    // with the fixed-size functions
+
+    const int bins = 129;
+    float *re = allocate<float>(bins), *im = allocate<float>(bins);
+    float *pairs = allocate<float>(bins * 2);
+    for (int i = 0; i < bins; ++i) {
+	re[i] = float(drand48());
+	im[i] = float(drand48());
+    }
+
+    int iterations = 2000000;
+    float divisor = float(CLOCKS_PER_SEC) / 1000.f;
+    int count = bins;
+    if (drand48() > 2.0) count = 0; // as the compiler can't tell
+
+    clock_t start = clock();
+    for (int j = 0; j < iterations; ++j) {
+	for (int i = 0; i < count; ++i) {
+	    pairs[i*2] = re[i];
+	    pairs[i*2+1] = im[i];
+	}
+	pairs[j % count] += 1.f;
+	for (int i = 0; i < count; ++i) {
+	    re[i] = pairs[i*2];
+	    im[i] = pairs[i*2+1];
+	}
+    }
+    clock_t end = clock();
+
+    cerr << "Time for runtime-length complex pack and unpack: " << float(end - start)/divisor << endl;
+
+    start = clock();
+    for (int j = 0; j < iterations; ++j) {
+	v_interleave_complex<bins>(pairs, re, im);
+	pairs[j % bins] += 1.f;
+	v_deinterleave_complex<bins>(re, im, pairs);
+    }
+    end = clock();
+
+    cerr << "Time for fixed-size complex pack and unpack: " << float(end - start)/divisor
+	 << " (" << re[0] << ")" << endl;
+
+    deallocate(re);
+    deallocate(im);
+    deallocate(pairs);
+    return true;
+}
+
+#ifdef HAVE_BQ_SIMD
+
+template <typename T>
+bool
+compareSIMD(const char *name, const T *a, const T *b, int n, double tolerance)
+{
+    for (int i = 0; i < n; ++i) {
+        double diff = fabs(double(a[i]) - double(b[i]));
+        double mag = fabs(double(b[i]));
+        if (diff > tolerance * (mag > 1.0 ? mag : 1.0)) {
+            cerr << "testVectorOps: " << name << " differs at index " << i
+                 << " of " << n << ": " << a[i] << " vs " << b[i] << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+bool
+testSIMDType(const char *type, double tolerance)
+{
+    cerr << "testVectorOps: testing SIMD " << type << " functions" << endl;
+
+    // Lengths around the vector widths, to exercise the scalar
+    // remainder handling as well as the vector loops
+    const int N = 67;
+    T src1[N], src2[N], target[N];
+    T expected[N] = { 0 };
+
+    for (int n = 0; n <= N; n += (n < 20 ? 1 : 15)) {
+
+	for (int i = 0; i < n; ++i) {
+	    src1[i] = T(drand48());
+	    src2[i] = T(drand48() + 1.5);
+	}
+
+	v_copy(target, src1, n);
+	v_add(target, src2, n);
+	for (int i = 0; i < n; ++i) expected[i] = src1[i] + src2[i];
+	if (!compareSIMD("v_add", target, expected, n, tolerance)) return false;
+
+	v_copy(target, src1, n);
+	v_add_with_gain(target, src2, T(0.3), n);
+	for (int i = 0; i < n; ++i) expected[i] = src1[i] + src2[i] * T(0.3);
+	if (!compareSIMD("v_add_with_gain", target, expected, n, tolerance)) return false;
+
+	v_copy(target, src1, n);
+	v_subtract(target, src2, n);
+	for (int i = 0; i < n; ++i) expected[i] = src1[i] - src2[i];
+	if (!compareSIMD("v_subtract", target, expected, n, tolerance)) return false;
+
+	v_copy(target, src1, n);
+	v_scale(target, T(-2.5), n);
+	for (int i = 0; i < n; ++i) expected[i] = src1[i] * T(-2.5);
+	if (!compareSIMD("v_scale", target, expected, n, tolerance)) return false;
+
+	v_multiply(target, src1, src2, n);
+	for (int i = 0; i < n; ++i) expected[i] = src1[i] * src2[i];
+	if (!compareSIMD("v_multiply", target, expected, n, tolerance)) return false;
+
+	v_copy(target, src1, n);
+	v_divide(target, src2, n);
+	for (int i = 0; i < n; ++i) expected[i] = src1[i] / src2[i];
+	if (!compareSIMD("v_divide", target, expected, n, tolerance)) return false;
+
+	v_copy(target, src1, n);
+	v_multiply_and_add(target, src1, src2, n);
+	for (int i = 0; i < n; ++i) expected[i] = src1[i] + src1[i] * src2[i];
+	if (!compareSIMD("v_multiply_and_add", target, expected, n, tolerance)) return false;
+
+	v_copy(target, src2, n);
+	v_sqrt(target, n);
+	for (int i = 0; i < n; ++i) expected[i] = sqrt(src2[i]);
+	if (!compareSIMD("v_sqrt", target, expected, n, tolerance)) return false;
+
+	v_copy(target, src1, n);
+	v_abs(target, n);
+	for (int i = 0; i < n; ++i) expected[i] = fabs(src1[i]);
+	if (!compareSIMD("v_abs", target, expected, n, tolerance)) return false;
+
+	v_copy(target, src2, n);
+	v_log(target, n);
+	for (int i = 0; i < n; ++i) expected[i] = log(src2[i]);
+	if (!compareSIMD("v_log", target, expected, n, tolerance)) return false;
+
+	v_copy(target, src1, n);
+	v_scale(target, T(40), n);
+	v_exp(target, n);
+	for (int i = 0; i < n; ++i) expected[i] = exp(src1[i] * T(40));
+	if (!compareSIMD("v_exp", target, expected, n, tolerance)) return false;
+
+	T sum = 0, dot = 0;
+	for (int i = 0; i < n; ++i) {
+	    sum += src1[i];
+	    dot += src1[i] * src2[i];
+	}
+	T result = v_sum(src1, n);
+	if (!compareSIMD("v_sum", &result, &sum, 1, tolerance * N)) return false;
+	result = v_multiply_and_sum(src1, src2, n);
+	if (!compareSIMD("v_multiply_and_sum", &result, &dot, 1, tolerance * N)) return false;
+    }
+
+    const int M = 1024;
+    T *a = allocate<T>(M), *b = allocate<T>(M), *c = allocate_and_zero<T>(M);
+    for (int i = 0; i < M; ++i) {
+	a[i] = T(drand48());
+	b[i] = T(drand48());
+    }
+
+    int iterations = 50000;
+    float divisor = float(CLOCKS_PER_SEC) / 1000.f;
+
+    clock_t start = clock();
+    for (int j = 0; j < iterations; ++j) {
+	for (int i = 0; i < M; ++i) {
+	    c[i] += a[i] * b[i];
+	}
+    }
+    clock_t end = clock();
+
+    cerr << "Time for naive multiply-and-add: " << float(end - start)/divisor << endl;
+
+    start = clock();
+    for (int j = 0; j < iterations; ++j) {
+	v_multiply_and_add(c, a, b, M);
+    }
+    end = clock();
+
+    cerr << "Time for v_multiply_and_add: " << float(end - start)/divisor << endl;
+
+    deallocate(a);
+    deallocate(b);
+    deallocate(c);
+
+    return true;
+}
+
+template <typename T>
+bool
+comparePhases(const char *name, const T *a, const T *b, int n, double tolerance)
+{
+    // Modulo 2pi, as the approximations may give pi where atan2
+    // gives -pi
+    for (int i = 0; i < n; ++i) {
+        double diff = fabs(double(a[i]) - double(b[i]));
+        if (diff > M_PI) diff = fabs(diff - 2.0 * M_PI);
+        if (diff > tolerance) {
+            cerr << "testVectorOps: " << name << " differs at index " << i
+                 << " of " << n << ": " << a[i] << " vs " << b[i] << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+bool
+testSIMDPolar(const char *type, PolarAccuracy accuracy, double tolerance)
+{
+    cerr << "testVectorOps: testing SIMD " << type << " polar conversions at "
+         << (accuracy == PolarFast ? "fast" : "precise") << " accuracy" << endl;
+
+    const int N = 67;
+    T re[N], im[N], cplx[N*2], mag[N], phase[N];
+    T target1[N], target2[N], expected1[N], expected2[N];
+
+    for (int n = 0; n <= N; n += (n < 20 ? 1 : 15)) {
+
+	// Some phases well outside -pi..pi, including a few beyond the
+	// range the approximations reduce themselves
+	for (int i = 0; i < n; ++i) {
+	    re[i] = T(drand48() * 2.0 - 1.0);
+	    im[i] = T(drand48() * 2.0 - 1.0);
+	    cplx[i*2] = re[i];
+	    cplx[i*2+1] = im[i];
+	    mag[i] = T(fabs(drand48()) * 10.0);
+	    phase[i] = T((drand48() * 2.0 - 1.0) * (i % 7 == 3 ? 20000.0 : 40.0));
+	}
+
+	v_cartesian_to_polar(expected1, expected2, re, im, n);
+	v_cartesian_to_polar(target1, target2, re, im, n, accuracy);
+	if (!compareSIMD("v_cartesian_to_polar magnitude",
+			 target1, expected1, n, tolerance)) return false;
+	if (!comparePhases("v_cartesian_to_polar phase",
+			   target2, expected2, n, tolerance)) return false;
+
+	v_cartesian_interleaved_to_polar(target1, target2, cplx, n, accuracy);
+	if (!compareSIMD("v_cartesian_interleaved_to_polar magnitude",
+			 target1, expected1, n, tolerance)) return false;
+	if (!comparePhases("v_cartesian_interleaved_to_polar phase",
+			   target2, expected2, n, tolerance)) return false;
+
+	v_polar_to_cartesian(expected1, expected2, mag, phase, n);
+	v_polar_to_cartesian(target1, target2, mag, phase, n, accuracy);
+	if (!compareSIMD("v_polar_to_cartesian real",
+			 target1, expected1, n, tolerance * 10.0)) return false;
+	if (!compareSIMD("v_polar_to_cartesian imaginary",
+			 target2, expected2, n, tolerance * 10.0)) return false;
+
+	v_polar_to_cartesian_interleaved(cplx, mag, phase, n, accuracy);
+	for (int i = 0; i < n; ++i) {
+	    target1[i] = cplx[i*2];
+	    target2[i] = cplx[i*2+1];
+	}
+	if (!compareSIMD("v_polar_to_cartesian_interleaved real",
+			 target1, expected1, n, tolerance * 10.0)) return false;
+	if (!compareSIMD("v_polar_to_cartesian_interleaved imaginary",
+			 target2, expected2, n, tolerance * 10.0)) return false;
+    }
+
+    return true;
+}
+
+template <typename T>
+bool
+testSIMDComplex(const char *type, double tolerance)
+{
+    cerr << "testVectorOps: testing SIMD " << type << " complex multiply" << endl;
+
+    const int N = 37;
+    bq_complex<T> src1[N], src2[N], target[N], expected[N];
+
+    for (int n = 0; n <= N; ++n) {
+
+	for (int i = 0; i < n; ++i) {
+	    src1[i].re = T(drand48() * 2.0 - 1.0);
+	    src1[i].im = T(drand48() * 2.0 - 1.0);
+	    src2[i].re = T(drand48() * 2.0 - 1.0);
+	    src2[i].im = T(drand48() * 2.0 - 1.0);
+	    c_multiply(expected[i], src1[i], src2[i]);
+	}
+
+	v_multiply(target, src1, src2, n);
+	if (!compareSIMD("v_multiply complex", (const T *)target,
+			 (const T *)expected, n * 2, tolerance)) return false;
+
+	v_copy(target, src1, n);
+	v_multiply(target, src2, n);
+	if (!compareSIMD("v_multiply complex in place", (const T *)target,
+			 (const T *)expected, n * 2, tolerance)) return false;
+
+	v_copy(target, src2, n);
+	v_multiply_and_add(target, src1, src2, n);
+	v_add(expected, src2, n);
+	if (!compareSIMD("v_multiply_and_add complex", (const T *)target,
+			 (const T *)expected, n * 2, tolerance)) return false;
+    }
+
+    return true;
+}
+
+bool
+testSIMD()
+{
+    cerr << "testVectorOps: SIMD instruction set is "
+         << v_simd_instruction_set() << endl;
+
+    if (!testSIMDType<float>("float", 1e-5)) return false;
+    if (!testSIMDType<double>("double", 1e-12)) return false;
+
+    if (!testSIMDPolar<float>("float", PolarPrecise, 1e-5)) return false;
+    if (!testSIMDPolar<float>("float", PolarFast, 2e-3)) return false;
+    if (!testSIMDPolar<double>("double", PolarPrecise, 1e-6)) return false;
+    if (!testSIMDPolar<double>("double", PolarFast, 2e-3)) return false;
+
+    if (!testSIMDComplex<float>("float", 1e-5)) return false;
+    if (!testSIMDComplex<double>("double", 1e-12)) return false;
+
+    float f[37], fback[37];
+    double d[37];
+    for (int i = 0; i < 37; ++i) f[i] = float(drand48());
+    v_convert(d, f, 37);
+    v_convert(fback, d, 37);
+    for (int i = 0; i < 37; ++i) {
+	if (d[i] != double(f[i]) || fback[i] != f[i]) {
+	    cerr << "testVectorOps: v_convert differs at index " << i << endl;
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+#endif
+
 bool
 testVectorOps()
 {
     if (!testMultiply()) return false;
     if (!testPolarToCart()) return false;
     if (!testPolarToCartInterleaved()) return false;
+    if (!testFused()) return false;
+    if (!testPCM()) return false;
+    if (!testReductions()) return false;
+    if (!testFixed()) return false;
+#ifdef HAVE_BQ_SIMD
+    if (!testSIMD()) return false;
+#endif
     
     return true;
 }
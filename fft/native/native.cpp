@@ -1,59 +1,296 @@
 
 #include <bqfft/FFT.h>
+#include <bqvec/Allocators.h>
 
 #include <vector>
+#include <string>
+#include <set>
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <cmath>
 #include <chrono>
 
 using namespace std;
 using namespace breakfastquay;
 
-int main(int argc, char **argv)
+// Times every compiled-in FFT implementation, at each size, for each
+// precision and each of the forward and inverse functions, and writes
+// the results to stdout as JSON. Progress goes to stderr.
+//
+// All buffers are allocated (aligned) and the FFT objects initialised
+// before any timing starts, so nothing but the transforms themselves
+// runs in the timed loop. Each sample times a batch of transforms
+// long enough to be well above the clock resolution, and the median
+// and 99th percentile of the per-transform time are reported over
+// all samples.
+//
+// Usage: native [-i implementation] [-n samples] [size ...]
+
+enum Function {
+    Forward,
+    ForwardInterleaved,
+    ForwardPolar,
+    ForwardMagnitude,
+    Inverse,
+    InverseInterleaved,
+    InversePolar,
+    InverseCepstral
+};
+
+static const char *functionNames[] = {
+    "forward",
+    "forwardInterleaved",
+    "forwardPolar",
+    "forwardMagnitude",
+    "inverse",
+    "inverseInterleaved",
+    "inversePolar",
+    "inverseCepstral"
+};
+
+static const int functionCount = 8;
+
+template <typename T>
+struct Buffers
+{
+    // time-domain in and out, frequency-domain in (as both split and
+    // interleaved complex) and out
+    T *time;
+    T *timeOut;
+    T *re;
+    T *im;
+    T *complex;
+    T *reOut;
+    T *imOut;
+    T *complexOut;
+
+    Buffers(int size) {
+	const int hs = size/2;
+	time = allocate<T>(size);
+	timeOut = allocate_and_zero<T>(size);
+	re = allocate<T>(hs + 1);
+	im = allocate<T>(hs + 1);
+	complex = allocate<T>((hs + 1) * 2);
+	reOut = allocate_and_zero<T>(hs + 1);
+	imOut = allocate_and_zero<T>(hs + 1);
+	complexOut = allocate_and_zero<T>((hs + 1) * 2);
+
+	// Arbitrary but repeatable input. The frequency-domain input
+	// serves as magnitude and phase as well as real and imaginary
+	// parts, so keep the real part positive for the cepstrum
+	for (int i = 0; i < size; ++i) {
+	    time[i] = T(sin(i * 0.37) + 0.5 * cos(i * 1.91));
+	}
+	for (int i = 0; i <= hs; ++i) {
+	    re[i] = T(1.0 + 0.5 * sin(i * 0.53));
+	    im[i] = T(cos(i * 0.29));
+	    complex[i*2] = re[i];
+	    complex[i*2+1] = im[i];
+	}
+	im[0] = T(0);
+	complex[1] = T(0);
+	if (size % 2 == 0) {
+	    im[hs] = T(0);
+	    complex[hs*2+1] = T(0);
+	}
+    }
+
+    ~Buffers() {
+	deallocate(time);
+	deallocate(timeOut);
+	deallocate(re);
+	deallocate(im);
+	deallocate(complex);
+	deallocate(reOut);
+	deallocate(imOut);
+	deallocate(complexOut);
+    }
+
+    // Something derived from the latest output, so that the compiler
+    // cannot discard the transforms that produced it
+    double check() const {
+	return double(timeOut[1]) + double(reOut[1]) + double(imOut[1])
+	    + double(complexOut[2]);
+    }
+
+private:
+    Buffers(const Buffers &);
+    Buffers &operator=(const Buffers &);
+};
+
+template <typename T>
+static void
+run(FFT &fft, Function fn, Buffers<T> &b, int count)
+{
+    switch (fn) {
+    case Forward:
+	for (int i = 0; i < count; ++i) fft.forward(b.time, b.reOut, b.imOut);
+	break;
+    case ForwardInterleaved:
+	for (int i = 0; i < count; ++i) fft.forwardInterleaved(b.time, b.complexOut);
+	break;
+    case ForwardPolar:
+	for (int i = 0; i < count; ++i) fft.forwardPolar(b.time, b.reOut, b.imOut);
+	break;
+    case ForwardMagnitude:
+	for (int i = 0; i < count; ++i) fft.forwardMagnitude(b.time, b.reOut);
+	break;
+    case Inverse:
+	for (int i = 0; i < count; ++i) fft.inverse(b.re, b.im, b.timeOut);
+	break;
+    case InverseInterleaved:
+	for (int i = 0; i < count; ++i) fft.inverseInterleaved(b.complex, b.timeOut);
+	break;
+    case InversePolar:
+	for (int i = 0; i < count; ++i) fft.inversePolar(b.re, b.im, b.timeOut);
+	break;
+    case InverseCepstral:
+	for (int i = 0; i < count; ++i) fft.inverseCepstral(b.re, b.timeOut);
+	break;
+    }
+}
+
+struct Result
+{
+    double median;
+    double p99;
+};
+
+typedef chrono::steady_clock Clock;
+
+static double check = 0.0;
+
+template <typename T>
+static Result
+measure(FFT &fft, Function fn, Buffers<T> &b, int samples)
 {
-    vector<int> sizes { 512, 2048 };
+    // Warm up, then find a batch size for which one sample takes at
+    // least 50us
 
-    int iterations = 2000;
-    int times = 100;
+    run(fft, fn, b, 4);
 
-    for (auto size: sizes) {
+    int batch = 1;
+    while (true) {
+	auto start = Clock::now();
+	run(fft, fn, b, batch);
+	auto end = Clock::now();
+	double ns = chrono::duration<double, nano>(end - start).count();
+	if (ns >= 50000.0 || batch >= (1 << 20)) break;
+	batch *= 2;
+    }
+
+    vector<double> times(samples);
+
+    for (int s = 0; s < samples; ++s) {
+	auto start = Clock::now();
+	run(fft, fn, b, batch);
+	auto end = Clock::now();
+	times[s] = chrono::duration<double, nano>(end - start).count() / batch;
+	check += b.check();
+    }
 
-	FFT fft(size);
-	double total = 0.0;
+    sort(times.begin(), times.end());
 
-	auto start = chrono::high_resolution_clock::now();
+    Result r;
+    r.median = times[samples / 2];
+    r.p99 = times[min(samples - 1, int(ceil(samples * 0.99)) - 1)];
+    return r;
+}
+
+template <typename T>
+static void
+benchmark(string impl, int size, string precision, int samples, bool &first)
+{
+    FFT fft(size);
+    Buffers<T> b(size);
 
-	for (int ti = 0; ti < times; ++ti) {
-	    
-	    total = 0.0;
+    if (precision == "float") fft.initFloat();
+    else fft.initDouble();
 
-	    for (int i = 0; i < iterations; ++i) {
+    // "Nominal" flop count for a complex transform of this size, the
+    // usual convention when comparing FFTs
+    const double flops = 5.0 * size * log2(double(size));
 
-		vector<double> ri(size), ro(size/2+1), io(size/2+1);
-		for (int j = 0; j < size; ++j) {
-		    ri[j] = (j % 2) / 4.0;
-		}
+    for (int f = 0; f < functionCount; ++f) {
+
+	Function fn = Function(f);
+	Result r = measure(fft, fn, b, samples);
+
+	cerr << impl << " " << size << " " << precision << " "
+	     << functionNames[f] << ": median " << r.median << " ns, p99 "
+	     << r.p99 << " ns" << endl;
+
+	cout << (first ? "" : ",\n")
+	     << "    { \"implementation\": \"" << impl << "\""
+	     << ", \"size\": " << size
+	     << ", \"precision\": \"" << precision << "\""
+	     << ", \"function\": \"" << functionNames[f] << "\""
+	     << ", \"samples\": " << samples
+	     << ", \"median_ns\": " << r.median
+	     << ", \"p99_ns\": " << r.p99
+	     << ", \"mflops\": " << (flops / r.median) * 1000.0
+	     << " }";
+
+	first = false;
+    }
+}
 
-		fft.forward(ri.data(), ro.data(), io.data());
+static void
+usage(const char *name)
+{
+    cerr << "Usage: " << name << " [-i implementation] [-n samples] [size ...]" << endl;
+    cerr << "Available implementations:";
+    set<string> impls = FFT::getImplementations();
+    for (auto i: impls) cerr << " " << i;
+    cerr << endl;
+    exit(2);
+}
 
-		for (int j = 0; j <= size/2; ++j) {
-		    total += sqrt(ro[j] * ro[j] + io[j] * io[j]);
-		}
+int main(int argc, char **argv)
+{
+    vector<int> sizes;
+    set<string> impls = FFT::getImplementations();
+    int samples = 201;
 
-		// synthesise the conjugate half
-		for (int j = 1; j < size/2; ++j) {
-		    total += sqrt(ro[j] * ro[j] + io[j] * io[j]);
-		}
-	    }
+    for (int i = 1; i < argc; ++i) {
+	if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+	    string impl = argv[++i];
+	    if (impls.find(impl) == impls.end()) usage(argv[0]);
+	    impls = { impl };
+	} else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+	    samples = atoi(argv[++i]);
+	    if (samples < 1) usage(argv[0]);
+	} else {
+	    int size = atoi(argv[i]);
+	    if (size < 2) usage(argv[0]);
+	    sizes.push_back(size);
 	}
+    }
+
+    if (sizes.empty()) {
+	sizes = { 512, 2048 };
+    }
 
-	auto end = chrono::high_resolution_clock::now();
+    string defaultImpl = FFT::getDefaultImplementation();
+    bool first = true;
 
-	double ms = chrono::duration<double, milli>(end - start).count() / times;
-	
-	cerr << "for " << iterations << " * size " << size << ": total = "
-	     << total << ", time = " << ms
-	     << " ms (" << (iterations / (ms / 1000.0)) << " itr/sec)" << endl;
+    cout.precision(6);
+    cout << "{\n  \"results\": [\n";
+
+    for (auto impl: impls) {
+
+	FFT::setDefaultImplementation(impl);
+
+	for (auto size: sizes) {
+	    benchmark<float>(impl, size, "float", samples, first);
+	    benchmark<double>(impl, size, "double", samples, first);
+	}
     }
+
+    cout << "\n  ],\n  \"check\": " << check << "\n}" << endl;
+
+    FFT::setDefaultImplementation(defaultImpl);
 }
 